@@ -53,6 +53,8 @@
 #define CONFDB_SERVICE_DEBUG_TIMESTAMPS "debug_timestamps"
 #define CONFDB_SERVICE_DEBUG_MICROSECONDS "debug_microseconds"
 #define CONFDB_SERVICE_DEBUG_TO_FILES "debug_to_files"
+#define CONFDB_SERVICE_DEBUG_RING_LEVEL "debug_ring_level"
+#define CONFDB_SERVICE_DEBUG_ASYNC "debug_async"
 #define CONFDB_SERVICE_TIMEOUT "timeout"
 #define CONFDB_SERVICE_FORCE_TIMEOUT "force_timeout"
 #define CONFDB_SERVICE_RECON_RETRIES "reconnection_retries"
@@ -81,6 +83,8 @@
 #define CONFDB_NSS_CONF_ENTRY "config/nss"
 #define CONFDB_NSS_ENUM_CACHE_TIMEOUT "enum_cache_timeout"
 #define CONFDB_NSS_ENTRY_CACHE_NOWAIT_PERCENTAGE "entry_cache_nowait_percentage"
+#define CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD "entry_cache_refresh_ahead"
+#define CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD_HITS "entry_cache_refresh_ahead_hits"
 #define CONFDB_NSS_ENTRY_NEG_TIMEOUT "entry_negative_timeout"
 #define CONFDB_NSS_FILTER_USERS_IN_GROUPS "filter_users_in_groups"
 #define CONFDB_NSS_FILTER_USERS "filter_users"
@@ -102,8 +106,14 @@
 #define CONFDB_DEFAULT_PAM_FAILED_LOGIN_ATTEMPTS 0
 #define CONFDB_PAM_FAILED_LOGIN_DELAY "offline_failed_login_delay"
 #define CONFDB_DEFAULT_PAM_FAILED_LOGIN_DELAY 5
+#define CONFDB_PAM_VERIFIER_TIMEOUT "offline_auth_verifier_timeout"
+#define CONFDB_DEFAULT_PAM_VERIFIER_TIMEOUT 300
+#define CONFDB_PAM_WRITE_DELAY "offline_auth_write_delay"
+#define CONFDB_DEFAULT_PAM_WRITE_DELAY 5
 #define CONFDB_PAM_VERBOSITY "pam_verbosity"
 #define CONFDB_PAM_ID_TIMEOUT "pam_id_timeout"
+#define CONFDB_PAM_ACCT_CACHE_TIMEOUT "pam_acct_mgmt_cache_timeout"
+#define CONFDB_DEFAULT_PAM_ACCT_CACHE_TIMEOUT 5
 #define CONFDB_PAM_PWD_EXPIRATION_WARNING "pam_pwd_expiration_warning"
 
 /* SUDO */
@@ -159,6 +169,9 @@
 #define CONFDB_DOMAIN_SUBDOMAIN_HOMEDIR "subdomain_homedir"
 #define CONFDB_DOMAIN_DEFAULT_SUBDOMAIN_HOMEDIR "/home/%d/%u"
 #define CONFDB_DOMAIN_IGNORE_GROUP_MEMBERS "ignore_group_members"
+#define CONFDB_DOMAIN_BINARY_IPC "dp_binary_ipc"
+#define CONFDB_DOMAIN_DP_BATCH_WINDOW "dp_batch_window"
+#define CONFDB_DOMAIN_DP_BATCH_MAX "dp_batch_max"
 
 #define CONFDB_DOMAIN_USER_CACHE_TIMEOUT "entry_cache_user_timeout"
 #define CONFDB_DOMAIN_GROUP_CACHE_TIMEOUT "entry_cache_group_timeout"
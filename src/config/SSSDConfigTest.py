@@ -285,6 +285,8 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'debug_timestamps',
             'debug_microseconds',
             'debug_to_files',
+            'debug_ring_level',
+            'debug_async',
             'command',
             'reconnection_retries',
             'fd_limit',
@@ -484,6 +486,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'description',
             'debug_level',
             'debug_timestamps',
+            'debug_ring_level',
+            'debug_async',
             'min_id',
             'max_id',
             'timeout',
@@ -495,6 +499,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'store_legacy_passwords',
             'use_fully_qualified_names',
             'ignore_group_members',
+            'dp_binary_ipc',
+            'dp_batch_window',
+            'dp_batch_max',
             'filter_users',
             'filter_groups',
             'entry_cache_timeout',
@@ -508,6 +515,13 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'account_cache_expiration',
             'dns_resolver_timeout',
             'dns_discovery_domain',
+            'dns_cache_max_ttl',
+            'dns_cache_negative_ttl',
+            'dns_cache_prefetch_percentage',
+            'failover_probe_servers',
+            'failover_probe_delay',
+            'failover_probe_timeout',
+            'failover_reprobe_interval',
             'dyndns_update',
             'dyndns_ttl',
             'dyndns_iface',
@@ -613,7 +627,10 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_use_fast',
              'krb5_fast_principal',
              'krb5_canonicalize',
-             'krb5_use_enterprise_principal'])
+             'krb5_use_enterprise_principal',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests',
+             'krb5_renew_max_parallel'])
 
         options = domain.list_options()
 
@@ -772,7 +789,10 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'krb5_use_fast',
             'krb5_fast_principal',
             'krb5_canonicalize',
-            'krb5_use_enterprise_principal']
+            'krb5_use_enterprise_principal',
+            'krb5_child_pool_size',
+            'krb5_child_pool_max_requests',
+            'krb5_renew_max_parallel']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -835,6 +855,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'description',
             'debug_level',
             'debug_timestamps',
+            'debug_ring_level',
+            'debug_async',
             'min_id',
             'max_id',
             'timeout',
@@ -846,6 +868,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'store_legacy_passwords',
             'use_fully_qualified_names',
             'ignore_group_members',
+            'dp_binary_ipc',
+            'dp_batch_window',
+            'dp_batch_max',
             'filter_users',
             'filter_groups',
             'entry_cache_timeout',
@@ -859,6 +884,13 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'lookup_family_order',
             'dns_resolver_timeout',
             'dns_discovery_domain',
+            'dns_cache_max_ttl',
+            'dns_cache_negative_ttl',
+            'dns_cache_prefetch_percentage',
+            'failover_probe_servers',
+            'failover_probe_delay',
+            'failover_probe_timeout',
+            'failover_reprobe_interval',
             'dyndns_update',
             'dyndns_ttl',
             'dyndns_iface',
@@ -965,7 +997,10 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_use_fast',
              'krb5_fast_principal',
              'krb5_canonicalize',
-             'krb5_use_enterprise_principal'])
+             'krb5_use_enterprise_principal',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests',
+             'krb5_renew_max_parallel'])
 
         options = domain.list_options()
 
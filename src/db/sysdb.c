@@ -22,6 +22,7 @@
 
 #include "util/util.h"
 #include "util/strtonum.h"
+#include "util/sss_stats.h"
 #include "util/sss_utf8.h"
 #include "db/sysdb_private.h"
 #include "confdb/confdb.h"
@@ -770,6 +771,8 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb)
     ret = ldb_transaction_start(sysdb->ldb);
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to start ldb transaction! (%d)\n", ret));
+    } else if (sysdb->transaction_nesting++ == 0) {
+        sss_stats_start(&sysdb->transaction_start);
     }
     return sysdb_error_to_errno(ret);
 }
@@ -782,6 +785,12 @@ int sysdb_transaction_commit(struct sysdb_ctx *sysdb)
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to commit ldb transaction! (%d)\n", ret));
     }
+    /* ldb ends the transaction even if the commit failed */
+    if (sysdb->transaction_nesting > 0
+            && --sysdb->transaction_nesting == 0) {
+        sss_stats_time(SSS_STATS_SYSDB_WRITE, &sysdb->transaction_start,
+                       ret != LDB_SUCCESS);
+    }
     return sysdb_error_to_errno(ret);
 }
 
@@ -793,6 +802,11 @@ int sysdb_transaction_cancel(struct sysdb_ctx *sysdb)
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to cancel ldb transaction! (%d)\n", ret));
     }
+    if (sysdb->transaction_nesting > 0
+            && --sysdb->transaction_nesting == 0) {
+        sss_stats_time(SSS_STATS_SYSDB_WRITE, &sysdb->transaction_start,
+                       true);
+    }
     return sysdb_error_to_errno(ret);
 }
 
@@ -701,6 +701,16 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
                      time_t *_expire_date,
                      time_t *_delayed_until);
 
+/* By default sysdb_cache_auth() writes the login information of the user
+ * before it returns. With a write delay > 0 the updates are collected in
+ * memory and written with a single transaction after write_delay seconds
+ * from the event loop ev. A write delay of 0 writes pending updates and
+ * switches back to the default. */
+errno_t sysdb_cache_auth_set_write_delay(struct sysdb_ctx *sysdb,
+                                         struct tevent_context *ev,
+                                         int write_delay);
+errno_t sysdb_cache_auth_flush(struct sysdb_ctx *sysdb);
+
 int sysdb_store_custom(struct sysdb_ctx *sysdb,
                        struct sss_domain_info *domain,
                        const char *object_name,
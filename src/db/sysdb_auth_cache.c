@@ -0,0 +1,650 @@
+/*
+   SSSD
+
+   System Database - in-memory state of cached authentications
+
+   Copyright (C) 2013 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "db/sysdb_private.h"
+#include "util/crypto/sss_crypto.h"
+
+#define AUTH_CACHE_INIT_SIZE 32
+/* Write the pending updates at once if that many users have some */
+#define AUTH_CACHE_MAX_PENDING 64
+
+#define AUTH_CACHE_PWD_CHANGE "lastCachedPasswordChange"
+
+/* Validating a cached password with s3crypt_sha512() is deliberately
+ * slow. After a password matched the stored hash a keyed SHA1 of it is
+ * kept here for a limited time, so that repeated logins of the same user
+ * during an outage are cheap. The plain text password is never stored
+ * and the verifier is bound to the hash it was checked against, so it
+ * becomes useless as soon as the cached password changes. */
+struct sysdb_auth_cache_entry {
+    struct sysdb_auth_cache_entry *prev;
+    struct sysdb_auth_cache_entry *next;
+
+    struct sysdb_auth_cache *cache;
+    struct sss_domain_info *domain;
+    char *key;
+    char *name;
+
+    char *userhash;
+    char *salt;
+    uint8_t verifier[SSS_SHA1_LENGTH];
+    time_t verifier_expire;
+
+    /* login bookkeeping which was not written to the cache yet */
+    bool pending;
+    time_t last_login;
+    time_t last_failed_login;
+    uint32_t failed_login_attempts;
+    /* the cached password and the last online authentication the
+     * failed_login_attempts were counted for */
+    uint64_t pwd_change;
+    uint64_t online_auth;
+};
+
+struct sysdb_auth_cache {
+    struct sysdb_ctx *sysdb;
+    hash_table_t *users;
+    /* -1 until read from the confdb */
+    int verifier_timeout;
+
+    struct tevent_context *ev;
+    int write_delay;
+    struct tevent_timer *flush_timer;
+    struct sysdb_auth_cache_entry *pending;
+    unsigned int num_pending;
+};
+
+static int sysdb_auth_cache_entry_destructor(void *ptr)
+{
+    struct sysdb_auth_cache_entry *entry =
+            talloc_get_type(ptr, struct sysdb_auth_cache_entry);
+
+    if (entry->pending) {
+        DLIST_REMOVE(entry->cache->pending, entry);
+        entry->cache->num_pending--;
+    }
+
+    safezero(entry->verifier, sizeof(entry->verifier));
+    if (entry->salt != NULL) {
+        safezero(entry->salt, strlen(entry->salt));
+    }
+
+    return 0;
+}
+
+static errno_t sysdb_auth_cache_get(struct sysdb_ctx *sysdb,
+                                    struct sysdb_auth_cache **_cache)
+{
+    struct sysdb_auth_cache *cache;
+    errno_t ret;
+
+    if (sysdb->auth_cache != NULL) {
+        *_cache = sysdb->auth_cache;
+        return EOK;
+    }
+
+    cache = talloc_zero(sysdb, struct sysdb_auth_cache);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+    cache->sysdb = sysdb;
+    cache->verifier_timeout = -1;
+
+    ret = sss_hash_create(cache, AUTH_CACHE_INIT_SIZE, &cache->users);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("sss_hash_create failed.\n"));
+        talloc_free(cache);
+        return ret;
+    }
+
+    sysdb->auth_cache = cache;
+    *_cache = cache;
+    return EOK;
+}
+
+errno_t sysdb_auth_cache_init(struct sysdb_ctx *sysdb,
+                              struct confdb_ctx *cdb)
+{
+    struct sysdb_auth_cache *cache;
+    errno_t ret;
+
+    ret = sysdb_auth_cache_get(sysdb, &cache);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (cache->verifier_timeout >= 0) {
+        return EOK;
+    }
+
+    ret = confdb_get_int(cdb, CONFDB_PAM_CONF_ENTRY,
+                         CONFDB_PAM_VERIFIER_TIMEOUT,
+                         CONFDB_DEFAULT_PAM_VERIFIER_TIMEOUT,
+                         &cache->verifier_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Failed to read [%s], disabling the verifier cache.\n",
+               CONFDB_PAM_VERIFIER_TIMEOUT));
+        cache->verifier_timeout = 0;
+        return ret;
+    }
+
+    if (cache->verifier_timeout < 0) {
+        cache->verifier_timeout = 0;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Password verifiers are kept for [%d] "
+                              "seconds.\n", cache->verifier_timeout));
+    return EOK;
+}
+
+static struct sysdb_auth_cache_entry *
+sysdb_auth_cache_lookup(struct sysdb_auth_cache *cache,
+                        struct sss_domain_info *domain,
+                        const char *name,
+                        bool create)
+{
+    struct sysdb_auth_cache_entry *entry;
+    hash_key_t key;
+    hash_value_t value;
+    char *strkey;
+    int hret;
+
+    strkey = talloc_asprintf(cache, "%s@%s", name, domain->name);
+    if (strkey == NULL) {
+        return NULL;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = strkey;
+
+    hret = hash_lookup(cache->users, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        talloc_free(strkey);
+        return talloc_get_type(value.ptr, struct sysdb_auth_cache_entry);
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        DEBUG(SSSDBG_OP_FAILURE, ("hash_lookup failed [%s].\n",
+                                  hash_error_string(hret)));
+        talloc_free(strkey);
+        return NULL;
+    }
+
+    if (!create) {
+        talloc_free(strkey);
+        return NULL;
+    }
+
+    entry = talloc_zero(cache, struct sysdb_auth_cache_entry);
+    if (entry == NULL) {
+        talloc_free(strkey);
+        return NULL;
+    }
+    entry->cache = cache;
+    entry->domain = domain;
+    entry->key = talloc_steal(entry, strkey);
+    entry->name = talloc_strdup(entry, name);
+    if (entry->name == NULL) {
+        talloc_free(entry);
+        return NULL;
+    }
+    talloc_set_destructor((TALLOC_CTX *) entry,
+                          sysdb_auth_cache_entry_destructor);
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+
+    hret = hash_enter(cache->users, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("hash_enter failed [%s].\n",
+                                  hash_error_string(hret)));
+        talloc_free(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+static void sysdb_auth_cache_drop(struct sysdb_auth_cache_entry *entry)
+{
+    hash_key_t key;
+
+    key.type = HASH_KEY_STRING;
+    key.str = entry->key;
+    hash_delete(entry->cache->users, &key);
+
+    talloc_free(entry);
+}
+
+static void sysdb_auth_cache_wipe_verifier(struct sysdb_auth_cache_entry *entry)
+{
+    safezero(entry->verifier, sizeof(entry->verifier));
+    if (entry->salt != NULL) {
+        safezero(entry->salt, strlen(entry->salt));
+        talloc_zfree(entry->salt);
+    }
+    talloc_zfree(entry->userhash);
+    entry->verifier_expire = 0;
+
+    if (!entry->pending) {
+        sysdb_auth_cache_drop(entry);
+    }
+}
+
+static errno_t sysdb_auth_cache_hash(const char *salt, const char *password,
+                                     uint8_t *out)
+{
+    return sss_hmac_sha1((const unsigned char *) salt, strlen(salt),
+                         (const unsigned char *) password, strlen(password),
+                         out);
+}
+
+bool sysdb_auth_cache_verify(struct sysdb_ctx *sysdb,
+                             struct sss_domain_info *domain,
+                             const char *name,
+                             const char *userhash,
+                             const char *password)
+{
+    struct sysdb_auth_cache_entry *entry;
+    uint8_t verifier[SSS_SHA1_LENGTH];
+    uint8_t diff = 0;
+    size_t i;
+    errno_t ret;
+
+    if (sysdb->auth_cache == NULL || sysdb->auth_cache->verifier_timeout <= 0) {
+        return false;
+    }
+
+    entry = sysdb_auth_cache_lookup(sysdb->auth_cache, domain, name, false);
+    if (entry == NULL || entry->verifier_expire == 0) {
+        return false;
+    }
+
+    if (entry->verifier_expire < time(NULL)
+            || strcmp(entry->userhash, userhash) != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Verifier of [%s] is no longer valid.\n",
+                                  name));
+        sysdb_auth_cache_wipe_verifier(entry);
+        return false;
+    }
+
+    ret = sysdb_auth_cache_hash(entry->salt, password, verifier);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("sss_hmac_sha1 failed.\n"));
+        return false;
+    }
+
+    for (i = 0; i < SSS_SHA1_LENGTH; i++) {
+        diff |= verifier[i] ^ entry->verifier[i];
+    }
+    safezero(verifier, sizeof(verifier));
+
+    /* A mismatch is not taken as a failed login, the caller falls back to
+     * the full check so that guessing does not become cheaper. */
+    return diff == 0;
+}
+
+void sysdb_auth_cache_remember(struct sysdb_ctx *sysdb,
+                               struct sss_domain_info *domain,
+                               const char *name,
+                               const char *userhash,
+                               const char *password)
+{
+    struct sysdb_auth_cache_entry *entry;
+    errno_t ret;
+
+    if (sysdb->auth_cache == NULL || sysdb->auth_cache->verifier_timeout <= 0) {
+        return;
+    }
+
+    entry = sysdb_auth_cache_lookup(sysdb->auth_cache, domain, name, true);
+    if (entry == NULL) {
+        return;
+    }
+
+    if (entry->salt != NULL) {
+        safezero(entry->salt, strlen(entry->salt));
+        talloc_zfree(entry->salt);
+    }
+    talloc_zfree(entry->userhash);
+
+    ret = s3crypt_gen_salt(entry, &entry->salt);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("s3crypt_gen_salt failed.\n"));
+        goto fail;
+    }
+
+    entry->userhash = talloc_strdup(entry, userhash);
+    if (entry->userhash == NULL) {
+        goto fail;
+    }
+
+    ret = sysdb_auth_cache_hash(entry->salt, password, entry->verifier);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("sss_hmac_sha1 failed.\n"));
+        goto fail;
+    }
+
+    entry->verifier_expire = time(NULL) + sysdb->auth_cache->verifier_timeout;
+    return;
+
+fail:
+    sysdb_auth_cache_wipe_verifier(entry);
+}
+
+static errno_t sysdb_auth_cache_replace_attr(struct ldb_message *msg,
+                                             const char *attr,
+                                             uint64_t value)
+{
+    int ret;
+
+    ldb_msg_remove_attr(msg, attr);
+    ret = ldb_msg_add_fmt(msg, attr, "%llu", (unsigned long long) value);
+    if (ret != LDB_SUCCESS) {
+        return sysdb_error_to_errno(ret);
+    }
+
+    return EOK;
+}
+
+/* Caching a new password or an online authentication resets the failed
+ * login attempts, possibly in another process. A pending counter from
+ * before that must not overwrite the reset. */
+static bool sysdb_auth_cache_was_reset(struct sysdb_auth_cache_entry *entry,
+                                       struct ldb_message *msg)
+{
+    return ldb_msg_find_attr_as_uint64(msg, AUTH_CACHE_PWD_CHANGE, 0)
+                != entry->pwd_change
+           || ldb_msg_find_attr_as_uint64(msg, SYSDB_LAST_ONLINE_AUTH, 0)
+                != entry->online_auth;
+}
+
+errno_t sysdb_auth_cache_apply_pending(struct sysdb_ctx *sysdb,
+                                       struct sss_domain_info *domain,
+                                       const char *name,
+                                       struct ldb_message *msg)
+{
+    struct sysdb_auth_cache_entry *entry;
+    errno_t ret;
+
+    if (sysdb->auth_cache == NULL || sysdb->auth_cache->pending == NULL) {
+        return EOK;
+    }
+
+    entry = sysdb_auth_cache_lookup(sysdb->auth_cache, domain, name, false);
+    if (entry == NULL || !entry->pending) {
+        return EOK;
+    }
+
+    if (sysdb_auth_cache_was_reset(entry, msg)) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Failed login attempts of [%s] were reset, "
+                                  "ignoring the pending ones.\n", name));
+    } else {
+        ret = sysdb_auth_cache_replace_attr(msg, SYSDB_FAILED_LOGIN_ATTEMPTS,
+                                            entry->failed_login_attempts);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if (entry->last_failed_login != 0) {
+        ret = sysdb_auth_cache_replace_attr(msg, SYSDB_LAST_FAILED_LOGIN,
+                                            entry->last_failed_login);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if (entry->last_login != 0) {
+        ret = sysdb_auth_cache_replace_attr(msg, SYSDB_LAST_LOGIN,
+                                            entry->last_login);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+bool sysdb_auth_cache_batched(struct sysdb_ctx *sysdb)
+{
+    return sysdb->auth_cache != NULL
+                && sysdb->auth_cache->ev != NULL
+                && sysdb->auth_cache->write_delay > 0;
+}
+
+static void sysdb_auth_cache_flush_timeout(struct tevent_context *ev,
+                                           struct tevent_timer *te,
+                                           struct timeval tv, void *pvt)
+{
+    struct sysdb_auth_cache *cache = talloc_get_type(pvt,
+                                                     struct sysdb_auth_cache);
+    errno_t ret;
+
+    cache->flush_timer = NULL;
+
+    ret = sysdb_cache_auth_flush(cache->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to write login information "
+                                  "[%d]: %s\n", ret, strerror(ret)));
+    }
+}
+
+static void sysdb_auth_cache_schedule(struct sysdb_auth_cache *cache)
+{
+    struct timeval tv;
+
+    if (cache->flush_timer != NULL || cache->ev == NULL) {
+        return;
+    }
+
+    tv = tevent_timeval_current_ofs(cache->write_delay, 0);
+    cache->flush_timer = tevent_add_timer(cache->ev, cache, tv,
+                                          sysdb_auth_cache_flush_timeout,
+                                          cache);
+    if (cache->flush_timer == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("tevent_add_timer failed.\n"));
+    }
+}
+
+errno_t sysdb_auth_cache_queue(struct sysdb_ctx *sysdb,
+                               struct sss_domain_info *domain,
+                               const char *name,
+                               struct ldb_message *msg,
+                               bool success,
+                               uint32_t failed_login_attempts)
+{
+    struct sysdb_auth_cache *cache = sysdb->auth_cache;
+    struct sysdb_auth_cache_entry *entry;
+
+    entry = sysdb_auth_cache_lookup(cache, domain, name, true);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
+
+    if (success) {
+        entry->last_login = time(NULL);
+    } else {
+        entry->last_failed_login = time(NULL);
+    }
+    entry->failed_login_attempts = failed_login_attempts;
+    entry->pwd_change = ldb_msg_find_attr_as_uint64(msg,
+                                                    AUTH_CACHE_PWD_CHANGE, 0);
+    entry->online_auth = ldb_msg_find_attr_as_uint64(msg,
+                                                     SYSDB_LAST_ONLINE_AUTH, 0);
+
+    if (!entry->pending) {
+        entry->pending = true;
+        DLIST_ADD_END(cache->pending, entry, struct sysdb_auth_cache_entry *);
+        cache->num_pending++;
+    }
+
+    if (cache->num_pending >= AUTH_CACHE_MAX_PENDING) {
+        return sysdb_cache_auth_flush(sysdb);
+    }
+
+    sysdb_auth_cache_schedule(cache);
+    return EOK;
+}
+
+errno_t sysdb_cache_auth_flush(struct sysdb_ctx *sysdb)
+{
+    const char *reset_attrs[] = { AUTH_CACHE_PWD_CHANGE,
+                                  SYSDB_LAST_ONLINE_AUTH, NULL };
+    struct sysdb_auth_cache *cache = sysdb->auth_cache;
+    struct sysdb_auth_cache_entry *entry;
+    struct sysdb_auth_cache_entry *next;
+    struct sysdb_attrs *attrs;
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    unsigned int count = 0;
+    bool in_transaction = false;
+    errno_t ret;
+
+    if (cache == NULL || cache->pending == NULL) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) {
+        goto done;
+    }
+    in_transaction = true;
+
+    for (entry = cache->pending; entry != NULL; entry = entry->next) {
+        ret = sysdb_search_user_by_name(tmp_ctx, sysdb, entry->domain,
+                                        entry->name, reset_attrs, &msg);
+        if (ret == ENOENT) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("User [%s] was removed from the cache "
+                                      "in the meantime.\n", entry->name));
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        attrs = sysdb_new_attrs(tmp_ctx);
+        if (attrs == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        if (entry->last_login != 0) {
+            ret = sysdb_attrs_add_time_t(attrs, SYSDB_LAST_LOGIN,
+                                         entry->last_login);
+            if (ret != EOK) goto done;
+        }
+
+        if (entry->last_failed_login != 0) {
+            ret = sysdb_attrs_add_time_t(attrs, SYSDB_LAST_FAILED_LOGIN,
+                                         entry->last_failed_login);
+            if (ret != EOK) goto done;
+        }
+
+        if (sysdb_auth_cache_was_reset(entry, msg)) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Failed login attempts of [%s] were "
+                                      "reset, not writing the pending "
+                                      "ones.\n", entry->name));
+        } else {
+            ret = sysdb_attrs_add_uint32(attrs, SYSDB_FAILED_LOGIN_ATTEMPTS,
+                                         entry->failed_login_attempts);
+            if (ret != EOK) goto done;
+        }
+
+        if (attrs->num == 0) {
+            continue;
+        }
+
+        ret = sysdb_set_user_attr(sysdb, entry->domain, entry->name,
+                                  attrs, LDB_FLAG_MOD_REPLACE);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Failed to update login information "
+                                      "of [%s].\n", entry->name));
+            goto done;
+        }
+        count++;
+    }
+
+    ret = sysdb_transaction_commit(sysdb);
+    if (ret != EOK) {
+        goto done;
+    }
+    in_transaction = false;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Wrote login information of [%u] users.\n",
+                              count));
+
+    for (entry = cache->pending; entry != NULL; entry = next) {
+        next = entry->next;
+
+        DLIST_REMOVE(cache->pending, entry);
+        cache->num_pending--;
+        entry->pending = false;
+        entry->last_login = 0;
+        entry->last_failed_login = 0;
+
+        if (entry->verifier_expire == 0) {
+            sysdb_auth_cache_drop(entry);
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (in_transaction) {
+        sysdb_transaction_cancel(sysdb);
+    }
+    if (ret != EOK) {
+        /* keep the updates and try again later */
+        sysdb_auth_cache_schedule(cache);
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t sysdb_cache_auth_set_write_delay(struct sysdb_ctx *sysdb,
+                                         struct tevent_context *ev,
+                                         int write_delay)
+{
+    struct sysdb_auth_cache *cache;
+    errno_t ret;
+
+    ret = sysdb_auth_cache_get(sysdb, &cache);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (write_delay <= 0) {
+        talloc_zfree(cache->flush_timer);
+        ret = sysdb_cache_auth_flush(sysdb);
+        cache->ev = NULL;
+        cache->write_delay = 0;
+        return ret;
+    }
+
+    cache->ev = ev;
+    cache->write_delay = write_delay;
+    return EOK;
+}
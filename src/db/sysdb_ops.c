@@ -2819,6 +2819,7 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
                             "accountExpires", SYSDB_FAILED_LOGIN_ATTEMPTS,
                             SYSDB_LAST_FAILED_LOGIN, NULL };
     struct ldb_message *ldb_msg;
+    const char *cname;
     const char *userhash;
     char *comphash;
     uint64_t lastLogin = 0;
@@ -2828,6 +2829,7 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
     bool authentication_successful = false;
     time_t expire_date = -1;
     time_t delayed_until = -1;
+    bool batched;
     int ret;
 
     if (name == NULL || *name == '\0') {
@@ -2850,16 +2852,27 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
         return EINVAL;
     }
 
+    ret = sysdb_auth_cache_init(sysdb, cdb);
+    if (ret != EOK) {
+        /* not fatal, every login is just checked the slow way */
+        DEBUG(SSSDBG_MINOR_FAILURE, ("sysdb_auth_cache_init failed.\n"));
+    }
+
     tmp_ctx = talloc_new(NULL);
     if (!tmp_ctx) {
         return ENOMEM;
     }
 
-    ret = ldb_transaction_start(sysdb->ldb);
-    if (ret) {
-        talloc_zfree(tmp_ctx);
-        ret = sysdb_error_to_errno(ret);
-        return ret;
+    /* If the login information is written later there is nothing to
+     * protect with a transaction here */
+    batched = sysdb_auth_cache_batched(sysdb);
+    if (!batched) {
+        ret = ldb_transaction_start(sysdb->ldb);
+        if (ret) {
+            talloc_zfree(tmp_ctx);
+            ret = sysdb_error_to_errno(ret);
+            return ret;
+        }
     }
 
     ret = sysdb_search_user_by_name(tmp_ctx, sysdb, domain,
@@ -2871,6 +2884,15 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
         goto done;
     }
 
+    cname = ldb_msg_find_attr_as_string(ldb_msg, SYSDB_NAME, name);
+
+    ret = sysdb_auth_cache_apply_pending(sysdb, domain, cname, ldb_msg);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to apply pending login "
+                                  "information.\n"));
+        goto done;
+    }
+
     /* Check offline_auth_cache_timeout */
     lastLogin = ldb_msg_find_attr_as_uint64(ldb_msg,
                                             SYSDB_LAST_ONLINE_AUTH,
@@ -2913,30 +2935,57 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
         goto done;
     }
 
-    ret = s3crypt_sha512(tmp_ctx, password, userhash, &comphash);
-    if (ret) {
-        DEBUG(4, ("Failed to create password hash.\n"));
-        ret = ERR_INTERNAL;
-        goto done;
-    }
+    if (sysdb_auth_cache_verify(sysdb, domain, cname, userhash, password)) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Password matches the cached verifier.\n"));
+        authentication_successful = true;
+    } else {
+        ret = s3crypt_sha512(tmp_ctx, password, userhash, &comphash);
+        if (ret) {
+            DEBUG(4, ("Failed to create password hash.\n"));
+            ret = ERR_INTERNAL;
+            goto done;
+        }
 
-    update_attrs = sysdb_new_attrs(tmp_ctx);
-    if (update_attrs == NULL) {
-        DEBUG(1, ("sysdb_new_attrs failed.\n"));
-        ret = ENOMEM;
-        goto done;
+        if (strcmp(userhash, comphash) == 0) {
+            authentication_successful = true;
+            sysdb_auth_cache_remember(sysdb, domain, cname,
+                                      userhash, password);
+        }
     }
 
-    if (strcmp(userhash, comphash) == 0) {
+    if (authentication_successful) {
         /* TODO: probable good point for audit logging */
         DEBUG(4, ("Hashes do match!\n"));
-        authentication_successful = true;
 
         if (just_check) {
             ret = EOK;
             goto done;
         }
 
+        failed_login_attempts = 0;
+    } else {
+        DEBUG(4, ("Authentication failed.\n"));
+        failed_login_attempts++;
+    }
+
+    if (batched) {
+        ret = sysdb_auth_cache_queue(sysdb, domain, cname, ldb_msg,
+                                     authentication_successful,
+                                     failed_login_attempts);
+        if (ret != EOK) {
+            DEBUG(1, ("Failed to queue Login attempt information!\n"));
+        }
+        goto done;
+    }
+
+    update_attrs = sysdb_new_attrs(tmp_ctx);
+    if (update_attrs == NULL) {
+        DEBUG(1, ("sysdb_new_attrs failed.\n"));
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (authentication_successful) {
         ret = sysdb_attrs_add_time_t(update_attrs,
                                      SYSDB_LAST_LOGIN, time(NULL));
         if (ret != EOK) {
@@ -2954,12 +3003,7 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
             ret = EOK;
             goto done;
         }
-
-
     } else {
-        DEBUG(4, ("Authentication failed.\n"));
-        authentication_successful = false;
-
         ret = sysdb_attrs_add_time_t(update_attrs,
                                      SYSDB_LAST_FAILED_LOGIN,
                                      time(NULL));
@@ -2970,7 +3014,7 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
 
         ret = sysdb_attrs_add_uint32(update_attrs,
                                      SYSDB_FAILED_LOGIN_ATTEMPTS,
-                                     ++failed_login_attempts);
+                                     failed_login_attempts);
         if (ret != EOK) {
             DEBUG(3, ("sysdb_attrs_add_uint32 failed.\n"));
             goto done;
@@ -2978,7 +3022,7 @@ int sysdb_cache_auth(struct sysdb_ctx *sysdb,
     }
 
     ret = sysdb_set_user_attr(sysdb, domain,
-                              name, update_attrs, LDB_FLAG_MOD_REPLACE);
+                              cname, update_attrs, LDB_FLAG_MOD_REPLACE);
     if (ret) {
         DEBUG(1, ("Failed to update Login attempt information!\n"));
     }
@@ -2990,13 +3034,15 @@ done:
     if (_delayed_until != NULL) {
         *_delayed_until = delayed_until;
     }
-    if (ret) {
-        ldb_transaction_cancel(sysdb->ldb);
-    } else {
-        ret = ldb_transaction_commit(sysdb->ldb);
-        ret = sysdb_error_to_errno(ret);
+    if (!batched) {
         if (ret) {
-            DEBUG(2, ("Failed to commit transaction!\n"));
+            ldb_transaction_cancel(sysdb->ldb);
+        } else {
+            ret = ldb_transaction_commit(sysdb->ldb);
+            ret = sysdb_error_to_errno(ret);
+            if (ret) {
+                DEBUG(2, ("Failed to commit transaction!\n"));
+            }
         }
     }
     if (authentication_successful) {
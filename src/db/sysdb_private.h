@@ -82,9 +82,16 @@
 
 #include "db/sysdb.h"
 
+struct sysdb_auth_cache;
+
 struct sysdb_ctx {
     struct ldb_context *ldb;
     char *ldb_file;
+    struct sysdb_auth_cache *auth_cache;
+
+    /* nesting level and start of the outermost transaction */
+    int transaction_nesting;
+    struct timeval transaction_start;
 };
 
 /* Internal utility functions */
@@ -99,6 +106,31 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
                                bool allow_upgrade,
                                struct sysdb_ctx **_ctx);
 
+/* In-memory state of cached authentications, see sysdb_auth_cache.c */
+errno_t sysdb_auth_cache_init(struct sysdb_ctx *sysdb,
+                              struct confdb_ctx *cdb);
+bool sysdb_auth_cache_verify(struct sysdb_ctx *sysdb,
+                             struct sss_domain_info *domain,
+                             const char *name,
+                             const char *userhash,
+                             const char *password);
+void sysdb_auth_cache_remember(struct sysdb_ctx *sysdb,
+                               struct sss_domain_info *domain,
+                               const char *name,
+                               const char *userhash,
+                               const char *password);
+errno_t sysdb_auth_cache_apply_pending(struct sysdb_ctx *sysdb,
+                                       struct sss_domain_info *domain,
+                                       const char *name,
+                                       struct ldb_message *msg);
+bool sysdb_auth_cache_batched(struct sysdb_ctx *sysdb);
+errno_t sysdb_auth_cache_queue(struct sysdb_ctx *sysdb,
+                               struct sss_domain_info *domain,
+                               const char *name,
+                               struct ldb_message *msg,
+                               bool success,
+                               uint32_t failed_login_attempts);
+
 /* Upgrade routines */
 int sysdb_upgrade_01(struct ldb_context *ldb, const char **ver);
 int sysdb_check_upgrade_02(struct sss_domain_info *domains,
@@ -47,6 +47,7 @@
 #define MON_CLI_METHOD_ROTATE "rotateLogs"
 #define MON_CLI_METHOD_CLEAR_MEMCACHE "clearMemcache"
 #define MON_CLI_METHOD_CLEAR_ENUM_CACHE "clearEnumCache"
+#define MON_CLI_METHOD_GET_STATS "getStats"
 
 #define SSSD_SERVICE_PIPE "private/sbus-monitor"
 
@@ -57,6 +58,8 @@ int monitor_common_pong(DBusMessage *message,
                         struct sbus_connection *conn);
 int monitor_common_res_init(DBusMessage *message,
                             struct sbus_connection *conn);
+int monitor_common_get_stats(DBusMessage *message,
+                             struct sbus_connection *conn);
 int monitor_common_rotate_logs(struct confdb_ctx *confdb,
                                const char *conf_entry);
 
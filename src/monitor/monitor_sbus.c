@@ -25,6 +25,7 @@
 #include <resolv.h>
 
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "confdb/confdb.h"
 #include "sbus/sssd_dbus.h"
 #include "sbus/sbus_client.h"
@@ -164,6 +165,39 @@ int monitor_common_pong(DBusMessage *message,
     return EOK;
 }
 
+int monitor_common_get_stats(DBusMessage *message,
+                             struct sbus_connection *conn)
+{
+    DBusMessage *reply;
+    dbus_bool_t ret;
+    char *stats;
+
+    stats = sss_stats_dump(NULL);
+    if (!stats) return ENOMEM;
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) {
+        talloc_free(stats);
+        return ENOMEM;
+    }
+
+    ret = dbus_message_append_args(reply,
+                                   DBUS_TYPE_STRING, &stats,
+                                   DBUS_TYPE_INVALID);
+    if (!ret) {
+        dbus_message_unref(reply);
+        talloc_free(stats);
+        return EIO;
+    }
+
+    /* send reply back */
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+    talloc_free(stats);
+
+    return EOK;
+}
+
 int monitor_common_res_init(DBusMessage *message,
                             struct sbus_connection *conn)
 {
@@ -183,6 +217,7 @@ errno_t monitor_common_rotate_logs(struct confdb_ctx *confdb,
 {
     errno_t ret;
     int old_debug_level = debug_level;
+    int ring_level;
 
     ret = rotate_debug_files();
     if (ret) {
@@ -191,6 +226,30 @@ errno_t monitor_common_rotate_logs(struct confdb_ctx *confdb,
         return ret;
     }
 
+    /* sss_debuglevel ends up here as well, write out what the ring buffer
+     * collected so far */
+    debug_ring_flush();
+
+    ret = confdb_get_int(confdb, conf_path,
+                         CONFDB_SERVICE_DEBUG_RING_LEVEL,
+                         0, &ring_level);
+    if (ret == EOK) {
+        if (ring_level != 0) {
+            ring_level = debug_convert_old_level(ring_level);
+            ret = debug_ring_init();
+            if (ret == EOK) {
+                ret = debug_catch_crashes();
+            }
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE, ("Cannot set up the debug ring "
+                                          "buffer (%d) [%s]\n",
+                                          ret, strerror(ret)));
+                ring_level = 0;
+            }
+        }
+        debug_ring_level = ring_level;
+    }
+
     /* Get new debug level from the confdb */
     ret = confdb_get_int(confdb, conf_path,
                          CONFDB_SERVICE_DEBUG_LEVEL,
@@ -254,6 +254,12 @@ ad_failover_init(TALLOC_CTX *mem_ctx, struct be_ctx *bectx,
         goto done;
     }
 
+    ret = be_fo_enable_probing(bectx, AD_SERVICE_NAME, LDAP_PORT);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to enable server probing!\n"));
+        goto done;
+    }
+
     service->sdap->name = talloc_strdup(service, AD_SERVICE_NAME);
     if (!service->sdap->name) {
         ret = ENOMEM;
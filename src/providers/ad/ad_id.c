@@ -37,6 +37,18 @@ ad_account_info_handler(struct be_req *be_req)
     return sdap_handle_account_info(be_req, sdap_id_ctx);
 }
 
+void
+ad_account_batch_handler(struct be_req *be_req)
+{
+    struct ad_id_ctx *ad_ctx;
+    struct be_ctx *be_ctx = be_req_get_be_ctx(be_req);
+
+    ad_ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                             struct ad_id_ctx);
+
+    return sdap_handle_account_batch(be_req, ad_ctx->sdap_id_ctx);
+}
+
 void
 ad_check_online(struct be_req *be_req)
 {
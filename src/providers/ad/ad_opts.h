@@ -123,6 +123,10 @@ struct dp_option ad_def_ldap_opts[] = {
     { "ldap_initgroups_use_matching_rule_in_chain", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_rfc2307_fallback_to_local_users", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_disable_range_retrieval", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_connection_warmup_time", DP_OPT_NUMBER, { .number = 30 }, NULL_NUMBER },
+    { "ldap_op_trace", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_op_slow_threshold", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_cache_chunk_time", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -145,6 +149,9 @@ struct dp_option ad_def_krb5_opts[] = {
     { "krb5_fast_principal", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_canonicalize", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "krb5_use_enterprise_principal", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_pool_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
+    { "krb5_renew_max_parallel", DP_OPT_NUMBER, { .number = 10 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -421,6 +421,9 @@ static void ad_subdom_online_cb(void *pvt)
         return;
     }
 
+    /* a background refresh, nobody is waiting for it */
+    be_sched_hold(be_req, ctx->be_ctx, BE_SCHED_REFRESH);
+
     ad_subdomains_retrieve(ctx, be_req);
 
     tv = tevent_timeval_current_ofs(AD_SUBDOMAIN_REFRESH_PERIOD, 0);
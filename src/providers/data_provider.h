@@ -45,22 +45,31 @@
 
 #define DATA_PROVIDER_VERSION 0x0001
 #define DATA_PROVIDER_PIPE "private/sbus-dp"
+#define DATA_PROVIDER_BIN_PIPE "private/dp-bin"
 
 #define DP_INTERFACE "org.freedesktop.sssd.dataprovider"
 #define DP_PATH "/org/freedesktop/sssd/dataprovider"
 
 #define DP_METHOD_REGISTER "RegisterService"
 #define DP_METHOD_GETACCTINFO "getAccountInfo"
+/* same as getAccountInfo, but with an array of names instead of the
+ * filter, the single reply covers all of them */
+#define DP_METHOD_GETACCTINFO_BATCH "getAccountInfoBatch"
 #define DP_METHOD_SUDOHANDLER "sudoHandler"
 #define DP_METHOD_AUTOFSHANDLER "autofsHandler"
 #define DP_METHOD_HOSTHANDLER "hostHandler"
 #define DP_METHOD_GETDOMAINS "getDomains"
+#define DP_METHOD_GETSTATS "getStats"
 
 /* this is a reverse method sent from providers to
  * the nss responder to tell it to update the mmap
  * cache */
 #define DP_REV_METHOD_UPDATE_CACHE "updateCache"
 #define DP_REV_METHOD_INITGR_CHECK "initgrCheck"
+/* sent to the pam responder when the access rules of a domain changed */
+#define DP_REV_METHOD_ACCT_CACHE_FLUSH "acctCacheFlush"
+/* sent to the sudo responder when new sudo rules were stored */
+#define DP_REV_METHOD_SUDO_RULES_CHANGED "sudoRulesChanged"
 
 /**
  * @defgroup pamHandler PAM DBUS request
@@ -141,6 +150,7 @@
 #define BE_FILTER_IDNUM 2
 #define BE_FILTER_ENUM 3
 #define BE_FILTER_SECID 4
+#define BE_FILTER_NAME_LIST 5
 
 #define BE_REQ_USER          0x0001
 #define BE_REQ_GROUP         0x0002
@@ -206,10 +216,16 @@ struct pam_data {
 #define SSS_KRB5_INFO 0x40000000
 #define SSS_LDAP_INFO 0x20000000
 #define SSS_PROXY_INFO 0x10000000
+#define SSS_ACCT_INFO 0x08000000
 
 #define SSS_KRB5_INFO_TGT_LIFETIME (SSS_SERVER_INFO|SSS_KRB5_INFO|0x01)
 #define SSS_KRB5_INFO_UPN (SSS_SERVER_INFO|SSS_KRB5_INFO|0x02)
 
+/* Sent by access providers which flush the account management decisions
+ * of the PAM responder when their policy changes, only those decisions
+ * are cached */
+#define SSS_ACCT_INFO_CACHEABLE (SSS_SERVER_INFO|SSS_ACCT_INFO|0x01)
+
 /**
  * @brief Create new zero initialized struct pam_data.
  *
@@ -245,6 +261,70 @@ void dp_id_callback(DBusPendingCall *pending, void *ptr);
 int dp_get_sbus_address(TALLOC_CTX *mem_ctx,
                         char **address, const char *domain_name);
 
+/* from dp_bin.c */
+
+/* The binary channel carries the account requests next to the D-Bus
+ * connection, see dp_bin.c for the framing. */
+#define DP_BIN_HEADER_LEN (3 * sizeof(uint32_t))
+#define DP_BIN_MAX_FRAME 65536
+
+#define DP_BIN_REPLY 0x80000000
+/* request: uint32 entry type, uint32 attr type, string filter,
+ *          string domain
+ * reply:   uint32 dp error, uint32 errno, string error message */
+#define DP_BIN_GETACCTINFO 0x0001
+
+struct dp_bin_conn;
+
+typedef void (dp_bin_frame_fn)(struct dp_bin_conn *conn,
+                               uint32_t type, uint32_t serial,
+                               const uint8_t *body, size_t body_len,
+                               void *pvt);
+typedef void (dp_bin_close_fn)(struct dp_bin_conn *conn, void *pvt);
+typedef void (dp_bin_accept_fn)(struct dp_bin_conn *conn, void *pvt);
+
+int dp_get_bin_address(TALLOC_CTX *mem_ctx,
+                       char **address, const char *domain_name);
+
+/* The accepted connections are allocated on the listener, accept_fn is
+ * expected to steal them and to set their handlers. */
+errno_t dp_bin_listen(TALLOC_CTX *mem_ctx,
+                      struct tevent_context *ev,
+                      const char *address,
+                      dp_bin_accept_fn *accept_fn,
+                      void *pvt);
+errno_t dp_bin_connect(TALLOC_CTX *mem_ctx,
+                       struct tevent_context *ev,
+                       const char *address,
+                       struct dp_bin_conn **_conn);
+/* Takes over an already connected socket, fd is closed on failure */
+errno_t dp_bin_conn_setup(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int fd,
+                          struct dp_bin_conn **_conn);
+
+/* The frame handler may free the connection. The close handler is called
+ * once, when the peer goes away or the stream is corrupted, and is
+ * expected to free the connection. */
+void dp_bin_set_handlers(struct dp_bin_conn *conn,
+                         dp_bin_frame_fn *frame_fn,
+                         dp_bin_close_fn *close_fn,
+                         void *pvt);
+uint32_t dp_bin_next_serial(struct dp_bin_conn *conn);
+errno_t dp_bin_send(struct dp_bin_conn *conn,
+                    uint32_t type, uint32_t serial,
+                    const uint8_t *body, size_t body_len);
+
+errno_t dp_bin_add_uint32(TALLOC_CTX *mem_ctx, uint8_t **body,
+                          size_t *body_len, uint32_t val);
+errno_t dp_bin_add_string(TALLOC_CTX *mem_ctx, uint8_t **body,
+                          size_t *body_len, const char *str);
+errno_t dp_bin_get_uint32(const uint8_t *body, size_t body_len,
+                          size_t *pos, uint32_t *val);
+/* The string points into body */
+errno_t dp_bin_get_string(const uint8_t *body, size_t body_len,
+                          size_t *pos, const char **str);
+
 
 /* Helpers */
 
@@ -332,6 +412,13 @@ enum dp_res_opts {
     DP_RES_OPT_RESOLVER_TIMEOUT,
     DP_RES_OPT_RESOLVER_OP_TIMEOUT,
     DP_RES_OPT_DNS_DOMAIN,
+    DP_RES_OPT_CACHE_MAX_TTL,
+    DP_RES_OPT_CACHE_NEGATIVE_TTL,
+    DP_RES_OPT_CACHE_PREFETCH,
+    DP_RES_OPT_FO_PROBE_SERVERS,
+    DP_RES_OPT_FO_PROBE_DELAY,
+    DP_RES_OPT_FO_PROBE_TIMEOUT,
+    DP_RES_OPT_FO_REPROBE_INTERVAL,
 
     DP_RES_OPTS /* attrs counter */
 };
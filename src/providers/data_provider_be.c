@@ -36,6 +36,7 @@
 
 #include "popt.h"
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
 #include "dbus/dbus.h"
@@ -67,6 +68,7 @@ struct sbus_method monitor_be_methods[] = {
     { MON_CLI_METHOD_OFFLINE, data_provider_go_offline },
     { MON_CLI_METHOD_RESET_OFFLINE, data_provider_reset_offline },
     { MON_CLI_METHOD_ROTATE, data_provider_logrotate },
+    { MON_CLI_METHOD_GET_STATS, monitor_common_get_stats },
     { NULL, NULL }
 };
 
@@ -80,6 +82,8 @@ struct sbus_interface monitor_be_interface = {
 
 static int client_registration(DBusMessage *message, struct sbus_connection *conn);
 static int be_get_account_info(DBusMessage *message, struct sbus_connection *conn);
+static int be_get_account_info_batch(DBusMessage *message,
+                                     struct sbus_connection *conn);
 static int be_pam_handler(DBusMessage *message, struct sbus_connection *conn);
 static int be_sudo_handler(DBusMessage *message, struct sbus_connection *conn);
 static int be_autofs_handler(DBusMessage *message, struct sbus_connection *conn);
@@ -89,11 +93,13 @@ static int be_get_subdomains(DBusMessage *message, struct sbus_connection *conn)
 struct sbus_method be_methods[] = {
     { DP_METHOD_REGISTER, client_registration },
     { DP_METHOD_GETACCTINFO, be_get_account_info },
+    { DP_METHOD_GETACCTINFO_BATCH, be_get_account_info_batch },
     { DP_METHOD_PAMHANDLER, be_pam_handler },
     { DP_METHOD_SUDOHANDLER, be_sudo_handler },
     { DP_METHOD_AUTOFSHANDLER, be_autofs_handler },
     { DP_METHOD_HOSTHANDLER, be_host_handler },
     { DP_METHOD_GETDOMAINS, be_get_subdomains },
+    { DP_METHOD_GETSTATS, monitor_common_get_stats },
     { NULL, NULL }
 };
 
@@ -135,8 +141,44 @@ struct be_req {
      * selinux provider is calling the callback.
      */
     int phase;
+
+    struct timeval start;
 };
 
+static void get_subdomains_callback(struct be_req *req, int dp_err_type,
+                                    int errnum, const char *errstr);
+static void acctinfo_callback(struct be_req *req, int dp_err_type,
+                              int errnum, const char *errstr);
+static void be_pam_handler_callback(struct be_req *req, int dp_err_type,
+                                    int errnum, const char *errstr);
+static void be_sudo_handler_callback(struct be_req *req, int dp_err_type,
+                                     int errnum, const char *errstr);
+static void be_autofs_handler_callback(struct be_req *req, int dp_err_type,
+                                       int errnum, const char *errstr);
+static void be_acct_batch_part_done(struct be_req *part, int dp_err_type,
+                                    int errnum, const char *errstr);
+
+/* the requests coming from the responders are told apart by their
+ * callbacks */
+static const char *be_req_stats_name(struct be_req *be_req)
+{
+    if (be_req->fn == acctinfo_callback) {
+        return "be_account";
+    } else if (be_req->fn == be_pam_handler_callback) {
+        return "be_pam";
+    } else if (be_req->fn == be_sudo_handler_callback) {
+        return "be_sudo";
+    } else if (be_req->fn == be_autofs_handler_callback) {
+        return "be_autofs";
+    } else if (be_req->fn == get_subdomains_callback) {
+        return "be_subdomains";
+    } else if (be_req->fn == be_acct_batch_part_done) {
+        return "be_account_part";
+    }
+
+    return NULL;
+}
+
 struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
                              struct be_client *becli, struct be_ctx *be_ctx,
                              be_async_callback_t fn, void *pvt_fn_data)
@@ -150,6 +192,7 @@ struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
     be_req->be_ctx = be_ctx;
     be_req->fn = fn;
     be_req->pvt = pvt_fn_data;
+    sss_stats_start(&be_req->start);
 
     return be_req;
 }
@@ -167,7 +210,15 @@ void *be_req_get_data(struct be_req *be_req)
 void be_req_terminate(struct be_req *be_req,
                       int dp_err_type, int errnum, const char *errstr)
 {
+    const char *stats_name;
+
     if (be_req->fn == NULL) return;
+
+    stats_name = be_req_stats_name(be_req);
+    if (stats_name != NULL) {
+        sss_stats_time(stats_name, &be_req->start, dp_err_type != DP_ERR_OK);
+    }
+
     be_req->fn(be_req, dp_err_type, errnum, errstr);
 }
 
@@ -288,6 +339,11 @@ static errno_t be_file_request(TALLOC_CTX *mem_ctx,
     areq->fn = fn;
     areq->req = be_req;
 
+    /* somebody is waiting for the answer, the background tasks step
+     * aside until the request is done; not being able to track it only
+     * means they do not */
+    be_sched_hold(be_req, be_req->be_ctx, BE_SCHED_INTERACTIVE);
+
     /* fire immediately */
     tv.tv_sec = 0;
     tv.tv_usec = 0;
@@ -552,6 +608,41 @@ immediate:
     return EOK;
 }
 
+/* Private data of the account requests received on the binary channel */
+struct be_bin_acct_reply {
+    uint32_t serial;
+};
+
+static void be_bin_acct_send_reply(struct be_client *becli, uint32_t type,
+                                   uint32_t serial, dbus_uint16_t err_maj,
+                                   dbus_uint32_t err_min, const char *err_msg)
+{
+    uint8_t *body = NULL;
+    size_t body_len = 0;
+    errno_t ret;
+
+    ret = dp_bin_add_uint32(becli, &body, &body_len, err_maj);
+    if (ret == EOK) {
+        ret = dp_bin_add_uint32(becli, &body, &body_len, err_min);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_add_string(becli, &body, &body_len, err_msg);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_send(becli->bin, type | DP_BIN_REPLY, serial,
+                          body, body_len);
+    }
+    talloc_free(body);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Cannot send binary reply [%d]: %s\n",
+                                  ret, strerror(ret)));
+        return;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA, ("Request processed. Returned %d,%d,%s\n",
+                             err_maj, err_min, err_msg));
+}
+
 static void acctinfo_callback(struct be_req *req,
                               int dp_err_type,
                               int errnum,
@@ -563,6 +654,20 @@ static void acctinfo_callback(struct be_req *req,
     dbus_uint16_t err_maj = 0;
     dbus_uint32_t err_min = 0;
     const char *err_msg = NULL;
+    struct be_bin_acct_reply *bin_reply;
+
+    if (req->becli->bin) {
+        bin_reply = talloc_get_type(req->pvt, struct be_bin_acct_reply);
+        if (bin_reply) {
+            err_msg = errstr ? errstr
+                             : dp_pam_err_to_string(req, dp_err_type, errnum);
+            be_bin_acct_send_reply(req->becli, DP_BIN_GETACCTINFO,
+                                   bin_reply->serial, dp_err_type, errnum,
+                                   err_msg ? err_msg : "OOM");
+        }
+        talloc_free(req);
+        return;
+    }
 
     reply = (DBusMessage *)req->pvt;
 
@@ -705,6 +810,70 @@ done:
     }
 }
 
+static void be_responder_notify_done(DBusPendingCall *pending, void *ptr)
+{
+    dbus_pending_call_unref(pending);
+}
+
+/* Tell a responder that cached data of this domain changed. The responder
+ * answers with an empty reply, nobody waits for it. */
+static void be_responder_notify(struct be_ctx *be_ctx,
+                                struct be_client *cli,
+                                const char *responder,
+                                const char *method)
+{
+    DBusMessage *msg;
+    dbus_bool_t dbret;
+    int ret;
+
+    if (!cli || !cli->conn) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, ("%s Service not connected\n",
+                                      responder));
+        return;
+    }
+
+    msg = dbus_message_new_method_call(NULL,
+                                       DP_PATH,
+                                       DP_INTERFACE,
+                                       method);
+    if (!msg) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory?!\n"));
+        return;
+    }
+
+    dbret = dbus_message_append_args(msg,
+                                     DBUS_TYPE_STRING, &be_ctx->domain->name,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory?!\n"));
+        dbus_message_unref(msg);
+        return;
+    }
+
+    /* the reply carries no data */
+    ret = sbus_conn_send(cli->conn, msg, -1,
+                         be_responder_notify_done, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              ("Error contacting %s responder: %d [%s]\n",
+               responder, ret, strerror(ret)));
+    }
+
+    dbus_message_unref(msg);
+}
+
+void be_pam_acct_cache_flush(struct be_ctx *be_ctx)
+{
+    be_responder_notify(be_ctx, be_ctx->pam_cli, "PAM",
+                        DP_REV_METHOD_ACCT_CACHE_FLUSH);
+}
+
+void be_sudo_rules_changed(struct be_ctx *be_ctx)
+{
+    be_responder_notify(be_ctx, be_ctx->sudo_cli, "SUDO",
+                        DP_REV_METHOD_SUDO_RULES_CHANGED);
+}
+
 static errno_t be_initgroups_prereq(struct be_req *be_req)
 {
     struct be_acct_req *ar = talloc_get_type(be_req_get_data(be_req),
@@ -921,9 +1090,99 @@ errno_t be_get_account_info_recv(struct tevent_req *req,
     return EOK;
 }
 
-static int be_get_account_info(DBusMessage *message, struct sbus_connection *conn)
+/* Checks the arguments of an account request and files it. On failure
+ * err_maj, err_min and err_msg describe the error to send back. */
+static errno_t
+be_file_account_request_args(struct be_req *be_req,
+                             uint32_t type, uint32_t attr_type,
+                             const char *filter, const char *domain,
+                             dbus_uint16_t *err_maj, dbus_uint32_t *err_min,
+                             const char **err_msg)
 {
     struct be_acct_req *req;
+    errno_t ret;
+
+    req = talloc_zero(be_req, struct be_acct_req);
+    if (!req) {
+        *err_maj = DP_ERR_FATAL;
+        *err_min = ENOMEM;
+        *err_msg = "Out of memory";
+        return ENOMEM;
+    }
+    req->entry_type = type;
+    req->attr_type = (int)attr_type;
+    req->domain = talloc_strdup(req, domain);
+    if (!req->domain) {
+        *err_maj = DP_ERR_FATAL;
+        *err_min = ENOMEM;
+        *err_msg = "Out of memory";
+        return ENOMEM;
+    }
+
+    if ((attr_type != BE_ATTR_CORE) &&
+        (attr_type != BE_ATTR_MEM) &&
+        (attr_type != BE_ATTR_ALL)) {
+        /* Unrecognized attr type */
+        *err_maj = DP_ERR_FATAL;
+        *err_min = EINVAL;
+        *err_msg = "Invalid Attrs Parameter";
+        return EINVAL;
+    }
+
+    if (filter) {
+        ret = EOK;
+        if (strncmp(filter, "name=", 5) == 0) {
+            req->filter_type = BE_FILTER_NAME;
+            ret = split_name_extended(req, &filter[5],
+                                      &req->filter_value,
+                                      &req->extra_value);
+        } else if (strncmp(filter, "idnumber=", 9) == 0) {
+            req->filter_type = BE_FILTER_IDNUM;
+            ret = split_name_extended(req, &filter[9],
+                                      &req->filter_value,
+                                      &req->extra_value);
+        } else if (strncmp(filter, DP_SEC_ID"=", DP_SEC_ID_LEN + 1) == 0) {
+            req->filter_type = BE_FILTER_SECID;
+            ret = split_name_extended(req, &filter[DP_SEC_ID_LEN + 1],
+                                      &req->filter_value,
+                                      &req->extra_value);
+        } else if (strcmp(filter, ENUM_INDICATOR) == 0) {
+            req->filter_type = BE_FILTER_ENUM;
+            req->filter_value = NULL;
+        } else {
+            *err_maj = DP_ERR_FATAL;
+            *err_min = EINVAL;
+            *err_msg = "Invalid Filter";
+            return EINVAL;
+        }
+
+        if (ret != EOK) {
+            *err_maj = DP_ERR_FATAL;
+            *err_min = EINVAL;
+            *err_msg = "Invalid Filter";
+            return EINVAL;
+        }
+
+    } else {
+        *err_maj = DP_ERR_FATAL;
+        *err_min = EINVAL;
+        *err_msg = "Missing Filter Parameter";
+        return EINVAL;
+    }
+
+    ret = be_file_account_request(be_req, req);
+    if (ret != EOK) {
+        *err_maj = DP_ERR_FATAL;
+        *err_min = ret;
+        *err_msg = "Cannot file account request";
+        return ret;
+    }
+
+    return EOK;
+}
+
+static int be_get_account_info(DBusMessage *message, struct sbus_connection *conn)
+{
     struct be_req *be_req;
     struct be_client *becli;
     DBusMessage *reply;
@@ -1004,106 +1263,300 @@ static int be_get_account_info(DBusMessage *message, struct sbus_connection *con
         goto done;
     }
 
-    req = talloc(be_req, struct be_acct_req);
-    if (!req) {
-        err_maj = DP_ERR_FATAL;
-        err_min = ENOMEM;
-        err_msg = "Out of memory";
+    ret = be_file_account_request_args(be_req, type, attr_type,
+                                       filter, domain,
+                                       &err_maj, &err_min, &err_msg);
+    if (ret != EOK) {
         goto done;
     }
-    req->entry_type = type;
-    req->attr_type = (int)attr_type;
-    req->domain = talloc_strdup(req, domain);
-    if (!req->domain) {
+
+    return EOK;
+
+done:
+    if (be_req) {
+        talloc_free(be_req);
+    }
+
+    if (reply) {
+        dbret = dbus_message_append_args(reply,
+                                         DBUS_TYPE_UINT16, &err_maj,
+                                         DBUS_TYPE_UINT32, &err_min,
+                                         DBUS_TYPE_STRING, &err_msg,
+                                         DBUS_TYPE_INVALID);
+        if (!dbret) return EIO;
+
+        DEBUG(4, ("Request processed. Returned %d,%d,%s\n",
+                  err_maj, err_min, err_msg));
+
+        /* send reply back */
+        sbus_conn_send_reply(conn, reply);
+        dbus_message_unref(reply);
+    }
+
+    return EOK;
+}
+
+static int be_acct_send_dbus_reply(struct sbus_connection *conn,
+                                   DBusMessage *reply,
+                                   dbus_uint16_t err_maj,
+                                   dbus_uint32_t err_min,
+                                   const char *err_msg)
+{
+    dbus_bool_t dbret;
+
+    dbret = dbus_message_append_args(reply,
+                                     DBUS_TYPE_UINT16, &err_maj,
+                                     DBUS_TYPE_UINT32, &err_min,
+                                     DBUS_TYPE_STRING, &err_msg,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) return EIO;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Request processed. Returned %d,%d,%s\n",
+                              err_maj, err_min, err_msg));
+
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+    return EOK;
+}
+
+/* A batch split into single lookups, for the providers that cannot
+ * resolve a list of names at once */
+struct be_acct_batch_state {
+    /* answers the responder once all the lookups finished */
+    struct be_req *be_req;
+    int pending;
+
+    int dp_err;
+    int dp_ret;
+    char *err_msg;
+};
+
+static void be_acct_batch_part_done(struct be_req *part,
+                                    int dp_err_type,
+                                    int errnum,
+                                    const char *errstr)
+{
+    struct be_acct_batch_state *state =
+            talloc_get_type(part->pvt, struct be_acct_batch_state);
+
+    /* the first failure is reported for the whole batch */
+    if (dp_err_type != DP_ERR_OK && state->dp_err == DP_ERR_OK) {
+        state->dp_err = dp_err_type;
+        state->dp_ret = errnum;
+        state->err_msg = talloc_strdup(state, errstr);
+    }
+    talloc_free(part);
+
+    state->pending--;
+    if (state->pending == 0) {
+        be_req_terminate(state->be_req, state->dp_err, state->dp_ret,
+                         state->err_msg);
+    }
+}
+
+static errno_t be_file_account_batch_split(struct be_req *be_req,
+                                           uint32_t type, uint32_t attr_type,
+                                           char **names, int count,
+                                           const char *domain)
+{
+    struct be_acct_batch_state *state;
+    struct be_req *part;
+    char *filter;
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    const char *err_msg;
+    errno_t ret;
+    int i;
+
+    state = talloc_zero(be_req, struct be_acct_batch_state);
+    if (!state) {
+        return ENOMEM;
+    }
+    state->be_req = be_req;
+    state->dp_err = DP_ERR_OK;
+
+    for (i = 0; i < count; i++) {
+        part = be_req_create(state, be_req->becli, be_req->be_ctx,
+                             be_acct_batch_part_done, state);
+        filter = talloc_asprintf(part, "name=%s", names[i]);
+        if (!part || !filter) {
+            talloc_free(part);
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = be_file_account_request_args(part, type, attr_type,
+                                           filter, domain,
+                                           &err_maj, &err_min, &err_msg);
+        if (ret != EOK) {
+            talloc_free(part);
+            goto done;
+        }
+        state->pending++;
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK && state->pending > 0) {
+        /* the lookups already filed answer for the whole batch */
+        state->dp_err = DP_ERR_FATAL;
+        state->dp_ret = ret;
+        state->err_msg = talloc_strdup(state, "Cannot file account request");
+        return EOK;
+    }
+    return ret;
+}
+
+static int be_get_account_info_batch(DBusMessage *message,
+                                     struct sbus_connection *conn)
+{
+    struct be_req *be_req = NULL;
+    struct be_client *becli;
+    struct be_ctx *be_ctx;
+    struct be_acct_req *ar;
+    DBusMessage *reply;
+    DBusError dbus_error;
+    void *user_data;
+    uint32_t type;
+    uint32_t attr_type;
+    char **names = NULL;
+    int count;
+    char *domain;
+    int ret;
+    int i;
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    const char *err_msg;
+
+    user_data = sbus_conn_get_private_data(conn);
+    if (!user_data) return EINVAL;
+    becli = talloc_get_type(user_data, struct be_client);
+    if (!becli) return EINVAL;
+    be_ctx = becli->bectx;
+
+    dbus_error_init(&dbus_error);
+
+    ret = dbus_message_get_args(message, &dbus_error,
+                                DBUS_TYPE_UINT32, &type,
+                                DBUS_TYPE_UINT32, &attr_type,
+                                DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                &names, &count,
+                                DBUS_TYPE_STRING, &domain,
+                                DBUS_TYPE_INVALID);
+    if (!ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse message!\n"));
+        if (dbus_error_is_set(&dbus_error)) dbus_error_free(&dbus_error);
+        return EIO;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA, ("Got batch request for [%u][%d] with %d "
+                             "names\n", type, attr_type, count));
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) {
+        ret = ENOMEM;
+        goto out;
+    }
+
+    /* If we are offline and fast reply was requested
+     * return offline immediately and go on in the background
+     */
+    if ((type & BE_REQ_FAST) && be_ctx->offstat.offline) {
+        ret = be_acct_send_dbus_reply(conn, reply, DP_ERR_OFFLINE, EAGAIN,
+                                      "Fast reply - offline");
+        reply = NULL;
+        if (ret != EOK) goto out;
+    }
+
+    be_req = be_req_create(becli, becli, be_ctx, acctinfo_callback, reply);
+    if (!be_req) {
         err_maj = DP_ERR_FATAL;
         err_min = ENOMEM;
         err_msg = "Out of memory";
         goto done;
     }
 
-    if ((attr_type != BE_ATTR_CORE) &&
-        (attr_type != BE_ATTR_MEM) &&
-        (attr_type != BE_ATTR_ALL)) {
-        /* Unrecognized attr type */
+    /* only user lookups are batched, the group ones may need to follow
+     * nested memberships of each group */
+    if ((type & BE_REQ_TYPE_MASK) != BE_REQ_USER || count == 0 ||
+        (attr_type != BE_ATTR_CORE &&
+         attr_type != BE_ATTR_MEM &&
+         attr_type != BE_ATTR_ALL)) {
         err_maj = DP_ERR_FATAL;
         err_min = EINVAL;
-        err_msg = "Invalid Attrs Parameter";
+        err_msg = "Invalid batch request";
         goto done;
     }
 
-    if (filter) {
-        ret = EOK;
-        if (strncmp(filter, "name=", 5) == 0) {
-            req->filter_type = BE_FILTER_NAME;
-            ret = split_name_extended(req, &filter[5],
-                                      &req->filter_value,
-                                      &req->extra_value);
-        } else if (strncmp(filter, "idnumber=", 9) == 0) {
-            req->filter_type = BE_FILTER_IDNUM;
-            ret = split_name_extended(req, &filter[9],
-                                      &req->filter_value,
-                                      &req->extra_value);
-        } else if (strncmp(filter, DP_SEC_ID"=", DP_SEC_ID_LEN + 1) == 0) {
-            req->filter_type = BE_FILTER_SECID;
-            ret = split_name_extended(req, &filter[DP_SEC_ID_LEN + 1],
-                                      &req->filter_value,
-                                      &req->extra_value);
-        } else if (strcmp(filter, ENUM_INDICATOR) == 0) {
-            req->filter_type = BE_FILTER_ENUM;
-            req->filter_value = NULL;
-        } else {
-            err_maj = DP_ERR_FATAL;
-            err_min = EINVAL;
-            err_msg = "Invalid Filter";
-            goto done;
-        }
-
+    if (be_ctx->bet_info[BET_ID].bet_ops->batch_handler == NULL) {
+        ret = be_file_account_batch_split(be_req, type, attr_type,
+                                          names, count, domain);
         if (ret != EOK) {
             err_maj = DP_ERR_FATAL;
-            err_min = EINVAL;
-            err_msg = "Invalid Filter";
+            err_min = ret;
+            err_msg = "Cannot file account request";
             goto done;
         }
+        ret = EOK;
+        goto out;
+    }
 
-    } else {
+    ar = talloc_zero(be_req, struct be_acct_req);
+    if (!ar) {
         err_maj = DP_ERR_FATAL;
-        err_min = EINVAL;
-        err_msg = "Missing Filter Parameter";
+        err_min = ENOMEM;
+        err_msg = "Out of memory";
         goto done;
     }
+    ar->entry_type = type;
+    ar->attr_type = attr_type;
+    ar->filter_type = BE_FILTER_NAME_LIST;
+    ar->domain = talloc_strdup(ar, domain);
+    ar->filter_list = talloc_array(ar, char *, count + 1);
+    if (!ar->domain || !ar->filter_list) {
+        err_maj = DP_ERR_FATAL;
+        err_min = ENOMEM;
+        err_msg = "Out of memory";
+        goto done;
+    }
+    for (i = 0; i < count; i++) {
+        ar->filter_list[i] = talloc_strdup(ar->filter_list, names[i]);
+        if (!ar->filter_list[i]) {
+            err_maj = DP_ERR_FATAL;
+            err_min = ENOMEM;
+            err_msg = "Out of memory";
+            goto done;
+        }
+    }
+    ar->filter_list[count] = NULL;
+    /* for the handlers that only log the filter */
+    ar->filter_value = ar->filter_list[0];
 
-    ret = be_file_account_request(be_req, req);
+    be_req->req_data = ar;
+    ret = be_file_request(be_ctx, be_req,
+                          be_ctx->bet_info[BET_ID].bet_ops->batch_handler);
     if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to file request\n"));
         err_maj = DP_ERR_FATAL;
         err_min = ret;
         err_msg = "Cannot file account request";
         goto done;
     }
 
-    return EOK;
+    ret = EOK;
+    goto out;
 
 done:
-    if (be_req) {
-        talloc_free(be_req);
-    }
-
+    talloc_free(be_req);
+    ret = EOK;
     if (reply) {
-        dbret = dbus_message_append_args(reply,
-                                         DBUS_TYPE_UINT16, &err_maj,
-                                         DBUS_TYPE_UINT32, &err_min,
-                                         DBUS_TYPE_STRING, &err_msg,
-                                         DBUS_TYPE_INVALID);
-        if (!dbret) return EIO;
-
-        DEBUG(4, ("Request processed. Returned %d,%d,%s\n",
-                  err_maj, err_min, err_msg));
-
-        /* send reply back */
-        sbus_conn_send_reply(conn, reply);
-        dbus_message_unref(reply);
+        ret = be_acct_send_dbus_reply(conn, reply, err_maj, err_min, err_msg);
     }
 
-    return EOK;
+out:
+    dbus_free_string_array(names);
+    return ret;
 }
 
 static void be_pam_handler_callback(struct be_req *req,
@@ -2165,6 +2618,7 @@ static int be_client_init(struct sbus_connection *conn, void *data)
     }
     becli->bectx = bectx;
     becli->conn = conn;
+    becli->bin = NULL;
     becli->initialized = false;
 
     /* 5 seconds should be plenty */
@@ -2186,11 +2640,146 @@ static int be_client_init(struct sbus_connection *conn, void *data)
     return EOK;
 }
 
+static void be_bin_get_account_info(struct be_client *becli, uint32_t serial,
+                                    const uint8_t *body, size_t body_len)
+{
+    struct be_bin_acct_reply *bin_reply = NULL;
+    struct be_req *be_req = NULL;
+    uint32_t type;
+    uint32_t attr_type;
+    const char *filter;
+    const char *domain;
+    size_t pos = 0;
+    errno_t ret;
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    const char *err_msg;
+
+    ret = dp_bin_get_uint32(body, body_len, &pos, &type);
+    if (ret == EOK) {
+        ret = dp_bin_get_uint32(body, body_len, &pos, &attr_type);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_get_string(body, body_len, &pos, &filter);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_get_string(body, body_len, &pos, &domain);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to parse binary request\n"));
+        be_bin_acct_send_reply(becli, DP_BIN_GETACCTINFO, serial,
+                               DP_ERR_FATAL, EINVAL, "Malformed request");
+        return;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA, ("Got binary request for [%u][%d][%s]\n",
+                             type, attr_type, filter));
+
+    /* If we are offline and fast reply was requested
+     * return offline immediately and go on in the background
+     */
+    if ((type & BE_REQ_FAST) && becli->bectx->offstat.offline) {
+        be_bin_acct_send_reply(becli, DP_BIN_GETACCTINFO, serial,
+                               DP_ERR_OFFLINE, EAGAIN,
+                               "Fast reply - offline");
+        serial = 0;
+    }
+
+    be_req = be_req_create(becli, becli, becli->bectx,
+                           acctinfo_callback, NULL);
+    if (!be_req) {
+        err_maj = DP_ERR_FATAL;
+        err_min = ENOMEM;
+        err_msg = "Out of memory";
+        goto done;
+    }
+
+    if (serial != 0) {
+        bin_reply = talloc(be_req, struct be_bin_acct_reply);
+        if (!bin_reply) {
+            err_maj = DP_ERR_FATAL;
+            err_min = ENOMEM;
+            err_msg = "Out of memory";
+            goto done;
+        }
+        bin_reply->serial = serial;
+        be_req->pvt = bin_reply;
+    }
+
+    ret = be_file_account_request_args(be_req, type, attr_type,
+                                       filter, domain,
+                                       &err_maj, &err_min, &err_msg);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    return;
+
+done:
+    talloc_free(be_req);
+    if (serial != 0) {
+        be_bin_acct_send_reply(becli, DP_BIN_GETACCTINFO, serial,
+                               err_maj, err_min, err_msg);
+    }
+}
+
+static void be_bin_frame(struct dp_bin_conn *conn,
+                         uint32_t type, uint32_t serial,
+                         const uint8_t *body, size_t body_len,
+                         void *pvt)
+{
+    struct be_client *becli = talloc_get_type(pvt, struct be_client);
+
+    switch (type) {
+    case DP_BIN_GETACCTINFO:
+        be_bin_get_account_info(becli, serial, body, body_len);
+        break;
+    default:
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unknown binary request type [%#x]\n", type));
+        be_bin_acct_send_reply(becli, type, serial, DP_ERR_FATAL, EINVAL,
+                               "Unknown request");
+        break;
+    }
+}
+
+static void be_bin_close(struct dp_bin_conn *conn, void *pvt)
+{
+    struct be_client *becli = talloc_get_type(pvt, struct be_client);
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Binary client [%p] went away\n", becli));
+
+    /* frees the connection as well */
+    talloc_free(becli);
+}
+
+static void be_bin_accept(struct dp_bin_conn *conn, void *pvt)
+{
+    struct be_ctx *bectx = talloc_get_type(pvt, struct be_ctx);
+    struct be_client *becli;
+
+    /* The responders register over D-Bus, the binary channel only
+     * carries requests, so there is nothing to wait for */
+    becli = talloc_zero(bectx, struct be_client);
+    if (!becli) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory?!\n"));
+        talloc_free(conn);
+        return;
+    }
+    becli->bectx = bectx;
+    becli->bin = talloc_steal(becli, conn);
+    becli->initialized = true;
+
+    dp_bin_set_handlers(conn, be_bin_frame, be_bin_close, becli);
+}
+
 /* be_srv_init
  * set up per-domain sbus channel */
 static int be_srv_init(struct be_ctx *ctx)
 {
     char *sbus_address;
+    char *bin_address;
+    bool use_bin;
     int ret;
 
     /* Set up SBUS connection to the monitor */
@@ -2208,6 +2797,32 @@ static int be_srv_init(struct be_ctx *ctx)
         return ret;
     }
 
+    ret = confdb_get_bool(ctx->cdb, ctx->conf_path,
+                          CONFDB_DOMAIN_BINARY_IPC, false, &use_bin);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read [%s] from confdb\n",
+                                    CONFDB_DOMAIN_BINARY_IPC));
+        return ret;
+    }
+
+    if (use_bin) {
+        ret = dp_get_bin_address(ctx, &bin_address, ctx->domain->name);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("Could not get binary channel address.\n"));
+            return ret;
+        }
+
+        /* The responders fall back to D-Bus when the binary channel is not
+         * available, so a failure here is not fatal */
+        ret = dp_bin_listen(ctx, ctx->ev, bin_address, be_bin_accept, ctx);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Could not set up the binary channel [%d]: %s\n",
+                   ret, strerror(ret)));
+        }
+    }
+
     return EOK;
 }
 
@@ -2502,6 +3117,13 @@ int be_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = be_sched_init(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("fatal error initializing the request scheduler\n"));
+        goto fail;
+    }
+
     ret = sssd_domain_init(ctx, cdb, be_domain, DB_PATH, &ctx->domain);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, ("fatal error opening cache database\n"));
@@ -55,6 +55,7 @@ struct be_failover_ctx {
 
     struct be_svc_data *svcs;
     struct tevent_timer *primary_server_handler;
+    struct tevent_timer *reprobe_handler;
 };
 
 static const char *proto_table[] = { FO_PROTO_TCP, FO_PROTO_UDP, NULL };
@@ -72,10 +73,18 @@ static int be_fo_get_options(struct be_ctx *ctx,
     opts->retry_timeout = 30;
     opts->srv_retry_timeout = 14400;
     opts->family_order = ctx->be_res->family_order;
+    opts->probe_count = dp_opt_get_int(ctx->be_res->opts,
+                                       DP_RES_OPT_FO_PROBE_SERVERS);
+    opts->probe_delay = dp_opt_get_int(ctx->be_res->opts,
+                                       DP_RES_OPT_FO_PROBE_DELAY);
+    opts->probe_timeout = dp_opt_get_int(ctx->be_res->opts,
+                                         DP_RES_OPT_FO_PROBE_TIMEOUT);
 
     return EOK;
 }
 
+static errno_t be_fo_reprobe_activate(struct be_ctx *ctx);
+
 int be_init_failover(struct be_ctx *ctx)
 {
     int ret;
@@ -111,6 +120,84 @@ int be_init_failover(struct be_ctx *ctx)
         return ENOMEM;
     }
 
+    ret = be_fo_reprobe_activate(ctx);
+    if (ret != EOK) {
+        talloc_zfree(ctx->be_fo);
+        return ret;
+    }
+
+    return EOK;
+}
+
+static void be_fo_reprobe_done(struct tevent_req *req)
+{
+    int ret;
+
+    ret = fo_reprobe_service_recv(req);
+    talloc_zfree(req);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Re-probing servers failed [%d]: %s\n",
+                                     ret, strerror(ret)));
+    }
+}
+
+/* Periodically measure the servers we are not connected to, so that
+ * a server that became faster or came back is noticed. */
+static void be_fo_reprobe(struct tevent_context *ev,
+                          struct tevent_timer *te,
+                          struct timeval tv, void *pvt)
+{
+    struct be_ctx *ctx = talloc_get_type(pvt, struct be_ctx);
+    struct be_svc_data *svc;
+    struct tevent_req *req;
+    errno_t ret;
+
+    ctx->be_fo->reprobe_handler = NULL;
+
+    if (!be_is_offline(ctx)) {
+        DLIST_FOR_EACH(svc, ctx->be_fo->svcs) {
+            req = fo_reprobe_service_send(ctx->be_fo, ev,
+                                          ctx->be_fo->be_res->resolv,
+                                          ctx->be_fo->fo_ctx,
+                                          svc->fo_service);
+            if (req == NULL) {
+                DEBUG(SSSDBG_CRIT_FAILURE, ("fo_reprobe_service_send failed\n"));
+                continue;
+            }
+            tevent_req_set_callback(req, be_fo_reprobe_done, NULL);
+        }
+    }
+
+    ret = be_fo_reprobe_activate(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot schedule server re-probing\n"));
+    }
+}
+
+static errno_t be_fo_reprobe_activate(struct be_ctx *ctx)
+{
+    struct timeval tv;
+    int interval;
+
+    /* servers are only measured when probing several at once is on */
+    if (dp_opt_get_int(ctx->be_res->opts, DP_RES_OPT_FO_PROBE_SERVERS) < 2) {
+        return EOK;
+    }
+
+    interval = dp_opt_get_int(ctx->be_res->opts,
+                              DP_RES_OPT_FO_REPROBE_INTERVAL);
+    if (interval <= 0) {
+        return EOK;
+    }
+
+    tv = tevent_timeval_current_ofs(interval, 0);
+    ctx->be_fo->reprobe_handler = tevent_add_timer(ctx->ev, ctx->be_fo, tv,
+                                                   be_fo_reprobe, ctx);
+    if (ctx->be_fo->reprobe_handler == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("tevent_add_timer failed.\n"));
+        return ENOMEM;
+    }
+
     return EOK;
 }
 
@@ -193,6 +280,20 @@ int be_fo_add_service(struct be_ctx *ctx, const char *service_name,
     return EOK;
 }
 
+int be_fo_enable_probing(struct be_ctx *ctx, const char *service_name,
+                         int default_port)
+{
+    struct be_svc_data *svc;
+
+    svc = be_fo_find_svc_data(ctx, service_name);
+    if (NULL == svc) {
+        return ENOENT;
+    }
+
+    fo_set_service_probing(svc->fo_service, default_port);
+    return EOK;
+}
+
 static int be_svc_callback_destroy(void *memptr)
 {
     struct be_svc_callback *callback;
@@ -777,6 +878,13 @@ static struct dp_option dp_res_default_opts[] = {
     { "dns_resolver_timeout", DP_OPT_NUMBER, { .number = 5 }, NULL_NUMBER },
     { "dns_resolver_op_timeout", DP_OPT_NUMBER, { .number = 5 }, NULL_NUMBER },
     { "dns_discovery_domain", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "dns_cache_max_ttl", DP_OPT_NUMBER, { .number = 300 }, NULL_NUMBER },
+    { "dns_cache_negative_ttl", DP_OPT_NUMBER, { .number = 15 }, NULL_NUMBER },
+    { "dns_cache_prefetch_percentage", DP_OPT_NUMBER, { .number = 75 }, NULL_NUMBER },
+    { "failover_probe_servers", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "failover_probe_delay", DP_OPT_NUMBER, { .number = 150 }, NULL_NUMBER },
+    { "failover_probe_timeout", DP_OPT_NUMBER, { .number = 3 }, NULL_NUMBER },
+    { "failover_reprobe_interval", DP_OPT_NUMBER, { .number = 300 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -843,5 +951,17 @@ errno_t be_res_init(struct be_ctx *ctx)
         return ret;
     }
 
+    ret = resolv_cache_init(ctx->be_res->resolv,
+                            dp_opt_get_int(ctx->be_res->opts,
+                                           DP_RES_OPT_CACHE_MAX_TTL),
+                            dp_opt_get_int(ctx->be_res->opts,
+                                           DP_RES_OPT_CACHE_NEGATIVE_TTL),
+                            dp_opt_get_int(ctx->be_res->opts,
+                                           DP_RES_OPT_CACHE_PREFETCH));
+    if (ret != EOK) {
+        talloc_zfree(ctx->be_res);
+        return ret;
+    }
+
     return EOK;
 }
@@ -0,0 +1,415 @@
+/*
+    SSSD
+
+    Data Provider Process - Request priorities
+
+    The back end serves everything from one event loop, so a long
+    enumeration or cleanup can delay the lookups the users are waiting for.
+    Background tasks take a hold of their class while they run and yield at
+    their checkpoints; a yield completes only when no task of a more
+    important class is running or waiting.
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "providers/dp_backend.h"
+
+/* how long a background task may run before it lets the pending
+ * file descriptors be served even if nobody else is waiting */
+#define BE_SCHED_SLICE_MSEC 50
+/* the event loop only polls the descriptors when no timer is due, so
+ * the yield is a short timer rather than an immediate event */
+#define BE_SCHED_YIELD_USEC 1000
+/* a background task is never postponed longer than this */
+#define BE_SCHED_MAX_WAIT 5
+
+struct be_sched_hold;
+struct be_sched_waiter;
+
+struct be_sched_queue {
+    const char *name;
+    const char *wait_stat;
+
+    unsigned int active;
+    unsigned int max_active;
+    unsigned int waiting;
+    unsigned int max_waiting;
+
+    uint64_t yields;
+    uint64_t delayed;
+    uint64_t forced;
+
+    struct timeval slice_start;
+    struct be_sched_hold *holds;
+    struct be_sched_waiter *waiters;
+};
+
+struct be_sched_ctx {
+    struct be_ctx *be_ctx;
+    struct tevent_timer *kick;
+
+    struct be_sched_queue classes[BE_SCHED_CLASSES];
+};
+
+struct be_sched_hold {
+    struct be_sched_hold *prev;
+    struct be_sched_hold *next;
+
+    struct be_sched_ctx *sched;
+    enum be_sched_class cls;
+};
+
+struct be_sched_waiter {
+    struct be_sched_waiter *prev;
+    struct be_sched_waiter *next;
+
+    struct tevent_req *req;
+    struct be_sched_ctx *sched;
+    enum be_sched_class cls;
+    struct timeval start;
+    struct tevent_timer *timeout;
+    bool queued;
+};
+
+/* the statistics section has no context of its own,
+ * there is a single back end in the process */
+static struct be_sched_ctx *be_sched_stats_ctx;
+
+static char *be_sched_dump(TALLOC_CTX *mem_ctx);
+static void be_sched_kick(struct be_sched_ctx *sched);
+
+static int be_sched_ctx_destructor(struct be_sched_ctx *sched)
+{
+    struct be_sched_hold *hold;
+    struct be_sched_waiter *w;
+    int i;
+
+    /* the requests may outlive the back end context on shutdown */
+    for (i = 0; i < BE_SCHED_CLASSES; i++) {
+        for (hold = sched->classes[i].holds; hold != NULL; hold = hold->next) {
+            hold->sched = NULL;
+        }
+        for (w = sched->classes[i].waiters; w != NULL; w = w->next) {
+            w->sched = NULL;
+        }
+    }
+
+    if (be_sched_stats_ctx == sched) {
+        be_sched_stats_ctx = NULL;
+    }
+
+    return 0;
+}
+
+errno_t be_sched_init(struct be_ctx *be_ctx)
+{
+    struct be_sched_ctx *sched;
+    int ret;
+
+    sched = talloc_zero(be_ctx, struct be_sched_ctx);
+    if (sched == NULL) {
+        return ENOMEM;
+    }
+    sched->be_ctx = be_ctx;
+
+    sched->classes[BE_SCHED_INTERACTIVE].name = "interactive";
+    sched->classes[BE_SCHED_INTERACTIVE].wait_stat = "be_sched_interactive";
+    sched->classes[BE_SCHED_REFRESH].name = "refresh";
+    sched->classes[BE_SCHED_REFRESH].wait_stat = "be_sched_refresh";
+    sched->classes[BE_SCHED_ENUMERATION].name = "enumeration";
+    sched->classes[BE_SCHED_ENUMERATION].wait_stat = "be_sched_enumeration";
+    sched->classes[BE_SCHED_CLEANUP].name = "cleanup";
+    sched->classes[BE_SCHED_CLEANUP].wait_stat = "be_sched_cleanup";
+
+    be_ctx->sched = sched;
+    be_sched_stats_ctx = sched;
+    talloc_set_destructor(sched, be_sched_ctx_destructor);
+
+    ret = sss_stats_add_section(be_sched_dump);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot add the request queues to the statistics [%d]: %s\n",
+               ret, strerror(ret)));
+    }
+
+    return EOK;
+}
+
+static bool be_sched_busy(struct be_sched_ctx *sched, enum be_sched_class cls)
+{
+    int i;
+
+    for (i = 0; i < cls; i++) {
+        if (sched->classes[i].active > 0 || sched->classes[i].waiting > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int be_sched_hold_destructor(struct be_sched_hold *hold)
+{
+    struct be_sched_queue *c;
+
+    if (hold->sched == NULL) {
+        return 0;
+    }
+
+    c = &hold->sched->classes[hold->cls];
+    DLIST_REMOVE(c->holds, hold);
+    c->active--;
+    be_sched_kick(hold->sched);
+
+    return 0;
+}
+
+struct be_sched_hold *be_sched_hold(TALLOC_CTX *mem_ctx,
+                                    struct be_ctx *be_ctx,
+                                    enum be_sched_class cls)
+{
+    struct be_sched_hold *hold;
+    struct be_sched_queue *c;
+
+    if (be_ctx->sched == NULL || cls >= BE_SCHED_CLASSES) {
+        return NULL;
+    }
+
+    hold = talloc_zero(mem_ctx, struct be_sched_hold);
+    if (hold == NULL) {
+        return NULL;
+    }
+    hold->sched = be_ctx->sched;
+    hold->cls = cls;
+
+    c = &hold->sched->classes[cls];
+    DLIST_ADD(c->holds, hold);
+    c->active++;
+    if (c->active > c->max_active) {
+        c->max_active = c->active;
+    }
+    if (c->active == 1) {
+        c->slice_start = tevent_timeval_current();
+    }
+
+    talloc_set_destructor(hold, be_sched_hold_destructor);
+    return hold;
+}
+
+static void be_sched_release(struct be_sched_waiter *w, bool forced)
+{
+    struct be_sched_queue *c = &w->sched->classes[w->cls];
+    struct timeval now;
+    uint64_t usec;
+
+    if (w->queued) {
+        DLIST_REMOVE(c->waiters, w);
+        c->waiting--;
+        w->queued = false;
+    }
+    talloc_zfree(w->timeout);
+
+    now = tevent_timeval_current();
+    usec = (uint64_t) (now.tv_sec - w->start.tv_sec) * 1000000
+           + (now.tv_usec - w->start.tv_usec);
+    sss_stats_add(c->wait_stat, usec, forced);
+    c->slice_start = now;
+
+    if (forced) {
+        c->forced++;
+        DEBUG(SSSDBG_TRACE_FUNC,
+              ("The %s task waited %d seconds, letting it run\n",
+               c->name, BE_SCHED_MAX_WAIT));
+    }
+
+    tevent_req_done(w->req);
+}
+
+static void be_sched_kick_handler(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval tv, void *pvt)
+{
+    struct be_sched_ctx *sched = talloc_get_type(pvt, struct be_sched_ctx);
+    int i;
+
+    sched->kick = NULL;
+
+    /* the more important classes first, releasing them may unblock the
+     * ones behind; the released task may take a hold again right away,
+     * so check again after each of them */
+    for (i = 0; i < BE_SCHED_CLASSES; i++) {
+        while (sched->classes[i].waiters != NULL && !be_sched_busy(sched, i)) {
+            be_sched_release(sched->classes[i].waiters, false);
+        }
+    }
+}
+
+static void be_sched_kick(struct be_sched_ctx *sched)
+{
+    int i;
+
+    if (sched->kick != NULL) {
+        return;
+    }
+
+    for (i = 0; i < BE_SCHED_CLASSES; i++) {
+        if (sched->classes[i].waiters != NULL) {
+            break;
+        }
+    }
+    if (i == BE_SCHED_CLASSES) {
+        return;
+    }
+
+    sched->kick = tevent_add_timer(sched->be_ctx->ev, sched,
+                                   tevent_timeval_zero(),
+                                   be_sched_kick_handler, sched);
+    if (sched->kick == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Cannot schedule the waiting tasks, "
+               "they will run after their timeout\n"));
+    }
+}
+
+static void be_sched_yield_timeout(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval tv, void *pvt)
+{
+    struct be_sched_waiter *w = talloc_get_type(pvt, struct be_sched_waiter);
+
+    w->timeout = NULL;
+    be_sched_release(w, w->queued);
+}
+
+static int be_sched_waiter_destructor(struct be_sched_waiter *w)
+{
+    struct be_sched_queue *c;
+
+    if (w->sched == NULL) {
+        return 0;
+    }
+
+    c = &w->sched->classes[w->cls];
+    if (w->queued) {
+        DLIST_REMOVE(c->waiters, w);
+        c->waiting--;
+        be_sched_kick(w->sched);
+    }
+
+    return 0;
+}
+
+struct tevent_req *be_sched_yield_send(TALLOC_CTX *mem_ctx,
+                                       struct be_ctx *be_ctx,
+                                       enum be_sched_class cls)
+{
+    struct tevent_req *req;
+    struct be_sched_waiter *w;
+    struct be_sched_queue *c;
+    struct timeval tv;
+
+    req = tevent_req_create(mem_ctx, &w, struct be_sched_waiter);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    if (be_ctx->sched == NULL || cls >= BE_SCHED_CLASSES) {
+        tevent_req_done(req);
+        tevent_req_post(req, be_ctx->ev);
+        return req;
+    }
+
+    w->req = req;
+    w->sched = be_ctx->sched;
+    w->cls = cls;
+    w->start = tevent_timeval_current();
+    talloc_set_destructor(w, be_sched_waiter_destructor);
+
+    c = &w->sched->classes[cls];
+    c->yields++;
+
+    if (!be_sched_busy(w->sched, cls)) {
+        tv = tevent_timeval_add(&c->slice_start, 0,
+                                BE_SCHED_SLICE_MSEC * 1000);
+        if (tevent_timeval_compare(&w->start, &tv) < 0) {
+            /* still within the time slice */
+            tevent_req_done(req);
+            tevent_req_post(req, be_ctx->ev);
+            return req;
+        }
+
+        /* nobody is waiting that we know of, but let the
+         * event loop look at the sockets before going on */
+        tv = tevent_timeval_current_ofs(0, BE_SCHED_YIELD_USEC);
+    } else {
+        c->delayed++;
+        DLIST_ADD_END(c->waiters, w, struct be_sched_waiter *);
+        c->waiting++;
+        if (c->waiting > c->max_waiting) {
+            c->max_waiting = c->waiting;
+        }
+        w->queued = true;
+
+        tv = tevent_timeval_current_ofs(BE_SCHED_MAX_WAIT, 0);
+    }
+
+    w->timeout = tevent_add_timer(be_ctx->ev, w, tv,
+                                  be_sched_yield_timeout, w);
+    if (w->timeout == NULL) {
+        /* never leave a task waiting without a way out */
+        be_sched_release(w, false);
+        tevent_req_post(req, be_ctx->ev);
+    }
+
+    return req;
+}
+
+errno_t be_sched_yield_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+static char *be_sched_dump(TALLOC_CTX *mem_ctx)
+{
+    struct be_sched_queue *c;
+    char *out;
+    int i;
+
+    if (be_sched_stats_ctx == NULL) {
+        return NULL;
+    }
+
+    out = talloc_asprintf(mem_ctx, "%-24s %7s %7s %7s %7s %9s %9s %7s\n",
+                          "Request class", "Active", "Max",
+                          "Waiting", "Max", "Yields", "Delayed", "Forced");
+
+    for (i = 0; out != NULL && i < BE_SCHED_CLASSES; i++) {
+        c = &be_sched_stats_ctx->classes[i];
+        out = talloc_asprintf_append(out,
+                                     "%-24s %7u %7u %7u %7u %9llu %9llu %7llu\n",
+                                     c->name, c->active, c->max_active,
+                                     c->waiting, c->max_waiting,
+                                     (unsigned long long) c->yields,
+                                     (unsigned long long) c->delayed,
+                                     (unsigned long long) c->forced);
+    }
+
+    return out;
+}
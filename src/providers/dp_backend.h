@@ -90,6 +90,8 @@ struct be_resolv_ctx {
 struct be_client {
     struct be_ctx *bectx;
     struct sbus_connection *conn;
+    /* set instead of conn for the clients of the binary channel */
+    struct dp_bin_conn *bin;
     struct tevent_timer *timeout;
     bool initialized;
 };
@@ -98,6 +100,8 @@ struct be_failover_ctx;
 
 struct be_cb;
 
+struct be_sched_ctx;
+
 struct be_ctx {
     struct tevent_context *ev;
     struct confdb_ctx *cdb;
@@ -131,12 +135,17 @@ struct be_ctx {
     struct bet_info bet_info[BET_MAX];
 
     size_t check_online_ref_count;
+
+    struct be_sched_ctx *sched;
 };
 
 struct bet_ops {
     be_req_fn_t check_online;
     be_req_fn_t handler;
     be_req_fn_t finalize;
+    /* optional, resolves BE_FILTER_NAME_LIST requests in one go; without
+     * it the names are looked up one by one through the handler */
+    be_req_fn_t batch_handler;
 };
 
 struct be_acct_req {
@@ -146,6 +155,8 @@ struct be_acct_req {
     char *filter_value;
     char *extra_value;
     char *domain;
+    /* NULL terminated, only set for BE_FILTER_NAME_LIST */
+    char **filter_list;
 };
 
 struct be_sudo_req {
@@ -194,6 +205,13 @@ int be_add_offline_cb(TALLOC_CTX *mem_ctx,
                      struct be_cb **online_cb);
 void be_run_offline_cb(struct be_ctx *be);
 
+/* Tell the PAM responder that the access rules of the domain changed and
+ * that cached account management decisions must not be used any longer */
+void be_pam_acct_cache_flush(struct be_ctx *be_ctx);
+
+/* Tell the sudo responder that the cached sudo rules of the domain changed */
+void be_sudo_rules_changed(struct be_ctx *be_ctx);
+
 /* from data_provider_fo.c */
 enum be_fo_protocol {
     BE_FO_PROTO_TCP,
@@ -207,6 +225,8 @@ int be_init_failover(struct be_ctx *ctx);
 int be_fo_is_srv_identifier(const char *server);
 int be_fo_add_service(struct be_ctx *ctx, const char *service_name,
                       datacmp_fn user_data_cmp);
+int be_fo_enable_probing(struct be_ctx *ctx, const char *service_name,
+                         int default_port);
 int be_fo_service_add_callback(TALLOC_CTX *memctx,
                                struct be_ctx *ctx, const char *service_name,
                                be_svc_callback_fn_t *fn, void *private_data);
@@ -257,6 +277,34 @@ void reset_fo(struct be_ctx *be_ctx);
 
 errno_t be_res_init(struct be_ctx *ctx);
 
+/* from data_provider_sched.c */
+enum be_sched_class {
+    BE_SCHED_INTERACTIVE,
+    BE_SCHED_REFRESH,
+    BE_SCHED_ENUMERATION,
+    BE_SCHED_CLEANUP,
+    BE_SCHED_CLASSES
+};
+
+struct be_sched_hold;
+
+errno_t be_sched_init(struct be_ctx *be_ctx);
+
+/* Marks a task of the class as running until the returned
+ * context is freed. Returns NULL if it cannot be tracked, the
+ * task may run anyway. */
+struct be_sched_hold *be_sched_hold(TALLOC_CTX *mem_ctx,
+                                    struct be_ctx *be_ctx,
+                                    enum be_sched_class cls);
+
+/* Completes once no task of a more important class is running or
+ * waiting, or after a few seconds at the latest. Background tasks call
+ * it between their steps, never inside a sysdb transaction. */
+struct tevent_req *be_sched_yield_send(TALLOC_CTX *mem_ctx,
+                                       struct be_ctx *be_ctx,
+                                       enum be_sched_class cls);
+errno_t be_sched_yield_recv(struct tevent_req *req);
+
 /* be_req helpers */
 
 struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
@@ -0,0 +1,689 @@
+/*
+   SSSD
+
+   Data Provider binary channel
+
+   A minimal framed protocol used between the responders and the data
+   providers for the requests that are sent most often. Every frame starts
+   with a fixed header of three 32-bit integers in host byte order (both
+   ends always run on the same machine):
+
+       total length of the frame, header included
+       frame type, with DP_BIN_REPLY set on replies
+       serial number, copied from the request to its reply
+
+   followed by the body, which is a sequence of 32-bit integers and
+   length-prefixed NUL-terminated strings.
+
+   Copyright (C) 2013 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "talloc.h"
+#include "tevent.h"
+#include "util/util.h"
+#include "providers/data_provider.h"
+
+struct dp_bin_out {
+    struct dp_bin_out *prev;
+    struct dp_bin_out *next;
+
+    uint8_t *data;
+    size_t len;
+    size_t done;
+};
+
+struct dp_bin_conn {
+    struct tevent_context *ev;
+    int fd;
+    struct tevent_fd *fde;
+
+    uint8_t in[DP_BIN_MAX_FRAME];
+    size_t in_len;
+
+    struct dp_bin_out *out_list;
+
+    dp_bin_frame_fn *frame_fn;
+    dp_bin_close_fn *close_fn;
+    void *pvt;
+
+    uint32_t serial;
+
+    /* set by the destructor when a handler frees the connection */
+    bool *freed;
+};
+
+struct dp_bin_server {
+    struct tevent_context *ev;
+    int fd;
+    struct tevent_fd *fde;
+    char *path;
+
+    dp_bin_accept_fn *accept_fn;
+    void *pvt;
+};
+
+int dp_get_bin_address(TALLOC_CTX *mem_ctx,
+                       char **address, const char *domain_name)
+{
+    char *default_address;
+
+    *address = NULL;
+    default_address = talloc_asprintf(mem_ctx, "%s/%s_%s",
+                                      PIPE_PATH, DATA_PROVIDER_BIN_PIPE,
+                                      domain_name);
+    if (default_address == NULL) {
+        return ENOMEM;
+    }
+
+    *address = default_address;
+    return EOK;
+}
+
+static errno_t dp_bin_set_flags(int fd)
+{
+    int flags;
+    errno_t ret;
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Unable to set fd non-blocking: [%d][%s]\n",
+               ret, strerror(ret)));
+        return ret;
+    }
+
+    flags = fcntl(fd, F_GETFD, 0);
+    if (flags == -1 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Unable to set fd close-on-exec: [%d][%s]\n",
+               ret, strerror(ret)));
+        return ret;
+    }
+
+    return EOK;
+}
+
+static errno_t dp_bin_fill_addr(const char *address, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(address) >= sizeof(addr->sun_path)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Socket path [%s] is too long\n",
+                                    address));
+        return EINVAL;
+    }
+    strcpy(addr->sun_path, address);
+
+    return EOK;
+}
+
+/* Connections */
+
+static void dp_bin_close(struct dp_bin_conn *conn)
+{
+    dp_bin_close_fn *close_fn = conn->close_fn;
+
+    /* the connection is unusable from now on */
+    talloc_zfree(conn->fde);
+    conn->close_fn = NULL;
+    conn->frame_fn = NULL;
+
+    if (close_fn) {
+        close_fn(conn, conn->pvt);
+    }
+}
+
+static void dp_bin_read(struct dp_bin_conn *conn)
+{
+    bool freed = false;
+    uint32_t frame_len;
+    uint32_t type;
+    uint32_t serial;
+    size_t pos;
+    ssize_t len;
+    errno_t ret;
+
+    errno = 0;
+    len = read(conn->fd, conn->in + conn->in_len,
+               DP_BIN_MAX_FRAME - conn->in_len);
+    if (len == -1) {
+        ret = errno;
+        if (ret == EAGAIN || ret == EWOULDBLOCK || ret == EINTR) {
+            return;
+        }
+        DEBUG(SSSDBG_OP_FAILURE, ("read failed [%d][%s]\n",
+                                  ret, strerror(ret)));
+        dp_bin_close(conn);
+        return;
+    }
+    if (len == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Peer closed the binary channel\n"));
+        dp_bin_close(conn);
+        return;
+    }
+    conn->in_len += len;
+
+    /* a single read often carries several frames */
+    conn->freed = &freed;
+    pos = 0;
+    while (conn->in_len - pos >= DP_BIN_HEADER_LEN) {
+        SAFEALIGN_COPY_UINT32(&frame_len, conn->in + pos, NULL);
+        SAFEALIGN_COPY_UINT32(&type, conn->in + pos + sizeof(uint32_t), NULL);
+        SAFEALIGN_COPY_UINT32(&serial, conn->in + pos + 2 * sizeof(uint32_t),
+                              NULL);
+
+        if (frame_len < DP_BIN_HEADER_LEN || frame_len > DP_BIN_MAX_FRAME) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("Invalid frame length [%u], closing the channel\n",
+                   frame_len));
+            conn->freed = NULL;
+            dp_bin_close(conn);
+            return;
+        }
+
+        if (conn->in_len - pos < frame_len) {
+            break;
+        }
+
+        if (conn->frame_fn) {
+            conn->frame_fn(conn, type, serial,
+                           conn->in + pos + DP_BIN_HEADER_LEN,
+                           frame_len - DP_BIN_HEADER_LEN, conn->pvt);
+            if (freed) {
+                return;
+            }
+        }
+        pos += frame_len;
+    }
+    conn->freed = NULL;
+
+    if (pos > 0) {
+        memmove(conn->in, conn->in + pos, conn->in_len - pos);
+        conn->in_len -= pos;
+    }
+}
+
+static errno_t dp_bin_write(struct dp_bin_conn *conn)
+{
+    struct dp_bin_out *out;
+    ssize_t len;
+    errno_t ret;
+
+    while ((out = conn->out_list) != NULL) {
+        errno = 0;
+        len = write(conn->fd, out->data + out->done, out->len - out->done);
+        if (len == -1) {
+            ret = errno;
+            if (ret == EAGAIN || ret == EWOULDBLOCK || ret == EINTR) {
+                return EAGAIN;
+            }
+            DEBUG(SSSDBG_OP_FAILURE, ("write failed [%d][%s]\n",
+                                      ret, strerror(ret)));
+            return ret;
+        }
+
+        out->done += len;
+        if (out->done < out->len) {
+            return EAGAIN;
+        }
+
+        DLIST_REMOVE(conn->out_list, out);
+        talloc_free(out);
+    }
+
+    return EOK;
+}
+
+static void dp_bin_fd_handler(struct tevent_context *ev,
+                              struct tevent_fd *fde,
+                              uint16_t flags, void *ptr)
+{
+    struct dp_bin_conn *conn = talloc_get_type(ptr, struct dp_bin_conn);
+    errno_t ret;
+
+    if (flags & TEVENT_FD_WRITE) {
+        ret = dp_bin_write(conn);
+        if (ret == EOK) {
+            TEVENT_FD_NOT_WRITEABLE(conn->fde);
+        } else if (ret != EAGAIN) {
+            dp_bin_close(conn);
+            return;
+        }
+    }
+
+    if (flags & TEVENT_FD_READ) {
+        dp_bin_read(conn);
+    }
+}
+
+static int dp_bin_conn_destructor(struct dp_bin_conn *conn)
+{
+    if (conn->freed) {
+        *conn->freed = true;
+    }
+
+    talloc_zfree(conn->fde);
+    if (conn->fd != -1) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+
+    return 0;
+}
+
+errno_t dp_bin_conn_setup(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int fd,
+                          struct dp_bin_conn **_conn)
+{
+    struct dp_bin_conn *conn;
+    errno_t ret;
+
+    ret = dp_bin_set_flags(fd);
+    if (ret != EOK) {
+        close(fd);
+        return ret;
+    }
+
+    conn = talloc_zero(mem_ctx, struct dp_bin_conn);
+    if (conn == NULL) {
+        close(fd);
+        return ENOMEM;
+    }
+    conn->ev = ev;
+    conn->fd = fd;
+    talloc_set_destructor(conn, dp_bin_conn_destructor);
+
+    conn->fde = tevent_add_fd(ev, conn, fd, TEVENT_FD_READ,
+                              dp_bin_fd_handler, conn);
+    if (conn->fde == NULL) {
+        talloc_free(conn);
+        return ENOMEM;
+    }
+
+    *_conn = conn;
+    return EOK;
+}
+
+void dp_bin_set_handlers(struct dp_bin_conn *conn,
+                         dp_bin_frame_fn *frame_fn,
+                         dp_bin_close_fn *close_fn,
+                         void *pvt)
+{
+    conn->frame_fn = frame_fn;
+    conn->close_fn = close_fn;
+    conn->pvt = pvt;
+}
+
+uint32_t dp_bin_next_serial(struct dp_bin_conn *conn)
+{
+    /* 0 is never used so that it can mean "no request" */
+    conn->serial++;
+    if (conn->serial == 0) {
+        conn->serial++;
+    }
+
+    return conn->serial;
+}
+
+errno_t dp_bin_send(struct dp_bin_conn *conn,
+                    uint32_t type, uint32_t serial,
+                    const uint8_t *body, size_t body_len)
+{
+    struct dp_bin_out *out;
+    uint32_t frame_len;
+    size_t rp;
+    errno_t ret;
+
+    if (conn->fde == NULL) {
+        /* already closed */
+        return EIO;
+    }
+
+    if (body_len > DP_BIN_MAX_FRAME - DP_BIN_HEADER_LEN) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Frame body too large [%zu]\n", body_len));
+        return EMSGSIZE;
+    }
+    frame_len = DP_BIN_HEADER_LEN + body_len;
+
+    out = talloc_zero(conn, struct dp_bin_out);
+    if (out == NULL) {
+        return ENOMEM;
+    }
+
+    out->data = talloc_size(out, frame_len);
+    if (out->data == NULL) {
+        talloc_free(out);
+        return ENOMEM;
+    }
+    out->len = frame_len;
+
+    rp = 0;
+    SAFEALIGN_SET_UINT32(out->data + rp, frame_len, &rp);
+    SAFEALIGN_SET_UINT32(out->data + rp, type, &rp);
+    SAFEALIGN_SET_UINT32(out->data + rp, serial, &rp);
+    if (body_len > 0) {
+        memcpy(out->data + rp, body, body_len);
+    }
+
+    DLIST_ADD_END(conn->out_list, out, struct dp_bin_out *);
+
+    /* Try to send right away, the socket buffer is almost never full and
+     * this saves a trip through the main loop */
+    if (conn->out_list == out) {
+        ret = dp_bin_write(conn);
+        if (ret == EOK) {
+            return EOK;
+        } else if (ret != EAGAIN) {
+            return ret;
+        }
+    }
+
+    TEVENT_FD_WRITEABLE(conn->fde);
+    return EOK;
+}
+
+errno_t dp_bin_connect(TALLOC_CTX *mem_ctx,
+                       struct tevent_context *ev,
+                       const char *address,
+                       struct dp_bin_conn **_conn)
+{
+    struct sockaddr_un addr;
+    int fd;
+    errno_t ret;
+
+    ret = dp_bin_fill_addr(address, &addr);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("socket failed [%d][%s]\n",
+                                    ret, strerror(ret)));
+        return ret;
+    }
+
+    /* connecting to a local socket does not block for long */
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_TRACE_FUNC, ("Cannot connect to [%s] [%d][%s]\n",
+                                  address, ret, strerror(ret)));
+        close(fd);
+        return ret;
+    }
+
+    return dp_bin_conn_setup(mem_ctx, ev, fd, _conn);
+}
+
+/* Server */
+
+static errno_t dp_bin_check_peer(int fd)
+{
+#ifdef HAVE_UCRED
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    errno_t ret;
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, ("getsockopt failed [%d][%s]\n",
+                                  ret, strerror(ret)));
+        return ret;
+    }
+    if (cred_len != sizeof(struct ucred)) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("getsockopt returned unexpected message size\n"));
+        return ENOMSG;
+    }
+
+    /* only the responders, which run as the same user, may talk to us */
+    if (cred.uid != 0 && cred.uid != geteuid()) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Rejecting binary channel from uid [%d]\n", cred.uid));
+        return EACCES;
+    }
+#endif
+
+    return EOK;
+}
+
+static void dp_bin_accept_handler(struct tevent_context *ev,
+                                  struct tevent_fd *fde,
+                                  uint16_t flags, void *ptr)
+{
+    struct dp_bin_server *srv = talloc_get_type(ptr, struct dp_bin_server);
+    struct dp_bin_conn *conn;
+    int fd;
+    errno_t ret;
+
+    fd = accept(srv->fd, NULL, NULL);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, ("accept failed [%d][%s]\n",
+                                  ret, strerror(ret)));
+        return;
+    }
+
+    ret = dp_bin_check_peer(fd);
+    if (ret != EOK) {
+        close(fd);
+        return;
+    }
+
+    ret = dp_bin_conn_setup(srv, srv->ev, fd, &conn);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Cannot set up the binary channel "
+                                  "[%d][%s]\n", ret, strerror(ret)));
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Accepted binary channel [%p]\n", conn));
+
+    srv->accept_fn(conn, srv->pvt);
+}
+
+static int dp_bin_server_destructor(struct dp_bin_server *srv)
+{
+    talloc_zfree(srv->fde);
+    if (srv->fd != -1) {
+        close(srv->fd);
+        unlink(srv->path);
+        srv->fd = -1;
+    }
+
+    return 0;
+}
+
+errno_t dp_bin_listen(TALLOC_CTX *mem_ctx,
+                      struct tevent_context *ev,
+                      const char *address,
+                      dp_bin_accept_fn *accept_fn,
+                      void *pvt)
+{
+    struct dp_bin_server *srv;
+    struct sockaddr_un addr;
+    mode_t old_umask;
+    errno_t ret;
+
+    ret = dp_bin_fill_addr(address, &addr);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    srv = talloc_zero(mem_ctx, struct dp_bin_server);
+    if (srv == NULL) {
+        return ENOMEM;
+    }
+    srv->ev = ev;
+    srv->accept_fn = accept_fn;
+    srv->pvt = pvt;
+    srv->fd = -1;
+
+    srv->path = talloc_strdup(srv, address);
+    if (srv->path == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    srv->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv->fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("socket failed [%d][%s]\n",
+                                    ret, strerror(ret)));
+        goto fail;
+    }
+    talloc_set_destructor(srv, dp_bin_server_destructor);
+
+    ret = dp_bin_set_flags(srv->fd);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    /* a stale socket of a previous instance would make bind fail */
+    unlink(address);
+
+    old_umask = umask(0177);
+    if (bind(srv->fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        ret = errno;
+        umask(old_umask);
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to bind on socket [%s] "
+                                    "[%d][%s]\n", address,
+                                    ret, strerror(ret)));
+        goto fail;
+    }
+    umask(old_umask);
+
+    if (listen(srv->fd, 10) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to listen on socket [%s] "
+                                    "[%d][%s]\n", address,
+                                    ret, strerror(ret)));
+        goto fail;
+    }
+
+    srv->fde = tevent_add_fd(ev, srv, srv->fd, TEVENT_FD_READ,
+                             dp_bin_accept_handler, srv);
+    if (srv->fde == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Listening for binary channels on [%s]\n",
+                              address));
+    return EOK;
+
+fail:
+    talloc_free(srv);
+    return ret;
+}
+
+/* Body encoding */
+
+errno_t dp_bin_add_uint32(TALLOC_CTX *mem_ctx, uint8_t **body,
+                          size_t *body_len, uint32_t val)
+{
+    uint8_t *buf;
+    size_t rp;
+
+    buf = talloc_realloc(mem_ctx, *body, uint8_t,
+                         *body_len + sizeof(uint32_t));
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    rp = *body_len;
+    SAFEALIGN_SET_UINT32(buf + rp, val, &rp);
+
+    *body = buf;
+    *body_len = rp;
+    return EOK;
+}
+
+errno_t dp_bin_add_string(TALLOC_CTX *mem_ctx, uint8_t **body,
+                          size_t *body_len, const char *str)
+{
+    uint8_t *buf;
+    uint32_t len;
+    size_t rp;
+
+    if (str == NULL) {
+        str = "";
+    }
+    len = strlen(str) + 1;
+
+    buf = talloc_realloc(mem_ctx, *body, uint8_t,
+                         *body_len + sizeof(uint32_t) + len);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    rp = *body_len;
+    SAFEALIGN_SET_UINT32(buf + rp, len, &rp);
+    memcpy(buf + rp, str, len);
+    rp += len;
+
+    *body = buf;
+    *body_len = rp;
+    return EOK;
+}
+
+errno_t dp_bin_get_uint32(const uint8_t *body, size_t body_len,
+                          size_t *pos, uint32_t *val)
+{
+    if (*pos > body_len || body_len - *pos < sizeof(uint32_t)) {
+        return EBADMSG;
+    }
+
+    SAFEALIGN_COPY_UINT32(val, body + *pos, pos);
+    return EOK;
+}
+
+errno_t dp_bin_get_string(const uint8_t *body, size_t body_len,
+                          size_t *pos, const char **str)
+{
+    uint32_t len;
+    size_t rp = *pos;
+    errno_t ret;
+
+    ret = dp_bin_get_uint32(body, body_len, &rp, &len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (len == 0 || body_len - rp < len || body[rp + len - 1] != '\0') {
+        return EBADMSG;
+    }
+
+    /* points into the frame, valid only while the frame is handled */
+    *str = (const char *) body + rp;
+    *pos = rp + len;
+    return EOK;
+}
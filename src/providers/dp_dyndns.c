@@ -964,46 +964,32 @@ struct tevent_req *be_nsupdate_send(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    child_pid = fork();
-
-    if (child_pid == 0) { /* child */
+    args = be_nsupdate_args(state, auth_type, force_tcp);
+    if (args == NULL) {
+        close(pipefd_to_child[0]);
         close(pipefd_to_child[1]);
-        ret = dup2(pipefd_to_child[0], STDIN_FILENO);
-        if (ret == -1) {
-            ret = errno;
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  ("dup2 failed [%d][%s].\n", ret, strerror(ret)));
-            goto done;
-        }
-
-        args = be_nsupdate_args(state, auth_type, force_tcp);
-        if (args == NULL) {
-            ret = ENOMEM;
-            goto done;
-        }
-
-        errno = 0;
-        execv(NSUPDATE_PATH, args);
-        /* The child should never end up here */
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, ("execv failed [%d][%s].\n", ret, strerror(ret)));
+        ret = ENOMEM;
         goto done;
-    } else if (child_pid > 0) { /* parent */
-        close(pipefd_to_child[0]);
+    }
 
-        subreq = nsupdate_child_send(state, ev, pipefd_to_child[1],
-                                     child_pid, nsupdate_msg);
-        if (subreq == NULL) {
-            ret = ERR_DYNDNS_FAILED;
-            goto done;
-        }
-        tevent_req_set_callback(subreq, be_nsupdate_done, req);
-    } else { /* error */
-        ret = errno;
+    ret = sss_spawn(NSUPDATE_PATH, args, pipefd_to_child, NULL, 0,
+                    &child_pid);
+    talloc_free(args);
+    close(pipefd_to_child[0]);
+    if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
-              ("fork failed [%d][%s].\n", ret, strerror(ret)));
+              ("Cannot start nsupdate [%d][%s].\n", ret, strerror(ret)));
+        close(pipefd_to_child[1]);
+        goto done;
+    }
+
+    subreq = nsupdate_child_send(state, ev, pipefd_to_child[1],
+                                 child_pid, nsupdate_msg);
+    if (subreq == NULL) {
+        ret = ERR_DYNDNS_FAILED;
         goto done;
     }
+    tevent_req_set_callback(subreq, be_nsupdate_done, req);
 
     ret = EOK;
 done:
@@ -24,10 +24,13 @@
 */
 
 #include <sys/time.h>
+#include <sys/socket.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <strings.h>
+#include <unistd.h>
 #include <talloc.h>
 
 #include "util/dlinklist.h"
@@ -43,6 +46,10 @@
 #define DEFAULT_SERVER_STATUS SERVER_NAME_NOT_RESOLVED
 #define DEFAULT_SRV_STATUS SRV_NEUTRAL
 
+/* Weight of the history in the latency moving average, each new sample
+ * contributes 1/FO_LATENCY_WEIGHT */
+#define FO_LATENCY_WEIGHT 8
+
 enum srv_lookup_status {
     SRV_NEUTRAL,        /* We didn't try this SRV lookup yet */
     SRV_RESOLVED,       /* This SRV lookup is resolved       */
@@ -76,6 +83,10 @@ struct fo_service {
      * is needed in fail over duplicate servers detection.
      */
     datacmp_fn user_data_cmp;
+
+    /* Port used to probe servers that were added without one. Probing of
+     * the service is disabled if this is 0. */
+    int probe_port;
 };
 
 struct fo_server {
@@ -90,6 +101,11 @@ struct fo_server {
     struct fo_service *service;
     struct timeval last_status_change;
     struct server_common *common;
+
+    /* Priority of the SRV record the server comes from, 0 otherwise */
+    int srv_priority;
+    /* Moving averages of the latency in ms, -1 if unknown */
+    int latency[FO_LATENCY_SENTINEL];
 };
 
 struct server_common {
@@ -153,6 +169,9 @@ fo_context_init(TALLOC_CTX *mem_ctx, struct fo_options *opts)
     ctx->opts->retry_timeout = opts->retry_timeout;
     ctx->opts->family_order  = opts->family_order;
     ctx->opts->service_resolv_timeout = opts->service_resolv_timeout;
+    ctx->opts->probe_count = opts->probe_count;
+    ctx->opts->probe_delay = opts->probe_delay;
+    ctx->opts->probe_timeout = opts->probe_timeout;
 
     DEBUG(SSSDBG_TRACE_FUNC, ("Created new fail over context, retry timeout is %d\n",
                               ctx->opts->retry_timeout));
@@ -587,6 +606,7 @@ create_fo_server(struct fo_service *service, const char *name,
 {
     struct fo_server *server;
     int ret;
+    int i;
 
     server = talloc_zero(service, struct fo_server);
     if (server == NULL)
@@ -597,6 +617,9 @@ create_fo_server(struct fo_service *service, const char *name,
     server->service = service;
     server->port_status = DEFAULT_PORT_STATUS;
     server->primary = primary;
+    for (i = 0; i < FO_LATENCY_SENTINEL; i++) {
+        server->latency[i] = -1;
+    }
 
     if (name != NULL) {
         ret = get_server_common(server, service->ctx, name, &server->common);
@@ -615,6 +638,15 @@ create_fo_server(struct fo_service *service, const char *name,
     return server;
 }
 
+void
+fo_set_service_probing(struct fo_service *service, int default_port)
+{
+    DEBUG(SSSDBG_TRACE_FUNC, ("Enabling server probing for service '%s', "
+                              "default port is %d\n",
+                              service->name, default_port));
+    service->probe_port = default_port;
+}
+
 int
 fo_get_server_count(struct fo_service *service)
 {
@@ -732,6 +764,7 @@ static errno_t fo_add_server_list(struct fo_service *service,
         }
 
         server->srv_data = srv_data;
+        server->srv_priority = servers[i].priority;
 
         ret = fo_add_server_to_list(&srv_list, service->server_list,
                                     server, service->name);
@@ -773,6 +806,70 @@ fo_add_server(struct fo_service *service, const char *name, int port,
     return ret;
 }
 
+/* True for servers that can be contacted right away, that is neither
+ * a SRV lookup placeholder nor a server from an expired SRV answer */
+static bool
+fo_server_is_direct(struct fo_server *server)
+{
+    if (server->common == NULL) return false;
+    if (server->srv_data == NULL) return true;
+    if (server->srv_data->meta == server) return false;
+
+    return get_srv_data_status(server->srv_data) == SRV_RESOLVED;
+}
+
+/* The search latency is what users wait for, the connect latency is
+ * used until the server answered a search */
+static int
+fo_server_latency_key(struct fo_server *server)
+{
+    if (server->latency[FO_LATENCY_SEARCH] >= 0) {
+        return server->latency[FO_LATENCY_SEARCH];
+    }
+
+    return server->latency[FO_LATENCY_CONNECT];
+}
+
+static bool
+fo_server_same_class(struct fo_server *a, struct fo_server *b)
+{
+    return a->primary == b->primary && a->srv_priority == b->srv_priority;
+}
+
+/* Look for a working server of the same class as 'server' that is known
+ * to be faster. Servers that were never measured are not considered. */
+static struct fo_server *
+fo_prefer_faster_server(struct fo_server *server)
+{
+    struct fo_server *best = server;
+    struct fo_server *iter;
+    int best_key;
+    int key;
+
+    best_key = fo_server_latency_key(server);
+
+    DLIST_FOR_EACH(iter, server->service->server_list) {
+        if (iter == server || !fo_server_is_direct(iter)) continue;
+        if (!fo_server_same_class(iter, server)) continue;
+
+        key = fo_server_latency_key(iter);
+        if (key < 0 || (best_key >= 0 && key >= best_key)) continue;
+
+        if (service_works(iter)) {
+            best = iter;
+            best_key = key;
+        }
+    }
+
+    if (best != server) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Preferring server '%s' (%d ms) to '%s'\n",
+                                  SERVER_NAME(best), best_key,
+                                  SERVER_NAME(server)));
+    }
+
+    return best;
+}
+
 static int
 get_first_server_entity(struct fo_service *service, struct fo_server **_server)
 {
@@ -799,7 +896,7 @@ get_first_server_entity(struct fo_service *service, struct fo_server **_server)
         if (service->last_tried_server->port_status == PORT_NEUTRAL &&
             server_works(service->last_tried_server)) {
             server = service->last_tried_server;
-            goto done;
+            goto found;
         }
 
         DLIST_FOR_EACH(server, service->last_tried_server->next) {
@@ -807,7 +904,7 @@ get_first_server_entity(struct fo_service *service, struct fo_server **_server)
             if (!server->primary) continue;
 
             if (service_works(server)) {
-                goto done;
+                goto found;
             }
         }
     }
@@ -818,7 +915,7 @@ get_first_server_entity(struct fo_service *service, struct fo_server **_server)
         if (!server->primary) continue;
 
         if (service_works(server)) {
-            goto done;
+            goto found;
         }
         if (server == service->last_tried_server) {
             break;
@@ -830,13 +927,18 @@ get_first_server_entity(struct fo_service *service, struct fo_server **_server)
         if (server->primary) continue;
 
         if (service_works(server)) {
-            goto done;
+            goto found;
         }
     }
 
     service->last_tried_server = NULL;
     return ENOENT;
 
+found:
+    if (fo_server_is_direct(server)) {
+        server = fo_prefer_faster_server(server);
+    }
+
 done:
     service->last_tried_server = server;
     *_server = server;
@@ -894,6 +996,16 @@ static errno_t fo_resolve_service_activate_timeout(struct tevent_req *req,
 static void fo_resolve_service_cont(struct tevent_req *subreq);
 static void fo_resolve_service_done(struct tevent_req *subreq);
 static bool fo_resolve_service_server(struct tevent_req *req);
+static bool fo_resolve_service_probe(struct tevent_req *req);
+static void fo_resolve_service_probe_done(struct tevent_req *subreq);
+
+/* Forward declarations for parallel probing */
+static struct tevent_req *
+fo_probe_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+              struct resolv_ctx *resolv, struct fo_ctx *ctx,
+              struct fo_server *first);
+static int
+fo_probe_recv(struct tevent_req *req, struct fo_server **winner);
 
 /* Forward declarations for SRV resolving */
 static struct tevent_req *
@@ -954,7 +1066,7 @@ fo_resolve_service_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
 
     /* This is a regular server, just do hostname lookup */
     state->server = server;
-    if (fo_resolve_service_server(req)) {
+    if (fo_resolve_service_probe(req)) {
         tevent_req_post(req, ev);
     }
 
@@ -1022,6 +1134,82 @@ fo_resolve_service_cont(struct tevent_req *subreq)
         return;
     }
 
+    fo_resolve_service_probe(req);
+}
+
+/* Race connections to several servers if the service asked for it,
+ * otherwise just resolve the server we have */
+static bool
+fo_resolve_service_probe(struct tevent_req *req)
+{
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    struct fo_service *service = state->server->service;
+    struct tevent_req *subreq;
+    int ret;
+
+    if (service->probe_port == 0
+            || state->fo_ctx->opts->probe_count < 2
+            || state->server->common == NULL
+            || state->server == service->active_server) {
+        return fo_resolve_service_server(req);
+    }
+
+    subreq = fo_probe_send(state, state->ev, state->resolv,
+                           state->fo_ctx, state->server);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return true;
+    }
+    tevent_req_set_callback(subreq, fo_resolve_service_probe_done, req);
+
+    /* The probes have their own timeout, extend the service one so
+     * that it does not fire in the middle of the race */
+    talloc_zfree(state->timeout_handler);
+    ret = fo_resolve_service_activate_timeout(req, state->ev,
+                                    state->fo_ctx->opts->service_resolv_timeout
+                                    + state->fo_ctx->opts->probe_timeout);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return true;
+    }
+
+    return false;
+}
+
+static void
+fo_resolve_service_probe_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    struct fo_server *winner = NULL;
+    int ret;
+
+    ret = fo_probe_recv(subreq, &winner);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (winner != NULL) {
+        state->server = winner;
+        state->server->service->last_tried_server = winner;
+        tevent_req_done(req);
+        return;
+    }
+
+    /* Nobody answered in time, let the caller try the first server
+     * the usual way so that it gets marked properly if it fails. If the
+     * probe already proved it dead, move on to the next one. */
+    if (get_server_status(state->server) == SERVER_NOT_WORKING
+            || state->server->port_status == PORT_NOT_WORKING) {
+        tevent_req_error(req, EAGAIN);
+        return;
+    }
+
     fo_resolve_service_server(req);
 }
 
@@ -1128,6 +1316,627 @@ fo_resolve_service_recv(struct tevent_req *req, struct fo_server **server)
     return EOK;
 }
 
+/*******************************************************************
+ * Race connections to several servers of a service.               *
+ *******************************************************************/
+
+/* Resolve the name of a particular server. Shares the lookup with any
+ * other request waiting for the same name. */
+static struct tevent_req *
+fo_resolve_server_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                       struct resolv_ctx *resolv, struct fo_ctx *ctx,
+                       struct fo_server *server)
+{
+    struct tevent_req *req;
+    struct resolve_service_state *state;
+
+    req = tevent_req_create(mem_ctx, &state, struct resolve_service_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->server = server;
+    state->resolv = resolv;
+    state->ev = ev;
+    state->fo_ctx = ctx;
+
+    if (fo_resolve_service_server(req)) {
+        tevent_req_post(req, ev);
+    }
+
+    return req;
+}
+
+struct fo_probe_server_state {
+    struct tevent_context *ev;
+    struct fo_server *server;
+
+    int fd;
+    struct tevent_fd *fde;
+    struct timeval start;
+};
+
+static void fo_probe_server_resolved(struct tevent_req *subreq);
+static errno_t fo_probe_server_connect(struct tevent_req *req);
+static void fo_probe_server_connected(struct tevent_context *ev,
+                                      struct tevent_fd *fde,
+                                      uint16_t flags, void *pvt);
+
+static int
+fo_probe_server_state_destructor(struct fo_probe_server_state *state)
+{
+    /* the fd event must go away before the descriptor is closed */
+    talloc_zfree(state->fde);
+    if (state->fd != -1) {
+        close(state->fd);
+        state->fd = -1;
+    }
+    return 0;
+}
+
+/* Resolve a single server and open a TCP connection to it, measuring
+ * how long the handshake took. */
+static struct tevent_req *
+fo_probe_server_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                     struct resolv_ctx *resolv, struct fo_ctx *ctx,
+                     struct fo_server *server)
+{
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    struct fo_probe_server_state *state;
+
+    req = tevent_req_create(mem_ctx, &state, struct fo_probe_server_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->server = server;
+    state->fd = -1;
+    talloc_set_destructor(state, fo_probe_server_state_destructor);
+
+    subreq = fo_resolve_server_send(state, ev, resolv, ctx, server);
+    if (subreq == NULL) {
+        talloc_zfree(req);
+        return NULL;
+    }
+    tevent_req_set_callback(subreq, fo_probe_server_resolved, req);
+
+    return req;
+}
+
+static void
+fo_probe_server_resolved(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct fo_probe_server_state *state = tevent_req_data(req,
+                                                struct fo_probe_server_state);
+    int ret;
+
+    ret = fo_resolve_service_recv(subreq, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (get_server_status(state->server) == SERVER_NOT_WORKING
+            || state->server->common->rhostent == NULL) {
+        tevent_req_error(req, EAGAIN);
+        return;
+    }
+
+    ret = fo_probe_server_connect(req);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+static void
+fo_probe_server_set_rtt(struct fo_probe_server_state *state)
+{
+    struct timeval tv;
+    int rtt;
+
+    gettimeofday(&tv, NULL);
+    rtt = (tv.tv_sec - state->start.tv_sec) * 1000
+          + (tv.tv_usec - state->start.tv_usec) / 1000;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Server '%s' answered the probe in %d ms\n",
+                              SERVER_NAME(state->server), rtt));
+    fo_add_server_latency(state->server, FO_LATENCY_CONNECT, rtt);
+}
+
+/* Returns EOK if connected immediately, EAGAIN if the connection is
+ * in progress and an error code otherwise */
+static errno_t
+fo_probe_server_connect(struct tevent_req *req)
+{
+    struct fo_probe_server_state *state = tevent_req_data(req,
+                                                struct fo_probe_server_state);
+    struct resolv_hostent *rhostent = state->server->common->rhostent;
+    struct sockaddr_storage *sockaddr;
+    socklen_t addr_len;
+    int port;
+    int flags;
+    int ret;
+
+    port = state->server->port != 0 ? state->server->port
+                                     : state->server->service->probe_port;
+
+    sockaddr = resolv_get_sockaddr_address(state, rhostent, port);
+    if (sockaddr == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Cannot get address of server '%s'\n",
+                                  SERVER_NAME(state->server)));
+        return EIO;
+    }
+
+    addr_len = rhostent->family == AF_INET6 ? sizeof(struct sockaddr_in6)
+                                            : sizeof(struct sockaddr_in);
+
+    state->fd = socket(rhostent->family, SOCK_STREAM, 0);
+    if (state->fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, ("socket failed [%d][%s].\n",
+                                  ret, strerror(ret)));
+        return ret;
+    }
+
+    flags = fcntl(state->fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(state->fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, ("fcntl failed [%d][%s].\n",
+                                  ret, strerror(ret)));
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Probing server '%s' on port %d\n",
+                              SERVER_NAME(state->server), port));
+
+    gettimeofday(&state->start, NULL);
+    ret = connect(state->fd, (struct sockaddr *) sockaddr, addr_len);
+    if (ret == EOK) {
+        fo_probe_server_set_rtt(state);
+        return EOK;
+    }
+
+    ret = errno;
+    if (ret != EINPROGRESS && ret != EINTR) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("connect to '%s' failed [%d][%s].\n",
+                                     SERVER_NAME(state->server),
+                                     ret, strerror(ret)));
+        return ret;
+    }
+
+    state->fde = tevent_add_fd(state->ev, state, state->fd, TEVENT_FD_WRITE,
+                               fo_probe_server_connected, req);
+    if (state->fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("tevent_add_fd failed.\n"));
+        return ENOMEM;
+    }
+
+    return EAGAIN;
+}
+
+static void
+fo_probe_server_connected(struct tevent_context *ev,
+                          struct tevent_fd *fde,
+                          uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct fo_probe_server_state *state = tevent_req_data(req,
+                                                struct fo_probe_server_state);
+    socklen_t optlen;
+    int error;
+    int ret;
+
+    talloc_zfree(state->fde);
+
+    optlen = sizeof(error);
+    ret = getsockopt(state->fd, SOL_SOCKET, SO_ERROR, &error, &optlen);
+    if (ret == -1) {
+        error = errno;
+    }
+
+    if (error != 0) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("connect to '%s' failed [%d][%s].\n",
+                                     SERVER_NAME(state->server),
+                                     error, strerror(error)));
+        tevent_req_error(req, error);
+        return;
+    }
+
+    fo_probe_server_set_rtt(state);
+    tevent_req_done(req);
+}
+
+static int
+fo_probe_server_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+struct fo_probe_state {
+    struct tevent_context *ev;
+    struct resolv_ctx *resolv;
+    struct fo_ctx *fo_ctx;
+
+    struct fo_server **candidates;
+    int num_candidates;
+    int next;
+    int pending;
+
+    struct tevent_timer *delay_te;
+    struct tevent_timer *timeout_te;
+    struct fo_server *winner;
+};
+
+static void fo_probe_launch_next(struct tevent_req *req);
+static void fo_probe_delay(struct tevent_context *ev,
+                           struct tevent_timer *te,
+                           struct timeval tv, void *pvt);
+static void fo_probe_timeout(struct tevent_context *ev,
+                             struct tevent_timer *te,
+                             struct timeval tv, void *pvt);
+static void fo_probe_done(struct tevent_req *subreq);
+
+/* Servers found by a SRV lookup are probed like configured ones, only the
+ * lookup placeholders and the servers of expired SRV answers are not */
+static bool
+fo_probe_is_candidate(struct fo_server *first, struct fo_server *server)
+{
+    if (server == first) return false;
+    if (!fo_server_is_direct(server)) return false;
+    if (!fo_server_same_class(server, first)) return false;
+    if (server->port == 0 && server->service->probe_port == 0) return false;
+
+    return service_works(server) ? true : false;
+}
+
+/* Servers that were already measured go first, fastest first. The rest
+ * keeps the order of the server list. */
+static void
+fo_probe_sort_candidates(struct fo_server **candidates, int num)
+{
+    struct fo_server *tmp;
+    int prev_key;
+    int key;
+    int i;
+    int j;
+
+    for (i = 1; i < num; i++) {
+        tmp = candidates[i];
+        key = fo_server_latency_key(tmp);
+        if (key < 0) continue;
+
+        for (j = i; j > 0; j--) {
+            prev_key = fo_server_latency_key(candidates[j - 1]);
+            if (prev_key >= 0 && prev_key <= key) {
+                break;
+            }
+            candidates[j] = candidates[j - 1];
+        }
+        candidates[j] = tmp;
+    }
+}
+
+/*
+ * Starts connection attempts to up to probe_count servers of the same
+ * class as 'first', 'probe_delay' ms apart. A failed attempt starts the
+ * next one immediately. The first server that accepts the connection is
+ * returned, NULL is returned if none did before 'probe_timeout'.
+ */
+static struct tevent_req *
+fo_probe_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+              struct resolv_ctx *resolv, struct fo_ctx *ctx,
+              struct fo_server *first)
+{
+    struct tevent_req *req;
+    struct fo_probe_state *state;
+    struct fo_server *server;
+    struct timeval tv;
+
+    req = tevent_req_create(mem_ctx, &state, struct fo_probe_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->resolv = resolv;
+    state->fo_ctx = ctx;
+
+    state->candidates = talloc_array(state, struct fo_server *,
+                                     ctx->opts->probe_count);
+    if (state->candidates == NULL) {
+        goto fail;
+    }
+
+    state->candidates[state->num_candidates++] = first;
+    DLIST_FOR_EACH(server, first->service->server_list) {
+        if (state->num_candidates == ctx->opts->probe_count) break;
+
+        if (fo_probe_is_candidate(first, server)) {
+            state->candidates[state->num_candidates++] = server;
+        }
+    }
+    fo_probe_sort_candidates(state->candidates, state->num_candidates);
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Probing %d servers of service '%s'\n",
+                              state->num_candidates,
+                              first->service->name));
+
+    tv = tevent_timeval_current_ofs(ctx->opts->probe_timeout, 0);
+    state->timeout_te = tevent_add_timer(ev, state, tv,
+                                         fo_probe_timeout, req);
+    if (state->timeout_te == NULL) {
+        goto fail;
+    }
+
+    fo_probe_launch_next(req);
+    if (!tevent_req_is_in_progress(req)) {
+        tevent_req_post(req, ev);
+    }
+
+    return req;
+
+fail:
+    talloc_zfree(req);
+    return NULL;
+}
+
+static void
+fo_probe_launch_next(struct tevent_req *req)
+{
+    struct fo_probe_state *state = tevent_req_data(req,
+                                                   struct fo_probe_state);
+    struct tevent_req *subreq;
+    struct timeval tv;
+
+    talloc_zfree(state->delay_te);
+
+    if (state->next >= state->num_candidates) {
+        if (state->pending == 0) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("No server answered the probe\n"));
+            tevent_req_done(req);
+        }
+        return;
+    }
+
+    subreq = fo_probe_server_send(state, state->ev, state->resolv,
+                                  state->fo_ctx,
+                                  state->candidates[state->next]);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(subreq, fo_probe_done, req);
+    state->next++;
+    state->pending++;
+
+    if (state->next < state->num_candidates) {
+        tv = tevent_timeval_current_ofs(0, state->fo_ctx->opts->probe_delay
+                                           * 1000);
+        state->delay_te = tevent_add_timer(state->ev, state, tv,
+                                           fo_probe_delay, req);
+        if (state->delay_te == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+    }
+}
+
+static void
+fo_probe_delay(struct tevent_context *ev,
+               struct tevent_timer *te,
+               struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct fo_probe_state *state = tevent_req_data(req,
+                                                   struct fo_probe_state);
+
+    state->delay_te = NULL;
+    fo_probe_launch_next(req);
+}
+
+static void
+fo_probe_timeout(struct tevent_context *ev,
+                 struct tevent_timer *te,
+                 struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct fo_probe_state *state = tevent_req_data(req,
+                                                   struct fo_probe_state);
+
+    state->timeout_te = NULL;
+    DEBUG(SSSDBG_MINOR_FAILURE, ("Server probing timed out\n"));
+    tevent_req_done(req);
+}
+
+static void
+fo_probe_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct fo_probe_state *state = tevent_req_data(req,
+                                                   struct fo_probe_state);
+    struct fo_probe_server_state *sstate = tevent_req_data(subreq,
+                                                struct fo_probe_server_state);
+    struct fo_server *server = sstate->server;
+    int ret;
+
+    ret = fo_probe_server_recv(subreq);
+    talloc_zfree(subreq);
+    state->pending--;
+
+    if (ret == EOK) {
+        state->winner = server;
+        tevent_req_done(req);
+        return;
+    }
+
+    /* A name that could not be resolved was already marked by the
+     * resolver, anything else means nobody listens on the port */
+    if (get_server_status(server) != SERVER_NOT_WORKING) {
+        fo_set_port_status(server, PORT_NOT_WORKING);
+    }
+
+    fo_probe_launch_next(req);
+}
+
+static int
+fo_probe_recv(struct tevent_req *req, struct fo_server **winner)
+{
+    struct fo_probe_state *state = tevent_req_data(req,
+                                                   struct fo_probe_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *winner = state->winner;
+    return EOK;
+}
+
+struct fo_reprobe_state {
+    int pending;
+    struct tevent_timer *timeout_te;
+};
+
+static void fo_reprobe_service_done(struct tevent_req *subreq);
+static void fo_reprobe_service_timeout(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval tv, void *pvt);
+
+struct tevent_req *
+fo_reprobe_service_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                        struct resolv_ctx *resolv, struct fo_ctx *ctx,
+                        struct fo_service *service)
+{
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    struct fo_reprobe_state *state;
+    struct fo_server *server;
+    struct timeval tv;
+    int ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct fo_reprobe_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    /* Re-probing is part of the parallel probing and
+     * is disabled together with it */
+    if (service->probe_port == 0 || ctx->opts->probe_count < 2) {
+        ret = EOK;
+        goto done;
+    }
+
+    DLIST_FOR_EACH(server, service->server_list) {
+        if (server == service->active_server) continue;
+        if (!fo_server_is_direct(server)) continue;
+
+        switch (get_server_status(server)) {
+        case SERVER_NOT_WORKING:
+        case SERVER_RESOLVING_NAME:
+            continue;
+        default:
+            break;
+        }
+
+        subreq = fo_probe_server_send(state, ev, resolv, ctx, server);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        tevent_req_set_callback(subreq, fo_reprobe_service_done, req);
+        state->pending++;
+    }
+
+    if (state->pending == 0) {
+        ret = EOK;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Re-probing %d servers of service '%s'\n",
+                              state->pending, service->name));
+
+    tv = tevent_timeval_current_ofs(ctx->opts->probe_timeout, 0);
+    state->timeout_te = tevent_add_timer(ev, state, tv,
+                                         fo_reprobe_service_timeout, req);
+    if (state->timeout_te == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    return req;
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static void
+fo_reprobe_service_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct fo_reprobe_state *state = tevent_req_data(req,
+                                                     struct fo_reprobe_state);
+    struct fo_probe_server_state *sstate = tevent_req_data(subreq,
+                                                struct fo_probe_server_state);
+    struct fo_server *server = sstate->server;
+    int ret;
+
+    ret = fo_probe_server_recv(subreq);
+    talloc_zfree(subreq);
+    state->pending--;
+
+    if (ret == EOK) {
+        if (server->port_status == PORT_NOT_WORKING) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Server '%s' answers again\n",
+                                      SERVER_NAME(server)));
+            fo_set_port_status(server, PORT_NEUTRAL);
+        }
+    } else if (get_server_status(server) != SERVER_NOT_WORKING) {
+        fo_set_port_status(server, PORT_NOT_WORKING);
+    }
+
+    if (state->pending == 0) {
+        tevent_req_done(req);
+    }
+}
+
+static void
+fo_reprobe_service_timeout(struct tevent_context *ev,
+                           struct tevent_timer *te,
+                           struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct fo_reprobe_state *state = tevent_req_data(req,
+                                                     struct fo_reprobe_state);
+
+    state->timeout_te = NULL;
+    DEBUG(SSSDBG_TRACE_FUNC, ("%d servers did not answer the re-probe\n",
+                              state->pending));
+    tevent_req_done(req);
+}
+
+int
+fo_reprobe_service_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /*******************************************************************
  * Resolve the server to connect to using a SRV query.             *
  *******************************************************************/
@@ -1456,6 +2265,38 @@ fo_is_server_primary(struct fo_server *server)
     return server->primary;
 }
 
+void
+fo_add_server_latency(struct fo_server *server,
+                      enum fo_latency_type type, int msecs)
+{
+    int *latency;
+
+    if (type < 0 || type >= FO_LATENCY_SENTINEL || msecs < 0) {
+        return;
+    }
+
+    latency = &server->latency[type];
+    if (*latency < 0) {
+        *latency = msecs;
+    } else {
+        *latency += (msecs - *latency) / FO_LATENCY_WEIGHT;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("%s latency of server '%s' is now %d ms\n",
+          type == FO_LATENCY_CONNECT ? "Connect" : "Search",
+          SERVER_NAME(server), *latency));
+}
+
+int
+fo_get_server_latency(struct fo_server *server, enum fo_latency_type type)
+{
+    if (type < 0 || type >= FO_LATENCY_SENTINEL) {
+        return -1;
+    }
+
+    return server->latency[type];
+}
+
 time_t
 fo_get_server_hostname_last_change(struct fo_server *server)
 {
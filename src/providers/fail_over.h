@@ -47,6 +47,13 @@ enum port_status {
     PORT_NOT_WORKING /* This port was reported to not work. */
 };
 
+enum fo_latency_type {
+    FO_LATENCY_CONNECT, /* The TCP handshake of a probe, without any
+                         * StartTLS or bind that would not compare. */
+    FO_LATENCY_SEARCH,  /* Answering a search on an open connection. */
+    FO_LATENCY_SENTINEL
+};
+
 enum server_status {
     SERVER_NAME_NOT_RESOLVED, /* We didn't yet resolved the host name. */
     SERVER_RESOLVING_NAME,    /* Name resolving is in progress. */
@@ -75,12 +82,21 @@ struct fo_server;
  *
  * The family_order member specifies the order of address families to
  * try when looking up the service.
+ *
+ * The 'probe_count' member specifies how many candidate servers are
+ * probed in parallel when resolving a service that has probing enabled
+ * (see fo_set_service_probing()). Values lower than 2 disable probing.
+ * The probes are started 'probe_delay' milliseconds apart and the whole
+ * race is given up after 'probe_timeout' seconds.
  */
 struct fo_options {
     time_t srv_retry_timeout;
     time_t retry_timeout;
     int service_resolv_timeout;
     enum restrict_family family_order;
+    int probe_count;
+    int probe_delay;
+    int probe_timeout;
 };
 
 /*
@@ -114,6 +130,14 @@ int fo_get_service(struct fo_ctx *ctx,
                    const char *name,
                    struct fo_service **_service);
 
+/*
+ * Enable parallel probing of the servers of 'service'. When the service is
+ * resolved, TCP connections are raced to several candidate servers and the
+ * first one that answers is returned. Servers that were added with port 0
+ * are probed on 'default_port'. Only use this for TCP based services.
+ */
+void fo_set_service_probing(struct fo_service *service, int default_port);
+
 /*
  * Get number of servers registered for the 'service'.
  */
@@ -149,6 +173,21 @@ struct tevent_req *fo_resolve_service_send(TALLOC_CTX *mem_ctx,
 int fo_resolve_service_recv(struct tevent_req *req,
                             struct fo_server **server);
 
+/*
+ * Probe all servers of a service with probing enabled except the active
+ * one to refresh their latency. Servers that answer are given another
+ * chance even if they were marked as not working before, servers that
+ * do not are marked as not working. Nothing is probed unless the
+ * 'probe_count' option is at least 2.
+ */
+struct tevent_req *fo_reprobe_service_send(TALLOC_CTX *mem_ctx,
+                                           struct tevent_context *ev,
+                                           struct resolv_ctx *resolv,
+                                           struct fo_ctx *ctx,
+                                           struct fo_service *service);
+
+int fo_reprobe_service_recv(struct tevent_req *req);
+
 /*
  * Set feedback about 'server'. Caller should use this to indicate a problem
  * with the server itself, not only with the service on that server. This
@@ -189,6 +228,22 @@ struct resolv_hostent *fo_get_server_hostent(struct fo_server *server);
 
 bool fo_is_server_primary(struct fo_server *server);
 
+/*
+ * Add a latency sample in milliseconds to the moving average of 'server'.
+ * When choosing a server, fail over prefers the fastest working server
+ * among the servers of the same class (primary or backup and SRV
+ * priority).
+ */
+void fo_add_server_latency(struct fo_server *server,
+                           enum fo_latency_type type, int msecs);
+
+/*
+ * Returns the moving average of the latency of 'server' in milliseconds
+ * or -1 if no sample was recorded yet.
+ */
+int fo_get_server_latency(struct fo_server *server,
+                          enum fo_latency_type type);
+
 time_t fo_get_server_hostname_last_change(struct fo_server *server);
 
 int fo_is_srv_lookup(struct fo_server *s);
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include "providers/ipa/ipa_hbac.h"
 #include "util/sss_utf8.h"
+#include "util/murmurhash3.h"
 
 #ifndef HAVE_ERRNO_T
 #define HAVE_ERRNO_T
@@ -294,6 +295,477 @@ static errno_t hbac_evaluate_element(struct hbac_rule_element *rule_el,
     return EOK;
 }
 
+/* Compiled rule sets
+ *
+ * For every rule element (users, services, target hosts, source hosts)
+ * the names and groups of all rules are case folded and put into a hash
+ * table that maps each of them to the list of rules mentioning it. An
+ * evaluation then only looks up the names and groups of the request and
+ * marks the rules they point to in a bitmap per element. The rules that
+ * are marked in all four bitmaps match the request.
+ */
+#define HBAC_ELEMENT_USERS       0
+#define HBAC_ELEMENT_SERVICES    1
+#define HBAC_ELEMENT_TARGETHOSTS 2
+#define HBAC_ELEMENT_SRCHOSTS    3
+#define HBAC_ELEMENT_COUNT       4
+
+#define HBAC_INDEX_SEED 0x48424143
+
+#define HBAC_BITMAP_WORDS(n) (((n) + 31) / 32)
+#define HBAC_BITMAP_SET(b, i) ((b)[(i) / 32] |= (1U << ((i) % 32)))
+
+struct hbac_index_entry {
+    char *key;
+    size_t key_len;
+    uint32_t hash;
+
+    uint32_t *rules;
+    size_t num_rules;
+    size_t alloc_rules;
+};
+
+struct hbac_index {
+    struct hbac_index_entry *entries;
+    size_t size;
+    size_t used;
+};
+
+struct hbac_compiled_element {
+    /* rules with HBAC_CATEGORY_ALL */
+    uint32_t *all;
+
+    struct hbac_index names;
+    struct hbac_index groups;
+};
+
+struct hbac_compiled_rules {
+    struct hbac_rule **rules;
+    size_t num_rules;
+    size_t num_words;
+
+    /* The rule set contains names that cannot be case folded,
+     * use the plain evaluation to report the error correctly */
+    bool linear;
+
+    /* enabled rules which can be evaluated */
+    uint32_t *enabled;
+
+    /* enabled rules which miss an element */
+    uint32_t *broken;
+
+    struct hbac_compiled_element el[HBAC_ELEMENT_COUNT];
+};
+
+static void hbac_index_free(struct hbac_index *index)
+{
+    size_t i;
+
+    if (index->entries == NULL) return;
+
+    for (i = 0; i < index->size; i++) {
+        free(index->entries[i].key);
+        free(index->entries[i].rules);
+    }
+    free(index->entries);
+    index->entries = NULL;
+}
+
+static struct hbac_index_entry *
+hbac_index_find(struct hbac_index *index, const char *key, size_t key_len,
+                uint32_t hash)
+{
+    struct hbac_index_entry *entry;
+    size_t pos;
+
+    pos = hash & (index->size - 1);
+    while (1) {
+        entry = &index->entries[pos];
+        if (entry->key == NULL) {
+            return entry;
+        }
+        if (entry->hash == hash && entry->key_len == key_len
+                && memcmp(entry->key, key, key_len) == 0) {
+            return entry;
+        }
+        pos = (pos + 1) & (index->size - 1);
+    }
+}
+
+static errno_t hbac_index_grow(struct hbac_index *index)
+{
+    struct hbac_index old = *index;
+    struct hbac_index_entry *entry;
+    size_t i;
+
+    index->size = old.size ? old.size * 2 : 64;
+    index->entries = calloc(index->size, sizeof(struct hbac_index_entry));
+    if (index->entries == NULL) {
+        *index = old;
+        return ENOMEM;
+    }
+
+    for (i = 0; i < old.size; i++) {
+        if (old.entries[i].key == NULL) continue;
+
+        entry = hbac_index_find(index, old.entries[i].key,
+                                old.entries[i].key_len, old.entries[i].hash);
+        *entry = old.entries[i];
+    }
+    free(old.entries);
+
+    return EOK;
+}
+
+/* Returns a case folded copy of name which must be freed with
+ * sss_utf8_free(), or NULL if name is not valid UTF-8. Names with the
+ * same key are the ones sss_utf8_case_eq() considers equal. */
+static char *hbac_index_key(const char *name, size_t *_len)
+{
+    return (char *) sss_utf8_casefold((const uint8_t *) name,
+                                      strlen(name), _len);
+}
+
+static errno_t hbac_index_add(struct hbac_index *index,
+                              const char *name, uint32_t rule)
+{
+    struct hbac_index_entry *entry;
+    uint32_t *rules;
+    char *key;
+    size_t key_len;
+    uint32_t hash;
+    errno_t ret;
+
+    key = hbac_index_key(name, &key_len);
+    if (key == NULL) {
+        return EINVAL;
+    }
+    hash = murmurhash3(key, key_len, HBAC_INDEX_SEED);
+
+    /* keep the table at most half full */
+    if ((index->used + 1) * 2 > index->size) {
+        ret = hbac_index_grow(index);
+        if (ret != EOK) goto done;
+    }
+
+    entry = hbac_index_find(index, key, key_len, hash);
+    if (entry->key == NULL) {
+        entry->key = malloc(key_len);
+        if (entry->key == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        memcpy(entry->key, key, key_len);
+        entry->key_len = key_len;
+        entry->hash = hash;
+        index->used++;
+    }
+
+    /* A rule may list the same name twice */
+    if (entry->num_rules > 0 && entry->rules[entry->num_rules - 1] == rule) {
+        ret = EOK;
+        goto done;
+    }
+
+    if (entry->num_rules == entry->alloc_rules) {
+        entry->alloc_rules = entry->alloc_rules ? entry->alloc_rules * 2 : 4;
+        rules = realloc(entry->rules, entry->alloc_rules * sizeof(uint32_t));
+        if (rules == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        entry->rules = rules;
+    }
+    entry->rules[entry->num_rules++] = rule;
+
+    ret = EOK;
+
+done:
+    sss_utf8_free(key);
+    return ret;
+}
+
+/* Marks the rules listing name in the bitmap. Returns EINVAL if name
+ * is not valid UTF-8. */
+static errno_t hbac_index_mark(struct hbac_index *index, const char *name,
+                               uint32_t *bitmap)
+{
+    struct hbac_index_entry *entry;
+    char *key;
+    size_t key_len;
+    size_t i;
+
+    if (index->used == 0) return EOK;
+
+    key = hbac_index_key(name, &key_len);
+    if (key == NULL) {
+        return EINVAL;
+    }
+
+    entry = hbac_index_find(index, key, key_len,
+                            murmurhash3(key, key_len, HBAC_INDEX_SEED));
+    sss_utf8_free(key);
+
+    if (entry->key == NULL) return EOK;
+
+    for (i = 0; i < entry->num_rules; i++) {
+        HBAC_BITMAP_SET(bitmap, entry->rules[i]);
+    }
+
+    return EOK;
+}
+
+static struct hbac_rule_element *hbac_rule_get_element(struct hbac_rule *rule,
+                                                       int el)
+{
+    switch (el) {
+    case HBAC_ELEMENT_USERS:
+        return rule->users;
+    case HBAC_ELEMENT_SERVICES:
+        return rule->services;
+    case HBAC_ELEMENT_TARGETHOSTS:
+        return rule->targethosts;
+    case HBAC_ELEMENT_SRCHOSTS:
+        return rule->srchosts;
+    }
+    return NULL;
+}
+
+static struct hbac_request_element *
+hbac_req_get_element(struct hbac_eval_req *hbac_req, int el)
+{
+    switch (el) {
+    case HBAC_ELEMENT_USERS:
+        return hbac_req->user;
+    case HBAC_ELEMENT_SERVICES:
+        return hbac_req->service;
+    case HBAC_ELEMENT_TARGETHOSTS:
+        return hbac_req->targethost;
+    case HBAC_ELEMENT_SRCHOSTS:
+        return hbac_req->srchost;
+    }
+    return NULL;
+}
+
+static errno_t hbac_compile_element(struct hbac_compiled_element *cel,
+                                    struct hbac_rule_element *rule_el,
+                                    uint32_t rule)
+{
+    size_t i;
+    errno_t ret;
+
+    if (rule_el->category & HBAC_CATEGORY_ALL) {
+        HBAC_BITMAP_SET(cel->all, rule);
+        return EOK;
+    }
+
+    if (rule_el->names) {
+        for (i = 0; rule_el->names[i]; i++) {
+            ret = hbac_index_add(&cel->names, rule_el->names[i], rule);
+            if (ret != EOK) return ret;
+        }
+    }
+
+    if (rule_el->groups) {
+        for (i = 0; rule_el->groups[i]; i++) {
+            ret = hbac_index_add(&cel->groups, rule_el->groups[i], rule);
+            if (ret != EOK) return ret;
+        }
+    }
+
+    return EOK;
+}
+
+struct hbac_compiled_rules *hbac_compile_rules(struct hbac_rule **rules)
+{
+    struct hbac_compiled_rules *compiled;
+    struct hbac_rule_element *rule_el;
+    size_t i;
+    int el;
+    errno_t ret;
+
+    compiled = calloc(1, sizeof(struct hbac_compiled_rules));
+    if (compiled == NULL) return NULL;
+
+    compiled->rules = rules;
+    for (i = 0; rules[i]; i++) ;
+    compiled->num_rules = i;
+    compiled->num_words = HBAC_BITMAP_WORDS(compiled->num_rules);
+
+    /* make sure there is always something to allocate */
+    compiled->enabled = calloc(compiled->num_words + 1, sizeof(uint32_t));
+    compiled->broken = calloc(compiled->num_words + 1, sizeof(uint32_t));
+    if (compiled->enabled == NULL || compiled->broken == NULL) {
+        goto fail;
+    }
+    for (el = 0; el < HBAC_ELEMENT_COUNT; el++) {
+        compiled->el[el].all = calloc(compiled->num_words + 1,
+                                      sizeof(uint32_t));
+        if (compiled->el[el].all == NULL) goto fail;
+    }
+
+    for (i = 0; i < compiled->num_rules; i++) {
+        if (!rules[i]->enabled) continue;
+
+        if (!rules[i]->users
+         || !rules[i]->services
+         || !rules[i]->targethosts
+         || !rules[i]->srchosts) {
+            HBAC_BITMAP_SET(compiled->broken, i);
+            continue;
+        }
+
+        HBAC_BITMAP_SET(compiled->enabled, i);
+
+        for (el = 0; el < HBAC_ELEMENT_COUNT; el++) {
+            rule_el = hbac_rule_get_element(rules[i], el);
+
+            ret = hbac_compile_element(&compiled->el[el], rule_el, i);
+            if (ret == EINVAL) {
+                compiled->linear = true;
+            } else if (ret != EOK) {
+                goto fail;
+            }
+        }
+    }
+
+    return compiled;
+
+fail:
+    hbac_free_compiled_rules(compiled);
+    return NULL;
+}
+
+void hbac_free_compiled_rules(struct hbac_compiled_rules *compiled)
+{
+    int el;
+
+    if (compiled == NULL) return;
+
+    for (el = 0; el < HBAC_ELEMENT_COUNT; el++) {
+        free(compiled->el[el].all);
+        hbac_index_free(&compiled->el[el].names);
+        hbac_index_free(&compiled->el[el].groups);
+    }
+    free(compiled->enabled);
+    free(compiled->broken);
+    free(compiled);
+}
+
+static errno_t hbac_mark_element(struct hbac_compiled_element *cel,
+                                 struct hbac_request_element *req_el,
+                                 uint32_t *bitmap, size_t num_words)
+{
+    size_t i;
+    errno_t ret;
+
+    memcpy(bitmap, cel->all, num_words * sizeof(uint32_t));
+
+    if (req_el == NULL) return EOK;
+
+    if (req_el->name != NULL) {
+        ret = hbac_index_mark(&cel->names, req_el->name, bitmap);
+        if (ret != EOK) return ret;
+    }
+
+    if (req_el->groups) {
+        for (i = 0; req_el->groups[i]; i++) {
+            ret = hbac_index_mark(&cel->groups, req_el->groups[i], bitmap);
+            if (ret != EOK) return ret;
+        }
+    }
+
+    return EOK;
+}
+
+enum hbac_eval_result
+hbac_evaluate_compiled(struct hbac_compiled_rules *compiled,
+                       struct hbac_eval_req *hbac_req,
+                       struct hbac_info **info)
+{
+    enum hbac_eval_result result = HBAC_EVAL_DENY;
+    uint32_t *matched = NULL;
+    uint32_t *bitmap = NULL;
+    uint32_t word;
+    size_t first;
+    size_t w;
+    int el;
+    errno_t ret;
+
+    if (compiled->linear) {
+        return hbac_evaluate(compiled->rules, hbac_req, info);
+    }
+
+    matched = malloc((compiled->num_words + 1) * sizeof(uint32_t));
+    bitmap = malloc((compiled->num_words + 1) * sizeof(uint32_t));
+    if (matched == NULL || bitmap == NULL) {
+        free(matched);
+        free(bitmap);
+        if (info) *info = NULL;
+        return HBAC_EVAL_OOM;
+    }
+    memcpy(matched, compiled->enabled, compiled->num_words * sizeof(uint32_t));
+
+    for (el = 0; el < HBAC_ELEMENT_COUNT; el++) {
+        ret = hbac_mark_element(&compiled->el[el],
+                                hbac_req_get_element(hbac_req, el),
+                                bitmap, compiled->num_words);
+        if (ret != EOK) {
+            /* The request cannot be compared case-insensitively,
+             * let the plain evaluation report it */
+            free(matched);
+            free(bitmap);
+            return hbac_evaluate(compiled->rules, hbac_req, info);
+        }
+
+        for (w = 0; w < compiled->num_words; w++) {
+            matched[w] &= bitmap[w];
+        }
+    }
+
+    if (info) {
+        *info = malloc(sizeof(struct hbac_info));
+        if (!*info) {
+            free(matched);
+            free(bitmap);
+            return HBAC_EVAL_OOM;
+        }
+        (*info)->code = HBAC_ERROR_UNKNOWN;
+        (*info)->rule_name = NULL;
+    }
+
+    /* The first rule that either matches or cannot be evaluated decides,
+     * just like in hbac_evaluate() */
+    for (w = 0; w < compiled->num_words; w++) {
+        word = matched[w] | compiled->broken[w];
+        if (word == 0) continue;
+
+        for (first = w * 32; (word & 1) == 0; word >>= 1) first++;
+        if (matched[w] & (1U << (first % 32))) {
+            result = HBAC_EVAL_ALLOW;
+            if (info) {
+                (*info)->code = HBAC_SUCCESS;
+                (*info)->rule_name = strdup(compiled->rules[first]->name);
+                if (!(*info)->rule_name) {
+                    result = HBAC_EVAL_ERROR;
+                    (*info)->code = HBAC_ERROR_OUT_OF_MEMORY;
+                }
+            }
+        } else {
+            result = HBAC_EVAL_ERROR;
+            if (info) {
+                (*info)->code = HBAC_ERROR_UNPARSEABLE_RULE;
+                (*info)->rule_name = strdup(compiled->rules[first]->name);
+            }
+        }
+        break;
+    }
+
+    free(matched);
+    free(bitmap);
+    return result;
+}
+
 const char *hbac_result_string(enum hbac_eval_result result)
 {
     switch(result) {
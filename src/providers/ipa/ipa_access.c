@@ -52,6 +52,24 @@ static void ipa_access_reply(struct hbac_ctx *hbac_ctx, int pam_status)
     }
 }
 
+/* A decision made by the HBAC rules may be cached by the PAM responder,
+ * the cached decisions are flushed whenever the rules change */
+static void ipa_access_reply_hbac(struct hbac_ctx *hbac_ctx, int pam_status)
+{
+    struct pam_data *pd;
+    uint8_t cacheable = 1;
+    errno_t ret;
+
+    pd = talloc_get_type(be_req_get_data(hbac_ctx->be_req), struct pam_data);
+    ret = pam_add_response(pd, SSS_ACCT_INFO_CACHEABLE,
+                           sizeof(cacheable), &cacheable);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("pam_add_response failed.\n"));
+    }
+
+    ipa_access_reply(hbac_ctx, pam_status);
+}
+
 enum hbac_result {
     HBAC_ALLOW = 1,
     HBAC_DENY,
@@ -463,6 +481,42 @@ fail:
     ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
 }
 
+/* Bumps the version of the rules only if the downloaded data differ from
+ * the previous download, so that an unchanged refresh keeps the prepared
+ * rules and the cached account decisions */
+static void hbac_update_rules_version(struct be_ctx *be_ctx,
+                                      struct ipa_access_ctx *access_ctx,
+                                      struct hbac_ctx *hbac_ctx,
+                                      size_t rule_count,
+                                      struct sysdb_attrs **rules)
+{
+    uint64_t digest = 0;
+
+    digest = ipa_hbac_objects_digest(digest, IPA_HBAC_DIGEST_RULES,
+                                     rule_count, rules);
+    digest = ipa_hbac_objects_digest(digest, IPA_HBAC_DIGEST_HOSTS,
+                                     hbac_ctx->host_count, hbac_ctx->hosts);
+    digest = ipa_hbac_objects_digest(digest, IPA_HBAC_DIGEST_HOSTGROUPS,
+                                     hbac_ctx->hostgroup_count,
+                                     hbac_ctx->hostgroups);
+    digest = ipa_hbac_objects_digest(digest, IPA_HBAC_DIGEST_SERVICES,
+                                     hbac_ctx->service_count,
+                                     hbac_ctx->services);
+    digest = ipa_hbac_objects_digest(digest, IPA_HBAC_DIGEST_SERVICEGROUPS,
+                                     hbac_ctx->servicegroup_count,
+                                     hbac_ctx->servicegroups);
+
+    if (access_ctx->rules_version != 0 && digest == access_ctx->rules_digest) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("HBAC rules did not change.\n"));
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("HBAC rules changed.\n"));
+    access_ctx->rules_digest = digest;
+    access_ctx->rules_version++;
+    be_pam_acct_cache_flush(be_ctx);
+}
+
 static void hbac_sysdb_save(struct tevent_req *req)
 {
     errno_t ret;
@@ -509,9 +563,10 @@ static void hbac_sysdb_save(struct tevent_req *req)
             ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
             return;
         }
+        hbac_update_rules_version(be_ctx, access_ctx, hbac_ctx, 0, NULL);
 
         /* If no rules are found, we default to DENY */
-        ipa_access_reply(hbac_ctx, PAM_PERM_DENIED);
+        ipa_access_reply_hbac(hbac_ctx, PAM_PERM_DENIED);
         return;
     }
 
@@ -570,6 +625,9 @@ static void hbac_sysdb_save(struct tevent_req *req)
     }
     in_transaction = false;
 
+    hbac_update_rules_version(be_ctx, access_ctx, hbac_ctx,
+                              hbac_ctx->rule_count, hbac_ctx->rules);
+
     /* We don't need the rule data any longer,
      * the rest of the processing relies on
      * sysdb lookups.
@@ -594,41 +652,183 @@ fail:
     ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
 }
 
-void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
+/* The HBAC rules from the cache in the form hbac_evaluate() expects,
+ * kept until the rules are downloaded again */
+struct ipa_hbac_rule_cache {
+    uint64_t version;
+    /* When the members of the rules were resolved */
+    time_t built;
+
+    /* The rules contain DENY rules, access is denied to everybody */
+    bool deny_rules;
+
+    struct hbac_rule **rules;
+    struct hbac_compiled_rules *compiled;
+};
+
+static int ipa_hbac_rule_cache_destructor(struct ipa_hbac_rule_cache *cache)
+{
+    hbac_free_compiled_rules(cache->compiled);
+    return 0;
+}
+
+static errno_t ipa_hbac_rule_cache_build(struct hbac_ctx *hbac_ctx)
 {
     struct be_ctx *be_ctx = be_req_get_be_ctx(hbac_ctx->be_req);
+    struct ipa_access_ctx *access_ctx = hbac_ctx->access_ctx;
+    struct ipa_hbac_rule_cache *cache;
     errno_t ret;
-    struct hbac_rule **hbac_rules;
-    struct hbac_eval_req *eval_req;
-    enum hbac_eval_result result;
-    struct hbac_info *info;
 
     /* Get HBAC rules from the sysdb */
     ret = hbac_get_cached_rules(hbac_ctx, be_ctx->domain,
                                 &hbac_ctx->rule_count, &hbac_ctx->rules);
     if (ret != EOK) {
         DEBUG(1, ("Could not retrieve rules from the cache\n"));
-        ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
+        return ret;
+    }
+
+    cache = talloc_zero(access_ctx, struct ipa_hbac_rule_cache);
+    if (cache == NULL) {
+        ret = ENOMEM;
+        goto done;
     }
+    talloc_set_destructor(cache, ipa_hbac_rule_cache_destructor);
+    cache->version = access_ctx->rules_version;
+    cache->built = time(NULL);
 
-    ret = hbac_ctx_to_rules(hbac_ctx, hbac_ctx,
-                            &hbac_rules, &eval_req);
+    ret = hbac_ctx_to_rules(cache, hbac_ctx, &cache->rules);
     if (ret == EPERM) {
-        DEBUG(1, ("DENY rules detected. Denying access to all users\n"));
-        ipa_access_reply(hbac_ctx, PAM_PERM_DENIED);
-        return;
+        cache->deny_rules = true;
     } else if (ret != EOK) {
         DEBUG(1, ("Could not construct HBAC rules\n"));
+        goto done;
+    } else {
+        cache->compiled = hbac_compile_rules(cache->rules);
+        if (cache->compiled == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Prepared %zu HBAC rules for evaluation\n",
+                              hbac_ctx->rule_count));
+
+    talloc_free(access_ctx->rule_cache);
+    access_ctx->rule_cache = cache;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(cache);
+    }
+    hbac_clear_rule_data(hbac_ctx);
+    return ret;
+}
+
+/* The members of the rules are resolved against the users and groups in
+ * the cache when the rules are prepared. A denial is only worth another
+ * look if the user or one of its groups was cached since then. */
+static bool ipa_hbac_rule_cache_outdated(struct hbac_ctx *hbac_ctx)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(hbac_ctx->be_req);
+    struct sss_domain_info *domain = be_ctx->domain;
+    struct sss_domain_info *user_dom = domain;
+    struct pam_data *pd = hbac_ctx->pd;
+    TALLOC_CTX *tmp_ctx;
+    bool updated = false;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return false;
+    }
+
+    if (strcasecmp(pd->domain, domain->name) != 0) {
+        user_dom = new_subdomain(tmp_ctx, domain, pd->domain,
+                                 NULL, NULL, NULL);
+        if (user_dom == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, ("new_subdomain failed.\n"));
+            goto done;
+        }
+    }
+
+    ret = ipa_hbac_entries_updated(domain, user_dom, pd->user,
+                                   hbac_ctx->access_ctx->rule_cache->built,
+                                   &updated);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Cannot check the cached entries of [%s] [%d][%s].\n",
+               pd->user, ret, sss_strerror(ret)));
+        updated = false;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return updated;
+}
+
+void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
+{
+    struct ipa_access_ctx *access_ctx = hbac_ctx->access_ctx;
+    struct ipa_hbac_rule_cache *cache = access_ctx->rule_cache;
+    bool fresh = false;
+    errno_t ret;
+    struct hbac_eval_req *eval_req;
+    enum hbac_eval_result result;
+    struct hbac_info *info;
+
+    if (cache == NULL || cache->version != access_ctx->rules_version) {
+        ret = ipa_hbac_rule_cache_build(hbac_ctx);
+        if (ret != EOK) {
+            ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
+            return;
+        }
+        fresh = true;
+    }
+
+    if (access_ctx->rule_cache->deny_rules) {
+        DEBUG(1, ("DENY rules detected. Denying access to all users\n"));
+        ipa_access_reply_hbac(hbac_ctx, PAM_PERM_DENIED);
+        return;
+    }
+
+    ret = hbac_ctx_to_eval_request(hbac_ctx, hbac_ctx, &eval_req);
+    if (ret != EOK) {
+        DEBUG(1, ("Could not construct eval request\n"));
         ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
         return;
     }
 
-    result = hbac_evaluate(hbac_rules, eval_req, &info);
+    result = hbac_evaluate_compiled(access_ctx->rule_cache->compiled,
+                                    eval_req, &info);
+    if (result == HBAC_EVAL_DENY && !fresh
+            && ipa_hbac_rule_cache_outdated(hbac_ctx)) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Entries of [%s] changed since the HBAC "
+                                  "rules were prepared, checking again.\n",
+                                  hbac_ctx->pd->user));
+        hbac_free_info(info);
+
+        ret = ipa_hbac_rule_cache_build(hbac_ctx);
+        if (ret != EOK) {
+            ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
+            return;
+        }
+
+        if (access_ctx->rule_cache->deny_rules) {
+            DEBUG(1, ("DENY rules detected. Denying access to all users\n"));
+            ipa_access_reply_hbac(hbac_ctx, PAM_PERM_DENIED);
+            return;
+        }
+
+        result = hbac_evaluate_compiled(access_ctx->rule_cache->compiled,
+                                        eval_req, &info);
+    }
+
     if (result == HBAC_EVAL_ALLOW) {
         DEBUG(3, ("Access granted by HBAC rule [%s]\n",
                   info->rule_name));
         hbac_free_info(info);
-        ipa_access_reply(hbac_ctx, PAM_SUCCESS);
+        ipa_access_reply_hbac(hbac_ctx, PAM_SUCCESS);
         return;
     } else if (result == HBAC_EVAL_ERROR) {
         DEBUG(1, ("Error [%s] occurred in rule [%s]\n",
@@ -645,7 +845,7 @@ void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
 
     DEBUG(3, ("Access denied by HBAC rules\n"));
     hbac_free_info(info);
-    ipa_access_reply(hbac_ctx, PAM_PERM_DENIED);
+    ipa_access_reply_hbac(hbac_ctx, PAM_PERM_DENIED);
 }
 
 errno_t hbac_get_cached_rules(TALLOC_CTX *mem_ctx,
@@ -32,11 +32,19 @@ enum ipa_access_mode {
     IPA_ACCESS_ALLOW
 };
 
+struct ipa_hbac_rule_cache;
+
 struct ipa_access_ctx {
     struct sdap_id_ctx *sdap_ctx;
     struct dp_option *ipa_options;
     struct time_rules_ctx *tr_ctx;
     time_t last_update;
+
+    /* Bumped whenever the HBAC rules in the cache change */
+    uint64_t rules_version;
+    /* Digest of the last downloaded rules, hosts and services */
+    uint64_t rules_digest;
+    struct ipa_hbac_rule_cache *rule_cache;
     struct sdap_access_ctx *sdap_access_ctx;
 
     struct sdap_attr_map *host_map;
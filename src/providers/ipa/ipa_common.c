@@ -868,6 +868,12 @@ int ipa_service_init(TALLOC_CTX *memctx, struct be_ctx *ctx,
         goto done;
     }
 
+    ret = be_fo_enable_probing(ctx, "IPA", LDAP_PORT);
+    if (ret != EOK) {
+        DEBUG(1, ("Failed to enable server probing!\n"));
+        goto done;
+    }
+
     service->sdap->name = talloc_strdup(service, "IPA");
     if (!service->sdap->name) {
         ret = ENOMEM;
@@ -259,6 +259,52 @@ enum hbac_eval_result hbac_evaluate(struct hbac_rule **rules,
                                     struct hbac_eval_req *hbac_req,
                                     struct hbac_info **info);
 
+/**
+ * Opaque type contained in hbac_evaluator.c
+ */
+struct hbac_compiled_rules;
+
+/**
+ * @brief Prepare a set of HBAC rules for repeated evaluation
+ *
+ * The names and groups of all rules are indexed so that
+ * #hbac_evaluate_compiled does not need to compare the request
+ * with every rule.
+ *
+ * @param[in] rules A NULL-terminated list of rules. The list and the
+ *                  rules must stay valid and unchanged until the result
+ *                  is freed with #hbac_free_compiled_rules
+ * @return The compiled rule set or NULL if there was not enough memory
+ */
+struct hbac_compiled_rules *hbac_compile_rules(struct hbac_rule **rules);
+
+/**
+ * @brief Evaluate an authorization request against a compiled rule set
+ *
+ * The result is the same as the one of #hbac_evaluate for the rules
+ * the set was compiled from.
+ *
+ * @param[in] compiled A rule set returned by #hbac_compile_rules
+ * @param[in] hbac_req A user authorization request
+ * @param[out] info    Extended information (including the name of the
+ *                     rule that allowed access (or caused a parse error)
+ * @return
+ *  - #HBAC_EVAL_ERROR: An error occurred
+ *  - #HBAC_EVAL_ALLOW: Access is granted
+ *  - #HBAC_EVAL_DENY:  Access is denied
+ *  - #HBAC_EVAL_OOM:   Insufficient memory to complete the evaluation
+ */
+enum hbac_eval_result
+hbac_evaluate_compiled(struct hbac_compiled_rules *compiled,
+                       struct hbac_eval_req *hbac_req,
+                       struct hbac_info **info);
+
+/**
+ * @brief Free a rule set returned by #hbac_compile_rules
+ * @param compiled The compiled rule set
+ */
+void hbac_free_compiled_rules(struct hbac_compiled_rules *compiled);
+
 /**
  * @brief Display result of hbac evaluation in human-readable form
  * @param[in] result Return value of #hbac_evaluate
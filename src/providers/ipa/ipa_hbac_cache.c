@@ -0,0 +1,168 @@
+/*
+    SSSD
+
+    IPA Backend Module -- Keeping the prepared HBAC rules up to date
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/murmurhash3.h"
+#include "db/sysdb.h"
+#include "providers/ipa/ipa_hbac_private.h"
+
+static uint64_t ipa_hbac_mix(const void *data, size_t len, uint32_t seed)
+{
+    uint64_t h1;
+    uint64_t h2;
+
+    h1 = murmurhash3(data, len, seed);
+    h2 = murmurhash3(data, len, ~seed);
+
+    return (h1 << 32) | h2;
+}
+
+/* The digest of an object is the sum of the digests of its values, so it
+ * does not depend on the order of the attributes and values */
+static uint64_t ipa_hbac_attrs_digest(struct sysdb_attrs *attrs)
+{
+    uint64_t digest = 0;
+    uint32_t name_hash;
+    int i;
+    unsigned int j;
+
+    for (i = 0; i < attrs->num; i++) {
+        name_hash = murmurhash3(attrs->a[i].name,
+                                strlen(attrs->a[i].name), 0x68626163);
+
+        for (j = 0; j < attrs->a[i].num_values; j++) {
+            digest += ipa_hbac_mix(attrs->a[i].values[j].data,
+                                   attrs->a[i].values[j].length, name_hash);
+        }
+    }
+
+    return digest;
+}
+
+uint64_t ipa_hbac_objects_digest(uint64_t digest, uint32_t kind,
+                                 size_t count, struct sysdb_attrs **objects)
+{
+    uint64_t object_digest;
+    size_t i;
+
+    /* The objects are mixed once more so that a value moved from one
+     * object to another changes the digest */
+    for (i = 0; i < count; i++) {
+        object_digest = ipa_hbac_attrs_digest(objects[i]);
+        digest += ipa_hbac_mix(&object_digest, sizeof(object_digest), kind);
+    }
+
+    return digest + ipa_hbac_mix(&count, sizeof(count), kind);
+}
+
+errno_t ipa_hbac_entries_updated(struct sss_domain_info *domain,
+                                 struct sss_domain_info *user_dom,
+                                 const char *username,
+                                 time_t since,
+                                 bool *_updated)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *user_attrs[] = { SYSDB_LAST_UPDATE,
+                                 SYSDB_ORIG_MEMBEROF,
+                                 NULL };
+    const char *group_attrs[] = { SYSDB_LAST_UPDATE, NULL };
+    struct ldb_message *msg;
+    struct ldb_message **groups;
+    struct ldb_message_element *el;
+    char *filter;
+    char *sanitized;
+    size_t count;
+    size_t i;
+    bool updated = false;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_user_by_name(tmp_ctx, user_dom->sysdb, user_dom,
+                                    username, user_attrs, &msg);
+    if (ret == ENOENT) {
+        /* nothing the rules could have missed */
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    if (ldb_msg_find_attr_as_uint64(msg, SYSDB_LAST_UPDATE, 0) >= since) {
+        updated = true;
+        ret = EOK;
+        goto done;
+    }
+
+    el = ldb_msg_find_element(msg, SYSDB_ORIG_MEMBEROF);
+    if (el == NULL || el->num_values == 0) {
+        ret = EOK;
+        goto done;
+    }
+
+    filter = talloc_strdup(tmp_ctx, "(|");
+    for (i = 0; i < el->num_values && filter != NULL; i++) {
+        ret = sss_filter_sanitize(tmp_ctx, (const char *) el->values[i].data,
+                                  &sanitized);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        filter = talloc_asprintf_append(filter, "(%s=%s)",
+                                        SYSDB_ORIG_DN, sanitized);
+    }
+    if (filter != NULL) {
+        filter = talloc_asprintf_append(filter, ")");
+    }
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_groups(tmp_ctx, domain->sysdb, domain, filter,
+                              group_attrs, &count, &groups);
+    if (ret == ENOENT) {
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (ldb_msg_find_attr_as_uint64(groups[i],
+                                        SYSDB_LAST_UPDATE, 0) >= since) {
+            updated = true;
+            break;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (ret == EOK) {
+        *_updated = updated;
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
@@ -79,8 +79,11 @@ replace_attribute_name(const char *old_name,
 
 errno_t hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                           struct hbac_ctx *hbac_ctx,
-                          struct hbac_rule ***rules,
-                          struct hbac_eval_req **request);
+                          struct hbac_rule ***rules);
+
+errno_t hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
+                                 struct hbac_ctx *hbac_ctx,
+                                 struct hbac_eval_req **request);
 
 errno_t
 hbac_get_category(struct sysdb_attrs *attrs,
@@ -107,6 +110,28 @@ get_ipa_hostgroupname(TALLOC_CTX *mem_ctx,
                       const char *host_dn,
                       char **hostgroupname);
 
+/* From ipa_hbac_cache.c */
+enum ipa_hbac_digest_kind {
+    IPA_HBAC_DIGEST_RULES = 1,
+    IPA_HBAC_DIGEST_HOSTS,
+    IPA_HBAC_DIGEST_HOSTGROUPS,
+    IPA_HBAC_DIGEST_SERVICES,
+    IPA_HBAC_DIGEST_SERVICEGROUPS
+};
+
+/* Adds the downloaded objects of one kind to the digest, the result does
+ * not depend on the order of the objects, attributes or values */
+uint64_t ipa_hbac_objects_digest(uint64_t digest, uint32_t kind,
+                                 size_t count, struct sysdb_attrs **objects);
+
+/* Checks if the entry of the user or of one of its groups was written to
+ * the cache at or after the given time */
+errno_t ipa_hbac_entries_updated(struct sss_domain_info *domain,
+                                 struct sss_domain_info *user_dom,
+                                 const char *username,
+                                 time_t since,
+                                 bool *_updated);
+
 /* From ipa_hbac_services.c */
 struct tevent_req *
 ipa_hbac_service_info_send(TALLOC_CTX *mem_ctx,
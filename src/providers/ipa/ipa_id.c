@@ -107,6 +107,18 @@ void ipa_account_info_handler(struct be_req *breq)
     tevent_req_set_callback(req, ipa_account_info_done, breq);
 }
 
+/* batches only come for the IPA domain itself */
+void ipa_account_batch_handler(struct be_req *breq)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct ipa_id_ctx *ipa_ctx;
+
+    ipa_ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                              struct ipa_id_ctx);
+
+    return sdap_handle_account_batch(breq, ipa_ctx->sdap_id_ctx);
+}
+
 static void ipa_account_info_done(struct tevent_req *req)
 {
     struct be_req *breq = tevent_req_callback_data(req, struct be_req);
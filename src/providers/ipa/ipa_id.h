@@ -32,6 +32,7 @@
 #include "providers/ipa/ipa_subdomains.h"
 
 void ipa_account_info_handler(struct be_req *breq);
+void ipa_account_batch_handler(struct be_req *breq);
 struct tevent_req *ipa_get_netgroups_send(TALLOC_CTX *memctx,
                                           struct tevent_context *ev,
                                           struct sysdb_ctx *sysdb,
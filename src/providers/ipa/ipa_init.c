@@ -49,7 +49,8 @@ struct ipa_options *ipa_options = NULL;
 struct bet_ops ipa_id_ops = {
     .handler = ipa_account_info_handler,
     .finalize = NULL,
-    .check_online = ipa_check_online
+    .check_online = ipa_check_online,
+    .batch_handler = ipa_account_batch_handler
 };
 
 struct bet_ops ipa_auth_ops = {
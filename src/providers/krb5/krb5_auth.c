@@ -1187,21 +1187,19 @@ void krb5_pam_handler(struct be_req *be_req)
     switch (pd->cmd) {
         case SSS_PAM_AUTHENTICATE:
         case SSS_CMD_RENEW:
-        case SSS_PAM_CHAUTHTOK_PRELIM:
         case SSS_PAM_CHAUTHTOK:
-            ret = add_to_wait_queue(be_req, pd, krb5_ctx);
+            ret = krb5_auth_queue_add(be_req, pd, krb5_ctx);
             if (ret == EOK) {
-                DEBUG(7, ("Request successfully added to wait queue "
-                          "of user [%s].\n", pd->user));
                 return;
-            } else if (ret == ENOENT) {
-                DEBUG(7, ("Wait queue of user [%s] is empty, "
-                          "running request immediately.\n", pd->user));
-            } else {
-                DEBUG(7, ("Failed to add request to wait queue of user [%s], "
-                          "running request immediately.\n", pd->user));
             }
 
+            DEBUG(7, ("Failed to add request to wait queue of user [%s], "
+                      "running request immediately.\n", pd->user));
+            /* fall through */
+        case SSS_PAM_CHAUTHTOK_PRELIM:
+            /* The password checks do not touch the credential cache and
+             * do not have to wait for other requests of the user */
+
             req = krb5_auth_send(be_req, be_ctx->ev, be_ctx, pd, krb5_ctx);
             if (req == NULL) {
                 DEBUG(1, ("krb5_auth_send failed.\n"));
@@ -1246,7 +1244,6 @@ void krb5_pam_handler_auth_done(struct tevent_req *req)
     int pam_status;
     int dp_err;
     struct pam_data *pd;
-    struct krb5_ctx *krb5_ctx;
 
     pd = talloc_get_type(be_req_get_data(be_req), struct pam_data);
 
@@ -1259,13 +1256,6 @@ void krb5_pam_handler_auth_done(struct tevent_req *req)
         pd->pam_status = pam_status;
     }
 
-    krb5_ctx = get_krb5_ctx(be_req);
-    if (krb5_ctx != NULL) {
-        check_wait_queue(krb5_ctx, pd->user);
-    } else {
-        DEBUG(1, ("Kerberos context not available.\n"));
-    }
-
     be_req_terminate(be_req, dp_err, pd->pam_status, NULL);
 }
 
@@ -111,7 +111,9 @@ struct tevent_req *krb5_access_send(TALLOC_CTX *mem_ctx,
 int krb5_access_recv(struct tevent_req *req, bool *access_allowed);
 
 /* krb5_wait_queue.c */
-errno_t add_to_wait_queue(struct be_req *be_req, struct pam_data *pd,
-                          struct krb5_ctx *krb5_ctx);
-void check_wait_queue(struct krb5_ctx *krb5_ctx, char *username);
+/* Run the request as soon as no other request of the same user is using
+ * the credential cache, or attach it to an identical authentication which
+ * is already scheduled. The queue terminates be_req. */
+errno_t krb5_auth_queue_add(struct be_req *be_req, struct pam_data *pd,
+                            struct krb5_ctx *krb5_ctx);
 #endif /* __KRB5_AUTH_H__ */
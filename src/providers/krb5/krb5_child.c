@@ -30,6 +30,7 @@
 #include <security/pam_modules.h>
 
 #include "util/util.h"
+#include "util/strtonum.h"
 #include "util/sss_krb5.h"
 #include "util/user_info_msg.h"
 #include "util/child_common.h"
@@ -63,6 +64,9 @@ struct krb5_req {
 };
 
 static krb5_context krb5_error_ctx;
+/* Context initialized once by a pool worker and inherited by the
+ * processes it forks for the single requests */
+static krb5_context k5c_pool_ctx;
 #define KRB5_CHILD_DEBUG(level, error) KRB5_DEBUG(level, krb5_error_ctx, error)
 
 static krb5_error_code get_changepw_options(krb5_context ctx,
@@ -1811,6 +1815,37 @@ done:
     return kerr;
 }
 
+/* The request must be for the user the child already runs as */
+static errno_t k5c_check_user(struct krb5_req *kr, uid_t uid, gid_t gid)
+{
+    if (kr->uid != uid || kr->gid != gid) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Request for [%llu][%llu] sent to a child running as "
+               "[%llu][%llu].\n",
+               (unsigned long long) kr->uid, (unsigned long long) kr->gid,
+               (unsigned long long) uid, (unsigned long long) gid));
+        return EPERM;
+    }
+
+    return EOK;
+}
+
+static errno_t k5c_parse_id(const char *str, uint32_t *_id)
+{
+    char *endptr;
+    uint32_t id;
+
+    errno = 0;
+    id = strtouint32(str, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || str == endptr) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Invalid id [%s].\n", str));
+        return EINVAL;
+    }
+
+    *_id = id;
+    return EOK;
+}
+
 static errno_t k5c_recv_data(struct krb5_req *kr, int fd, uint32_t *offline)
 {
     uint8_t buf[IN_BUF_SIZE];
@@ -1926,10 +1961,15 @@ static int k5c_setup(struct krb5_req *kr, uint32_t offline)
               ("Cannot read [%s] from environment.\n", SSSD_KRB5_REALM));
     }
 
-    kerr = krb5_init_context(&kr->ctx);
-    if (kerr != 0) {
-        KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, kerr);
-        return kerr;
+    if (k5c_pool_ctx != NULL) {
+        /* krb5.conf was already read by the pool worker */
+        kr->ctx = k5c_pool_ctx;
+    } else {
+        kerr = krb5_init_context(&kr->ctx);
+        if (kerr != 0) {
+            KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, kerr);
+            return kerr;
+        }
     }
 
     /* Set the global error context */
@@ -2050,6 +2090,267 @@ static int k5c_setup(struct krb5_req *kr, uint32_t offline)
     return kerr;
 }
 
+static errno_t k5c_handle_request(struct krb5_req *kr, uint32_t offline,
+                                  int fd)
+{
+    errno_t ret;
+
+    ret = k5c_setup(kr, offline);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("krb5_child_setup failed.\n"));
+        return ret;
+    }
+
+    switch(kr->pd->cmd) {
+    case SSS_PAM_AUTHENTICATE:
+        /* If we are offline, we need to create an empty ccache file */
+        if (offline) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform offline auth\n"));
+            ret = create_empty_ccache(kr);
+        } else {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform online auth\n"));
+            ret = tgt_req_child(kr);
+        }
+        break;
+    case SSS_PAM_CHAUTHTOK:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change\n"));
+        ret = changepw_child(kr, false);
+        break;
+    case SSS_PAM_CHAUTHTOK_PRELIM:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change checks\n"));
+        ret = changepw_child(kr, true);
+        break;
+    case SSS_PAM_ACCT_MGMT:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform account management\n"));
+        ret = kuserok_child(kr);
+        break;
+    case SSS_CMD_RENEW:
+        if (offline) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot renew TGT while offline\n"));
+            return KRB5_KDC_UNREACH;
+        }
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform ticket renewal\n"));
+        ret = renew_tgt_child(kr);
+        break;
+    default:
+        DEBUG(1, ("PAM command [%d] not supported.\n", kr->pd->cmd));
+        return EINVAL;
+    }
+
+    ret = k5c_send_data(kr, fd, ret);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to send reply\n"));
+    }
+
+    return ret;
+}
+
+/* Run a single request of a pool worker in a child process which drops
+ * privileges if requested before it unpacks the request, and collect its
+ * reply. An empty reply means that the child failed without answering. */
+static errno_t k5c_pool_run_request(TALLOC_CTX *mem_ctx,
+                                    uint8_t *req_buf, size_t req_len,
+                                    uint32_t run_as_user,
+                                    uid_t uid, gid_t gid,
+                                    uint8_t **_resp, size_t *_resp_len)
+{
+    struct krb5_req *kr;
+    uint32_t offline;
+    int pipefd[2];
+    uint8_t *resp;
+    size_t resp_len = 0;
+    ssize_t len;
+    pid_t pid;
+    int status;
+    errno_t ret;
+
+    ret = pipe(pipefd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("pipe failed [%d][%s].\n", ret, strerror(ret)));
+        return ret;
+    }
+
+    pid = fork();
+    if (pid == 0) { /* child */
+        close(pipefd[0]);
+        close(STDIN_FILENO);
+        close(STDOUT_FILENO);
+
+        kr = talloc_zero(NULL, struct krb5_req);
+        if (kr == NULL) {
+            _exit(-1);
+        }
+
+        debug_prg_name = talloc_asprintf(kr, "[sssd[krb5_child[%d]]]",
+                                         getpid());
+        if (debug_prg_name == NULL) {
+            _exit(-1);
+        }
+
+        ret = EOK;
+        if (run_as_user) {
+            ret = become_user(uid, gid);
+            if (ret != EOK) {
+                DEBUG(1, ("become_user failed.\n"));
+            }
+        }
+
+        if (ret == EOK) {
+            ret = unpack_buffer(req_buf, req_len, kr, &offline);
+            if (ret != EOK) {
+                DEBUG(1, ("unpack_buffer failed.\n"));
+            }
+        }
+
+        if (ret == EOK && run_as_user) {
+            ret = k5c_check_user(kr, uid, gid);
+        }
+
+        if (ret == EOK) {
+            ret = k5c_handle_request(kr, offline, pipefd[1]);
+        }
+
+        krb5_cleanup(kr);
+        talloc_free(kr);
+        _exit(ret == EOK ? 0 : -1);
+    } else if (pid < 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("fork failed [%d][%s].\n", ret, strerror(ret)));
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return ret;
+    }
+
+    close(pipefd[1]);
+
+    resp = talloc_array(mem_ctx, uint8_t, CHILD_MSG_CHUNK);
+    if (resp == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    while (1) {
+        if (resp_len == talloc_get_size(resp)) {
+            resp = talloc_realloc(mem_ctx, resp, uint8_t,
+                                  resp_len + CHILD_MSG_CHUNK);
+            if (resp == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+
+        errno = 0;
+        len = sss_atomic_read_s(pipefd[0], resp + resp_len,
+                                talloc_get_size(resp) - resp_len);
+        if (len == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("read failed [%d][%s].\n", ret, strerror(ret)));
+            goto done;
+        } else if (len == 0) {
+            break;
+        }
+        resp_len += len;
+    }
+
+    *_resp = resp;
+    *_resp_len = resp_len;
+    ret = EOK;
+
+done:
+    close(pipefd[0]);
+    if (ret != EOK) {
+        talloc_free(resp);
+    }
+
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+    DEBUG(SSSDBG_TRACE_FUNC, ("Request child [%d] finished with status "
+                              "[%d].\n", pid, status));
+
+    return ret;
+}
+
+/* Serve requests framed by the back end until it closes our stdin */
+static errno_t k5c_pool_loop(TALLOC_CTX *mem_ctx)
+{
+    uint8_t hdr[4*sizeof(uint32_t)];
+    uint8_t buf[IN_BUF_SIZE];
+    uint32_t run_as_user;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t req_len;
+    size_t rp;
+    uint8_t *resp;
+    size_t resp_len;
+    uint32_t frame_len;
+    ssize_t len;
+    krb5_error_code kerr;
+    errno_t ret;
+
+    kerr = krb5_init_context(&k5c_pool_ctx);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to init kerberos context.\n"));
+        return EIO;
+    }
+
+    while (1) {
+        errno = 0;
+        len = sss_atomic_read_s(STDIN_FILENO, hdr, sizeof(hdr));
+        if (len == 0) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Back end closed the pipe.\n"));
+            return EOK;
+        } else if (len != sizeof(hdr)) {
+            ret = (len == -1) ? errno : EIO;
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read request header.\n"));
+            return ret;
+        }
+
+        rp = 0;
+        SAFEALIGN_COPY_UINT32(&run_as_user, hdr + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&uid, hdr + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&gid, hdr + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&req_len, hdr + rp, &rp);
+        if (req_len > IN_BUF_SIZE) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Request too long [%u].\n", req_len));
+            return EINVAL;
+        }
+
+        errno = 0;
+        len = sss_atomic_read_s(STDIN_FILENO, buf, req_len);
+        if (len != req_len) {
+            ret = (len == -1) ? errno : EIO;
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read request.\n"));
+            return ret;
+        }
+
+        ret = k5c_pool_run_request(mem_ctx, buf, req_len, run_as_user,
+                                   uid, gid, &resp, &resp_len);
+        safezero(buf, req_len);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        frame_len = resp_len;
+        errno = 0;
+        len = sss_atomic_write_s(STDOUT_FILENO, &frame_len, sizeof(frame_len));
+        if (len == sizeof(frame_len) && resp_len > 0) {
+            len = sss_atomic_write_s(STDOUT_FILENO, resp, resp_len);
+            if (len == resp_len) {
+                len = sizeof(frame_len);
+            }
+        }
+        talloc_free(resp);
+        if (len != sizeof(frame_len)) {
+            ret = (len == -1) ? errno : EIO;
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot send response.\n"));
+            return ret;
+        }
+    }
+}
+
 int main(int argc, const char *argv[])
 {
     struct krb5_req *kr = NULL;
@@ -2057,6 +2358,11 @@ int main(int argc, const char *argv[])
     int opt;
     poptContext pc;
     int debug_fd = -1;
+    const char *uid_str = NULL;
+    const char *gid_str = NULL;
+    uint32_t uid;
+    uint32_t gid;
+    int worker = 0;
     errno_t ret;
 
     struct poptOption long_options[] = {
@@ -2069,6 +2375,12 @@ int main(int argc, const char *argv[])
          _("Show timestamps with microseconds"), NULL},
         {"debug-fd", 0, POPT_ARG_INT, &debug_fd, 0,
          _("An open file descriptor for the debug logs"), NULL},
+        {"uid", 0, POPT_ARG_STRING, &uid_str, 0,
+         _("Switch to this uid before reading the request"), NULL},
+        {"gid", 0, POPT_ARG_STRING, &gid_str, 0,
+         _("Switch to this gid before reading the request"), NULL},
+        {"worker", 0, POPT_ARG_NONE, &worker, 0,
+         _("Handle a stream of requests as a pool worker"), NULL},
         POPT_TABLEEND
     };
 
@@ -2112,62 +2424,52 @@ int main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, ("krb5_child started.\n"));
 
-    ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
-    if (ret != EOK) {
+    if (worker) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Running as pool worker.\n"));
+        ret = k5c_pool_loop(kr);
         goto done;
     }
 
-    close(STDIN_FILENO);
-
-    ret = k5c_setup(kr, offline);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("krb5_child_setup failed.\n"));
+    /* The child is spawned with the privileges of the backend and drops
+     * them before any data of the request is read */
+    if ((uid_str == NULL) != (gid_str == NULL)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Both --uid and --gid are required.\n"));
+        ret = EINVAL;
         goto done;
     }
 
-    switch(kr->pd->cmd) {
-    case SSS_PAM_AUTHENTICATE:
-        /* If we are offline, we need to create an empty ccache file */
-        if (offline) {
-            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform offline auth\n"));
-            ret = create_empty_ccache(kr);
-        } else {
-            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform online auth\n"));
-            ret = tgt_req_child(kr);
+    if (uid_str != NULL) {
+        ret = k5c_parse_id(uid_str, &uid);
+        if (ret == EOK) {
+            ret = k5c_parse_id(gid_str, &gid);
         }
-        break;
-    case SSS_PAM_CHAUTHTOK:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change\n"));
-        ret = changepw_child(kr, false);
-        break;
-    case SSS_PAM_CHAUTHTOK_PRELIM:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change checks\n"));
-        ret = changepw_child(kr, true);
-        break;
-    case SSS_PAM_ACCT_MGMT:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform account management\n"));
-        ret = kuserok_child(kr);
-        break;
-    case SSS_CMD_RENEW:
-        if (offline) {
-            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot renew TGT while offline\n"));
-            ret = KRB5_KDC_UNREACH;
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = become_user(uid, gid);
+        if (ret != EOK) {
+            DEBUG(1, ("become_user failed.\n"));
             goto done;
         }
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform ticket renewal\n"));
-        ret = renew_tgt_child(kr);
-        break;
-    default:
-        DEBUG(1, ("PAM command [%d] not supported.\n", kr->pd->cmd));
-        ret = EINVAL;
-        goto done;
     }
 
-    ret = k5c_send_data(kr, STDOUT_FILENO, ret);
+    ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to send reply\n"));
+        goto done;
+    }
+
+    close(STDIN_FILENO);
+
+    if (uid_str != NULL) {
+        ret = k5c_check_user(kr, uid, gid);
+        if (ret != EOK) {
+            goto done;
+        }
     }
 
+    ret = k5c_handle_request(kr, offline, STDOUT_FILENO);
+
 done:
     krb5_cleanup(kr);
     talloc_free(kr);
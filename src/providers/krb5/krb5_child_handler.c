@@ -46,9 +46,39 @@ struct io {
     int write_to_child_fd;
 };
 
+/* A long-lived krb5_child started in pool mode. The worker reads framed
+ * requests from its stdin and forks a short-lived child for each of them,
+ * which drops privileges if needed, so the worker itself never runs with
+ * the identity of a user. */
+struct krb5_child_worker {
+    struct krb5_child_worker *prev;
+    struct krb5_child_worker *next;
+
+    struct krb5_child_pool *pool;
+    struct krb5_child_worker_watch *watch;
+    pid_t pid;
+    struct io *io;
+    int requests;
+    bool idle;
+    bool exited;
+};
+
+/* Passed to the SIGCHLD handler of a worker. It lives on the event context
+ * so that it outlives the worker, which clears the back pointer when it is
+ * released before the process exits. */
+struct krb5_child_worker_watch {
+    struct krb5_child_worker *worker;
+};
+
+struct krb5_child_pool {
+    struct krb5_child_worker *idle_workers;
+    int num_workers;
+};
+
 struct handle_child_state {
     struct tevent_context *ev;
     struct krb5child_req *kr;
+    struct io_buffer *send_buf;
     uint8_t *buf;
     ssize_t len;
 
@@ -56,6 +86,7 @@ struct handle_child_state {
     pid_t child_pid;
 
     struct io *io;
+    struct krb5_child_worker *worker;
 };
 
 static int child_io_destructor(void *ptr)
@@ -239,7 +270,14 @@ static void krb5_child_timeout(struct tevent_context *ev,
 
     DEBUG(9, ("timeout for child [%d] reached.\n", state->child_pid));
 
-    ret = kill(state->child_pid, SIGKILL);
+    if (state->worker != NULL) {
+        /* Kill the whole process group of the worker, including the child
+         * currently handling the request. The worker is not returned to
+         * the pool and is released together with the request. */
+        ret = kill(-state->child_pid, SIGKILL);
+    } else {
+        ret = kill(state->child_pid, SIGKILL);
+    }
     if (ret == -1) {
         DEBUG(1, ("kill failed [%d][%s].\n", errno, strerror(errno)));
     }
@@ -271,6 +309,7 @@ static errno_t fork_child(struct tevent_req *req)
 {
     int pipefd_to_child[2];
     int pipefd_from_child[2];
+    const char *extra_args[3] = { NULL, NULL, NULL };
     pid_t pid;
     int ret;
     errno_t err;
@@ -290,58 +329,499 @@ static errno_t fork_child(struct tevent_req *req)
         return err;
     }
 
-    pid = fork();
-
-    if (pid == 0) { /* child */
-        if (state->kr->run_as_user) {
-            ret = become_user(state->kr->uid, state->kr->gid);
-            if (ret != EOK) {
-                DEBUG(1, ("become_user failed.\n"));
-                return ret;
-            }
+    /* krb5_child drops the privileges itself before it reads the request,
+     * so it can be spawned without a fork() of the backend */
+    if (state->kr->run_as_user) {
+        extra_args[0] = talloc_asprintf(state, "--uid=%lu",
+                                        (unsigned long) state->kr->uid);
+        extra_args[1] = talloc_asprintf(state, "--gid=%lu",
+                                        (unsigned long) state->kr->gid);
+        if (extra_args[0] == NULL || extra_args[1] == NULL) {
+            DEBUG(1, ("talloc_asprintf failed.\n"));
+            close(pipefd_from_child[0]);
+            close(pipefd_from_child[1]);
+            close(pipefd_to_child[0]);
+            close(pipefd_to_child[1]);
+            return ENOMEM;
         }
+    }
 
-        err = exec_child(state,
-                         pipefd_to_child, pipefd_from_child,
-                         KRB5_CHILD, state->kr->krb5_ctx->child_debug_fd);
-        if (err != EOK) {
-            DEBUG(1, ("Could not exec KRB5 child: [%d][%s].\n",
-                      err, strerror(err)));
-            return err;
-        }
-    } else if (pid > 0) { /* parent */
-        state->child_pid = pid;
-        state->io->read_from_child_fd = pipefd_from_child[0];
+    err = spawn_child(state, pipefd_to_child, pipefd_from_child,
+                      KRB5_CHILD, state->kr->krb5_ctx->child_debug_fd,
+                      extra_args, 0, &pid);
+    if (err != EOK) {
+        DEBUG(1, ("Could not spawn KRB5 child: [%d][%s].\n",
+                  err, strerror(err)));
+        close(pipefd_from_child[0]);
         close(pipefd_from_child[1]);
-        state->io->write_to_child_fd = pipefd_to_child[1];
         close(pipefd_to_child[0]);
-        fd_nonblocking(state->io->read_from_child_fd);
-        fd_nonblocking(state->io->write_to_child_fd);
+        close(pipefd_to_child[1]);
+        return err;
+    }
+
+    state->child_pid = pid;
+    state->io->read_from_child_fd = pipefd_from_child[0];
+    close(pipefd_from_child[1]);
+    state->io->write_to_child_fd = pipefd_to_child[1];
+    close(pipefd_to_child[0]);
+    fd_nonblocking(state->io->read_from_child_fd);
+    fd_nonblocking(state->io->write_to_child_fd);
+
+    ret = child_handler_setup(state->ev, pid, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(1, ("Could not set up child signal handler\n"));
+        return ret;
+    }
+
+    err = activate_child_timeout_handler(req, state->ev,
+              dp_opt_get_int(state->kr->krb5_ctx->opts, KRB5_AUTH_TIMEOUT));
+    if (err != EOK) {
+        DEBUG(1, ("activate_child_timeout_handler failed.\n"));
+    }
+
+    return EOK;
+}
+
+static int krb5_child_worker_destructor(void *ptr)
+{
+    struct krb5_child_worker *worker =
+            talloc_get_type(ptr, struct krb5_child_worker);
+
+    if (worker->idle) {
+        DLIST_REMOVE(worker->pool->idle_workers, worker);
+    }
+    worker->pool->num_workers--;
+
+    if (worker->watch != NULL) {
+        worker->watch->worker = NULL;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Releasing krb5_child worker [%d] after [%d] requests.\n",
+           worker->pid, worker->requests));
 
-        ret = child_handler_setup(state->ev, pid, NULL, NULL);
+    /* The io destructor closes the pipes, the worker exits when it
+     * sees EOF on its stdin and is reaped by the SIGCHLD handler. */
+    return 0;
+}
+
+static void krb5_child_worker_exited(int child_status,
+                                     struct tevent_signal *sige,
+                                     void *pvt)
+{
+    struct krb5_child_worker_watch *watch =
+            talloc_get_type(pvt, struct krb5_child_worker_watch);
+    struct krb5_child_worker *worker = watch->worker;
+
+    talloc_free(watch);
+    if (worker == NULL) {
+        /* Already released, the worker just saw EOF on its stdin */
+        return;
+    }
+
+    DEBUG(SSSDBG_MINOR_FAILURE,
+          ("krb5_child worker [%d] exited unexpectedly.\n", worker->pid));
+
+    worker->watch = NULL;
+    worker->exited = true;
+    if (worker->idle) {
+        talloc_free(worker);
+    }
+    /* A busy worker is discarded by the request using it, which sees EOF
+     * or EPIPE on the pipes. */
+}
+
+static errno_t krb5_child_worker_spawn(struct tevent_context *ev,
+                                       struct krb5_ctx *krb5_ctx,
+                                       struct krb5_child_worker **_worker)
+{
+    struct krb5_child_pool *pool = krb5_ctx->child_pool;
+    struct krb5_child_worker *worker;
+    const char *worker_args[] = { "--worker", NULL };
+    int pipefd_to_child[2];
+    int pipefd_from_child[2];
+    pid_t pid;
+    int ret;
+    errno_t err;
+
+    worker = talloc_zero(pool, struct krb5_child_worker);
+    if (worker == NULL) {
+        DEBUG(1, ("talloc failed.\n"));
+        return ENOMEM;
+    }
+    worker->pool = pool;
+
+    worker->io = talloc(worker, struct io);
+    if (worker->io == NULL) {
+        DEBUG(1, ("talloc failed.\n"));
+        talloc_free(worker);
+        return ENOMEM;
+    }
+    worker->io->write_to_child_fd = -1;
+    worker->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) worker->io, child_io_destructor);
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        err = errno;
+        DEBUG(1, ("pipe failed [%d][%s].\n", errno, strerror(errno)));
+        talloc_free(worker);
+        return err;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        err = errno;
+        DEBUG(1, ("pipe failed [%d][%s].\n", errno, strerror(errno)));
+        close(pipefd_from_child[0]);
+        close(pipefd_from_child[1]);
+        talloc_free(worker);
+        return err;
+    }
+
+    /* The worker forks a child for every request, keep both in a
+     * process group of their own so that a timeout can kill them
+     * together. */
+    err = spawn_child(worker, pipefd_to_child, pipefd_from_child,
+                      KRB5_CHILD, krb5_ctx->child_debug_fd,
+                      worker_args, SSS_SPAWN_NEW_PGROUP, &pid);
+    if (err != EOK) {
+        DEBUG(1, ("Could not spawn KRB5 child worker: [%d][%s].\n",
+                  err, strerror(err)));
+        close(pipefd_from_child[0]);
+        close(pipefd_from_child[1]);
+        close(pipefd_to_child[0]);
+        close(pipefd_to_child[1]);
+        talloc_free(worker);
+        return err;
+    }
+
+    worker->pid = pid;
+    worker->io->read_from_child_fd = pipefd_from_child[0];
+    close(pipefd_from_child[1]);
+    worker->io->write_to_child_fd = pipefd_to_child[1];
+    close(pipefd_to_child[0]);
+    fd_nonblocking(worker->io->read_from_child_fd);
+    fd_nonblocking(worker->io->write_to_child_fd);
+
+    pool->num_workers++;
+    talloc_set_destructor((void *) worker, krb5_child_worker_destructor);
+
+    worker->watch = talloc(ev, struct krb5_child_worker_watch);
+    if (worker->watch == NULL) {
+        DEBUG(1, ("talloc failed.\n"));
+        talloc_free(worker);
+        return ENOMEM;
+    }
+    worker->watch->worker = worker;
+
+    ret = child_handler_setup(ev, pid, krb5_child_worker_exited,
+                              worker->watch);
+    if (ret != EOK) {
+        DEBUG(1, ("Could not set up child signal handler\n"));
+        talloc_zfree(worker->watch);
+        talloc_free(worker);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Started krb5_child worker [%d], "
+                              "[%d] workers running.\n",
+                              pid, pool->num_workers));
+
+    *_worker = worker;
+    return EOK;
+}
+
+/* Hand out an idle worker or start a new one if the pool is not full yet.
+ * The worker is owned by mem_ctx until it is returned to the pool with
+ * krb5_child_worker_release(), so it is discarded if the request fails
+ * or is cancelled half-way through the exchange. */
+static errno_t krb5_child_worker_get(TALLOC_CTX *mem_ctx,
+                                     struct tevent_context *ev,
+                                     struct krb5_ctx *krb5_ctx,
+                                     struct krb5_child_worker **_worker)
+{
+    struct krb5_child_worker *worker;
+    int pool_size;
+    errno_t ret;
+
+    pool_size = dp_opt_get_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE);
+    if (pool_size <= 0) {
+        return ENOENT;
+    }
+
+    if (krb5_ctx->child_pool == NULL) {
+        krb5_ctx->child_pool = talloc_zero(krb5_ctx, struct krb5_child_pool);
+        if (krb5_ctx->child_pool == NULL) {
+            DEBUG(1, ("talloc failed.\n"));
+            return ENOMEM;
+        }
+    }
+
+    worker = krb5_ctx->child_pool->idle_workers;
+    if (worker != NULL) {
+        DLIST_REMOVE(krb5_ctx->child_pool->idle_workers, worker);
+        worker->idle = false;
+    } else if (krb5_ctx->child_pool->num_workers < pool_size) {
+        ret = krb5_child_worker_spawn(ev, krb5_ctx, &worker);
         if (ret != EOK) {
-            DEBUG(1, ("Could not set up child signal handler\n"));
             return ret;
         }
+    } else {
+        DEBUG(SSSDBG_TRACE_FUNC, ("All [%d] krb5_child workers are busy.\n",
+                                  pool_size));
+        return EBUSY;
+    }
 
-        err = activate_child_timeout_handler(req, state->ev,
-                  dp_opt_get_int(state->kr->krb5_ctx->opts, KRB5_AUTH_TIMEOUT));
-        if (err != EOK) {
-            DEBUG(1, ("activate_child_timeout_handler failed.\n"));
-        }
+    *_worker = talloc_steal(mem_ctx, worker);
+    return EOK;
+}
+
+static void krb5_child_worker_release(struct krb5_ctx *krb5_ctx,
+                                      struct krb5_child_worker *worker)
+{
+    struct krb5_child_pool *pool = worker->pool;
+
+    worker->requests++;
+    if (worker->exited
+            || worker->requests >= dp_opt_get_int(krb5_ctx->opts,
+                                                  KRB5_CHILD_POOL_MAX_REQUESTS)) {
+        talloc_free(worker);
+        return;
+    }
+
+    talloc_steal(pool, worker);
+    worker->idle = true;
+    DLIST_ADD(pool->idle_workers, worker);
+}
+
+/* Requests to a worker are framed as
+ * uint32_t run as user (0 or 1)
+ * uint32_t uid the request child switches to before reading the request
+ * uint32_t gid the request child switches to before reading the request
+ * uint32_t length of the following data
+ * uint8_t[len] request as built by create_send_buffer()
+ *
+ * and answered with
+ * uint32_t length of the following data
+ * uint8_t[len] response as read from a one-shot krb5_child, empty if
+ *              the child failed without sending a response
+ */
+static errno_t create_worker_frame(struct krb5child_req *kr,
+                                   struct io_buffer *buf,
+                                   struct io_buffer **_frame)
+{
+    struct io_buffer *frame;
+    uint32_t run_as_user;
+    size_t rp = 0;
+
+    frame = talloc(kr, struct io_buffer);
+    if (frame == NULL) {
+        DEBUG(1, ("talloc failed.\n"));
+        return ENOMEM;
+    }
+
+    frame->size = 4*sizeof(uint32_t) + buf->size;
+    frame->data = talloc_size(frame, frame->size);
+    if (frame->data == NULL) {
+        DEBUG(1, ("talloc_size failed.\n"));
+        talloc_free(frame);
+        return ENOMEM;
+    }
+
+    run_as_user = kr->run_as_user ? 1 : 0;
+    SAFEALIGN_COPY_UINT32(&frame->data[rp], &run_as_user, &rp);
+    SAFEALIGN_COPY_UINT32(&frame->data[rp], &kr->uid, &rp);
+    SAFEALIGN_COPY_UINT32(&frame->data[rp], &kr->gid, &rp);
+    SAFEALIGN_SET_UINT32(&frame->data[rp], buf->size, &rp);
+    safealign_memcpy(&frame->data[rp], buf->data, buf->size, &rp);
+
+    *_frame = frame;
+    return EOK;
+}
+
+struct read_frame_state {
+    int fd;
+    uint8_t hdr[sizeof(uint32_t)];
+    uint8_t *buf;
+    size_t len;
+    size_t nread;
+};
+
+static void read_frame_handler(struct tevent_context *ev,
+                               struct tevent_fd *fde,
+                               uint16_t flags, void *pvt);
+
+static struct tevent_req *read_frame_send(TALLOC_CTX *mem_ctx,
+                                          struct tevent_context *ev, int fd)
+{
+    struct tevent_req *req;
+    struct read_frame_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state, struct read_frame_state);
+    if (req == NULL) return NULL;
+
+    state->fd = fd;
+    state->buf = NULL;
+    state->len = 0;
+    state->nread = 0;
 
-    } else { /* error */
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        read_frame_handler, req);
+    if (fde == NULL) {
+        DEBUG(1, ("tevent_add_fd failed.\n"));
+        talloc_free(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void read_frame_handler(struct tevent_context *ev,
+                               struct tevent_fd *fde,
+                               uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct read_frame_state *state = tevent_req_data(req,
+                                                     struct read_frame_state);
+    uint8_t *dest;
+    size_t want;
+    ssize_t size;
+    errno_t err;
+
+    if (flags & TEVENT_FD_WRITE) {
+        DEBUG(1, ("read_frame_done called with TEVENT_FD_WRITE, "
+                  "this should not happen.\n"));
+        tevent_req_error(req, EINVAL);
+        return;
+    }
+
+    if (state->buf == NULL) {
+        dest = state->hdr + state->nread;
+        want = sizeof(state->hdr) - state->nread;
+    } else {
+        dest = state->buf + state->nread;
+        want = state->len - state->nread;
+    }
+
+    size = read(state->fd, dest, want);
+    if (size == -1) {
         err = errno;
-        DEBUG(1, ("fork failed [%d][%s].\n", errno, strerror(errno)));
-        return err;
+        if (err == EAGAIN || err == EINTR) {
+            return;
+        }
+
+        DEBUG(1, ("read failed [%d][%s].\n", err, strerror(err)));
+        tevent_req_error(req, err);
+        return;
+    } else if (size == 0) {
+        DEBUG(1, ("krb5_child worker closed the pipe.\n"));
+        tevent_req_error(req, EPIPE);
+        return;
     }
 
+    state->nread += size;
+    if (state->buf == NULL) {
+        if (state->nread < sizeof(state->hdr)) {
+            return;
+        }
+
+        SAFEALIGN_COPY_UINT32(&state->len, state->hdr, NULL);
+        state->nread = 0;
+        state->buf = talloc_size(state, state->len ? state->len : 1);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+    }
+
+    if (state->nread == state->len) {
+        tevent_req_done(req);
+    }
+}
+
+static int read_frame_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                           uint8_t **buf, ssize_t *len)
+{
+    struct read_frame_state *state = tevent_req_data(req,
+                                                     struct read_frame_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *buf = talloc_steal(mem_ctx, state->buf);
+    *len = state->len;
+
     return EOK;
 }
 
 static void handle_child_step(struct tevent_req *subreq);
 static void handle_child_done(struct tevent_req *subreq);
 
+static errno_t handle_child_oneshot(struct tevent_req *req)
+{
+    struct handle_child_state *state = tevent_req_data(req,
+                                                    struct handle_child_state);
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    state->io = talloc(state, struct io);
+    if (state->io == NULL) {
+        DEBUG(1, ("talloc failed.\n"));
+        return ENOMEM;
+    }
+    state->io->write_to_child_fd = -1;
+    state->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) state->io, child_io_destructor);
+
+    ret = fork_child(req);
+    if (ret != EOK) {
+        DEBUG(1, ("fork_child failed.\n"));
+        return ret;
+    }
+
+    subreq = write_pipe_send(state, state->ev, state->send_buf->data,
+                             state->send_buf->size,
+                             state->io->write_to_child_fd);
+    if (!subreq) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, handle_child_step, req);
+
+    return EOK;
+}
+
+/* A worker may have died while it was idle in the pool, e.g. because it
+ * was killed by an administrator or the OOM killer. Do not fail the login
+ * because of that but send the request to a one-shot child instead. This
+ * is only safe as long as the request was not completely written to the
+ * worker, afterwards it may already have been sent to the KDC. */
+static bool handle_child_worker_retry(struct tevent_req *req, errno_t err)
+{
+    struct handle_child_state *state = tevent_req_data(req,
+                                                    struct handle_child_state);
+    errno_t ret;
+
+    if (state->worker == NULL) {
+        return false;
+    }
+
+    DEBUG(SSSDBG_MINOR_FAILURE,
+          ("Lost krb5_child worker [%d] [%d][%s], retrying the request "
+           "with a new child.\n", state->child_pid, err, sss_strerror(err)));
+
+    talloc_zfree(state->timeout_handler);
+    state->io = NULL;
+    talloc_zfree(state->worker);
+    state->child_pid = -1;
+
+    ret = handle_child_oneshot(req);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+    }
+
+    return true;
+}
+
 struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
                                      struct krb5child_req *kr)
@@ -362,36 +842,52 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
     state->len = 0;
     state->child_pid = -1;
     state->timeout_handler = NULL;
-
-    state->io = talloc(state, struct io);
-    if (state->io == NULL) {
-        DEBUG(1, ("talloc failed.\n"));
-        ret = ENOMEM;
-        goto fail;
-    }
-    state->io->write_to_child_fd = -1;
-    state->io->read_from_child_fd = -1;
-    talloc_set_destructor((void *) state->io, child_io_destructor);
+    state->worker = NULL;
 
     ret = create_send_buffer(kr, &buf);
     if (ret != EOK) {
         DEBUG(1, ("create_send_buffer failed.\n"));
         goto fail;
     }
+    /* Kept for a retry with a one-shot child if the worker is lost */
+    state->send_buf = buf;
 
-    ret = fork_child(req);
-    if (ret != EOK) {
-        DEBUG(1, ("fork_child failed.\n"));
-        goto fail;
+    ret = krb5_child_worker_get(state, ev, kr->krb5_ctx, &state->worker);
+    if (ret == EOK) {
+        state->child_pid = state->worker->pid;
+        state->io = state->worker->io;
+
+        ret = create_worker_frame(kr, buf, &buf);
+        if (ret != EOK) {
+            goto fail;
+        }
+
+        ret = activate_child_timeout_handler(req, ev,
+                  dp_opt_get_int(kr->krb5_ctx->opts, KRB5_AUTH_TIMEOUT));
+        if (ret != EOK) {
+            DEBUG(1, ("activate_child_timeout_handler failed.\n"));
+            goto fail;
+        }
+
+        subreq = write_pipe_send(state, ev, buf->data, buf->size,
+                                 state->io->write_to_child_fd);
+        if (!subreq) {
+            ret = ENOMEM;
+            goto fail;
+        }
+        tevent_req_set_callback(subreq, handle_child_step, req);
+
+        return req;
+    } else if (ret != ENOENT && ret != EBUSY) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot use krb5_child worker [%d][%s], "
+               "starting a new child.\n", ret, sss_strerror(ret)));
     }
 
-    subreq = write_pipe_send(state, ev, buf->data, buf->size,
-                             state->io->write_to_child_fd);
-    if (!subreq) {
-        ret = ENOMEM;
+    ret = handle_child_oneshot(req);
+    if (ret != EOK) {
         goto fail;
     }
-    tevent_req_set_callback(subreq, handle_child_step, req);
 
     return req;
 
@@ -412,7 +908,21 @@ static void handle_child_step(struct tevent_req *subreq)
     ret = write_pipe_recv(subreq);
     talloc_zfree(subreq);
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        if (!handle_child_worker_retry(req, ret)) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    if (state->worker != NULL) {
+        /* The worker keeps its pipes open for the next request */
+        subreq = read_frame_send(state, state->ev,
+                                 state->io->read_from_child_fd);
+        if (!subreq) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+        tevent_req_set_callback(subreq, handle_child_done, req);
         return;
     }
 
@@ -437,6 +947,30 @@ static void handle_child_done(struct tevent_req *subreq)
 
     talloc_zfree(state->timeout_handler);
 
+    if (state->worker != NULL) {
+        ret = read_frame_recv(subreq, state, &state->buf, &state->len);
+        talloc_zfree(subreq);
+        if (ret != EOK) {
+            /* The worker got the whole request and may have acted on it
+             * already, replaying it could e.g. change a password twice */
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Lost krb5_child worker [%d] [%d][%s] while waiting for "
+                   "the reply.\n", state->child_pid, ret, sss_strerror(ret)));
+            state->io = NULL;
+            talloc_zfree(state->worker);
+            state->child_pid = -1;
+            tevent_req_error(req, EIO);
+            return;
+        }
+
+        krb5_child_worker_release(state->kr->krb5_ctx, state->worker);
+        state->worker = NULL;
+        state->io = NULL;
+
+        tevent_req_done(req);
+        return;
+    }
+
     ret = read_pipe_recv(subreq, state, &state->buf, &state->len);
     talloc_zfree(subreq);
     if (ret != EOK) {
@@ -66,6 +66,9 @@ enum krb5_opts {
     KRB5_FAST_PRINCIPAL,
     KRB5_CANONICALIZE,
     KRB5_USE_ENTERPRISE_PRINCIPAL,
+    KRB5_CHILD_POOL_SIZE,
+    KRB5_CHILD_POOL_MAX_REQUESTS,
+    KRB5_RENEW_MAX_PARALLEL,
 
     KRB5_OPTS
 };
@@ -88,6 +91,8 @@ struct fo_service;
 struct deferred_auth_ctx;
 struct renew_tgt_ctx;
 struct sss_krb5_cc_be;
+struct krb5_child_pool;
+struct krb5_auth_queue;
 
 struct krb5_ctx {
     /* opts taken from kinit */
@@ -126,7 +131,9 @@ struct krb5_ctx {
     struct renew_tgt_ctx *renew_tgt_ctx;
     bool use_fast;
 
-    hash_table_t *wait_queue_hash;
+    struct krb5_auth_queue *auth_queue;
+
+    struct krb5_child_pool *child_pool;
 };
 
 struct remove_info_files_ctx {
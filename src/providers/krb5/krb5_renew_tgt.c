@@ -30,6 +30,8 @@
 
 #define INITIAL_TGT_TABLE_SIZE 10
 
+struct auth_data;
+
 struct renew_tgt_ctx {
     hash_table_t *tgt_table;
     struct be_ctx *be_ctx;
@@ -37,6 +39,22 @@ struct renew_tgt_ctx {
     struct krb5_ctx *krb5_ctx;
     time_t timer_interval;
     struct tevent_timer *te;
+
+    /* Renewals which are due but wait for one of the max_running slots */
+    struct auth_data *queue;
+    size_t queued;
+    size_t running;
+    size_t max_running;
+
+    /* Last generation given to a renewal item */
+    uint64_t generation;
+    /* Seed of the random renewal times */
+    unsigned int rand_seed;
+
+    uint64_t renewed;
+    uint64_t failed;
+    uint64_t latency_total_ms;
+    uint64_t latency_max_ms;
 };
 
 struct renew_data {
@@ -45,59 +63,160 @@ struct renew_data {
     time_t lifetime;
     time_t start_renew_at;
     struct pam_data *pd;
+    uint64_t generation;
 };
 
 struct auth_data {
+    struct auth_data *prev;
+    struct auth_data *next;
+
+    struct renew_tgt_ctx *renew_tgt_ctx;
+    struct timeval started;
     struct be_ctx *be_ctx;
     struct krb5_ctx *krb5_ctx;
     struct pam_data *pd;
     struct renew_data *renew_data;
+    uint64_t generation;
     hash_table_t *table;
     hash_key_t key;
 };
 
 
+/* The renewal item might have been replaced by a new one, e.g. after the
+ * user logged in again, while the renewal was queued or running. The new
+ * item may reuse the memory of the old one, so the generation is compared
+ * and not the pointer. */
+static bool renew_data_is_current(struct auth_data *auth_data)
+{
+    struct renew_data *renew_data;
+    hash_value_t value;
+    int ret;
+
+    ret = hash_lookup(auth_data->table, &auth_data->key, &value);
+    if (ret != HASH_SUCCESS || value.type != HASH_VALUE_PTR) {
+        return false;
+    }
+
+    renew_data = talloc_get_type(value.ptr, struct renew_data);
+    return renew_data != NULL
+                && renew_data->generation == auth_data->generation;
+}
+
+/* Give back the pam data to the renewal item to be able to retry at the next
+ * time the renewals re run. */
+static void renew_give_back_pd(struct auth_data *auth_data)
+{
+    if (auth_data->renew_data != NULL && renew_data_is_current(auth_data)) {
+        DEBUG(5, ("Giving back pam data.\n"));
+        auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
+                                                 auth_data->pd);
+    }
+}
+
 static void renew_tgt_done(struct tevent_req *req);
-static void renew_tgt(struct tevent_context *ev, struct tevent_timer *te,
-                      struct timeval current_time, void *private_data)
+static errno_t renew_tgt(struct auth_data *auth_data)
 {
-    struct auth_data *auth_data = talloc_get_type(private_data,
-                                                  struct auth_data);
     struct tevent_req *req;
 
-    req = krb5_auth_send(auth_data, ev, auth_data->be_ctx, auth_data->pd,
+    req = krb5_auth_send(auth_data, auth_data->renew_tgt_ctx->ev,
+                         auth_data->be_ctx, auth_data->pd,
                          auth_data->krb5_ctx);
     if (req == NULL) {
         DEBUG(1, ("krb5_auth_send failed.\n"));
-/* Give back the pam data to the renewal item to be able to retry at the next
- * time the renewals re run. */
-        auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                 auth_data->pd);
-        talloc_free(auth_data);
-        return;
+        return ENOMEM;
     }
 
     tevent_req_set_callback(req, renew_tgt_done, auth_data);
+    return EOK;
+}
+
+static void renew_tgt_dispatch(struct renew_tgt_ctx *renew_tgt_ctx)
+{
+    struct auth_data *auth_data;
+    errno_t ret;
+
+    /* Queued renewals are started by the online callback */
+    if (be_is_offline(renew_tgt_ctx->be_ctx)) {
+        return;
+    }
+
+    while (renew_tgt_ctx->queue != NULL
+            && renew_tgt_ctx->running < renew_tgt_ctx->max_running) {
+        auth_data = renew_tgt_ctx->queue;
+        DLIST_REMOVE(renew_tgt_ctx->queue, auth_data);
+        renew_tgt_ctx->queued--;
+
+        if (!renew_data_is_current(auth_data)) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Renewal item for [%s] was replaced, "
+                                      "skipping renewal.\n",
+                                      auth_data->key.str));
+            talloc_free(auth_data);
+            continue;
+        }
+
+        gettimeofday(&auth_data->started, NULL);
+        ret = renew_tgt(auth_data);
+        if (ret != EOK) {
+            renew_give_back_pd(auth_data);
+            talloc_free(auth_data);
+            continue;
+        }
+        renew_tgt_ctx->running++;
+    }
+}
+
+static void renew_tgt_stats(struct renew_tgt_ctx *renew_tgt_ctx)
+{
+    uint64_t done = renew_tgt_ctx->renewed + renew_tgt_ctx->failed;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("TGT renewals: [%zu] queued, [%zu] running, [%llu] renewed, "
+           "[%llu] failed, latency avg [%llu] ms max [%llu] ms.\n",
+           renew_tgt_ctx->queued, renew_tgt_ctx->running,
+           (unsigned long long) renew_tgt_ctx->renewed,
+           (unsigned long long) renew_tgt_ctx->failed,
+           (unsigned long long) (done ? renew_tgt_ctx->latency_total_ms / done
+                                      : 0),
+           (unsigned long long) renew_tgt_ctx->latency_max_ms));
+}
+
+static void renew_tgt_finished(struct auth_data *auth_data, bool success)
+{
+    struct renew_tgt_ctx *renew_tgt_ctx = auth_data->renew_tgt_ctx;
+    struct timeval now;
+    uint64_t msecs;
+
+    gettimeofday(&now, NULL);
+    msecs = (now.tv_sec - auth_data->started.tv_sec) * 1000
+            + (now.tv_usec - auth_data->started.tv_usec) / 1000;
+
+    renew_tgt_ctx->running--;
+    renew_tgt_ctx->latency_total_ms += msecs;
+    if (msecs > renew_tgt_ctx->latency_max_ms) {
+        renew_tgt_ctx->latency_max_ms = msecs;
+    }
+    if (success) {
+        renew_tgt_ctx->renewed++;
+    } else {
+        renew_tgt_ctx->failed++;
+    }
 }
 
 static void renew_tgt_done(struct tevent_req *req)
 {
     struct auth_data *auth_data = tevent_req_callback_data(req,
                                                            struct auth_data);
+    struct renew_tgt_ctx *renew_tgt_ctx;
     int ret;
     int pam_status = PAM_SYSTEM_ERR;
     int dp_err;
-    hash_value_t value;
 
     ret = krb5_auth_recv(req, &pam_status, &dp_err);
     talloc_free(req);
+    renew_tgt_finished(auth_data, ret == EOK && pam_status == PAM_SUCCESS);
     if (ret) {
         DEBUG(1, ("krb5_auth request failed.\n"));
-        if (auth_data->renew_data != NULL) {
-            DEBUG(5, ("Giving back pam data.\n"));
-            auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                     auth_data->pd);
-        }
+        renew_give_back_pd(auth_data);
     } else {
         switch (pam_status) {
             case PAM_SUCCESS:
@@ -109,18 +228,13 @@ static void renew_tgt_done(struct tevent_req *req)
  * renewal item is not updated and the value from the hash and the one we have
  * stored are the same. Since the TGT cannot be renewed anymore we want to
  * remove it from the list of renewable tickets. */
-                ret = hash_lookup(auth_data->table, &auth_data->key, &value);
-                if (ret == HASH_SUCCESS) {
-                    if (value.type == HASH_VALUE_PTR &&
-                        auth_data->renew_data == talloc_get_type(value.ptr,
-                                                           struct renew_data)) {
-                        DEBUG(5, ("New TGT was not added for renewal, "
-                                  "removing list entry for user [%s].\n",
-                                  auth_data->pd->user));
-                        ret = hash_delete(auth_data->table, &auth_data->key);
-                        if (ret != HASH_SUCCESS) {
-                            DEBUG(1, ("hash_delete failed.\n"));
-                        }
+                if (renew_data_is_current(auth_data)) {
+                    DEBUG(5, ("New TGT was not added for renewal, "
+                              "removing list entry for user [%s].\n",
+                              auth_data->pd->user));
+                    ret = hash_delete(auth_data->table, &auth_data->key);
+                    if (ret != HASH_SUCCESS) {
+                        DEBUG(1, ("hash_delete failed.\n"));
                     }
                 }
                 break;
@@ -129,11 +243,7 @@ static void renew_tgt_done(struct tevent_req *req)
                 DEBUG(4, ("Cannot renewed TGT for user [%s] while offline, "
                           "will retry later.\n",
                           auth_data->pd->user));
-                if (auth_data->renew_data != NULL) {
-                    DEBUG(5, ("Giving back pam data.\n"));
-                    auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                             auth_data->pd);
-                }
+                renew_give_back_pd(auth_data);
                 break;
             default:
                 DEBUG(1, ("Failed to renew TGT for user [%s].\n",
@@ -145,7 +255,10 @@ static void renew_tgt_done(struct tevent_req *req)
         }
     }
 
+    renew_tgt_ctx = auth_data->renew_tgt_ctx;
     talloc_zfree(auth_data);
+
+    renew_tgt_dispatch(renew_tgt_ctx);
 }
 
 static errno_t renew_all_tgts(struct renew_tgt_ctx *renew_tgt_ctx)
@@ -157,7 +270,6 @@ static errno_t renew_all_tgts(struct renew_tgt_ctx *renew_tgt_ctx)
     time_t now;
     struct auth_data *auth_data;
     struct renew_data *renew_data;
-    struct tevent_timer *te = NULL;
 
     ret = hash_entries(renew_tgt_ctx->tgt_table, &count, &entries);
     if (ret != HASH_SUCCESS) {
@@ -188,26 +300,26 @@ static errno_t renew_all_tgts(struct renew_tgt_ctx *renew_tgt_ctx)
  * might want to steal the pam_data back to renew_data before freeing
  * auth_data to allow a new renewal attempt. */
                 auth_data->pd = talloc_move(auth_data, &renew_data->pd);
+                auth_data->renew_tgt_ctx = renew_tgt_ctx;
                 auth_data->krb5_ctx = renew_tgt_ctx->krb5_ctx;
                 auth_data->be_ctx = renew_tgt_ctx->be_ctx;
                 auth_data->table = renew_tgt_ctx->tgt_table;
                 auth_data->renew_data = renew_data;
+                auth_data->generation = renew_data->generation;
                 auth_data->key.type = entries[c].key.type;
                 auth_data->key.str = talloc_strdup(auth_data,
                                                    entries[c].key.str);
                 if (auth_data->key.str == NULL) {
                     DEBUG(1, ("talloc_strdup failed.\n"));
+                    talloc_zfree(auth_data);
                 } else {
-                    te = tevent_add_timer(renew_tgt_ctx->ev,
-                                          auth_data, tevent_timeval_current(),
-                                          renew_tgt, auth_data);
-                    if (te == NULL) {
-                        DEBUG(1, ("tevent_add_timer failed.\n"));
-                    }
+                    DLIST_ADD_END(renew_tgt_ctx->queue, auth_data,
+                                  struct auth_data *);
+                    renew_tgt_ctx->queued++;
                 }
             }
 
-            if (auth_data == NULL || te == NULL) {
+            if (auth_data == NULL) {
                 DEBUG(1, ("Failed to renew TGT in [%s].\n", renew_data->ccfile));
                 ret = hash_delete(renew_tgt_ctx->tgt_table, &entries[c].key);
                 if (ret != HASH_SUCCESS) {
@@ -219,6 +331,9 @@ static errno_t renew_all_tgts(struct renew_tgt_ctx *renew_tgt_ctx)
 
     talloc_free(entries);
 
+    renew_tgt_dispatch(renew_tgt_ctx);
+    renew_tgt_stats(renew_tgt_ctx);
+
     return EOK;
 }
 
@@ -470,6 +585,8 @@ errno_t init_renew_tgt(struct krb5_ctx *krb5_ctx, struct be_ctx *be_ctx,
                        struct tevent_context *ev, time_t renew_intv)
 {
     int ret;
+    int max_running;
+    int pool_size;
     struct timeval next;
 
     krb5_ctx->renew_tgt_ctx = talloc_zero(krb5_ctx, struct renew_tgt_ctx);
@@ -490,6 +607,20 @@ errno_t init_renew_tgt(struct krb5_ctx *krb5_ctx, struct be_ctx *be_ctx,
     krb5_ctx->renew_tgt_ctx->krb5_ctx = krb5_ctx;
     krb5_ctx->renew_tgt_ctx->ev = ev;
     krb5_ctx->renew_tgt_ctx->timer_interval = renew_intv;
+    krb5_ctx->renew_tgt_ctx->rand_seed = time(NULL) ^ getpid();
+
+    max_running = dp_opt_get_int(krb5_ctx->opts, KRB5_RENEW_MAX_PARALLEL);
+    pool_size = dp_opt_get_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE);
+    if (pool_size > 0 && max_running > pool_size) {
+        /* keep the renewals on the persistent workers */
+        max_running = pool_size;
+    }
+    if (max_running < 1) {
+        max_running = 1;
+    }
+    krb5_ctx->renew_tgt_ctx->max_running = max_running;
+    DEBUG(SSSDBG_CONF_SETTINGS, ("Running up to [%d] TGT renewals in "
+                                 "parallel.\n", max_running));
 
     ret = check_ccache_files(krb5_ctx->renew_tgt_ctx);
     if (ret != EOK) {
@@ -532,6 +663,31 @@ fail:
     return ret;
 }
 
+/* Pick the renewal time at random between half and four fifths of the
+ * lifetime of the ticket. Otherwise all tickets acquired at the start of
+ * the working day would be renewed in the same run. The ticket must still
+ * be valid after the next check following the renewal time. */
+static time_t renew_tgt_start_at(struct renew_tgt_ctx *renew_tgt_ctx,
+                                 struct tgt_times *tgtt)
+{
+    time_t lifetime = tgtt->endtime - tgtt->starttime;
+    time_t earliest;
+    time_t latest;
+
+    earliest = tgtt->starttime + lifetime / 2;
+    latest = tgtt->starttime + (lifetime / 5) * 4;
+    if (latest > tgtt->endtime - 2 * renew_tgt_ctx->timer_interval) {
+        latest = tgtt->endtime - 2 * renew_tgt_ctx->timer_interval;
+    }
+
+    if (latest <= earliest) {
+        return earliest;
+    }
+
+    return earliest + rand_r(&renew_tgt_ctx->rand_seed)
+                        % (latest - earliest + 1);
+}
+
 errno_t add_tgt_to_renew_table(struct krb5_ctx *krb5_ctx, const char *ccfile,
                                struct tgt_times *tgtt, struct pam_data *pd,
                                const char *upn)
@@ -581,10 +737,11 @@ errno_t add_tgt_to_renew_table(struct krb5_ctx *krb5_ctx, const char *ccfile,
         renew_data->ccfile = talloc_strdup(renew_data, ccfile);
     }
 
+    renew_data->generation = ++krb5_ctx->renew_tgt_ctx->generation;
     renew_data->start_time = tgtt->starttime;
     renew_data->lifetime = tgtt->endtime;
-    renew_data->start_renew_at = (time_t) (tgtt->starttime +
-                                        0.5 *(tgtt->endtime - tgtt->starttime));
+    renew_data->start_renew_at = renew_tgt_start_at(krb5_ctx->renew_tgt_ctx,
+                                                    tgtt);
 
     ret = copy_pam_data(renew_data, pd, &renew_data->pd);
     if (ret != EOK) {
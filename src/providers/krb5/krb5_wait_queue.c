@@ -1,7 +1,7 @@
 /*
     SSSD
 
-    Kerberos 5 Backend Module - Serialize the request of a user
+    Kerberos 5 Backend Module - Schedule the requests of a user
 
     Authors:
         Sumit Bose <sbose@redhat.com>
@@ -24,186 +24,457 @@
 
 #include <tevent.h>
 #include <dhash.h>
+#include <security/pam_modules.h>
 
 #include "src/providers/krb5/krb5_auth.h"
 
 #define INIT_HASH_SIZE 5
 
+/* Buckets of the latency histograms, bucket n counts requests which took
+ * less than 2^n milliseconds, the last one everything slower. */
+#define QUEUE_HIST_BUCKETS 16
+
 struct queue_entry {
     struct queue_entry *prev;
     struct queue_entry *next;
 
+    struct user_queue *uq;
     struct be_req *be_req;
     struct pam_data *pd;
     struct krb5_ctx *krb5_ctx;
+
+    /* Copy of the credentials, pd->authtok might be changed while the
+     * request is processed */
+    struct sss_auth_token *authtok;
+
+    /* Identical authentications waiting for the result of this one */
+    struct queue_entry *followers;
+
+    struct timeval queued;
+};
+
+/* Requests of a single user. Only one request which touches the
+ * credential cache of the user runs at a time. */
+struct user_queue {
+    struct krb5_auth_queue *queue;
+    char *user;
+
+    struct queue_entry *running;
+    struct queue_entry *pending;
+};
+
+struct krb5_auth_queue {
+    hash_table_t *users;
+
+    uint64_t wait_hist[QUEUE_HIST_BUCKETS];
+    uint64_t total_hist[QUEUE_HIST_BUCKETS];
+    uint64_t coalesced;
 };
 
-static void wait_queue_auth(struct tevent_context *ev, struct tevent_timer *te,
-                             struct timeval current_time, void *private_data)
+static uint64_t queue_hist_add(uint64_t *hist, struct timeval *start,
+                               struct timeval *end)
+{
+    struct timeval diff;
+    uint64_t msecs;
+    int i;
+
+    diff = tevent_timeval_until(start, end);
+    msecs = diff.tv_sec * 1000 + diff.tv_usec / 1000;
+
+    for (i = 0; i < QUEUE_HIST_BUCKETS - 1; i++) {
+        if (msecs < (1ULL << i)) {
+            break;
+        }
+    }
+
+    hist[i]++;
+    return msecs;
+}
+
+static void queue_hist_print(const char *name, uint64_t *hist)
+{
+    char buf[QUEUE_HIST_BUCKETS * 21 + 1];
+    size_t p = 0;
+    int i;
+
+    for (i = 0; i < QUEUE_HIST_BUCKETS; i++) {
+        p += snprintf(buf + p, sizeof(buf) - p, " %llu",
+                      (unsigned long long) hist[i]);
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("%s latency histogram [ms < 2^n]:%s\n",
+                              name, buf));
+}
+
+static int queue_entry_destructor(struct queue_entry *qe)
+{
+    if (qe->authtok != NULL) {
+        sss_authtok_wipe_password(qe->authtok);
+    }
+
+    return 0;
+}
+
+static struct queue_entry *queue_entry_new(TALLOC_CTX *mem_ctx,
+                                           struct user_queue *uq,
+                                           struct be_req *be_req,
+                                           struct pam_data *pd,
+                                           struct krb5_ctx *krb5_ctx)
+{
+    struct queue_entry *qe;
+    errno_t ret;
+
+    qe = talloc_zero(mem_ctx, struct queue_entry);
+    if (qe == NULL) {
+        DEBUG(1, ("talloc_zero failed.\n"));
+        return NULL;
+    }
+
+    qe->uq = uq;
+    qe->be_req = be_req;
+    qe->pd = pd;
+    qe->krb5_ctx = krb5_ctx;
+    qe->queued = tevent_timeval_current();
+
+    if (pd->cmd == SSS_PAM_AUTHENTICATE) {
+        qe->authtok = sss_authtok_new(qe);
+        if (qe->authtok == NULL) {
+            talloc_free(qe);
+            return NULL;
+        }
+        talloc_set_destructor(qe, queue_entry_destructor);
+
+        ret = sss_authtok_copy(pd->authtok, qe->authtok);
+        if (ret != EOK) {
+            DEBUG(1, ("sss_authtok_copy failed.\n"));
+            talloc_free(qe);
+            return NULL;
+        }
+    }
+
+    return qe;
+}
+
+/* A missing item only matches a missing or empty one */
+static bool queue_entry_same_item(const char *s1, const char *s2)
+{
+    return strcmp(s1 != NULL ? s1 : "", s2 != NULL ? s2 : "") == 0;
+}
+
+/* Two authentications can share one KDC exchange if they are for the
+ * same user, PAM service, remote host and terminal with exactly the same
+ * credentials. The result depends on the service, e.g. for OTP or the
+ * bookkeeping of offline authentications, so it must not be shared with
+ * another one. */
+static bool queue_entry_same_auth(struct queue_entry *qe,
+                                  struct pam_data *pd)
+{
+    size_t len;
+
+    if (qe->pd->cmd != SSS_PAM_AUTHENTICATE
+            || pd->cmd != SSS_PAM_AUTHENTICATE
+            || qe->authtok == NULL) {
+        return false;
+    }
+
+    if (!queue_entry_same_item(qe->pd->user, pd->user)
+            || !queue_entry_same_item(qe->pd->domain, pd->domain)
+            || !queue_entry_same_item(qe->pd->service, pd->service)
+            || !queue_entry_same_item(qe->pd->rhost, pd->rhost)
+            || !queue_entry_same_item(qe->pd->tty, pd->tty)) {
+        return false;
+    }
+
+    if (sss_authtok_get_type(qe->authtok) != sss_authtok_get_type(pd->authtok)
+            || sss_authtok_get_type(pd->authtok) != SSS_AUTHTOK_TYPE_PASSWORD) {
+        return false;
+    }
+
+    len = sss_authtok_get_size(pd->authtok);
+    if (sss_authtok_get_size(qe->authtok) != len) {
+        return false;
+    }
+
+    return memcmp(sss_authtok_get_data(qe->authtok),
+                  sss_authtok_get_data(pd->authtok), len) == 0;
+}
+
+static errno_t copy_resp_list(struct pam_data *dst, struct response_data *src)
+{
+    errno_t ret;
+
+    if (src == NULL) {
+        return EOK;
+    }
+
+    /* pam_add_response() prepends, copy the tail first to keep the order */
+    ret = copy_resp_list(dst, src->next);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = pam_add_response(dst, src->type, src->len, src->data);
+    if (ret != EOK) {
+        return ret;
+    }
+    dst->resp_list->do_not_send_to_client = src->do_not_send_to_client;
+
+    return EOK;
+}
+
+static void queue_entry_finish(struct queue_entry *qe, struct pam_data *src,
+                               int dp_err)
+{
+    struct timeval now;
+    uint64_t msecs;
+    errno_t ret;
+
+    if (src != qe->pd) {
+        qe->pd->pam_status = src->pam_status;
+        qe->pd->offline_auth = src->offline_auth;
+        qe->pd->last_auth_saved = src->last_auth_saved;
+        ret = copy_resp_list(qe->pd, src->resp_list);
+        if (ret != EOK) {
+            DEBUG(1, ("Failed to copy the response of user [%s].\n",
+                      qe->pd->user));
+            qe->pd->pam_status = PAM_SYSTEM_ERR;
+        }
+    }
+
+    now = tevent_timeval_current();
+    msecs = queue_hist_add(qe->uq->queue->total_hist, &qe->queued, &now);
+    DEBUG(SSSDBG_TRACE_FUNC, ("Request of user [%s] finished after [%llu] "
+                              "ms.\n", qe->pd->user,
+                              (unsigned long long) msecs));
+
+    be_req_terminate(qe->be_req, dp_err, qe->pd->pam_status, NULL);
+}
+
+static void queue_auth_done(struct tevent_req *req);
+
+static void user_queue_next(struct user_queue *uq)
 {
-    struct queue_entry *qe = talloc_get_type(private_data, struct queue_entry);
-    struct be_ctx *be_ctx = be_req_get_be_ctx(qe->be_req);
+    struct krb5_auth_queue *queue = uq->queue;
+    struct queue_entry *qe;
+    struct queue_entry *follower;
     struct tevent_req *req;
+    struct be_ctx *be_ctx;
+    struct timeval now;
+    hash_key_t key;
+    int ret;
+
+    while ((qe = uq->pending) != NULL) {
+        DLIST_REMOVE(uq->pending, qe);
+        uq->running = qe;
+
+        now = tevent_timeval_current();
+        queue_hist_add(queue->wait_hist, &qe->queued, &now);
+
+        be_ctx = be_req_get_be_ctx(qe->be_req);
+        req = krb5_auth_send(qe->be_req, be_ctx->ev, be_ctx, qe->pd,
+                             qe->krb5_ctx);
+        if (req != NULL) {
+            tevent_req_set_callback(req, queue_auth_done, qe);
+            return;
+        }
 
-    req = krb5_auth_send(qe->be_req, be_ctx->ev, be_ctx, qe->pd, qe->krb5_ctx);
-    if (req == NULL) {
         DEBUG(1, ("krb5_auth_send failed.\n"));
+        qe->pd->pam_status = PAM_SYSTEM_ERR;
+        while ((follower = qe->followers) != NULL) {
+            DLIST_REMOVE(qe->followers, follower);
+            queue_entry_finish(follower, qe->pd, DP_ERR_FATAL);
+            talloc_free(follower);
+        }
+        queue_entry_finish(qe, qe->pd, DP_ERR_FATAL);
+        uq->running = NULL;
+        talloc_free(qe);
+    }
+
+    DEBUG(7, ("Wait queue for user [%s] is empty.\n", uq->user));
+    queue_hist_print("Wait", queue->wait_hist);
+    queue_hist_print("Total", queue->total_hist);
+    DEBUG(SSSDBG_TRACE_FUNC, ("[%llu] authentications were coalesced.\n",
+                              (unsigned long long) queue->coalesced));
+
+    key.type = HASH_KEY_STRING;
+    key.str = uq->user;
+
+    /* This frees uq */
+    ret = hash_delete(queue->users, &key);
+    if (ret != HASH_SUCCESS) {
+        DEBUG(1, ("Failed to remove wait queue for user [%s].\n", uq->user));
+    }
+}
+
+static void queue_auth_done(struct tevent_req *req)
+{
+    struct queue_entry *qe = tevent_req_callback_data(req, struct queue_entry);
+    struct user_queue *uq = qe->uq;
+    struct queue_entry *follower;
+    int pam_status;
+    int dp_err;
+    int ret;
+
+    ret = krb5_auth_recv(req, &pam_status, &dp_err);
+    talloc_zfree(req);
+    if (ret) {
+        qe->pd->pam_status = PAM_SYSTEM_ERR;
+        dp_err = DP_ERR_OK;
     } else {
-        tevent_req_set_callback(req, krb5_pam_handler_auth_done, qe->be_req);
+        qe->pd->pam_status = pam_status;
+    }
+
+    while ((follower = qe->followers) != NULL) {
+        DLIST_REMOVE(qe->followers, follower);
+        queue_entry_finish(follower, qe->pd, dp_err);
+        talloc_free(follower);
     }
 
-    talloc_zfree(qe);
+    queue_entry_finish(qe, qe->pd, dp_err);
+    uq->running = NULL;
+    talloc_free(qe);
+
+    user_queue_next(uq);
 }
 
 static void wait_queue_del_cb(hash_entry_t *entry, hash_destroy_enum type,
                               void *pvt)
 {
-    struct queue_entry *head;
+    struct user_queue *uq;
 
     if (entry->value.type == HASH_VALUE_PTR) {
-        head = talloc_get_type(entry->value.ptr, struct queue_entry);
-        talloc_zfree(head);
+        uq = talloc_get_type(entry->value.ptr, struct user_queue);
+        talloc_zfree(uq);
         return;
     }
 
     DEBUG(1, ("Unexpected value type [%d].\n", entry->value.type));
 }
 
-errno_t add_to_wait_queue(struct be_req *be_req, struct pam_data *pd,
-                          struct krb5_ctx *krb5_ctx)
+static struct user_queue *get_user_queue(struct krb5_ctx *krb5_ctx,
+                                         const char *user)
 {
-    int ret;
+    struct krb5_auth_queue *queue;
+    struct user_queue *uq;
     hash_key_t key;
     hash_value_t value;
-    struct queue_entry *head;
-    struct queue_entry *queue_entry;
+    int ret;
+
+    if (krb5_ctx->auth_queue == NULL) {
+        queue = talloc_zero(krb5_ctx, struct krb5_auth_queue);
+        if (queue == NULL) {
+            DEBUG(1, ("talloc_zero failed.\n"));
+            return NULL;
+        }
 
-    if (krb5_ctx->wait_queue_hash == NULL) {
-        ret = sss_hash_create_ex(krb5_ctx, INIT_HASH_SIZE,
-                                 &krb5_ctx->wait_queue_hash, 0, 0, 0, 0,
-                                 wait_queue_del_cb, NULL);
+        ret = sss_hash_create_ex(queue, INIT_HASH_SIZE, &queue->users,
+                                 0, 0, 0, 0, wait_queue_del_cb, NULL);
         if (ret != EOK) {
             DEBUG(1, ("sss_hash_create failed"));
-            return ret;
+            talloc_free(queue);
+            return NULL;
         }
+
+        krb5_ctx->auth_queue = queue;
     }
+    queue = krb5_ctx->auth_queue;
 
     key.type = HASH_KEY_STRING;
-    key.str = pd->user;
+    key.str = discard_const(user);
 
-    ret = hash_lookup(krb5_ctx->wait_queue_hash, &key, &value);
+    ret = hash_lookup(queue->users, &key, &value);
     switch (ret) {
         case HASH_SUCCESS:
             if (value.type != HASH_VALUE_PTR) {
                 DEBUG(1, ("Unexpected hash value type.\n"));
-                return EINVAL;
+                return NULL;
             }
 
-            head = talloc_get_type(value.ptr, struct queue_entry);
-
-            queue_entry = talloc_zero(head, struct queue_entry);
-            if (queue_entry == NULL) {
+            return talloc_get_type(value.ptr, struct user_queue);
+        case HASH_ERROR_KEY_NOT_FOUND:
+            uq = talloc_zero(queue->users, struct user_queue);
+            if (uq == NULL) {
                 DEBUG(1, ("talloc_zero failed.\n"));
-                return ENOMEM;
+                return NULL;
+            }
+            uq->queue = queue;
+            uq->user = talloc_strdup(uq, user);
+            if (uq->user == NULL) {
+                talloc_free(uq);
+                return NULL;
             }
 
-            queue_entry->be_req = be_req;
-            queue_entry->pd = pd;
-            queue_entry->krb5_ctx = krb5_ctx;
-
-            DLIST_ADD_END(head, queue_entry, struct queue_entry *);
-
-            break;
-        case HASH_ERROR_KEY_NOT_FOUND:
             value.type = HASH_VALUE_PTR;
-            head = talloc_zero(krb5_ctx->wait_queue_hash, struct queue_entry);
-            if (head == NULL) {
-                DEBUG(1, ("talloc_zero failed.\n"));
-                return ENOMEM;
-            }
-            value.ptr = head;
+            value.ptr = uq;
 
-            ret = hash_enter(krb5_ctx->wait_queue_hash, &key, &value);
+            ret = hash_enter(queue->users, &key, &value);
             if (ret != HASH_SUCCESS) {
                 DEBUG(1, ("hash_enter failed.\n"));
-                talloc_free(head);
-                return EIO;
+                talloc_free(uq);
+                return NULL;
             }
 
-            break;
+            return uq;
         default:
             DEBUG(1, ("hash_lookup failed.\n"));
-            return EIO;
-    }
-
-    if (head->next == NULL) {
-        return ENOENT;
-    } else {
-        return EOK;
+            return NULL;
     }
 }
 
-void check_wait_queue(struct krb5_ctx *krb5_ctx, char *username)
+errno_t krb5_auth_queue_add(struct be_req *be_req, struct pam_data *pd,
+                            struct krb5_ctx *krb5_ctx)
 {
-    int ret;
-    hash_key_t key;
-    hash_value_t value;
-    struct queue_entry *head;
-    struct queue_entry *queue_entry;
-    struct tevent_timer *te;
-    struct be_ctx *be_ctx;
+    struct user_queue *uq;
+    struct queue_entry *qe;
+    struct queue_entry *leader = NULL;
 
-    if (krb5_ctx->wait_queue_hash == NULL) {
-        DEBUG(1, ("No wait queue available.\n"));
-        return;
+    uq = get_user_queue(krb5_ctx, pd->user);
+    if (uq == NULL) {
+        return EIO;
     }
 
-    key.type = HASH_KEY_STRING;
-    key.str = username;
-
-    ret = hash_lookup(krb5_ctx->wait_queue_hash, &key, &value);
-
-    switch (ret) {
-        case HASH_SUCCESS:
-            if (value.type != HASH_VALUE_PTR) {
-                DEBUG(1, ("Unexpected hash value type.\n"));
-                return;
+    /* Join an identical authentication which is running or waiting */
+    if (uq->running != NULL && queue_entry_same_auth(uq->running, pd)) {
+        leader = uq->running;
+    } else {
+        for (qe = uq->pending; qe != NULL; qe = qe->next) {
+            if (queue_entry_same_auth(qe, pd)) {
+                leader = qe;
+                break;
             }
+        }
+    }
 
-            head = talloc_get_type(value.ptr, struct queue_entry);
-
-            if (head->next == NULL) {
-                DEBUG(7, ("Wait queue for user [%s] is empty.\n", username));
-            } else {
-                queue_entry = head->next;
-
-                DLIST_REMOVE(head, queue_entry);
-
-                be_ctx = be_req_get_be_ctx(queue_entry->be_req);
-                te = tevent_add_timer(be_ctx->ev, krb5_ctx,
-                                      tevent_timeval_current(), wait_queue_auth,
-                                      queue_entry);
-                if (te == NULL) {
-                    DEBUG(1, ("tevent_add_timer failed.\n"));
-                } else {
-                    return;
-                }
-            }
+    if (leader != NULL) {
+        qe = queue_entry_new(leader, uq, be_req, pd, krb5_ctx);
+    } else {
+        qe = queue_entry_new(uq, uq, be_req, pd, krb5_ctx);
+    }
+    if (qe == NULL) {
+        if (uq->running == NULL && uq->pending == NULL) {
+            /* drop the empty queue again */
+            user_queue_next(uq);
+        }
+        return ENOMEM;
+    }
 
-            ret = hash_delete(krb5_ctx->wait_queue_hash, &key);
-            if (ret != HASH_SUCCESS) {
-                DEBUG(1, ("Failed to remove wait queue for user [%s].\n",
-                          username));
-            }
+    if (leader != NULL) {
+        DEBUG(7, ("Authentication of user [%s] joins a request with the "
+                  "same credentials.\n", pd->user));
+        uq->queue->coalesced++;
+        DLIST_ADD_END(leader->followers, qe, struct queue_entry *);
+        return EOK;
+    }
 
-            break;
-        case HASH_ERROR_KEY_NOT_FOUND:
-            DEBUG(1, ("No wait queue for user [%s] found.\n", username));
-            break;
-        default:
-            DEBUG(1, ("hash_lookup failed.\n"));
+    DLIST_ADD_END(uq->pending, qe, struct queue_entry *);
+    if (uq->running == NULL) {
+        DEBUG(7, ("Wait queue of user [%s] is empty, "
+                  "running request immediately.\n", pd->user));
+        user_queue_next(uq);
+    } else {
+        DEBUG(7, ("Request successfully added to wait queue "
+                  "of user [%s].\n", pd->user));
     }
 
-    return;
+    return EOK;
 }
-
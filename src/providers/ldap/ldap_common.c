@@ -760,6 +760,11 @@ int sdap_id_setup_tasks(struct sdap_id_ctx *ctx)
     int delay;
     bool has_enumerated;
 
+    ret = sdap_trace_setup(ctx->opts);
+    if (ret != EOK) {
+        return ret;
+    }
+
     /* set up enumeration task */
     if (ctx->be->domain->enumerate) {
         /* If this is the first startup, we need to kick off
@@ -1325,6 +1330,12 @@ int sdap_service_init(TALLOC_CTX *memctx, struct be_ctx *ctx,
         goto done;
     }
 
+    ret = be_fo_enable_probing(ctx, service_name, LDAP_PORT);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to enable server probing!\n"));
+        goto done;
+    }
+
     service->name = talloc_strdup(service, service_name);
     if (!service->name) {
         ret = ENOMEM;
@@ -85,6 +85,8 @@ errno_t sdap_reinit_cleanup_recv(struct tevent_req *req);
 /* id */
 void sdap_account_info_handler(struct be_req *breq);
 void sdap_handle_account_info(struct be_req *breq, struct sdap_id_ctx *ctx);
+void sdap_account_batch_handler(struct be_req *breq);
+void sdap_handle_account_batch(struct be_req *breq, struct sdap_id_ctx *ctx);
 int sdap_id_setup_tasks(struct sdap_id_ctx *ctx);
 
 /* auth */
@@ -188,6 +190,9 @@ services_get_recv(struct tevent_req *req, int *dp_error_out);
 /* setup child logging */
 int sdap_setup_child(void);
 
+/* setup LDAP operation tracing, from sdap_trace.c */
+errno_t sdap_trace_setup(struct sdap_options *opts);
+
 
 errno_t string_to_shadowpw_days(const char *s, long *d);
 
@@ -244,7 +244,7 @@ static void users_get_done(struct tevent_req *subreq)
     int dp_error = DP_ERR_FATAL;
     int ret;
 
-    ret = sdap_get_users_recv(subreq, NULL, NULL);
+    ret = sdap_get_users_recv(subreq, NULL, NULL, NULL, NULL);
     talloc_zfree(subreq);
 
     ret = sdap_id_op_done(state->op, ret, &dp_error);
@@ -355,6 +355,314 @@ int users_get_recv(struct tevent_req *req, int *dp_error_out)
     return EOK;
 }
 
+/* =Users-Related-Functions-(list-of-names)=============================== */
+
+struct users_batch_get_state {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *ctx;
+    struct sdap_id_op *op;
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *domain;
+
+    char **names;
+    struct sysdb_attrs **users;
+    size_t count;
+
+    char *filter;
+    const char **attrs;
+
+    int dp_error;
+};
+
+static int users_batch_get_retry(struct tevent_req *req);
+static void users_batch_get_connect_done(struct tevent_req *subreq);
+static void users_batch_get_done(struct tevent_req *subreq);
+static errno_t users_batch_get_purge_missing(struct users_batch_get_state *state);
+
+/* Looks up all the names with a single search */
+static struct tevent_req *users_batch_get_send(TALLOC_CTX *memctx,
+                                               struct tevent_context *ev,
+                                               struct sdap_id_ctx *ctx,
+                                               char **names)
+{
+    struct tevent_req *req;
+    struct users_batch_get_state *state;
+    const char *attr_name;
+    char *clean_name;
+    int ret;
+    int i;
+
+    req = tevent_req_create(memctx, &state, struct users_batch_get_state);
+    if (!req) return NULL;
+
+    state->ev = ev;
+    state->ctx = ctx;
+    state->dp_error = DP_ERR_FATAL;
+    state->names = names;
+
+    state->op = sdap_id_op_create(state, state->ctx->conn_cache);
+    if (!state->op) {
+        DEBUG(SSSDBG_OP_FAILURE, ("sdap_id_op_create failed\n"));
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    state->sysdb = ctx->be->domain->sysdb;
+    state->domain = state->ctx->be->domain;
+
+    attr_name = ctx->opts->user_map[SDAP_AT_USER_NAME].name;
+    state->filter = talloc_strdup(state, "(&(|");
+    for (i = 0; state->filter && names[i]; i++) {
+        ret = sss_filter_sanitize(state, names[i], &clean_name);
+        if (ret != EOK) {
+            goto fail;
+        }
+
+        state->filter = talloc_asprintf_append_buffer(state->filter,
+                                                      "(%s=%s)",
+                                                      attr_name, clean_name);
+        talloc_free(clean_name);
+    }
+    if (state->filter) {
+        state->filter = talloc_asprintf_append_buffer(state->filter,
+                                ")(objectclass=%s))",
+                                ctx->opts->user_map[SDAP_OC_USER].name);
+    }
+    if (!state->filter) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to build the batch filter\n"));
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Looking up %d users at once\n", i));
+
+    ret = build_attrs_from_map(state, ctx->opts->user_map, SDAP_OPTS_USER,
+                               NULL, &state->attrs, NULL);
+    if (ret != EOK) goto fail;
+
+    ret = users_batch_get_retry(req);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    return req;
+
+fail:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static int users_batch_get_retry(struct tevent_req *req)
+{
+    struct users_batch_get_state *state =
+            tevent_req_data(req, struct users_batch_get_state);
+    struct tevent_req *subreq;
+    int ret = EOK;
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (!subreq) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, users_batch_get_connect_done, req);
+    return EOK;
+}
+
+static void users_batch_get_connect_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct users_batch_get_state *state =
+            tevent_req_data(req, struct users_batch_get_state);
+    int dp_error = DP_ERR_FATAL;
+    int ret;
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+
+    if (ret != EOK) {
+        state->dp_error = dp_error;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    /* unlike a single lookup, the names may be spread over all the
+     * search bases, so they are all searched like when enumerating */
+    subreq = sdap_get_users_send(state, state->ev,
+                                 state->domain, state->sysdb,
+                                 state->ctx->opts,
+                                 state->ctx->opts->user_search_bases,
+                                 sdap_id_op_handle(state->op),
+                                 state->attrs, state->filter,
+                                 dp_opt_get_int(state->ctx->opts->basic,
+                                                SDAP_SEARCH_TIMEOUT),
+                                 true);
+    if (!subreq) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(subreq, users_batch_get_done, req);
+}
+
+static void users_batch_get_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct users_batch_get_state *state =
+            tevent_req_data(req, struct users_batch_get_state);
+    int dp_error = DP_ERR_FATAL;
+    int ret;
+
+    talloc_zfree(state->users);
+    state->count = 0;
+    ret = sdap_get_users_recv(subreq, state, NULL,
+                              &state->count, &state->users);
+    talloc_zfree(subreq);
+
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry */
+        ret = users_batch_get_retry(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+            return;
+        }
+
+        return;
+    }
+
+    if (ret && ret != ENOENT) {
+        state->dp_error = dp_error;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = users_batch_get_purge_missing(state);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    state->dp_error = DP_ERR_OK;
+    tevent_req_done(req);
+}
+
+/* Does for the names the server did not return what a single lookup
+ * does when it finds nothing */
+static errno_t users_batch_get_purge_missing(struct users_batch_get_state *state)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct sysdb_attrs **usr_attrs;
+    struct ldb_message *msg;
+    const char **found;
+    const char **missing;
+    const char **still_missing;
+    const char *cached[2] = { NULL, NULL };
+    bool case_sensitive = state->domain->case_sensitive;
+    bool fallback;
+    errno_t ret;
+    size_t i, n;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    fallback = (state->ctx->opts->schema_type == SDAP_SCHEMA_RFC2307) &&
+               dp_opt_get_bool(state->ctx->opts->basic,
+                               SDAP_RFC2307_FALLBACK_TO_LOCAL_USERS);
+
+    found = talloc_zero_array(tmp_ctx, const char *, state->count + 1);
+    if (!found) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0, n = 0; i < state->count; i++) {
+        ret = sysdb_attrs_primary_name(state->sysdb, state->users[i],
+                        state->ctx->opts->user_map[SDAP_AT_USER_NAME].name,
+                        &found[n]);
+        if (ret != EOK) {
+            /* such an entry was not saved either */
+            continue;
+        }
+        n++;
+    }
+
+    ret = sss_get_missing_names(tmp_ctx, (const char * const *) state->names,
+                                found, case_sensitive, &missing);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; missing[i]; i++) {
+        /* The cache looks users up by their DN, which ignores the case.
+         * Keep the entry if the server returned it under its cached name,
+         * which differs from the requested one in case only. */
+        ret = sysdb_search_user_by_name(tmp_ctx, state->sysdb, state->domain,
+                                        missing[i], attrs, &msg);
+        if (ret == EOK) {
+            cached[0] = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+            if (cached[0] != NULL) {
+                ret = sss_get_missing_names(tmp_ctx, cached, found,
+                                            case_sensitive, &still_missing);
+                if (ret != EOK) {
+                    goto done;
+                }
+                if (still_missing[0] == NULL) {
+                    continue;
+                }
+            }
+        } else if (ret != ENOENT) {
+            goto done;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, ("User [%s] was not found\n", missing[i]));
+
+        if (fallback) {
+            ret = sdap_fallback_local_user(tmp_ctx, state->ctx->opts,
+                                           missing[i], -1, &usr_attrs);
+            if (ret == EOK) {
+                ret = sdap_save_user(tmp_ctx, state->sysdb,
+                                     state->ctx->opts, state->domain,
+                                     usr_attrs[0], false, NULL, 0);
+                if (ret != EOK) {
+                    goto done;
+                }
+                continue;
+            }
+        }
+
+        ret = sysdb_delete_user(state->sysdb, state->domain,
+                                missing[i], 0);
+        if (ret != EOK && ret != ENOENT) {
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int users_batch_get_recv(struct tevent_req *req, int *dp_error_out)
+{
+    struct users_batch_get_state *state =
+            tevent_req_data(req, struct users_batch_get_state);
+
+    if (dp_error_out) {
+        *dp_error_out = state->dp_error;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /* =Groups-Related-Functions-(by-name,by-uid)============================= */
 
 struct groups_get_state {
@@ -976,6 +1284,7 @@ static void sdap_account_info_groups_done(struct tevent_req *req);
 static void sdap_account_info_initgr_done(struct tevent_req *req);
 static void sdap_account_info_netgroups_done(struct tevent_req *req);
 static void sdap_account_info_services_done(struct tevent_req *req);
+static void sdap_account_info_batch_done(struct tevent_req *req);
 void sdap_handle_account_info(struct be_req *breq, struct sdap_id_ctx *ctx);
 
 static struct tevent_req *get_user_and_group_send(TALLOC_CTX *memctx,
@@ -1160,6 +1469,47 @@ void sdap_handle_account_info(struct be_req *breq, struct sdap_id_ctx *ctx)
     if (ret != EOK) return sdap_handler_done(breq, DP_ERR_FATAL, ret, err);
 }
 
+void sdap_account_batch_handler(struct be_req *breq)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct sdap_id_ctx *ctx;
+
+    ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data, struct sdap_id_ctx);
+    if (!ctx) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Could not get sdap ctx\n"));
+        return sdap_handler_done(breq, DP_ERR_FATAL,
+                                 EINVAL, "Invalid request data\n");
+    }
+    return sdap_handle_account_batch(breq, ctx);
+}
+
+void sdap_handle_account_batch(struct be_req *breq, struct sdap_id_ctx *ctx)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct be_acct_req *ar;
+    struct tevent_req *req;
+
+    if (be_is_offline(ctx->be)) {
+        return sdap_handler_done(breq, DP_ERR_OFFLINE, EAGAIN, "Offline");
+    }
+
+    ar = talloc_get_type(be_req_get_data(breq), struct be_acct_req);
+
+    if ((ar->entry_type & BE_REQ_TYPE_MASK) != BE_REQ_USER ||
+        ar->filter_type != BE_FILTER_NAME_LIST ||
+        strcasecmp(ar->domain, be_ctx->domain->name) != 0) {
+        return sdap_handler_done(breq, DP_ERR_FATAL,
+                                 EINVAL, "Invalid batch request");
+    }
+
+    req = users_batch_get_send(breq, be_ctx->ev, ctx, ar->filter_list);
+    if (!req) {
+        return sdap_handler_done(breq, DP_ERR_FATAL, ENOMEM, "Out of memory");
+    }
+
+    tevent_req_set_callback(req, sdap_account_info_batch_done, breq);
+}
+
 static void sdap_account_info_complete(struct be_req *breq, int dp_error,
                                        int ret, const char *default_error_text)
 {
@@ -1195,6 +1545,17 @@ static void sdap_account_info_users_done(struct tevent_req *req)
     sdap_account_info_complete(breq, dp_error, ret, "User lookup failed");
 }
 
+static void sdap_account_info_batch_done(struct tevent_req *req)
+{
+    struct be_req *breq = tevent_req_callback_data(req, struct be_req);
+    int ret, dp_error;
+
+    ret = users_batch_get_recv(req, &dp_error);
+    talloc_zfree(req);
+
+    sdap_account_info_complete(breq, dp_error, ret, "User lookup failed");
+}
+
 static void sdap_account_info_groups_done(struct tevent_req *req)
 {
     struct be_req *breq = tevent_req_callback_data(req, struct be_req);
@@ -28,6 +28,7 @@
 
 #include "util/util.h"
 #include "util/find_uid.h"
+#include "util/sss_stats.h"
 #include "db/sysdb.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_async.h"
@@ -36,22 +37,23 @@
 
 struct tevent_req *ldap_id_cleanup_send(TALLOC_CTX *memctx,
                                         struct tevent_context *ev,
-                                        struct sdap_id_ctx *ctx);
+                                        struct sdap_id_ctx *ctx,
+                                        enum be_sched_class cls);
 static void ldap_id_cleanup_reschedule(struct tevent_req *req);
 
 static void ldap_id_cleanup_timeout(struct tevent_context *ev,
                                       struct tevent_timer *te,
                                       struct timeval tv, void *pvt);
+static void ldap_id_cleanup_yield_done(struct tevent_req *subreq);
+static void ldap_id_cleanup_start(struct sdap_id_ctx *ctx);
 
 static void ldap_id_cleanup_timer(struct tevent_context *ev,
                                   struct tevent_timer *tt,
                                   struct timeval tv, void *pvt)
 {
     struct sdap_id_ctx *ctx = talloc_get_type(pvt, struct sdap_id_ctx);
-    struct tevent_timer *timeout;
-    struct tevent_req *req;
+    struct tevent_req *subreq;
     int delay;
-    errno_t ret;
 
     if (be_is_offline(ctx->be)) {
         DEBUG(4, ("Backend is marked offline, retry later!\n"));
@@ -62,7 +64,36 @@ static void ldap_id_cleanup_timer(struct tevent_context *ev,
         return;
     }
 
-    req = ldap_id_cleanup_send(ctx, ev, ctx);
+    /* wait until the more important requests are served */
+    subreq = be_sched_yield_send(ctx, ctx->be, BE_SCHED_CLEANUP);
+    if (subreq == NULL) {
+        ldap_id_cleanup_start(ctx);
+        return;
+    }
+    tevent_req_set_callback(subreq, ldap_id_cleanup_yield_done, ctx);
+}
+
+static void ldap_id_cleanup_yield_done(struct tevent_req *subreq)
+{
+    struct sdap_id_ctx *ctx = tevent_req_callback_data(subreq,
+                                                       struct sdap_id_ctx);
+
+    /* the yield only fails when it could not wait, run anyway */
+    be_sched_yield_recv(subreq);
+    talloc_zfree(subreq);
+
+    ldap_id_cleanup_start(ctx);
+}
+
+static void ldap_id_cleanup_start(struct sdap_id_ctx *ctx)
+{
+    struct tevent_timer *timeout;
+    struct tevent_req *req;
+    struct timeval tv;
+    int delay;
+    errno_t ret;
+
+    req = ldap_id_cleanup_send(ctx, ctx->be->ev, ctx, BE_SCHED_CLEANUP);
     if (!req) {
         DEBUG(1, ("Failed to schedule cleanup, retrying later!\n"));
         /* schedule starting from now, not the last run */
@@ -167,75 +198,276 @@ int ldap_id_cleanup_set_timer(struct sdap_id_ctx *ctx, struct timeval tv)
 struct global_cleanup_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *ctx;
-};
+    enum be_sched_class cls;
+    int chunk_time;
 
-static int cleanup_users(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx);
-static int cleanup_groups(TALLOC_CTX *memctx,
-                          struct sysdb_ctx *sysdb,
-                          struct sss_domain_info *domain);
+    hash_table_t *uid_table;
+    bool check_logged_in;
+    const char *filter;
+    struct ldb_message **msgs;
+    size_t count;
+    size_t next;
+    bool groups;
+};
 
+static int cleanup_users_search(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx,
+                                const char **_filter,
+                                struct ldb_message ***_msgs, size_t *_count);
+static int cleanup_user(struct global_cleanup_state *state,
+                        struct ldb_message *msg);
+static int cleanup_groups_search(TALLOC_CTX *memctx,
+                                 struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *domain,
+                                 const char **_filter,
+                                 struct ldb_message ***_msgs, size_t *_count);
+static errno_t cleanup_still_expired(TALLOC_CTX *memctx,
+                                     struct sysdb_ctx *sysdb,
+                                     struct ldb_message *msg,
+                                     const char *filter);
+static int cleanup_group(TALLOC_CTX *memctx,
+                         struct sysdb_ctx *sysdb,
+                         struct sss_domain_info *domain,
+                         struct ldb_message *msg);
+static errno_t ldap_id_cleanup_chunk(struct tevent_req *req);
+static errno_t ldap_id_cleanup_yield(struct tevent_req *req);
+static void ldap_id_cleanup_chunk_done(struct tevent_req *subreq);
+
+/* The expired entries are deleted in parts, each in its own short
+ * transaction, and the more important requests are served in between.
+ * An entry may be refreshed or the user may log in after the search, so
+ * every entry is checked again in the transaction that deletes it.
+ * The callers pass the class of the task the cleanup runs as. */
 struct tevent_req *ldap_id_cleanup_send(TALLOC_CTX *memctx,
                                         struct tevent_context *ev,
-                                        struct sdap_id_ctx *ctx)
+                                        struct sdap_id_ctx *ctx,
+                                        enum be_sched_class cls)
 {
     struct global_cleanup_state *state;
     struct tevent_req *req;
     int ret;
-    bool in_transaction = false;
 
     req = tevent_req_create(memctx, &state, struct global_cleanup_state);
     if (!req) return NULL;
 
     state->ev = ev;
     state->ctx = ctx;
+    state->cls = cls;
+    state->chunk_time = dp_opt_get_int(ctx->opts->basic,
+                                       SDAP_CACHE_CHUNK_TIME);
 
     ctx->last_purge = tevent_timeval_current();
 
-    ret = sysdb_transaction_start(state->ctx->be->domain->sysdb);
+    state->check_logged_in = true;
+
+    ret = cleanup_users_search(state, ctx, &state->filter,
+                               &state->msgs, &state->count);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start transaction\n"));
         goto fail;
     }
-    in_transaction = true;
 
-    ret = cleanup_users(state, state->ctx);
-    if (ret && ret != ENOENT) {
+    ret = ldap_id_cleanup_yield(req);
+    if (ret != EOK) {
         goto fail;
     }
 
-    ret = cleanup_groups(state,
-                         state->ctx->be->domain->sysdb,
-                         state->ctx->be->domain);
-    if (ret) {
-        goto fail;
+    return req;
+
+fail:
+    DEBUG(1, ("Failed to cleanup caches (%d [%s]), retrying later!\n",
+              (int)ret, strerror(ret)));
+    tevent_req_done(req);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ldap_id_cleanup_yield(struct tevent_req *req)
+{
+    struct global_cleanup_state *state = tevent_req_data(req,
+                                                struct global_cleanup_state);
+    struct tevent_req *subreq;
+
+    subreq = be_sched_yield_send(state, state->ctx->be, state->cls);
+    if (!subreq) {
+        return ENOMEM;
     }
+    tevent_req_set_callback(subreq, ldap_id_cleanup_chunk_done, req);
+
+    return EOK;
+}
+
+static void ldap_id_cleanup_chunk_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    int ret;
 
-    ret = sysdb_transaction_commit(state->ctx->be->domain->sysdb);
+    ret = be_sched_yield_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ldap_id_cleanup_chunk(req);
+    if (ret == EAGAIN) {
+        ret = ldap_id_cleanup_yield(req);
+        if (ret == EOK) {
+            return;
+        }
+    }
+
+done:
+    if (ret != EOK) {
+        DEBUG(1, ("Failed to cleanup caches (%d [%s]), retrying later!\n",
+                  (int)ret, strerror(ret)));
+    }
+    tevent_req_done(req);
+}
+
+/* Deletes the next part of the expired entries. Returns EAGAIN if there
+ * is more to do, EOK once the users and then the groups are done. */
+static errno_t ldap_id_cleanup_chunk(struct tevent_req *req)
+{
+    struct global_cleanup_state *state = tevent_req_data(req,
+                                                struct global_cleanup_state);
+    struct sysdb_ctx *sysdb = state->ctx->be->domain->sysdb;
+    struct sss_domain_info *domain = state->ctx->be->domain;
+    TALLOC_CTX *tmpctx;
+    struct timeval start;
+    struct timeval end;
+    struct timeval tv;
+    bool in_transaction = false;
+    size_t first;
+    errno_t sret;
+    int ret;
+
+    if (state->next == state->count && !state->groups) {
+        talloc_zfree(state->msgs);
+        state->count = 0;
+        state->next = 0;
+        state->groups = true;
+        talloc_zfree(state->uid_table);
+
+        ret = cleanup_groups_search(state, sysdb, domain, &state->filter,
+                                    &state->msgs, &state->count);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if (state->next == state->count) {
+        return EOK;
+    }
+
+    if (!state->groups && state->check_logged_in) {
+        /* Users may have logged in while the cleanup was waiting */
+        talloc_zfree(state->uid_table);
+        ret = get_uid_table(state, &state->uid_table);
+        /* get_uid_table returns ENOSYS on non-Linux platforms. We proceed
+         * with the cleanup in that case
+         */
+        if (ret == ENOSYS) {
+            state->uid_table = NULL;
+            state->check_logged_in = false;
+        } else if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    tmpctx = talloc_new(state);
+    if (!tmpctx) {
+        return ENOMEM;
+    }
+
+    start = tevent_timeval_current();
+    end = tevent_timeval_add(&start, state->chunk_time / 1000,
+                             (state->chunk_time % 1000) * 1000);
+    first = state->next;
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start transaction\n"));
+        goto done;
+    }
+    in_transaction = true;
+
+    while (state->next < state->count) {
+        ret = cleanup_still_expired(tmpctx, sysdb, state->msgs[state->next],
+                                    state->filter);
+        if (ret == EOK) {
+            if (state->groups) {
+                ret = cleanup_group(tmpctx, sysdb, domain,
+                                    state->msgs[state->next]);
+            } else {
+                ret = cleanup_user(state, state->msgs[state->next]);
+            }
+        } else if (ret == ENOENT) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Entry %s is no longer expired, "
+                  "keeping it\n",
+                  ldb_dn_get_linearized(state->msgs[state->next]->dn)));
+            ret = EOK;
+        }
+        if (ret != EOK) {
+            goto done;
+        }
+        state->next++;
+
+        if (state->chunk_time > 0) {
+            tv = tevent_timeval_current();
+            if (tevent_timeval_compare(&tv, &end) >= 0) {
+                break;
+            }
+        }
+    }
+
+    ret = sysdb_transaction_commit(sysdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to commit transaction\n"));
-        goto fail;
+        goto done;
     }
     in_transaction = false;
 
-    tevent_req_done(req);
-    tevent_req_post(req, ev);
-    return req;
+    sss_stats_time("ldap_cleanup_chunk", &start, false);
+    DEBUG(SSSDBG_TRACE_FUNC, ("Checked expired %s %zu to %zu of %zu\n",
+                              state->groups ? "groups" : "users",
+                              first + 1, state->next, state->count));
 
-fail:
-    DEBUG(1, ("Failed to cleanup caches (%d [%s]), retrying later!\n",
-              (int)ret, strerror(ret)));
+    if (state->next < state->count || !state->groups) {
+        ret = EAGAIN;
+    } else {
+        ret = EOK;
+    }
+
+done:
     if (in_transaction) {
-        ret = sysdb_transaction_cancel(state->ctx->be->domain->sysdb);
-        if (ret != EOK) {
+        sret = sysdb_transaction_cancel(sysdb);
+        if (sret != EOK) {
             DEBUG(1, ("Could not cancel transaction\n"));
-            tevent_req_error(req, ret);
-            tevent_req_post(req, ev);
-            return req;
         }
     }
-    tevent_req_done(req);
-    tevent_req_post(req, ev);
-    return req;
+    talloc_free(tmpctx);
+    return ret;
+}
+
+/* Returns EOK if the entry still matches the filter it was found with,
+ * ENOENT if it was refreshed or removed in the meantime. */
+static errno_t cleanup_still_expired(TALLOC_CTX *memctx,
+                                     struct sysdb_ctx *sysdb,
+                                     struct ldb_message *msg,
+                                     const char *filter)
+{
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message **msgs;
+    size_t count;
+    errno_t ret;
+
+    ret = sysdb_search_entry(memctx, sysdb, msg->dn, LDB_SCOPE_BASE,
+                             filter, attrs, &count, &msgs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    talloc_free(msgs);
+    return EOK;
 }
 
 
@@ -244,7 +476,9 @@ fail:
 static int cleanup_users_logged_in(hash_table_t *table,
                                    const struct ldb_message *msg);
 
-static int cleanup_users(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx)
+static int cleanup_users_search(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx,
+                                const char **_filter,
+                                struct ldb_message ***_msgs, size_t *_count)
 {
     TALLOC_CTX *tmpctx;
     struct sysdb_ctx *sysdb = ctx->be->domain->sysdb;
@@ -252,12 +486,9 @@ static int cleanup_users(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx)
     time_t now = time(NULL);
     char *subfilter = NULL;
     int account_cache_expiration;
-    hash_table_t *uid_table;
     struct ldb_message **msgs;
     size_t count;
-    const char *name;
     int ret;
-    int i;
 
     tmpctx = talloc_new(memctx);
     if (!tmpctx) {
@@ -294,60 +525,61 @@ static int cleanup_users(TALLOC_CTX *memctx, struct sdap_id_ctx *ctx)
 
     ret = sysdb_search_users(tmpctx, sysdb, ctx->be->domain,
                              subfilter, attrs, &count, &msgs);
-    if (ret) {
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
+    if (ret == ENOENT) {
+        msgs = NULL;
+        count = 0;
+        ret = EOK;
+    } else if (ret) {
         goto done;
     }
 
     DEBUG(4, ("Found %d expired user entries!\n", count));
 
-    if (count == 0) {
-        ret = EOK;
-        goto done;
-    }
+    *_filter = talloc_steal(memctx, subfilter);
+    *_msgs = talloc_steal(memctx, msgs);
+    *_count = count;
+    ret = EOK;
 
-    ret = get_uid_table(tmpctx, &uid_table);
-    /* get_uid_table returns ENOSYS on non-Linux platforms. We proceed with
-     * the cleanup in that case
-     */
-    if (ret != EOK && ret != ENOSYS) {
-        goto done;
-    }
+done:
+    talloc_zfree(tmpctx);
+    return ret;
+}
 
-    for (i = 0; i < count; i++) {
-        name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
-        if (!name) {
-            DEBUG(2, ("Entry %s has no Name Attribute ?!?\n",
-                       ldb_dn_get_linearized(msgs[i]->dn)));
-            ret = EFAULT;
-            goto done;
-        }
+static int cleanup_user(struct global_cleanup_state *state,
+                        struct ldb_message *msg)
+{
+    const char *name;
+    int ret;
 
-        if (uid_table) {
-            ret = cleanup_users_logged_in(uid_table, msgs[i]);
-            if (ret == EOK) {
-                /* If the user is logged in, proceed to the next one */
-                DEBUG(5, ("User %s is still logged in or a dummy entry, "
-                          "keeping data\n", name));
-                continue;
-            } else if (ret != ENOENT) {
-                goto done;
-            }
-        }
+    name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+    if (!name) {
+        DEBUG(2, ("Entry %s has no Name Attribute ?!?\n",
+                   ldb_dn_get_linearized(msg->dn)));
+        return EFAULT;
+    }
 
-        /* If not logged in or cannot check the table, delete him */
-        DEBUG(9, ("About to delete user %s\n", name));
-        ret = sysdb_delete_user(sysdb, ctx->be->domain, name, 0);
-        if (ret) {
-            goto done;
+    if (state->uid_table) {
+        ret = cleanup_users_logged_in(state->uid_table, msg);
+        if (ret == EOK) {
+            /* If the user is logged in, proceed to the next one */
+            DEBUG(5, ("User %s is still logged in or a dummy entry, "
+                      "keeping data\n", name));
+            return EOK;
+        } else if (ret != ENOENT) {
+            return ret;
         }
     }
 
-done:
-    talloc_zfree(tmpctx);
-    return ret;
+    /* If not logged in or cannot check the table, delete him */
+    DEBUG(9, ("About to delete user %s\n", name));
+    ret = sysdb_delete_user(state->ctx->be->domain->sysdb,
+                            state->ctx->be->domain, name, 0);
+    if (ret) {
+        return ret;
+    }
+
+    sss_stats_inc("ldap_cleanup_user");
+    return EOK;
 }
 
 static int cleanup_users_logged_in(hash_table_t *table,
@@ -381,24 +613,19 @@ static int cleanup_users_logged_in(hash_table_t *table,
 
 /* ==Group-Cleanup-Process================================================ */
 
-static int cleanup_groups(TALLOC_CTX *memctx,
-                          struct sysdb_ctx *sysdb,
-                          struct sss_domain_info *domain)
+static int cleanup_groups_search(TALLOC_CTX *memctx,
+                                 struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *domain,
+                                 const char **_filter,
+                                 struct ldb_message ***_msgs, size_t *_count)
 {
     TALLOC_CTX *tmpctx;
     const char *attrs[] = { SYSDB_NAME, SYSDB_GIDNUM, NULL };
     time_t now = time(NULL);
     char *subfilter;
-    const char *dn;
-    gid_t gid;
     struct ldb_message **msgs;
     size_t count;
-    struct ldb_message **u_msgs;
-    size_t u_count;
     int ret;
-    int i;
-    const char *posix;
-    struct ldb_dn *base_dn;
 
     tmpctx = talloc_new(memctx);
     if (!tmpctx) {
@@ -416,80 +643,101 @@ static int cleanup_groups(TALLOC_CTX *memctx,
 
     ret = sysdb_search_groups(tmpctx, sysdb, domain,
                               subfilter, attrs, &count, &msgs);
-    if (ret) {
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
+    if (ret == ENOENT) {
+        msgs = NULL;
+        count = 0;
+        ret = EOK;
+    } else if (ret) {
         goto done;
     }
 
     DEBUG(4, ("Found %d expired group entries!\n", count));
 
-    if (count == 0) {
-        ret = EOK;
+    *_filter = talloc_steal(memctx, subfilter);
+    *_msgs = talloc_steal(memctx, msgs);
+    *_count = count;
+    ret = EOK;
+
+done:
+    talloc_zfree(tmpctx);
+    return ret;
+}
+
+static int cleanup_group(TALLOC_CTX *memctx,
+                         struct sysdb_ctx *sysdb,
+                         struct sss_domain_info *domain,
+                         struct ldb_message *msg)
+{
+    TALLOC_CTX *tmpctx;
+    char *subfilter;
+    const char *dn;
+    gid_t gid;
+    struct ldb_message **u_msgs;
+    size_t u_count;
+    int ret;
+    const char *posix;
+    struct ldb_dn *base_dn;
+
+    tmpctx = talloc_new(memctx);
+    if (!tmpctx) {
+        return ENOMEM;
+    }
+
+    dn = ldb_dn_get_linearized(msg->dn);
+    if (!dn) {
+        ret = EFAULT;
         goto done;
     }
 
-    for (i = 0; i < count; i++) {
-        dn = ldb_dn_get_linearized(msgs[i]->dn);
-        if (!dn) {
-            ret = EFAULT;
-            goto done;
-        }
+    posix = ldb_msg_find_attr_as_string(msg, SYSDB_POSIX, NULL);
+    if (!posix || strcmp(posix, "TRUE") == 0) {
+        /* Search for users that are members of this group, or
+         * that have this group as their primary GID.
+         * Include subdomain users as well.
+         */
+        gid = (gid_t) ldb_msg_find_attr_as_uint(msg, SYSDB_GIDNUM, 0);
+        subfilter = talloc_asprintf(tmpctx, "(&(%s=%s)(|(%s=%s)(%s=%lu)))",
+                                    SYSDB_OBJECTCLASS, SYSDB_USER_CLASS,
+                                    SYSDB_MEMBEROF, dn,
+                                    SYSDB_GIDNUM, (long unsigned) gid);
+    } else {
+        subfilter = talloc_asprintf(tmpctx, "(%s=%s)", SYSDB_MEMBEROF, dn);
+    }
+    if (!subfilter) {
+        DEBUG(2, ("Failed to build filter\n"));
+        ret = ENOMEM;
+        goto done;
+    }
 
-        posix = ldb_msg_find_attr_as_string(msgs[i], SYSDB_POSIX, NULL);
-        if (!posix || strcmp(posix, "TRUE") == 0) {
-            /* Search for users that are members of this group, or
-             * that have this group as their primary GID.
-             * Include subdomain users as well.
-             */
-            gid = (gid_t) ldb_msg_find_attr_as_uint(msgs[i], SYSDB_GIDNUM, 0);
-            subfilter = talloc_asprintf(tmpctx, "(&(%s=%s)(|(%s=%s)(%s=%lu)))",
-                                        SYSDB_OBJECTCLASS, SYSDB_USER_CLASS,
-                                        SYSDB_MEMBEROF, dn,
-                                        SYSDB_GIDNUM, (long unsigned) gid);
-        } else {
-            subfilter = talloc_asprintf(tmpctx, "(%s=%s)", SYSDB_MEMBEROF, dn);
-        }
-        if (!subfilter) {
-            DEBUG(2, ("Failed to build filter\n"));
-            ret = ENOMEM;
-            goto done;
-        }
+    base_dn = sysdb_base_dn(sysdb, tmpctx);
+    if (base_dn == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to build base dn\n"));
+        ret = ENOMEM;
+        goto done;
+    }
 
-        base_dn = sysdb_base_dn(sysdb, tmpctx);
-        if (base_dn == NULL) {
-            DEBUG(SSSDBG_OP_FAILURE, ("Failed to build base dn\n"));
-            ret = ENOMEM;
+    ret = sysdb_search_entry(tmpctx, sysdb, base_dn,
+                             LDB_SCOPE_SUBTREE, subfilter, NULL,
+                             &u_count, &u_msgs);
+    if (ret == ENOENT) {
+        const char *name;
+
+        name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+        if (!name) {
+            DEBUG(2, ("Entry %s has no Name Attribute ?!?\n",
+                      ldb_dn_get_linearized(msg->dn)));
+            ret = EFAULT;
             goto done;
         }
 
-        ret = sysdb_search_entry(tmpctx, sysdb, base_dn,
-                                 LDB_SCOPE_SUBTREE, subfilter, NULL,
-                                 &u_count, &u_msgs);
-        if (ret == ENOENT) {
-            const char *name;
-
-            name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
-            if (!name) {
-                DEBUG(2, ("Entry %s has no Name Attribute ?!?\n",
-                          ldb_dn_get_linearized(msgs[i]->dn)));
-                ret = EFAULT;
-                goto done;
-            }
-
-            DEBUG(8, ("About to delete group %s\n", name));
-            ret = sysdb_delete_group(sysdb, domain, name, 0);
-            if (ret) {
-                DEBUG(2, ("Group delete returned %d (%s)\n",
-                          ret, strerror(ret)));
-                goto done;
-            }
-        }
-        if (ret != EOK) {
+        DEBUG(8, ("About to delete group %s\n", name));
+        ret = sysdb_delete_group(sysdb, domain, name, 0);
+        if (ret) {
+            DEBUG(2, ("Group delete returned %d (%s)\n",
+                      ret, strerror(ret)));
             goto done;
         }
-        talloc_zfree(u_msgs);
+        sss_stats_inc("ldap_cleanup_group");
     }
 
 done:
@@ -33,7 +33,8 @@
 
 extern struct tevent_req *ldap_id_cleanup_send(TALLOC_CTX *memctx,
                                                struct tevent_context *ev,
-                                               struct sdap_id_ctx *ctx);
+                                               struct sdap_id_ctx *ctx,
+                                               enum be_sched_class cls);
 
 /* ==Enumeration-Task===================================================== */
 
@@ -177,12 +178,19 @@ int ldap_id_enumerate_set_timer(struct sdap_id_ctx *ctx, struct timeval tv)
 
 #define MAX_ENUM_RESTARTS 3
 
+enum global_enum_step {
+    GLOBAL_ENUM_USERS,
+    GLOBAL_ENUM_GROUPS,
+    GLOBAL_ENUM_SERVICES
+};
+
 struct global_enum_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *ctx;
     struct sdap_id_op *op;
 
     bool purge;
+    enum global_enum_step next;
 };
 
 static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
@@ -199,6 +207,9 @@ static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
 static void ldap_id_enum_groups_done(struct tevent_req *subreq);
 static void ldap_id_enum_services_done(struct tevent_req *subreq);
 static void ldap_id_enum_cleanup_done(struct tevent_req *subreq);
+static void ldap_id_enum_step(struct tevent_req *req,
+                              enum global_enum_step next);
+static void ldap_id_enum_step_done(struct tevent_req *subreq);
 
 struct tevent_req *ldap_id_enumerate_send(struct tevent_context *ev,
                                           struct sdap_id_ctx *ctx)
@@ -219,6 +230,9 @@ struct tevent_req *ldap_id_enumerate_send(struct tevent_context *ev,
         return NULL;
     }
 
+    /* the user and group lookups go first while this runs */
+    be_sched_hold(state, ctx->be, BE_SCHED_ENUMERATION);
+
     ctx->last_enum = tevent_timeval_current();
 
     t = dp_opt_get_int(ctx->opts->basic, SDAP_CACHE_PURGE_TIMEOUT);
@@ -258,8 +272,6 @@ static void ldap_id_enumerate_connect_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
                                                       struct tevent_req);
-    struct global_enum_state *state = tevent_req_data(req,
-                                                 struct global_enum_state);
     int ret, dp_error;
 
     ret = sdap_id_op_connect_recv(subreq, &dp_error);
@@ -276,15 +288,66 @@ static void ldap_id_enumerate_connect_done(struct tevent_req *subreq)
         return;
     }
 
-    subreq = enum_users_send(state, state->ev,
-                             state->ctx, state->op,
-                             state->purge);
-    if(!subreq) {
+    ldap_id_enum_step(req, GLOBAL_ENUM_USERS);
+}
+
+/* Each of the users, groups and services steps saves a whole tree to the
+ * cache, let the pending requests in before starting the next one */
+static void ldap_id_enum_step(struct tevent_req *req,
+                              enum global_enum_step next)
+{
+    struct global_enum_state *state = tevent_req_data(req,
+                                                 struct global_enum_state);
+    struct tevent_req *subreq;
+
+    state->next = next;
+
+    subreq = be_sched_yield_send(state, state->ctx->be, BE_SCHED_ENUMERATION);
+    if (!subreq) {
         tevent_req_error(req, ENOMEM);
         return;
     }
+    tevent_req_set_callback(subreq, ldap_id_enum_step_done, req);
+}
 
-    tevent_req_set_callback(subreq, ldap_id_enum_users_done, req);
+static void ldap_id_enum_step_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct global_enum_state *state = tevent_req_data(req,
+                                                 struct global_enum_state);
+    errno_t ret;
+
+    ret = be_sched_yield_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    switch (state->next) {
+    case GLOBAL_ENUM_USERS:
+        subreq = enum_users_send(state, state->ev,
+                                 state->ctx, state->op,
+                                 state->purge);
+        if (!subreq) break;
+        tevent_req_set_callback(subreq, ldap_id_enum_users_done, req);
+        return;
+    case GLOBAL_ENUM_GROUPS:
+        subreq = enum_groups_send(state, state->ev, state->ctx,
+                                  state->op, state->purge);
+        if (!subreq) break;
+        tevent_req_set_callback(subreq, ldap_id_enum_groups_done, req);
+        return;
+    case GLOBAL_ENUM_SERVICES:
+        subreq = enum_services_send(state, state->ev, state->ctx,
+                                    state->op, state->purge);
+        if (!subreq) break;
+        tevent_req_set_callback(subreq, ldap_id_enum_services_done, req);
+        return;
+    }
+
+    tevent_req_error(req, ENOMEM);
 }
 
 static void ldap_id_enum_users_done(struct tevent_req *subreq)
@@ -332,12 +395,7 @@ static void ldap_id_enum_users_done(struct tevent_req *subreq)
         return;
     }
 
-    subreq = enum_groups_send(state, state->ev, state->ctx, state->op, state->purge);
-    if (!subreq) {
-        tevent_req_error(req, ENOMEM);
-        return;
-    }
-    tevent_req_set_callback(subreq, ldap_id_enum_groups_done, req);
+    ldap_id_enum_step(req, GLOBAL_ENUM_GROUPS);
 }
 
 static void ldap_id_enum_groups_done(struct tevent_req *subreq)
@@ -388,13 +446,7 @@ static void ldap_id_enum_groups_done(struct tevent_req *subreq)
         }
     }
 
-    subreq = enum_services_send(state, state->ev, state->ctx,
-                                state->op, state->purge);
-    if (!subreq) {
-        tevent_req_error(req, ENOMEM);
-        return;
-    }
-    tevent_req_set_callback(subreq, ldap_id_enum_services_done, req);
+    ldap_id_enum_step(req, GLOBAL_ENUM_SERVICES);
 }
 
 static void ldap_id_enum_services_done(struct tevent_req *subreq)
@@ -439,7 +491,9 @@ static void ldap_id_enum_services_done(struct tevent_req *subreq)
 
     if (state->purge) {
 
-        subreq = ldap_id_cleanup_send(state, state->ev, state->ctx);
+        /* runs as a part of the enumeration, which holds its class */
+        subreq = ldap_id_cleanup_send(state, state->ev, state->ctx,
+                                      BE_SCHED_ENUMERATION);
         if (!subreq) {
             tevent_req_error(req, ENOMEM);
             return;
@@ -598,7 +652,7 @@ static void enum_users_op_done(struct tevent_req *subreq)
     unsigned usn_number;
     int ret;
 
-    ret = sdap_get_users_recv(subreq, state, &usn_value);
+    ret = sdap_get_users_recv(subreq, state, &usn_value, NULL, NULL);
     talloc_zfree(subreq);
     if (ret) {
         tevent_req_error(req, ret);
@@ -114,6 +114,10 @@ struct dp_option default_basic_opts[] = {
     { "ldap_initgroups_use_matching_rule_in_chain", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_rfc2307_fallback_to_local_users", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_disable_range_retrieval", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_connection_warmup_time", DP_OPT_NUMBER, { .number = 30 }, NULL_NUMBER },
+    { "ldap_op_trace", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_op_slow_threshold", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_cache_chunk_time", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
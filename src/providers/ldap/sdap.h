@@ -38,6 +38,15 @@ typedef void (sdap_op_callback_t)(struct sdap_op *op,
 
 struct sdap_handle;
 
+/* What an operation asked for and got back, kept for tracing */
+struct sdap_op_trace {
+    const char *base;
+    const char *filter;
+    int scope;
+    uint64_t entries;
+    uint64_t bytes;
+};
+
 struct sdap_op {
     struct sdap_op *prev, *next;
     struct sdap_handle *sh;
@@ -51,6 +60,9 @@ struct sdap_op {
     struct tevent_context *ev;
     struct sdap_msg *list;
     struct sdap_msg *last;
+
+    struct timeval start;
+    struct sdap_op_trace trace;
 };
 
 struct fd_event_item {
@@ -218,6 +230,10 @@ enum sdap_basic_opt {
     SDAP_AD_MATCHING_RULE_INITGROUPS,
     SDAP_RFC2307_FALLBACK_TO_LOCAL_USERS,
     SDAP_DISABLE_RANGE_RETRIEVAL,
+    SDAP_EXPIRE_WARMUP,
+    SDAP_OP_TRACE,
+    SDAP_OP_SLOW_THRESHOLD,
+    SDAP_CACHE_CHUNK_TIME,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -366,6 +382,19 @@ enum dc_functional_level {
     DS_BEHAVIOR_WIN2012 = 5
 };
 
+/* Credentials used for the GSSAPI bind, shared by all connections that
+ * use the same sdap_options. ccname points to an in-memory ccache that
+ * also keeps the LDAP service tickets between reconnects. */
+struct sdap_kinit_cache {
+    char *ccname;
+    time_t expire_time;
+
+    /* number of TGTs requested through ldap_child */
+    uint64_t kinit_count;
+    /* number of connections that reused the cached credentials */
+    uint64_t reuse_count;
+};
+
 struct sdap_options {
     struct dp_option *basic;
     struct sdap_attr_map *gen_map;
@@ -400,6 +429,8 @@ struct sdap_options {
 
     bool support_matching_rule;
     enum dc_functional_level dc_functional_level;
+
+    struct sdap_kinit_cache *kinit_cache;
 };
 
 struct sdap_server_opts {
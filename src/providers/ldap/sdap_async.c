@@ -21,6 +21,7 @@
 
 #include <ctype.h>
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "providers/ldap/sdap_async_private.h"
 
 #define REALM_SEPARATOR '@'
@@ -310,6 +311,7 @@ static void sdap_process_message(struct tevent_context *ev,
     switch (msgtype) {
     case LDAP_RES_SEARCH_ENTRY:
         /* go and process entry */
+        sdap_trace_entry(op, msg);
         break;
 
     case LDAP_RES_SEARCH_REFERENCE:
@@ -329,6 +331,8 @@ static void sdap_process_message(struct tevent_context *ev,
     case LDAP_RES_INTERMEDIATE:
         /* no more results expected with this msgid */
         op->done = true;
+        sss_stats_time(SSS_STATS_LDAP_OP, &op->start, false);
+        sdap_trace_done(op, msgtype, false);
         break;
 
     default:
@@ -438,6 +442,9 @@ static void sdap_op_timeout(struct tevent_req *req)
         return;
     }
 
+    sss_stats_time(SSS_STATS_LDAP_OP, &op->start, true);
+    sdap_trace_done(op, 0, true);
+
     /* signal the caller that we have a timeout */
     op->callback(op, NULL, ETIMEDOUT, op->data);
 }
@@ -457,6 +464,7 @@ int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
     op->callback = callback;
     op->data = data;
     op->ev = ev;
+    sss_stats_start(&op->start);
 
     /* check if we need to set a timeout */
     if (timeout) {
@@ -1309,6 +1317,9 @@ static errno_t sdap_get_generic_ext_step(struct tevent_req *req)
         goto done;
     }
 
+    sdap_trace_search(state->op, state->search_base, state->scope,
+                      state->filter);
+
 done:
     return ret;
 }
@@ -69,8 +69,11 @@ struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
                                        const char *filter,
                                        int timeout,
                                        bool enumeration);
+/* The users as returned by the server can be requested with _count and
+ * _users, pass NULL if they are not needed. */
 int sdap_get_users_recv(struct tevent_req *req,
-                        TALLOC_CTX *mem_ctx, char **timestamp);
+                        TALLOC_CTX *mem_ctx, char **timestamp,
+                        size_t *_count, struct sysdb_attrs ***_users);
 
 struct tevent_req *sdap_get_groups_send(TALLOC_CTX *memctx,
                                        struct tevent_context *ev,
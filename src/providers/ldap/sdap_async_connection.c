@@ -1050,6 +1050,7 @@ struct sdap_kinit_state {
     struct be_ctx *be;
 
     struct fo_server *kdc_srv;
+    char *ccname;
     time_t expire_time;
 };
 
@@ -1220,6 +1221,7 @@ static void sdap_kinit_done(struct tevent_req *subreq)
             tevent_req_error(req, ERR_AUTH_FAILED);
         }
 
+        state->ccname = ccname;
         state->expire_time = expire_time;
         tevent_req_done(req);
         return;
@@ -1241,6 +1243,8 @@ static void sdap_kinit_done(struct tevent_req *subreq)
 }
 
 static errno_t sdap_kinit_recv(struct tevent_req *req,
+                               TALLOC_CTX *mem_ctx,
+                               char **ccname,
                                time_t *expire_time)
 {
     struct sdap_kinit_state *state = tevent_req_data(req,
@@ -1254,6 +1258,7 @@ static errno_t sdap_kinit_recv(struct tevent_req *req,
         }
     }
 
+    *ccname = talloc_steal(mem_ctx, state->ccname);
     *expire_time = state->expire_time;
     return EOK;
 }
@@ -1393,13 +1398,33 @@ struct sdap_cli_connect_state {
     struct sdap_handle *sh;
 
     struct fo_server *srv;
+    struct timeval op_start;
 
     struct sdap_server_opts *srv_opts;
 
     enum connect_tls force_tls;
     bool do_auth;
+    bool kinit_reused;
 };
 
+/* Feed the time since op_start to the fail over latency statistics
+ * of the current server */
+static void sdap_cli_add_latency(struct sdap_cli_connect_state *state,
+                                 enum fo_latency_type type)
+{
+    struct timeval now;
+    struct timeval diff;
+
+    if (state->srv == NULL) {
+        return;
+    }
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(&state->op_start, &now);
+    fo_add_server_latency(state->srv, type,
+                          diff.tv_sec * 1000 + diff.tv_usec / 1000);
+}
+
 static int sdap_cli_resolve_next(struct tevent_req *req);
 static void sdap_cli_resolve_done(struct tevent_req *subreq);
 static void sdap_cli_connect_done(struct tevent_req *subreq);
@@ -1575,6 +1600,7 @@ static void sdap_cli_rootdse_step(struct tevent_req *req)
     struct tevent_req *subreq;
     int ret;
 
+    state->op_start = tevent_timeval_current();
     subreq = sdap_get_rootdse_send(state, state->ev, state->opts, state->sh);
     if (!subreq) {
         tevent_req_error(req, ENOMEM);
@@ -1623,6 +1649,8 @@ static void sdap_cli_rootdse_done(struct tevent_req *subreq)
          * work properly.
          */
         state->rootdse = NULL;
+    } else {
+        sdap_cli_add_latency(state, FO_LATENCY_SEARCH);
     }
 
 
@@ -1688,6 +1716,114 @@ static errno_t sdap_cli_use_rootdse(struct sdap_cli_connect_state *state)
     return EOK;
 }
 
+static const char *sdap_cli_kinit_realm(struct sdap_options *opts)
+{
+    const char *realm;
+
+    realm = dp_opt_get_string(opts->basic, SDAP_SASL_REALM);
+    if (!realm) {
+        realm = dp_opt_get_string(opts->basic, SDAP_KRB5_REALM);
+    }
+
+    return realm;
+}
+
+/* Point the GSSAPI mechanism at the cached credentials if the TGT is
+ * still valid long enough to be worth it. The service ticket for the
+ * LDAP server stays in the same ccache, so the bind doesn't need to talk
+ * to the KDC at all. */
+static bool sdap_cli_kinit_reuse(struct sdap_cli_connect_state *state)
+{
+    struct sdap_kinit_cache *cache = state->opts->kinit_cache;
+    time_t now;
+    int ret;
+
+    if (cache == NULL || cache->ccname == NULL) {
+        return false;
+    }
+
+    now = time(NULL);
+    if (cache->expire_time <= now + dp_opt_get_int(state->opts->basic,
+                                                   SDAP_OPT_TIMEOUT)) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Cached TGT in [%s] has expired\n",
+                                  cache->ccname));
+        return false;
+    }
+
+    ret = setenv("KRB5CCNAME", cache->ccname, 1);
+    if (ret == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to set env. variable KRB5CCNAME!\n"));
+        return false;
+    }
+
+    cache->reuse_count++;
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Reusing credentials in [%s], valid until [%ld] "
+           "(%llu TGT requests, %llu reuses)\n",
+           cache->ccname, (long) cache->expire_time,
+           (unsigned long long) cache->kinit_count,
+           (unsigned long long) cache->reuse_count));
+
+    state->sh->expire_time = cache->expire_time;
+    return true;
+}
+
+/* Copy the TGT written by ldap_child into the in-memory ccache of this
+ * back end. On failure the file ccache is used directly, like before. */
+static void sdap_cli_kinit_cache_update(struct sdap_cli_connect_state *state,
+                                        const char *ccname,
+                                        time_t expire_time)
+{
+    struct sdap_kinit_cache *cache;
+    const char *realm;
+    errno_t ret;
+
+    if (state->opts->kinit_cache == NULL) {
+        state->opts->kinit_cache = talloc_zero(state->opts,
+                                               struct sdap_kinit_cache);
+        if (state->opts->kinit_cache == NULL) {
+            return;
+        }
+    }
+    cache = state->opts->kinit_cache;
+
+    cache->kinit_count++;
+    cache->expire_time = 0;
+
+    if (cache->ccname == NULL) {
+        /* without a configured realm ldap_child used the default one */
+        realm = sdap_cli_kinit_realm(state->opts);
+        cache->ccname = talloc_asprintf(cache, "MEMORY:sssd_ldap_%s",
+                                        realm ? realm : "default");
+        if (cache->ccname == NULL) {
+            return;
+        }
+    }
+
+    ret = sss_krb5_copy_ccache(ccname, cache->ccname);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot copy [%s] to [%s], credentials will not be reused\n",
+               ccname, cache->ccname));
+        return;
+    }
+
+    ret = setenv("KRB5CCNAME", cache->ccname, 1);
+    if (ret == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to set env. variable KRB5CCNAME!\n"));
+        /* KRB5CCNAME still points to the file ccache */
+        return;
+    }
+
+    cache->expire_time = expire_time;
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Credentials cached in [%s] until [%ld] "
+           "(%llu TGT requests, %llu reuses)\n",
+           cache->ccname, (long) cache->expire_time,
+           (unsigned long long) cache->kinit_count,
+           (unsigned long long) cache->reuse_count));
+}
+
 static void sdap_cli_kinit_step(struct tevent_req *req)
 {
     struct sdap_cli_connect_state *state = tevent_req_data(req,
@@ -1695,10 +1831,14 @@ static void sdap_cli_kinit_step(struct tevent_req *req)
     struct tevent_req *subreq;
     const char *realm;
 
-    realm = dp_opt_get_string(state->opts->basic, SDAP_SASL_REALM);
-    if (!realm) {
-        realm = dp_opt_get_string(state->opts->basic, SDAP_KRB5_REALM);
+    if (!state->kinit_reused && sdap_cli_kinit_reuse(state)) {
+        state->kinit_reused = true;
+        sdap_cli_auth_step(req);
+        return;
     }
+    state->kinit_reused = false;
+
+    realm = sdap_cli_kinit_realm(state->opts);
 
     subreq = sdap_kinit_send(state, state->ev,
                              state->be,
@@ -1728,10 +1868,11 @@ static void sdap_cli_kinit_done(struct tevent_req *subreq)
                                                       struct tevent_req);
     struct sdap_cli_connect_state *state = tevent_req_data(req,
                                              struct sdap_cli_connect_state);
+    char *ccname = NULL;
     time_t expire_time = 0;
     errno_t ret;
 
-    ret = sdap_kinit_recv(subreq, &expire_time);
+    ret = sdap_kinit_recv(subreq, state, &ccname, &expire_time);
     talloc_zfree(subreq);
     if (ret != EOK) {
         /* We're not able to authenticate to the LDAP server.
@@ -1743,6 +1884,9 @@ static void sdap_cli_kinit_done(struct tevent_req *subreq)
     }
     state->sh->expire_time = expire_time;
 
+    sdap_cli_kinit_cache_update(state, ccname, expire_time);
+    talloc_free(ccname);
+
     sdap_cli_auth_step(req);
 }
 
@@ -1833,6 +1977,16 @@ static void sdap_cli_auth_done(struct tevent_req *subreq)
 
     ret = sdap_auth_recv(subreq, NULL, NULL);
     talloc_zfree(subreq);
+    if (ret && state->kinit_reused) {
+        /* The cached credentials were not good enough, perhaps the
+         * keytab changed. Get a fresh TGT and try once more. */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Bind with cached credentials failed, requesting new TGT\n"));
+        state->opts->kinit_cache->expire_time = 0;
+        state->sh->expire_time = 0;
+        sdap_cli_kinit_step(req);
+        return;
+    }
     if (ret) {
         tevent_req_error(req, ret);
         return;
@@ -62,6 +62,13 @@ int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
                 sdap_op_callback_t *callback, void *data,
                 int timeout, struct sdap_op **_op);
 
+/* from sdap_trace.c */
+char *sdap_filter_shape(TALLOC_CTX *mem_ctx, const char *filter);
+void sdap_trace_search(struct sdap_op *op, const char *base, int scope,
+                       const char *filter);
+void sdap_trace_entry(struct sdap_op *op, LDAPMessage *msg);
+void sdap_trace_done(struct sdap_op *op, int msgtype, bool timed_out);
+
 struct tevent_req *sdap_get_rootdse_send(TALLOC_CTX *memctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
@@ -49,6 +49,8 @@ struct sdap_sudo_refresh_state {
     int error;
     char *highest_usn;
     size_t num_rules;
+
+    struct timeval search_start;
 };
 
 struct sdap_sudo_load_sudoers_state {
@@ -86,23 +88,6 @@ static int sdap_sudo_load_sudoers_recv(struct tevent_req *req,
 
 static void sdap_sudo_refresh_load_done(struct tevent_req *subreq);
 
-static int sdap_sudo_purge_sudoers(struct sysdb_ctx *sysdb_ctx,
-                                   struct sss_domain_info *dom,
-                                   const char *filter,
-                                   struct sdap_attr_map *map,
-                                   size_t rules_count,
-                                   struct sysdb_attrs **rules);
-
-static int sdap_sudo_store_sudoers(TALLOC_CTX *mem_ctx,
-                                   struct sysdb_ctx *sysdb_ctx,
-                                   struct sss_domain_info *domain,
-                                   struct sdap_options *opts,
-                                   size_t rules_count,
-                                   struct sysdb_attrs **rules,
-                                   int cache_timeout,
-                                   time_t now,
-                                   char **_usn);
-
 struct tevent_req *sdap_sudo_refresh_send(TALLOC_CTX *mem_ctx,
                                           struct be_ctx *be_ctx,
                                           struct sdap_options *opts,
@@ -257,6 +242,7 @@ static void sdap_sudo_refresh_connect_done(struct tevent_req *subreq)
 
     DEBUG(SSSDBG_TRACE_FUNC, ("SUDO LDAP connection successful\n"));
 
+    state->search_start = tevent_timeval_current();
     subreq = sdap_sudo_load_sudoers_send(state, state->be_ctx->ev,
                                          state->opts,
                                          sdap_id_op_handle(state->sdap_op),
@@ -461,12 +447,12 @@ static void sdap_sudo_refresh_load_done(struct tevent_req *subreq)
 {
     struct tevent_req *req; /* req from sdap_sudo_refresh_send() */
     struct sdap_sudo_refresh_state *state;
+    struct sdap_sudo_sync_stats stats;
     struct sysdb_attrs **rules = NULL;
     size_t rules_count = 0;
+    struct timeval now_tv;
+    struct timeval diff;
     int ret;
-    errno_t sret;
-    bool in_transaction = false;
-    time_t now;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_sudo_refresh_state);
@@ -477,54 +463,41 @@ static void sdap_sudo_refresh_load_done(struct tevent_req *subreq)
         goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, ("Received %d rules\n", rules_count));
-
-    /* start transaction */
-    ret = sysdb_transaction_start(state->sysdb);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start transaction\n"));
-        goto done;
-    }
-    in_transaction = true;
-
-    /* purge cache */
-    ret = sdap_sudo_purge_sudoers(state->sysdb, state->domain, state->sysdb_filter,
-                                  state->opts->sudorule_map, rules_count, rules);
-    if (ret != EOK) {
-        goto done;
-    }
+    now_tv = tevent_timeval_current();
+    diff = tevent_timeval_until(&state->search_start, &now_tv);
 
-    /* store rules */
-    now = time(NULL);
-    ret = sdap_sudo_store_sudoers(state, state->sysdb, state->domain,
-                                  state->opts, rules_count, rules,
-                                  state->domain->sudo_timeout, now,
-                                  &state->highest_usn);
-    if (ret != EOK) {
-        goto done;
-    }
+    DEBUG(SSSDBG_TRACE_FUNC, ("Received %d rules\n", rules_count));
 
-    /* commit transaction */
-    ret = sysdb_transaction_commit(state->sysdb);
+    /* only the rules that differ from the cached copies are written */
+    ret = sdap_sudo_sync_rules(state, state->sysdb, state->domain,
+                               state->opts->sudorule_map, state->sysdb_filter,
+                               rules, rules_count, state->domain->sudo_timeout,
+                               time(NULL), &state->highest_usn, &stats);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to commit transaction\n"));
+        DEBUG(SSSDBG_OP_FAILURE, ("failed to save sudo rules [%d]: %s\n",
+              ret, strerror(ret)));
         goto done;
     }
-    in_transaction = false;
 
     DEBUG(SSSDBG_TRACE_FUNC, ("Sudoers is successfuly stored in cache\n"));
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Sudo refresh: %zu added, %zu modified, %zu unchanged, "
+           "%zu deleted; search %ld ms, cache read %u ms, "
+           "cache write %u ms\n",
+           stats.added, stats.modified, stats.unchanged, stats.deleted,
+           (long) (diff.tv_sec * 1000 + diff.tv_usec / 1000),
+           stats.read_ms, stats.write_ms));
+
+    /* The notification travels on the same connection as the reply to the
+     * responder's request, so its rule index is dropped before it reads
+     * the cache again. Unchanged rules got a new expiration time, so it
+     * is sent after every successful refresh. */
+    be_sudo_rules_changed(state->be_ctx);
 
     ret = EOK;
     state->num_rules = rules_count;
 
 done:
-    if (in_transaction) {
-        sret = sysdb_transaction_cancel(state->sysdb);
-        if (sret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE, ("Could not cancel transaction\n"));
-        }
-    }
-
     state->error = ret;
     if (ret == EOK) {
         state->dp_error = DP_ERR_OK;
@@ -534,87 +507,3 @@ done:
         tevent_req_error(req, ret);
     }
 }
-
-static int sdap_sudo_purge_sudoers(struct sysdb_ctx *sysdb_ctx,
-                                   struct sss_domain_info *dom,
-                                   const char *filter,
-                                   struct sdap_attr_map *map,
-                                   size_t rules_count,
-                                   struct sysdb_attrs **rules)
-{
-    const char *name;
-    int i;
-    errno_t ret;
-
-    if (filter == NULL) {
-        /* removes downloaded rules from the cache */
-        if (rules_count == 0 || rules == NULL) {
-            return EOK;
-        }
-
-        for (i = 0; i < rules_count; i++) {
-            ret = sysdb_attrs_get_string(rules[i],
-                                         map[SDAP_AT_SUDO_NAME].sys_name,
-                                         &name);
-            if (ret != EOK) {
-                DEBUG(SSSDBG_MINOR_FAILURE,
-                      ("Failed to retrieve rule name: [%s]\n", strerror(ret)));
-                continue;
-            }
-
-            ret = sysdb_sudo_purge_byname(sysdb_ctx, dom, name);
-            if (ret != EOK) {
-                DEBUG(SSSDBG_MINOR_FAILURE,
-                      ("Failed to delete rule %s: [%s]\n",
-                       name, strerror(ret)));
-                continue;
-            }
-        }
-
-        ret = EOK;
-    } else {
-        /* purge cache by provided filter */
-        ret = sysdb_sudo_purge_byfilter(sysdb_ctx, dom, filter);
-        if (ret != EOK) {
-            goto done;
-        }
-    }
-
-done:
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("failed to purge sudo rules [%d]: %s\n",
-                                  ret, strerror(ret)));
-    }
-
-    return ret;
-}
-
-static int sdap_sudo_store_sudoers(TALLOC_CTX *mem_ctx,
-                                   struct sysdb_ctx *sysdb_ctx,
-                                   struct sss_domain_info *domain,
-                                   struct sdap_options *opts,
-                                   size_t rules_count,
-                                   struct sysdb_attrs **rules,
-                                   int cache_timeout,
-                                   time_t now,
-                                   char **_usn)
-{
-    errno_t ret;
-
-    /* Empty sudoers? Done. */
-    if (rules_count == 0 || rules == NULL) {
-        return EOK;
-    }
-
-    ret = sdap_save_native_sudorule_list(mem_ctx, sysdb_ctx, domain,
-                                         opts->sudorule_map, rules,
-                                         rules_count, cache_timeout, now,
-                                         _usn);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("failed to save sudo rules [%d]: %s\n",
-              ret, strerror(ret)));
-        return ret;
-    }
-
-    return EOK;
-}
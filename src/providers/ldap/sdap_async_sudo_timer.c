@@ -24,6 +24,7 @@
 
 #include "util/util.h"
 #include "providers/ldap/sdap.h"
+#include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_id_op.h"
 #include "providers/ldap/sdap_sudo.h"
 
@@ -42,6 +43,8 @@ static void sdap_sudo_timer(struct tevent_context *ev,
                             struct tevent_timer *tt,
                             struct timeval tv, void *pvt);
 
+static void sdap_sudo_timer_yield_done(struct tevent_req *subreq);
+
 static void sdap_sudo_timer_done(struct tevent_req *subreq);
 
 static void sdap_sudo_timer_timeout(struct tevent_context *ev,
@@ -113,10 +116,40 @@ static void sdap_sudo_timer(struct tevent_context *ev,
 {
     struct tevent_req *req = NULL;
     struct sdap_sudo_timer_state *state = NULL;
+    struct tevent_req *subreq = NULL;
 
     req = talloc_get_type(pvt, struct tevent_req);
     state = tevent_req_data(req, struct sdap_sudo_timer_state);
 
+    /* let the pending lookups of the users go first */
+    subreq = be_sched_yield_send(state, state->sudo_ctx->id_ctx->be,
+                                 BE_SCHED_REFRESH);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to issue timed request!\n"));
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, sdap_sudo_timer_yield_done, req);
+}
+
+static void sdap_sudo_timer_yield_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    struct sdap_sudo_timer_state *state = NULL;
+    struct timeval tv;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_sudo_timer_state);
+
+    ret = be_sched_yield_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
     /* issue request */
     state->subreq = state->fn(state, state->sudo_ctx);
     if (state->subreq == NULL) {
@@ -127,6 +160,10 @@ static void sdap_sudo_timer(struct tevent_context *ev,
 
     tevent_req_set_callback(state->subreq, sdap_sudo_timer_done, req);
 
+    /* held until the caller receives the request or it times out */
+    be_sched_hold(state->subreq, state->sudo_ctx->id_ctx->be,
+                  BE_SCHED_REFRESH);
+
     /* schedule timeout */
     tv = tevent_timeval_current_ofs(state->timeout, 0);
     state->timer_timeout = tevent_add_timer(state->ev, state->subreq, tv,
@@ -22,6 +22,7 @@
 */
 
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "db/sysdb.h"
 #include "providers/ldap/sdap_async_private.h"
 #include "providers/ldap/ldap_common.h"
@@ -422,13 +423,36 @@ done:
 
 /* ==Generic-Function-to-save-multiple-users============================= */
 
-int sdap_save_users(TALLOC_CTX *memctx,
-                    struct sysdb_ctx *sysdb,
-                    struct sss_domain_info *dom,
-                    struct sdap_options *opts,
-                    struct sysdb_attrs **users,
-                    int num_users,
-                    char **_usn_value)
+/* pause between the parts of a large save, short enough not to matter
+ * but long enough for the event loop to look at the sockets */
+#define SDAP_SAVE_YIELD_USEC 1000
+
+/* USNs are decimal numbers without leading zeros, a longer one is higher
+ * and only those of the same length compare as strings */
+static bool sdap_usn_is_higher(const char *usn, const char *than)
+{
+    size_t len;
+    size_t than_len;
+
+    len = strlen(usn);
+    than_len = strlen(than);
+
+    return len > than_len || (len == than_len && strcmp(usn, than) > 0);
+}
+
+/* Saves the users starting at *_next in a single transaction. With a
+ * non-zero time budget it stops after the first user that ends past the
+ * budget, the caller continues later from the updated *_next. The highest
+ * USN seen so far is kept in *_higher_usn, allocated on memctx. */
+static int sdap_save_users_chunk(TALLOC_CTX *memctx,
+                                 struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *dom,
+                                 struct sdap_options *opts,
+                                 struct sysdb_attrs **users,
+                                 int num_users,
+                                 int budget_ms,
+                                 int *_next,
+                                 char **_higher_usn)
 {
     TALLOC_CTX *tmpctx;
     char *higher_usn = NULL;
@@ -437,18 +461,20 @@ int sdap_save_users(TALLOC_CTX *memctx,
     errno_t sret;
     int i;
     time_t now;
+    struct timeval start;
+    struct timeval end;
+    struct timeval tv;
     bool in_transaction = false;
 
-    if (num_users == 0) {
-        /* Nothing to do if there are no users */
-        return EOK;
-    }
-
     tmpctx = talloc_new(memctx);
     if (!tmpctx) {
         return ENOMEM;
     }
 
+    start = tevent_timeval_current();
+    end = tevent_timeval_add(&start, budget_ms / 1000,
+                             (budget_ms % 1000) * 1000);
+
     ret = sysdb_transaction_start(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start transaction\n"));
@@ -457,7 +483,7 @@ int sdap_save_users(TALLOC_CTX *memctx,
     in_transaction = true;
 
     now = time(NULL);
-    for (i = 0; i < num_users; i++) {
+    for (i = *_next; i < num_users; i++) {
         usn_value = NULL;
 
         ret = sdap_save_user(tmpctx, sysdb, opts, dom,
@@ -474,8 +500,7 @@ int sdap_save_users(TALLOC_CTX *memctx,
 
         if (usn_value) {
             if (higher_usn) {
-                if ((strlen(usn_value) > strlen(higher_usn)) ||
-                    (strcmp(usn_value, higher_usn) > 0)) {
+                if (sdap_usn_is_higher(usn_value, higher_usn)) {
                     talloc_zfree(higher_usn);
                     higher_usn = usn_value;
                 } else {
@@ -485,6 +510,14 @@ int sdap_save_users(TALLOC_CTX *memctx,
                 higher_usn = usn_value;
             }
         }
+
+        if (budget_ms > 0 && i + 1 < num_users) {
+            tv = tevent_timeval_current();
+            if (tevent_timeval_compare(&tv, &end) >= 0) {
+                i++;
+                break;
+            }
+        }
     }
 
     ret = sysdb_transaction_commit(sysdb);
@@ -494,8 +527,17 @@ int sdap_save_users(TALLOC_CTX *memctx,
     }
     in_transaction = false;
 
-    if (_usn_value) {
-        *_usn_value = talloc_steal(memctx, higher_usn);
+    sss_stats_time("ldap_save_users_chunk", &start, false);
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("Saved users %d to %d of %d\n",
+                                  *_next, i - 1, num_users));
+    *_next = i;
+
+    if (higher_usn) {
+        if (*_higher_usn == NULL
+                || sdap_usn_is_higher(higher_usn, *_higher_usn)) {
+            talloc_zfree(*_higher_usn);
+            *_higher_usn = talloc_steal(memctx, higher_usn);
+        }
     }
 
 done:
@@ -509,6 +551,38 @@ done:
     return ret;
 }
 
+int sdap_save_users(TALLOC_CTX *memctx,
+                    struct sysdb_ctx *sysdb,
+                    struct sss_domain_info *dom,
+                    struct sdap_options *opts,
+                    struct sysdb_attrs **users,
+                    int num_users,
+                    char **_usn_value)
+{
+    char *higher_usn = NULL;
+    int next = 0;
+    int ret;
+
+    if (num_users == 0) {
+        /* Nothing to do if there are no users */
+        return EOK;
+    }
+
+    ret = sdap_save_users_chunk(memctx, sysdb, dom, opts, users, num_users,
+                                0, &next, &higher_usn);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (_usn_value) {
+        *_usn_value = higher_usn;
+    } else {
+        talloc_free(higher_usn);
+    }
+
+    return EOK;
+}
+
 
 /* ==Search-Users-with-filter============================================= */
 
@@ -527,6 +601,7 @@ struct sdap_get_users_state {
     char *higher_usn;
     struct sysdb_attrs **users;
     size_t count;
+    int saved;
 
     size_t base_iter;
     struct sdap_search_base **search_bases;
@@ -534,6 +609,10 @@ struct sdap_get_users_state {
 
 static errno_t sdap_get_users_next_base(struct tevent_req *req);
 static void sdap_get_users_process(struct tevent_req *subreq);
+static void sdap_get_users_save(struct tevent_req *req);
+static void sdap_get_users_save_resume(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval tv, void *pvt);
 
 struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
                                        struct tevent_context *ev,
@@ -692,23 +771,61 @@ static void sdap_get_users_process(struct tevent_req *subreq)
         return;
     }
 
-    ret = sdap_save_users(state, state->sysdb,
-                          state->dom, state->opts,
-                          state->users, state->count,
-                          &state->higher_usn);
+    state->saved = 0;
+    sdap_get_users_save(req);
+}
+
+/* An enumeration can bring tens of thousands of users. They are saved
+ * in parts, between them the event loop serves the other requests and
+ * the responders can read the cache. */
+static void sdap_get_users_save(struct tevent_req *req)
+{
+    struct sdap_get_users_state *state = tevent_req_data(req,
+                                            struct sdap_get_users_state);
+    struct tevent_timer *te;
+    struct timeval tv;
+    int ret;
+
+    ret = sdap_save_users_chunk(state, state->sysdb,
+                                state->dom, state->opts,
+                                state->users, state->count,
+                                dp_opt_get_int(state->opts->basic,
+                                               SDAP_CACHE_CHUNK_TIME),
+                                &state->saved, &state->higher_usn);
     if (ret) {
         DEBUG(2, ("Failed to store users.\n"));
         tevent_req_error(req, ret);
         return;
     }
 
+    if ((size_t) state->saved < state->count) {
+        /* the loop polls the sockets only when no timer is due */
+        tv = tevent_timeval_current_ofs(0, SDAP_SAVE_YIELD_USEC);
+        te = tevent_add_timer(state->ev, state, tv,
+                              sdap_get_users_save_resume, req);
+        if (te == NULL) {
+            tevent_req_error(req, ENOMEM);
+        }
+        return;
+    }
+
     DEBUG(9, ("Saving %d Users - Done\n", state->count));
 
     tevent_req_done(req);
 }
 
+static void sdap_get_users_save_resume(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+
+    sdap_get_users_save(req);
+}
+
 int sdap_get_users_recv(struct tevent_req *req,
-                        TALLOC_CTX *mem_ctx, char **usn_value)
+                        TALLOC_CTX *mem_ctx, char **usn_value,
+                        size_t *_count, struct sysdb_attrs ***_users)
 {
     struct sdap_get_users_state *state = tevent_req_data(req,
                                             struct sdap_get_users_state);
@@ -719,6 +836,11 @@ int sdap_get_users_recv(struct tevent_req *req,
         *usn_value = talloc_steal(mem_ctx, state->higher_usn);
     }
 
+    if (_count && _users) {
+        *_count = state->count;
+        *_users = talloc_steal(mem_ctx, state->users);
+    }
+
     return EOK;
 }
 
@@ -101,33 +101,29 @@ static errno_t sdap_fork_child(struct tevent_context *ev,
         return err;
     }
 
-    pid = fork();
-
-    if (pid == 0) { /* child */
-        err = exec_child(child,
-                         pipefd_to_child, pipefd_from_child,
-                         LDAP_CHILD, ldap_child_debug_fd);
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Could not exec LDAP child: [%d][%s].\n",
+    err = spawn_child(child, pipefd_to_child, pipefd_from_child,
+                      LDAP_CHILD, ldap_child_debug_fd, NULL, 0, &pid);
+    if (err != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Could not spawn LDAP child: [%d][%s].\n",
                                     err, strerror(err)));
-        return err;
-    } else if (pid > 0) { /* parent */
-        child->pid = pid;
-        child->read_from_child_fd = pipefd_from_child[0];
+        close(pipefd_from_child[0]);
         close(pipefd_from_child[1]);
-        child->write_to_child_fd = pipefd_to_child[1];
         close(pipefd_to_child[0]);
-        fd_nonblocking(child->read_from_child_fd);
-        fd_nonblocking(child->write_to_child_fd);
+        close(pipefd_to_child[1]);
+        return err;
+    }
 
-        ret = child_handler_setup(ev, pid, NULL, NULL);
-        if (ret != EOK) {
-            return ret;
-        }
+    child->pid = pid;
+    child->read_from_child_fd = pipefd_from_child[0];
+    close(pipefd_from_child[1]);
+    child->write_to_child_fd = pipefd_to_child[1];
+    close(pipefd_to_child[0]);
+    fd_nonblocking(child->read_from_child_fd);
+    fd_nonblocking(child->write_to_child_fd);
 
-    } else { /* error */
-        err = errno;
-        DEBUG(1, ("fork failed [%d][%s].\n", err, strerror(err)));
-        return err;
+    ret = child_handler_setup(ev, pid, NULL, NULL);
+    if (ret != EOK) {
+        return ret;
     }
 
     return EOK;
@@ -34,6 +34,8 @@ struct sdap_id_conn_cache {
     struct sdap_id_conn_data *connections;
     /* cached (current) connection */
     struct sdap_id_conn_data *cached_connection;
+    /* replacement for the cached connection being established */
+    struct sdap_id_conn_data *warmup_connection;
 };
 
 /* LDAP async operation tracker:
@@ -68,6 +70,8 @@ struct sdap_id_conn_data {
     struct tevent_req *connect_req;
     /* timer for connection expiration */
     struct tevent_timer *expire_timer;
+    /* timer for establishing a replacement connection */
+    struct tevent_timer *warmup_timer;
     /* number of running connection notifies */
     int notify_lock;
     /* list of operations using connect */
@@ -90,6 +94,16 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
                                              struct timeval current_time,
                                              void *pvt);
 static int sdap_id_conn_data_set_expire_timer(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_data_warmup_handler(struct tevent_context *ev,
+                                             struct tevent_timer *te,
+                                             struct timeval current_time,
+                                             void *pvt);
+static int sdap_id_conn_cache_warmup(struct sdap_id_conn_cache *conn_cache);
+static void sdap_id_conn_cache_drop_warmup(struct sdap_id_conn_cache *conn_cache);
+static void sdap_id_conn_warmup_done(struct tevent_req *subreq);
+static bool sdap_id_conn_check_reinit(struct sdap_id_conn_cache *conn_cache,
+                                      struct sdap_server_opts *srv_opts);
+static void sdap_id_conn_cache_reinit(struct sdap_id_conn_cache *conn_cache);
 
 static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn_data *conn_data);
 static int sdap_id_op_destroy(void *pvt);
@@ -150,6 +164,8 @@ static void sdap_id_conn_cache_be_offline_cb(void *pvt)
         conn_cache->cached_connection = NULL;
         sdap_id_release_conn_data(cached_connection);
     }
+
+    sdap_id_conn_cache_drop_warmup(conn_cache);
 }
 
 /* Callback for attempt to reconnect to primary server */
@@ -158,10 +174,21 @@ static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt)
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
     struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
 
-    /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        cached_connection->disconnecting = true;
+    if (cached_connection == NULL) {
+        return;
     }
+
+    /* Keep using the current connection until a new one is established
+     * in the background, if possible */
+    if (cached_connection->connect_req == NULL
+            && dp_opt_get_int(conn_cache->id_ctx->opts->basic,
+                              SDAP_EXPIRE_WARMUP) > 0
+            && sdap_id_conn_cache_warmup(conn_cache) == EOK) {
+        return;
+    }
+
+    /* Release any cached connection on going offline */
+    cached_connection->disconnecting = true;
 }
 
 /* Release sdap_id_conn_data and destroy it if no longer needed */
@@ -233,6 +260,7 @@ static bool sdap_can_reuse_connection(struct sdap_id_conn_data *conn_data)
 static int sdap_id_conn_data_set_expire_timer(struct sdap_id_conn_data *conn_data)
 {
     int timeout;
+    int warmup;
     struct timeval tv;
 
     memset(&tv, 0, sizeof(tv));
@@ -263,6 +291,26 @@ static int sdap_id_conn_data_set_expire_timer(struct sdap_id_conn_data *conn_dat
         return ENOMEM;
     }
 
+    /* Start connecting the replacement early enough for it to be ready
+     * before this connection is released */
+    warmup = dp_opt_get_int(conn_data->conn_cache->id_ctx->opts->basic,
+                            SDAP_EXPIRE_WARMUP);
+    if (warmup <= 0 || tv.tv_sec - warmup <= time(NULL)) {
+        return EOK;
+    }
+    tv.tv_sec -= warmup;
+
+    talloc_zfree(conn_data->warmup_timer);
+
+    conn_data->warmup_timer =
+                        tevent_add_timer(conn_data->conn_cache->id_ctx->be->ev,
+                                         conn_data, tv,
+                                         sdap_id_conn_data_warmup_handler,
+                                         conn_data);
+    if (!conn_data->warmup_timer) {
+        return ENOMEM;
+    }
+
     return EOK;
 }
 
@@ -285,6 +333,154 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
     }
 }
 
+/* Handler for connection warm-up timer */
+static void sdap_id_conn_data_warmup_handler(struct tevent_context *ev,
+                                             struct tevent_timer *te,
+                                             struct timeval current_time,
+                                             void *pvt)
+{
+    struct sdap_id_conn_data *conn_data = talloc_get_type(pvt,
+                                                          struct sdap_id_conn_data);
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    int ret;
+
+    conn_data->warmup_timer = NULL;
+
+    if (conn_cache->cached_connection != conn_data) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("connection is about to expire, "
+                              "establishing a replacement\n"));
+
+    ret = sdap_id_conn_cache_warmup(conn_cache);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot establish a replacement "
+                                     "connection [%d]: %s\n",
+                                     ret, strerror(ret)));
+    }
+}
+
+/* Begin to connect a replacement for the cached connection in the
+ * background. The cached connection is used until it is ready. */
+static int sdap_id_conn_cache_warmup(struct sdap_id_conn_cache *conn_cache)
+{
+    struct sdap_id_ctx *id_ctx = conn_cache->id_ctx;
+    struct sdap_id_conn_data *conn_data;
+    struct tevent_req *subreq;
+
+    if (conn_cache->warmup_connection != NULL) {
+        DEBUG(9, ("replacement connection is already being established\n"));
+        return EOK;
+    }
+
+    if (be_is_offline(id_ctx->be)) {
+        return EAGAIN;
+    }
+
+    conn_data = talloc_zero(conn_cache, struct sdap_id_conn_data);
+    if (!conn_data) {
+        return ENOMEM;
+    }
+
+    talloc_set_destructor(conn_data, sdap_id_conn_data_destroy);
+
+    conn_data->conn_cache = conn_cache;
+    subreq = sdap_cli_connect_send(conn_data, id_ctx->be->ev,
+                                   id_ctx->opts, id_ctx->be,
+                                   id_ctx->service, false,
+                                   CON_TLS_DFL, false);
+    if (!subreq) {
+        talloc_free(conn_data);
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_id_conn_warmup_done, conn_data);
+    conn_data->connect_req = subreq;
+
+    DLIST_ADD(conn_cache->connections, conn_data);
+    conn_cache->warmup_connection = conn_data;
+
+    return EOK;
+}
+
+/* Abandon the replacement connection */
+static void sdap_id_conn_cache_drop_warmup(struct sdap_id_conn_cache *conn_cache)
+{
+    struct sdap_id_conn_data *conn_data = conn_cache->warmup_connection;
+
+    if (conn_data == NULL) {
+        return;
+    }
+
+    conn_cache->warmup_connection = NULL;
+    DLIST_REMOVE(conn_cache->connections, conn_data);
+    talloc_zfree(conn_data);
+}
+
+/* Subrequest callback for replacement connection completion */
+static void sdap_id_conn_warmup_done(struct tevent_req *subreq)
+{
+    struct sdap_id_conn_data *conn_data =
+                tevent_req_callback_data(subreq, struct sdap_id_conn_data);
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    struct sdap_id_conn_data *old_conn_data;
+    struct sdap_server_opts *srv_opts = NULL;
+    bool can_retry = false;
+    bool reinit;
+    int ret;
+
+    ret = sdap_cli_connect_recv(subreq, conn_data, &can_retry,
+                                &conn_data->sh, &srv_opts);
+    conn_data->connect_req = NULL;
+    talloc_zfree(subreq);
+
+    if (ret == EOK && (!conn_data->sh || !conn_data->sh->connected)) {
+        DEBUG(0, ("sdap_cli_connect_recv returned bogus connection\n"));
+        ret = EFAULT;
+    }
+
+    old_conn_data = conn_cache->cached_connection;
+    if (ret == EOK
+            && (be_is_offline(conn_cache->id_ctx->be)
+                || (old_conn_data && old_conn_data->connect_req))) {
+        /* operations are already waiting for another connection */
+        ret = EAGAIN;
+    }
+
+    if (ret == EOK) {
+        ret = sdap_id_conn_data_set_expire_timer(conn_data);
+    }
+
+    if (ret != EOK) {
+        /* The cached connection is still used, it will be re-established
+         * the regular way once it expires */
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Replacement connection was not "
+                                     "established [%d]: %s\n",
+                                     ret, strerror(ret)));
+        sdap_id_conn_cache_drop_warmup(conn_cache);
+        return;
+    }
+
+    reinit = sdap_id_conn_check_reinit(conn_cache, srv_opts);
+    sdap_steal_server_opts(conn_cache->id_ctx, &srv_opts);
+
+    /* Hand the new connection over, operations still running on the old
+     * one keep it until they finish */
+    DEBUG(9, ("replacing cached connection\n"));
+    conn_cache->warmup_connection = NULL;
+    conn_cache->cached_connection = conn_data;
+    if (old_conn_data) {
+        talloc_zfree(old_conn_data->expire_timer);
+        talloc_zfree(old_conn_data->warmup_timer);
+        sdap_id_release_conn_data(old_conn_data);
+    }
+
+    if (reinit) {
+        sdap_id_conn_cache_reinit(conn_cache);
+    }
+}
+
 /* Create an operation object */
 struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cache *conn_cache)
 {
@@ -528,10 +724,8 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
                 tevent_req_callback_data(subreq, struct sdap_id_conn_data);
     struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
     struct sdap_server_opts *srv_opts = NULL;
-    struct sdap_server_opts *current_srv_opts = NULL;
     bool can_retry = false;
     bool is_offline = false;
-    struct tevent_req *reinit_req = NULL;
     bool reinit = false;
     int ret;
 
@@ -560,24 +754,7 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
     }
 
     if (ret == EOK) {
-        current_srv_opts = conn_cache->id_ctx->srv_opts;
-        if (current_srv_opts) {
-            DEBUG(8, ("Old USN: %lu, New USN: %lu\n", current_srv_opts->last_usn, srv_opts->last_usn));
-
-            if (strcmp(srv_opts->server_id, current_srv_opts->server_id) == 0 &&
-                srv_opts->supports_usn &&
-                current_srv_opts->last_usn > srv_opts->last_usn) {
-                DEBUG(5, ("Server was probably re-initialized\n"));
-
-                current_srv_opts->max_user_value = 0;
-                current_srv_opts->max_group_value = 0;
-                current_srv_opts->max_service_value = 0;
-                current_srv_opts->max_sudo_value = 0;
-                current_srv_opts->last_usn = srv_opts->last_usn;
-
-                reinit = true;
-            }
-        }
+        reinit = sdap_id_conn_check_reinit(conn_cache, srv_opts);
         ret = sdap_id_conn_data_set_expire_timer(conn_data);
         sdap_steal_server_opts(conn_cache->id_ctx, &srv_opts);
     }
@@ -702,20 +879,58 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
     }
 
     if (reinit) {
-        DEBUG(SSSDBG_TRACE_FUNC, ("Server reinitialization detected. "
-                                  "Cleaning cache.\n"));
-        reinit_req = sdap_reinit_cleanup_send(conn_cache->id_ctx->be,
-                                              conn_cache->id_ctx->be,
-                                              conn_cache->id_ctx);
-        if (reinit_req == NULL) {
-            DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to perform reinitialization "
-                                        "clean up.\n"));
-            return;
-        }
+        sdap_id_conn_cache_reinit(conn_cache);
+    }
+}
+
+/* Check whether the server was re-initialized since the last connection */
+static bool sdap_id_conn_check_reinit(struct sdap_id_conn_cache *conn_cache,
+                                      struct sdap_server_opts *srv_opts)
+{
+    struct sdap_server_opts *current_srv_opts;
 
-        tevent_req_set_callback(reinit_req, sdap_id_op_connect_reinit_done,
-                                NULL);
+    current_srv_opts = conn_cache->id_ctx->srv_opts;
+    if (!current_srv_opts) {
+        return false;
     }
+
+    DEBUG(8, ("Old USN: %lu, New USN: %lu\n", current_srv_opts->last_usn, srv_opts->last_usn));
+
+    if (strcmp(srv_opts->server_id, current_srv_opts->server_id) == 0 &&
+        srv_opts->supports_usn &&
+        current_srv_opts->last_usn > srv_opts->last_usn) {
+        DEBUG(5, ("Server was probably re-initialized\n"));
+
+        current_srv_opts->max_user_value = 0;
+        current_srv_opts->max_group_value = 0;
+        current_srv_opts->max_service_value = 0;
+        current_srv_opts->max_sudo_value = 0;
+        current_srv_opts->last_usn = srv_opts->last_usn;
+
+        return true;
+    }
+
+    return false;
+}
+
+/* Clean the cache after the server was re-initialized */
+static void sdap_id_conn_cache_reinit(struct sdap_id_conn_cache *conn_cache)
+{
+    struct tevent_req *reinit_req;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Server reinitialization detected. "
+                              "Cleaning cache.\n"));
+    reinit_req = sdap_reinit_cleanup_send(conn_cache->id_ctx->be,
+                                          conn_cache->id_ctx->be,
+                                          conn_cache->id_ctx);
+    if (reinit_req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to perform reinitialization "
+                                    "clean up.\n"));
+        return;
+    }
+
+    tevent_req_set_callback(reinit_req, sdap_id_op_connect_reinit_done,
+                            NULL);
 }
 
 static void sdap_id_op_connect_reinit_done(struct tevent_req *req)
@@ -19,154 +19,567 @@
 */
 
 #include <talloc.h>
+#include <tevent.h>
 
+#include "util/util.h"
+#include "util/murmurhash3.h"
 #include "db/sysdb.h"
 #include "db/sysdb_sudo.h"
 #include "providers/ldap/sdap_sudo_cache.h"
 
 /* ==========  Functions specific for the native sudo LDAP schema ========== */
-static errno_t sdap_sudo_get_usn(TALLOC_CTX *mem_ctx,
-                                 struct sysdb_attrs *attrs,
-                                 struct sdap_attr_map *map,
-                                 const char *name,
-                                 char **_usn)
+static void sdap_sudo_update_highest_usn(char **_highest, char *usn_value)
 {
-    const char *usn;
-    errno_t ret;
+    if (usn_value == NULL) {
+        return;
+    }
 
-    if (_usn == NULL) {
-        return EINVAL;
+    if (*_highest) {
+        if ((strlen(usn_value) > strlen(*_highest)) ||
+            (strcmp(usn_value, *_highest) > 0)) {
+            talloc_zfree(*_highest);
+            *_highest = usn_value;
+        } else {
+            talloc_zfree(usn_value);
+        }
+    } else {
+        *_highest = usn_value;
     }
+}
+
+/* ==========  Incremental synchronization of the cached rules ========== */
+
+static int sdap_sudo_el_cmp(const void *a, const void *b)
+{
+    const struct ldb_message_element *e1;
+    const struct ldb_message_element *e2;
+
+    e1 = * (const struct ldb_message_element * const *) a;
+    e2 = * (const struct ldb_message_element * const *) b;
+
+    return strcasecmp(e1->name, e2->name);
+}
 
-    ret = sysdb_attrs_get_string(attrs, map[SDAP_AT_SUDO_USN].sys_name, &usn);
-    if (ret != EOK && ret != ENOENT) {
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              ("Failed to retrieve USN value: [%s]\n", strerror(ret)));
+static int sdap_sudo_val_cmp(const void *a, const void *b)
+{
+    const struct ldb_val *v1 = * (const struct ldb_val * const *) a;
+    const struct ldb_val *v2 = * (const struct ldb_val * const *) b;
+    size_t len;
+    int ret;
 
+    len = v1->length < v2->length ? v1->length : v2->length;
+    ret = memcmp(v1->data, v2->data, len);
+    if (ret != 0) {
         return ret;
     }
 
-    *_usn = talloc_strdup(mem_ctx, usn);
-    if (*_usn == NULL) {
+    if (v1->length == v2->length) {
+        return 0;
+    }
+
+    return v1->length < v2->length ? -1 : 1;
+}
+
+/* Hashes the attributes of a downloaded rule independently of the order of
+ * attributes and values. The USN is left out, it changes with every
+ * modification on the server even if the rule is the same. */
+static errno_t sdap_sudo_rule_hash(TALLOC_CTX *mem_ctx,
+                                   struct sysdb_attrs *rule,
+                                   struct sdap_attr_map *map,
+                                   char **_hash)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_message_element **els;
+    struct ldb_val **vals;
+    const char *usn_name;
+    uint32_t h1 = 0x73756430;
+    uint32_t h2 = 0x73756431;
+    uint32_t len;
+    int num_els;
+    int i;
+    unsigned int j;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    usn_name = map[SDAP_AT_SUDO_USN].sys_name;
+
+    els = talloc_array(tmp_ctx, struct ldb_message_element *, rule->num + 1);
+    if (els == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    num_els = 0;
+    for (i = 0; i < rule->num; i++) {
+        if (strcasecmp(rule->a[i].name, usn_name) == 0
+                || strcasecmp(rule->a[i].name, SYSDB_CACHE_EXPIRE) == 0) {
+            continue;
+        }
+        els[num_els++] = &rule->a[i];
+    }
+
+    qsort(els, num_els, sizeof(struct ldb_message_element *),
+          sdap_sudo_el_cmp);
+
+    for (i = 0; i < num_els; i++) {
+        h1 = murmurhash3(els[i]->name, strlen(els[i]->name) + 1, h1);
+        h2 = murmurhash3(els[i]->name, strlen(els[i]->name) + 1, h2);
+
+        vals = talloc_array(tmp_ctx, struct ldb_val *,
+                            els[i]->num_values + 1);
+        if (vals == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        for (j = 0; j < els[i]->num_values; j++) {
+            vals[j] = &els[i]->values[j];
+        }
+
+        qsort(vals, els[i]->num_values, sizeof(struct ldb_val *),
+              sdap_sudo_val_cmp);
+
+        for (j = 0; j < els[i]->num_values; j++) {
+            /* the length keeps "ab","c" apart from "a","bc" */
+            len = vals[j]->length;
+            h1 = murmurhash3((const char *) &len, sizeof(len), h1);
+            h2 = murmurhash3((const char *) &len, sizeof(len), h2);
+            h1 = murmurhash3((const char *) vals[j]->data, len, h1);
+            h2 = murmurhash3((const char *) vals[j]->data, len, h2);
+        }
+
+        talloc_free(vals);
+    }
+
+    *_hash = talloc_asprintf(mem_ctx, "%08x%08x", h1, h2);
+    if (*_hash == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* A cached rule, the table is keyed by the lower case name because the
+ * cache compares rule names case-insensitively */
+struct sdap_sudo_cached_rule {
+    const char *name;
+    const char *hash;
+};
+
+static errno_t sdap_sudo_rule_key(TALLOC_CTX *mem_ctx, const char *name,
+                                  hash_key_t *key)
+{
+    key->type = HASH_KEY_STRING;
+    key->str = sss_tc_utf8_str_tolower(mem_ctx, name);
+    if (key->str == NULL) {
         return ENOMEM;
     }
 
     return EOK;
 }
 
-static errno_t
-sdap_save_native_sudorule(TALLOC_CTX *mem_ctx,
-                          struct sysdb_ctx *sysdb_ctx,
-                          struct sss_domain_info *domain,
-                          struct sdap_attr_map *map,
-                          struct sysdb_attrs *attrs,
-                          int cache_timeout,
-                          time_t now,
-                          char **_usn)
+static errno_t sdap_sudo_cached_hash_add(hash_table_t *table,
+                                         struct ldb_message *msg)
 {
+    struct sdap_sudo_cached_rule *rule;
+    const char *name;
+    const char *hash;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
     errno_t ret;
-    const char *rule_name;
 
-    ret = sysdb_attrs_get_string(attrs, map[SDAP_AT_SUDO_NAME].sys_name,
-                                 &rule_name);
+    name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+    if (name == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, ("A rule without a name?\n"));
+        return EOK;
+    }
+
+    /* rules cached by an older version have no hash and are replaced */
+    hash = ldb_msg_find_attr_as_string(msg, SYSDB_SUDO_CACHE_AT_HASH, "");
+
+    rule = talloc(table, struct sdap_sudo_cached_rule);
+    if (rule == NULL) {
+        return ENOMEM;
+    }
+
+    rule->name = talloc_strdup(rule, name);
+    rule->hash = talloc_strdup(rule, hash);
+    if (rule->name == NULL || rule->hash == NULL) {
+        talloc_free(rule);
+        return ENOMEM;
+    }
+
+    ret = sdap_sudo_rule_key(rule, name, &key);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Could not get rule name [%d]: %s\n",
-              ret, strerror(ret)));
+        talloc_free(rule);
         return ret;
     }
 
-    ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE,
-                                 (cache_timeout ? (now + cache_timeout) : 0));
-    if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Could not set sysdb cache expire [%d]: %s\n",
-              ret, strerror(ret)));
-        return ret;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = rule;
+
+    hret = hash_enter(table, &key, &value);
+    talloc_free(key.str);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to add [%s] to hash table: %s\n",
+                                  name, hash_error_string(hret)));
+        talloc_free(rule);
+        return EIO;
     }
 
-    ret = sdap_sudo_get_usn(mem_ctx, attrs, map, rule_name, _usn);
-    if (ret != EOK && ret != ENOENT) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Could not read USN from %s\n", rule_name));
-        return ret;
+    return EOK;
+}
+
+/* Reads the names and content hashes of the cached rules the refresh may
+ * touch: the rules matching the filter or, without a filter, the cached
+ * copies of the downloaded rules. */
+static errno_t sdap_sudo_get_cached_hashes(TALLOC_CTX *mem_ctx,
+                                           struct sysdb_ctx *sysdb_ctx,
+                                           struct sss_domain_info *domain,
+                                           struct sdap_attr_map *map,
+                                           const char *sysdb_filter,
+                                           struct sysdb_attrs **rules,
+                                           size_t rules_count,
+                                           hash_table_t **_table)
+{
+    TALLOC_CTX *tmp_ctx;
+    hash_table_t *table;
+    struct ldb_message **msgs;
+    const char *name;
+    size_t count;
+    size_t i;
+    errno_t ret;
+    const char *attrs[] = { SYSDB_NAME,
+                            SYSDB_SUDO_CACHE_AT_HASH,
+                            NULL };
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
     }
 
-    ret = sysdb_save_sudorule(sysdb_ctx, domain, rule_name, attrs);
+    ret = sss_hash_create(tmp_ctx, rules_count, &table);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Could not save sudorule %s\n", rule_name));
-        return ret;
+        goto done;
+    }
+
+    if (sysdb_filter != NULL) {
+        ret = sysdb_search_custom(tmp_ctx, sysdb_ctx, domain, sysdb_filter,
+                                  SUDORULE_SUBDIR, attrs, &count, &msgs);
+        if (ret == ENOENT) {
+            count = 0;
+        } else if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Error looking up SUDO rules\n"));
+            goto done;
+        }
+
+        for (i = 0; i < count; i++) {
+            ret = sdap_sudo_cached_hash_add(table, msgs[i]);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    } else {
+        for (i = 0; i < rules_count; i++) {
+            ret = sysdb_attrs_get_string(rules[i],
+                                         map[SDAP_AT_SUDO_NAME].sys_name,
+                                         &name);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("Failed to retrieve rule name: [%s]\n",
+                       strerror(ret)));
+                continue;
+            }
+
+            ret = sysdb_search_custom_by_name(tmp_ctx, sysdb_ctx, domain,
+                                              name, SUDORULE_SUBDIR, attrs,
+                                              &count, &msgs);
+            if (ret == ENOENT) {
+                continue;
+            } else if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      ("Error looking up SUDO rule %s\n", name));
+                goto done;
+            }
+
+            ret = sdap_sudo_cached_hash_add(table, msgs[0]);
+            if (ret != EOK) {
+                goto done;
+            }
+            talloc_zfree(msgs);
+        }
     }
 
+    *_table = talloc_steal(mem_ctx, table);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
     return ret;
 }
 
+static errno_t sdap_sudo_bump_expire(struct sysdb_ctx *sysdb_ctx,
+                                     struct sss_domain_info *domain,
+                                     const char *rule_name,
+                                     time_t expire)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    struct ldb_dn *dn;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    dn = sysdb_custom_dn(sysdb_ctx, tmp_ctx, domain, rule_name,
+                         SUDORULE_SUBDIR);
+    if (dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    attrs = sysdb_new_attrs(tmp_ctx);
+    if (attrs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE, expire);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_set_entry_attr(sysdb_ctx, dn, attrs, SYSDB_MOD_REP);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static unsigned int sdap_sudo_elapsed_ms(struct timeval *start)
+{
+    struct timeval now;
+    struct timeval diff;
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(start, &now);
+
+    return diff.tv_sec * 1000 + diff.tv_usec / 1000;
+}
+
 errno_t
-sdap_save_native_sudorule_list(TALLOC_CTX *mem_ctx,
-                               struct sysdb_ctx *sysdb_ctx,
-                               struct sss_domain_info *domain,
-                               struct sdap_attr_map *map,
-                               struct sysdb_attrs **replies,
-                               size_t replies_count,
-                               int cache_timeout,
-                               time_t now,
-                               char **_usn)
+sdap_sudo_sync_rules(TALLOC_CTX *mem_ctx,
+                     struct sysdb_ctx *sysdb_ctx,
+                     struct sss_domain_info *domain,
+                     struct sdap_attr_map *map,
+                     const char *sysdb_filter,
+                     struct sysdb_attrs **rules,
+                     size_t rules_count,
+                     int cache_timeout,
+                     time_t now,
+                     char **_usn,
+                     struct sdap_sudo_sync_stats *_stats)
 {
-    TALLOC_CTX *tmp_ctx = NULL;
+    TALLOC_CTX *tmp_ctx;
+    struct sdap_sudo_sync_stats stats;
+    struct timeval start;
+    hash_table_t *cached;
+    struct sdap_sudo_cached_rule *cached_rule;
+    hash_key_t key;
+    hash_value_t *values;
+    hash_value_t value;
+    unsigned long num_values;
+    const char *name;
+    const char *usn;
+    char *hash;
+    char *usn_value;
     char *higher_usn = NULL;
-    char *usn_value = NULL;
+    time_t expire;
+    size_t i;
+    int hret;
     errno_t ret, tret;
     bool in_transaction = false;
-    size_t i;
+
+    memset(&stats, 0, sizeof(stats));
 
     tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL)  {
-        DEBUG(SSSDBG_FATAL_FAILURE, ("talloc_new() failed\n"));
+    if (tmp_ctx == NULL) {
         return ENOMEM;
     }
 
     ret = sysdb_transaction_start(sysdb_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Could not start transaction\n"));
-        goto fail;
+        goto done;
     }
     in_transaction = true;
 
-    for (i=0; i<replies_count; i++) {
-        usn_value = NULL;
-        ret = sdap_save_native_sudorule(tmp_ctx, sysdb_ctx,
-                                        domain, map, replies[i],
-                                        cache_timeout, now, &usn_value);
+    /* Read the hashes inside the transaction so that nothing else can
+     * change or remove the rules before they are compared and written */
+    start = tevent_timeval_current();
+
+    ret = sdap_sudo_get_cached_hashes(tmp_ctx, sysdb_ctx, domain, map,
+                                      sysdb_filter, rules, rules_count,
+                                      &cached);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    stats.read_ms = sdap_sudo_elapsed_ms(&start);
+    start = tevent_timeval_current();
+
+    expire = cache_timeout ? (now + cache_timeout) : 0;
+
+    for (i = 0; i < rules_count; i++) {
+        ret = sysdb_attrs_get_string(rules[i],
+                                     map[SDAP_AT_SUDO_NAME].sys_name,
+                                     &name);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Could not get rule name [%d]: %s\n",
+                  ret, strerror(ret)));
+            goto done;
+        }
+
+        ret = sysdb_attrs_get_string(rules[i], map[SDAP_AT_SUDO_USN].sys_name,
+                                     &usn);
+        if (ret == EOK) {
+            usn_value = talloc_strdup(tmp_ctx, usn);
+            if (usn_value == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+            sdap_sudo_update_highest_usn(&higher_usn, usn_value);
+        } else if (ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Failed to retrieve USN value: [%s]\n", strerror(ret)));
+            goto done;
+        }
+
+        ret = sdap_sudo_rule_hash(tmp_ctx, rules[i], map, &hash);
         if (ret != EOK) {
-            goto fail;
-        }
-
-        /* find highest usn */
-        if (usn_value) {
-            if (higher_usn) {
-                if ((strlen(usn_value) > strlen(higher_usn)) ||
-                    (strcmp(usn_value, higher_usn) > 0)) {
-                    talloc_zfree(higher_usn);
-                    higher_usn = usn_value;
-                } else {
-                    talloc_zfree(usn_value);
+            goto done;
+        }
+
+        ret = sdap_sudo_rule_key(hash, name, &key);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        hret = hash_lookup(cached, &key, &value);
+        if (hret == HASH_SUCCESS) {
+            cached_rule = talloc_get_type(value.ptr,
+                                          struct sdap_sudo_cached_rule);
+            talloc_steal(hash, cached_rule);
+            hash_delete(cached, &key);
+
+            /* the cached name may differ in case, the hash tells it */
+            if (strcmp(hash, cached_rule->hash) == 0) {
+                /* same content, only extend its lifetime */
+                ret = sdap_sudo_bump_expire(sysdb_ctx, domain, name, expire);
+                if (ret != EOK) {
+                    DEBUG(SSSDBG_OP_FAILURE,
+                          ("Could not update rule %s\n", name));
+                    goto done;
                 }
-            } else {
-                higher_usn = usn_value;
+                stats.unchanged++;
+                talloc_free(hash);
+                continue;
+            }
+
+            /* remove the old copy so no stale attribute survives */
+            ret = sysdb_sudo_purge_byname(sysdb_ctx, domain,
+                                          cached_rule->name);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      ("Could not delete rule %s\n", cached_rule->name));
+                goto done;
             }
+            stats.modified++;
+        } else if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+            stats.added++;
+        } else {
+            DEBUG(SSSDBG_OP_FAILURE, ("Unable to look up [%s]: %s\n",
+                                      name, hash_error_string(hret)));
+            ret = EIO;
+            goto done;
+        }
+
+        ret = sysdb_attrs_add_string(rules[i], SYSDB_SUDO_CACHE_AT_HASH, hash);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = sysdb_attrs_add_time_t(rules[i], SYSDB_CACHE_EXPIRE, expire);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Could not set sysdb cache expire [%d]: %s\n",
+                   ret, strerror(ret)));
+            goto done;
+        }
+
+        ret = sysdb_save_sudorule(sysdb_ctx, domain, name, rules[i]);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Could not save sudorule %s\n", name));
+            goto done;
+        }
+
+        talloc_free(hash);
+    }
+
+    /* whatever matched the filter and was not downloaded is gone */
+    if (sysdb_filter != NULL) {
+        hret = hash_values(cached, &num_values, &values);
+        if (hret != HASH_SUCCESS) {
+            ret = EIO;
+            goto done;
+        }
+
+        for (i = 0; i < num_values; i++) {
+            cached_rule = talloc_get_type(values[i].ptr,
+                                          struct sdap_sudo_cached_rule);
+            ret = sysdb_sudo_purge_byname(sysdb_ctx, domain,
+                                          cached_rule->name);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      ("Could not delete rule %s\n", cached_rule->name));
+                goto done;
+            }
+            stats.deleted++;
         }
     }
 
     ret = sysdb_transaction_commit(sysdb_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to commit transaction\n"));
-        goto fail;
+        goto done;
     }
     in_transaction = false;
 
+    stats.write_ms = sdap_sudo_elapsed_ms(&start);
+
     if (higher_usn != NULL) {
         *_usn = talloc_steal(mem_ctx, higher_usn);
     }
 
+    if (_stats != NULL) {
+        *_stats = stats;
+    }
+
     ret = EOK;
-fail:
+
+done:
     if (in_transaction) {
         tret = sysdb_transaction_cancel(sysdb_ctx);
         if (tret != EOK) {
@@ -175,6 +588,5 @@ fail:
     }
 
     talloc_free(tmp_ctx);
-
     return ret;
 }
@@ -24,15 +24,33 @@
 #include "src/providers/ldap/sdap.h"
 
 /* Cache functions specific for the native sudo LDAP schema */
+struct sdap_sudo_sync_stats {
+    size_t added;
+    size_t modified;
+    size_t unchanged;
+    size_t deleted;
+
+    /* time spent reading the cached rules and writing the changes */
+    unsigned int read_ms;
+    unsigned int write_ms;
+};
+
+/* Brings the cache in line with the downloaded rules. Rules whose content
+ * did not change only get a new expiration time, changed rules are
+ * replaced and new ones added, all in one transaction. If sysdb_filter is
+ * set, the cached rules matching it that were not downloaded are deleted.
+ * Without a filter only the downloaded rules are touched. */
 errno_t
-sdap_save_native_sudorule_list(TALLOC_CTX *mem_ctx,
-                               struct sysdb_ctx *sysdb_ctx,
-                               struct sss_domain_info *domain,
-                               struct sdap_attr_map *map,
-                               struct sysdb_attrs **replies,
-                               size_t replies_count,
-                               int cache_timeout,
-                               time_t now,
-                               char **_usn);
+sdap_sudo_sync_rules(TALLOC_CTX *mem_ctx,
+                     struct sysdb_ctx *sysdb_ctx,
+                     struct sss_domain_info *domain,
+                     struct sdap_attr_map *map,
+                     const char *sysdb_filter,
+                     struct sysdb_attrs **rules,
+                     size_t rules_count,
+                     int cache_timeout,
+                     time_t now,
+                     char **_usn,
+                     struct sdap_sudo_sync_stats *_stats);
 
 #endif /* _SDAP_SUDO_CACHE_H_ */
@@ -0,0 +1,432 @@
+/*
+    SSSD
+
+    LDAP operation tracing
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async_private.h"
+
+/* Only this many distinct operations are summarized, anything else is
+ * added to a single "other" line */
+#define SDAP_TRACE_MAX_ENTRIES 256
+
+struct sdap_trace_entry {
+    struct sdap_trace_entry *prev, *next;
+
+    const char *type;
+    char *base;
+    int scope;
+    char *shape;
+
+    uint64_t count;
+    uint64_t timeouts;
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t total_us;
+    uint64_t max_us;
+};
+
+static struct {
+    bool enabled;
+    int slow_threshold;
+
+    TALLOC_CTX *mem_ctx;
+    struct sdap_trace_entry *list;
+    size_t num_entries;
+    struct sdap_trace_entry other;
+} sdap_trace;
+
+static char *sdap_trace_dump(TALLOC_CTX *mem_ctx);
+
+errno_t sdap_trace_setup(struct sdap_options *opts)
+{
+    int ret;
+
+    sdap_trace.enabled = dp_opt_get_bool(opts->basic, SDAP_OP_TRACE);
+    sdap_trace.slow_threshold = dp_opt_get_int(opts->basic,
+                                               SDAP_OP_SLOW_THRESHOLD);
+    if (sdap_trace.slow_threshold < 0) {
+        sdap_trace.slow_threshold = 0;
+    }
+
+    if (!sdap_trace.enabled) {
+        return EOK;
+    }
+
+    if (sdap_trace.mem_ctx == NULL) {
+        sdap_trace.mem_ctx = talloc_named_const(NULL, 0, "sdap_trace");
+        if (sdap_trace.mem_ctx == NULL) {
+            return ENOMEM;
+        }
+
+        sdap_trace.other.type = "other";
+        sdap_trace.other.scope = -1;
+        sdap_trace.other.base = discard_const("");
+        sdap_trace.other.shape = discard_const("");
+    }
+
+    ret = sss_stats_add_section(sdap_trace_dump);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot add the LDAP operations to the statistics [%d]: %s\n",
+               ret, strerror(ret)));
+    }
+
+    return EOK;
+}
+
+/* Replaces the assertion values of a filter with '?' so that the searches
+ * for different users or groups are summarized together. Presence filters
+ * and objectClass values are kept, they tell the searches apart. */
+char *sdap_filter_shape(TALLOC_CTX *mem_ctx, const char *filter)
+{
+    const char *attr;
+    const char *value;
+    const char *p;
+    size_t attr_len;
+    char *shape;
+    size_t i;
+
+    if (filter == NULL) {
+        return talloc_strdup(mem_ctx, "");
+    }
+
+    /* an empty value is replaced by one character, nothing else grows */
+    shape = talloc_array(mem_ctx, char, 2 * strlen(filter) + 1);
+    if (shape == NULL) {
+        return NULL;
+    }
+
+    i = 0;
+    attr = filter;
+    p = filter;
+    while (*p != '\0') {
+        if (*p != '=') {
+            if (*p == '(') {
+                attr = p + 1;
+            }
+            shape[i++] = *p++;
+            continue;
+        }
+
+        attr_len = p - attr;
+        shape[i++] = *p++;
+
+        /* special characters in values are escaped, an unescaped ')' is
+         * always the end of the item */
+        value = p;
+        while (*p != '\0' && *p != ')') {
+            p++;
+        }
+
+        if (attr_len == sizeof(SYSDB_OBJECTCLASS) - 1
+                && strncasecmp(attr, SYSDB_OBJECTCLASS, attr_len) == 0) {
+            memcpy(&shape[i], value, p - value);
+            i += p - value;
+        } else if (p - value == 1 && *value == '*') {
+            shape[i++] = '*';
+        } else {
+            shape[i++] = '?';
+        }
+    }
+    shape[i] = '\0';
+
+    return shape;
+}
+
+static const char *sdap_trace_scope_str(int scope)
+{
+    switch (scope) {
+    case LDAP_SCOPE_BASE:
+        return "base";
+    case LDAP_SCOPE_ONELEVEL:
+        return "one";
+    case LDAP_SCOPE_SUBTREE:
+        return "sub";
+    default:
+        break;
+    }
+
+    return "-";
+}
+
+static const char *sdap_trace_type(struct sdap_op *op, int msgtype)
+{
+    switch (msgtype) {
+    case LDAP_RES_BIND:
+        return "bind";
+    case LDAP_RES_SEARCH_RESULT:
+        return "search";
+    case LDAP_RES_MODIFY:
+        return "modify";
+    case LDAP_RES_ADD:
+        return "add";
+    case LDAP_RES_DELETE:
+        return "delete";
+    case LDAP_RES_MODDN:
+        return "moddn";
+    case LDAP_RES_COMPARE:
+        return "compare";
+    case LDAP_RES_EXTENDED:
+        return "extended";
+    case LDAP_RES_INTERMEDIATE:
+        return "intermediate";
+    default:
+        break;
+    }
+
+    /* the operation timed out before any result arrived */
+    return op->trace.base != NULL ? "search" : "unknown";
+}
+
+/* Returns the encoded size of an entry as it was received */
+static uint64_t sdap_trace_msg_size(LDAP *ldap, LDAPMessage *msg)
+{
+#ifdef LBER_OPT_TOTAL_BYTES
+    BerElement *ber = NULL;
+    struct berval dn;
+    ber_len_t len = 0;
+    int lret;
+
+    lret = ldap_get_dn_ber(ldap, msg, &ber, &dn);
+    if (lret != LDAP_SUCCESS || ber == NULL) {
+        return 0;
+    }
+
+    lret = ber_get_option(ber, LBER_OPT_TOTAL_BYTES, &len);
+    ber_free(ber, 0);
+    if (lret != LBER_OPT_SUCCESS) {
+        return 0;
+    }
+
+    return len;
+#else
+    return 0;
+#endif
+}
+
+void sdap_trace_search(struct sdap_op *op, const char *base, int scope,
+                       const char *filter)
+{
+    op->trace.base = base;
+    op->trace.scope = scope;
+    op->trace.filter = filter;
+}
+
+void sdap_trace_entry(struct sdap_op *op, LDAPMessage *msg)
+{
+    op->trace.entries++;
+
+    if (sdap_trace.enabled) {
+        op->trace.bytes += sdap_trace_msg_size(op->sh->ldap, msg);
+    }
+}
+
+static struct sdap_trace_entry *sdap_trace_get(const char *type,
+                                               const char *base,
+                                               int scope,
+                                               const char *filter)
+{
+    struct sdap_trace_entry *entry;
+    char *shape;
+
+    shape = sdap_filter_shape(sdap_trace.mem_ctx, filter);
+    if (shape == NULL) {
+        return &sdap_trace.other;
+    }
+
+    if (base == NULL) {
+        base = "";
+    }
+
+    for (entry = sdap_trace.list; entry != NULL; entry = entry->next) {
+        if (entry->type == type
+                && entry->scope == scope
+                && strcmp(entry->shape, shape) == 0
+                && strcmp(entry->base, base) == 0) {
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        talloc_free(shape);
+
+        /* the same few searches are repeated over and over */
+        if (entry != sdap_trace.list) {
+            DLIST_REMOVE(sdap_trace.list, entry);
+            DLIST_ADD(sdap_trace.list, entry);
+        }
+        return entry;
+    }
+
+    if (sdap_trace.num_entries == SDAP_TRACE_MAX_ENTRIES) {
+        talloc_free(shape);
+        return &sdap_trace.other;
+    }
+
+    entry = talloc_zero(sdap_trace.mem_ctx, struct sdap_trace_entry);
+    if (entry == NULL) {
+        talloc_free(shape);
+        return &sdap_trace.other;
+    }
+
+    entry->type = type;
+    entry->scope = scope;
+    entry->shape = talloc_steal(entry, shape);
+    entry->base = talloc_strdup(entry, base);
+    if (entry->base == NULL) {
+        talloc_free(entry);
+        return &sdap_trace.other;
+    }
+
+    DLIST_ADD(sdap_trace.list, entry);
+    sdap_trace.num_entries++;
+
+    return entry;
+}
+
+void sdap_trace_done(struct sdap_op *op, int msgtype, bool timed_out)
+{
+    struct sdap_trace_entry *entry;
+    struct timeval now;
+    const char *type;
+    int64_t usec;
+
+    if (!sdap_trace.enabled && sdap_trace.slow_threshold == 0) {
+        return;
+    }
+
+    gettimeofday(&now, NULL);
+    usec = (int64_t) (now.tv_sec - op->start.tv_sec) * 1000000
+           + (now.tv_usec - op->start.tv_usec);
+    if (usec < 0) {
+        usec = 0;
+    }
+
+    type = sdap_trace_type(op, msgtype);
+
+    if (sdap_trace.slow_threshold > 0
+            && usec >= (int64_t) sdap_trace.slow_threshold * 1000) {
+        if (op->trace.base != NULL) {
+            DEBUG(SSSDBG_IMPORTANT_INFO,
+                  ("Slow LDAP %s %s after %lld ms: base [%s] scope [%s] "
+                   "filter [%s] entries [%llu] bytes [%llu]\n",
+                   type, timed_out ? "timed out" : "finished",
+                   (long long) usec / 1000, op->trace.base,
+                   sdap_trace_scope_str(op->trace.scope),
+                   op->trace.filter ? op->trace.filter : "no filter",
+                   (unsigned long long) op->trace.entries,
+                   (unsigned long long) op->trace.bytes));
+        } else {
+            DEBUG(SSSDBG_IMPORTANT_INFO,
+                  ("Slow LDAP %s %s after %lld ms\n",
+                   type, timed_out ? "timed out" : "finished",
+                   (long long) usec / 1000));
+        }
+    }
+
+    if (!sdap_trace.enabled) {
+        return;
+    }
+
+    entry = sdap_trace_get(type, op->trace.base,
+                           op->trace.base != NULL ? op->trace.scope : -1,
+                           op->trace.filter);
+
+    entry->count++;
+    if (timed_out) {
+        entry->timeouts++;
+    }
+    entry->entries += op->trace.entries;
+    entry->bytes += op->trace.bytes;
+    entry->total_us += usec;
+    if (usec > entry->max_us) {
+        entry->max_us = usec;
+    }
+}
+
+static int sdap_trace_entry_cmp(const void *a, const void *b)
+{
+    const struct sdap_trace_entry *e1 = *(struct sdap_trace_entry * const *) a;
+    const struct sdap_trace_entry *e2 = *(struct sdap_trace_entry * const *) b;
+
+    if (e1->total_us == e2->total_us) return 0;
+    return e1->total_us > e2->total_us ? -1 : 1;
+}
+
+/* The operations that took the most time in total come first */
+static char *sdap_trace_dump(TALLOC_CTX *mem_ctx)
+{
+    struct sdap_trace_entry **sorted;
+    struct sdap_trace_entry *entry;
+    char *out;
+    size_t num;
+    size_t i;
+
+    if (sdap_trace.num_entries == 0 && sdap_trace.other.count == 0) {
+        return NULL;
+    }
+
+    sorted = talloc_array(mem_ctx, struct sdap_trace_entry *,
+                          sdap_trace.num_entries + 1);
+    if (sorted == NULL) {
+        return NULL;
+    }
+
+    num = 0;
+    for (entry = sdap_trace.list; entry != NULL; entry = entry->next) {
+        sorted[num++] = entry;
+    }
+    if (sdap_trace.other.count > 0) {
+        sorted[num++] = &sdap_trace.other;
+    }
+
+    qsort(sorted, num, sizeof(struct sdap_trace_entry *),
+          sdap_trace_entry_cmp);
+
+    out = talloc_asprintf(mem_ctx, "%-8s %-5s %9s %8s %9s %9s %9s %12s  %s\n",
+                          "LDAP op", "Scope", "Count", "Timeouts",
+                          "Avg(us)", "Max(us)", "Entries", "Bytes",
+                          "Base and filter");
+
+    for (i = 0; out != NULL && i < num; i++) {
+        entry = sorted[i];
+        out = talloc_asprintf_append(out,
+                                "%-8s %-5s %9llu %8llu %9llu %9llu %9llu "
+                                "%12llu  %s %s\n",
+                                entry->type,
+                                sdap_trace_scope_str(entry->scope),
+                                (unsigned long long) entry->count,
+                                (unsigned long long) entry->timeouts,
+                                (unsigned long long)
+                                    (entry->total_us / entry->count),
+                                (unsigned long long) entry->max_us,
+                                (unsigned long long) entry->entries,
+                                (unsigned long long) entry->bytes,
+                                entry->base, entry->shape);
+    }
+
+    talloc_free(sorted);
+    return out;
+}
@@ -23,6 +23,7 @@
 */
 
 #include "providers/proxy/proxy.h"
+#include "util/child_common.h"
 
 struct proxy_client_ctx {
     struct be_req *be_req;
@@ -254,62 +255,58 @@ static struct tevent_req *proxy_child_init_send(TALLOC_CTX *mem_ctx,
 
     DEBUG(7, ("Starting proxy child with args [%s]\n", state->command));
 
-    pid = fork();
-    if (pid < 0) {
-        ret = errno;
-        DEBUG(1, ("fork failed [%d][%s].\n", ret, strerror(ret)));
+    proxy_child_args = parse_args(state->command);
+    if (proxy_child_args == NULL) {
+        DEBUG(1, ("parse_args failed.\n"));
         talloc_zfree(req);
         return NULL;
     }
 
-    if (pid == 0) { /* child */
-        proxy_child_args = parse_args(state->command);
-        execvp(proxy_child_args[0], proxy_child_args);
-
-        ret = errno;
+    ret = sss_spawn(proxy_child_args[0], proxy_child_args,
+                    NULL, NULL, 0, &pid);
+    free_args(proxy_child_args);
+    if (ret != EOK) {
         DEBUG(0, ("Could not start proxy child [%s]: [%d][%s].\n",
                   state->command, ret, strerror(ret)));
-
-        _exit(1);
+        talloc_zfree(req);
+        return NULL;
     }
 
-    else { /* parent */
-        state->pid = pid;
-        /* Make sure to kill the child process if we abort */
-        talloc_set_destructor((TALLOC_CTX *)state, pc_init_destructor);
+    state->pid = pid;
+    /* Make sure to kill the child process if we abort */
+    talloc_set_destructor((TALLOC_CTX *)state, pc_init_destructor);
 
-        state->sige = tevent_add_signal(auth_ctx->be->ev, req,
-                                        SIGCHLD, SA_SIGINFO,
-                                        pc_init_sig_handler, req);
-        if (state->sige == NULL) {
-            DEBUG(1, ("tevent_add_signal failed.\n"));
-            talloc_zfree(req);
-            return NULL;
-        }
+    state->sige = tevent_add_signal(auth_ctx->be->ev, req,
+                                    SIGCHLD, SA_SIGINFO,
+                                    pc_init_sig_handler, req);
+    if (state->sige == NULL) {
+        DEBUG(1, ("tevent_add_signal failed.\n"));
+        talloc_zfree(req);
+        return NULL;
+    }
 
-        /* Save the init request to the child context.
-         * This is technically a layering violation,
-         * but it's the only sane way to be able to
-         * identify which client is which when it
-         * connects to the backend in
-         * client_registration()
-         */
-        child_ctx->init_req = req;
+    /* Save the init request to the child context.
+     * This is technically a layering violation,
+     * but it's the only sane way to be able to
+     * identify which client is which when it
+     * connects to the backend in
+     * client_registration()
+     */
+    child_ctx->init_req = req;
 
-        /* Wait six seconds for the child to connect
-         * This is because the connection handler will add
-         * its own five-second timeout, and we don't want to
-         * be faster here.
-         */
-        tv = tevent_timeval_current_ofs(6, 0);
-        state->timeout = tevent_add_timer(auth_ctx->be->ev, req,
-                                          tv, pc_init_timeout, req);
+    /* Wait six seconds for the child to connect
+     * This is because the connection handler will add
+     * its own five-second timeout, and we don't want to
+     * be faster here.
+     */
+    tv = tevent_timeval_current_ofs(6, 0);
+    state->timeout = tevent_add_timer(auth_ctx->be->ev, req,
+                                      tv, pc_init_timeout, req);
 
-        /* processing will continue once the connection is received
-         * in proxy_client_init()
-         */
-        return req;
-    }
+    /* processing will continue once the connection is received
+     * in proxy_client_init()
+     */
+    return req;
 }
 
 static void pc_init_sig_handler(struct tevent_context *ev,
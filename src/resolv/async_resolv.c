@@ -62,6 +62,11 @@
 #endif
 
 #define DNS__16BIT(p)                   (((p)[0] << 8) | (p)[1])
+#define DNS__32BIT(p)                   ((uint32_t)(p)[0] << 24 | \
+                                         (uint32_t)(p)[1] << 16 | \
+                                         (uint32_t)(p)[2] << 8 | \
+                                         (uint32_t)(p)[3])
+#define DNS_HEADER_QDCOUNT(h)           DNS__16BIT((h) + 4)
 #define DNS_HEADER_ANCOUNT(h)           DNS__16BIT((h) + 6)
 
 #define RESOLV_TIMEOUTMS  5000
@@ -91,6 +96,9 @@ struct resolv_ctx {
      * if our pending requests didn't timeout. */
     int pending_requests;
     struct tevent_timer *timeout_watcher;
+
+    /* Cache of DNS answers, NULL if caching is disabled */
+    struct resolv_cache *cache;
 };
 
 struct request_watch {
@@ -492,6 +500,10 @@ void
 resolv_reread_configuration(struct resolv_ctx *ctx)
 {
     recreate_ares_channel(ctx);
+
+    /* The answers might have come from name servers that are no
+     * longer configured */
+    resolv_cache_flush(ctx);
 }
 
 static errno_t
@@ -666,6 +678,531 @@ fail:
     return NULL;
 }
 
+/*******************************************************************
+ * Cache of DNS answers                                            *
+ *******************************************************************/
+
+enum resolv_cache_type {
+    RESOLV_CACHE_A,
+    RESOLV_CACHE_AAAA,
+    RESOLV_CACHE_SRV
+};
+
+struct resolv_cache_entry {
+    struct resolv_cache_entry *prev;
+    struct resolv_cache_entry *next;
+
+    struct resolv_cache *cache;
+    enum resolv_cache_type type;
+    char *name;
+
+    /* ARES_SUCCESS for positive answers, ARES_ENOTFOUND or ARES_ENODATA
+     * for negative ones */
+    int status;
+    struct resolv_hostent *rhostent;
+    struct ares_srv_reply *reply_list;
+
+    time_t expire;
+    time_t prefetch;
+
+    /* Background refresh of this entry, allocated on the entry itself so
+     * that it is cancelled when the entry goes away */
+    struct tevent_req *prefetch_req;
+};
+
+struct resolv_cache {
+    struct resolv_ctx *ctx;
+    struct resolv_cache_entry *entries;
+
+    int max_ttl;
+    int negative_ttl;
+    int prefetch_percentage;
+};
+
+static struct tevent_req *
+resolv_gethostbyname_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                              struct resolv_ctx *ctx, const char *name,
+                              int family, bool use_cache);
+static int
+resolv_gethostbyname_dns_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                              int *status, int *timeouts,
+                              struct resolv_hostent **rhostent);
+static struct tevent_req *
+resolv_getsrv_send_ext(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                       struct resolv_ctx *ctx, const char *query,
+                       bool use_cache);
+
+static const char *
+resolv_cache_type_str(enum resolv_cache_type type)
+{
+    switch (type) {
+    case RESOLV_CACHE_A:
+        return "A";
+    case RESOLV_CACHE_AAAA:
+        return "AAAA";
+    case RESOLV_CACHE_SRV:
+        return "SRV";
+    }
+
+    return "unknown";
+}
+
+static int
+resolv_cache_entry_destructor(struct resolv_cache_entry *entry)
+{
+    DLIST_REMOVE(entry->cache->entries, entry);
+    return 0;
+}
+
+errno_t
+resolv_cache_init(struct resolv_ctx *ctx, int max_ttl,
+                  int negative_ttl, int prefetch_percentage)
+{
+    struct resolv_cache *cache;
+
+    talloc_zfree(ctx->cache);
+
+    if (max_ttl <= 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, ("DNS answer cache is disabled\n"));
+        return EOK;
+    }
+
+    if (prefetch_percentage < 0 || prefetch_percentage > 99) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              ("Invalid prefetch percentage %d, disabling prefetch\n",
+               prefetch_percentage));
+        prefetch_percentage = 0;
+    }
+
+    cache = talloc_zero(ctx, struct resolv_cache);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+
+    cache->ctx = ctx;
+    cache->max_ttl = max_ttl;
+    cache->negative_ttl = negative_ttl > 0 ? negative_ttl : 0;
+    cache->prefetch_percentage = prefetch_percentage;
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("DNS answer cache enabled: max TTL %d, negative TTL %d, "
+           "prefetch at %d%%\n", cache->max_ttl, cache->negative_ttl,
+           cache->prefetch_percentage));
+
+    ctx->cache = cache;
+    return EOK;
+}
+
+void
+resolv_cache_flush(struct resolv_ctx *ctx)
+{
+    if (ctx->cache == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Flushing the DNS answer cache\n"));
+    while (ctx->cache->entries != NULL) {
+        talloc_free(ctx->cache->entries);
+    }
+}
+
+static struct resolv_cache_entry *
+resolv_cache_find(struct resolv_cache *cache, enum resolv_cache_type type,
+                  const char *name)
+{
+    struct resolv_cache_entry *entry;
+
+    DLIST_FOR_EACH(entry, cache->entries) {
+        if (entry->type == type && strcasecmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static struct resolv_hostent *
+resolv_cache_copy_hostent(TALLOC_CTX *mem_ctx, struct resolv_hostent *src,
+                          int ttl)
+{
+    struct resolv_hostent *ret;
+    size_t addrlen;
+    int len;
+    int i;
+
+    ret = talloc_zero(mem_ctx, struct resolv_hostent);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->family = src->family;
+    addrlen = (src->family == AF_INET6) ? sizeof(struct in6_addr)
+                                        : sizeof(struct in_addr);
+
+    if (src->name != NULL) {
+        ret->name = talloc_strdup(ret, src->name);
+        if (ret->name == NULL) {
+            goto fail;
+        }
+    }
+
+    if (src->aliases != NULL) {
+        for (len = 0; src->aliases[len] != NULL; len++);
+
+        ret->aliases = talloc_array(ret, char *, len + 1);
+        if (ret->aliases == NULL) {
+            goto fail;
+        }
+
+        for (i = 0; i < len; i++) {
+            ret->aliases[i] = talloc_strdup(ret->aliases, src->aliases[i]);
+            if (ret->aliases[i] == NULL) {
+                goto fail;
+            }
+        }
+        ret->aliases[len] = NULL;
+    }
+
+    if (src->addr_list != NULL) {
+        for (len = 0; src->addr_list[len] != NULL; len++);
+
+        ret->addr_list = talloc_array(ret, struct resolv_addr *, len + 1);
+        if (ret->addr_list == NULL) {
+            goto fail;
+        }
+
+        for (i = 0; i < len; i++) {
+            ret->addr_list[i] = talloc_zero(ret->addr_list,
+                                            struct resolv_addr);
+            if (ret->addr_list[i] == NULL) {
+                goto fail;
+            }
+
+            ret->addr_list[i]->ipaddr = talloc_memdup(ret->addr_list[i],
+                                                 src->addr_list[i]->ipaddr,
+                                                 addrlen);
+            if (ret->addr_list[i]->ipaddr == NULL) {
+                goto fail;
+            }
+
+            /* A negative TTL keeps the TTL of the original answer */
+            ret->addr_list[i]->ttl = ttl < 0 ? src->addr_list[i]->ttl : ttl;
+        }
+        ret->addr_list[len] = NULL;
+    }
+
+    return ret;
+
+fail:
+    talloc_free(ret);
+    return NULL;
+}
+
+static struct ares_srv_reply *
+resolv_cache_copy_srv_reply(TALLOC_CTX *mem_ctx, struct ares_srv_reply *src)
+{
+    struct ares_srv_reply *new_list = NULL;
+    struct ares_srv_reply *ptr = NULL;
+    struct ares_srv_reply *item;
+
+    for (; src != NULL; src = src->next) {
+        item = talloc_zero(new_list ? (TALLOC_CTX *) new_list : mem_ctx,
+                           struct ares_srv_reply);
+        if (item == NULL) {
+            talloc_free(new_list);
+            return NULL;
+        }
+
+        item->weight = src->weight;
+        item->priority = src->priority;
+        item->port = src->port;
+        item->host = talloc_strdup(item, src->host);
+        if (item->host == NULL) {
+            talloc_free(item);
+            talloc_free(new_list);
+            return NULL;
+        }
+
+        if (new_list == NULL) {
+            new_list = item;
+        } else {
+            ptr->next = item;
+        }
+        ptr = item;
+    }
+
+    return new_list;
+}
+
+/*
+ * Returns the lowest TTL found in the answer section of a DNS reply
+ */
+static errno_t
+resolv_get_answer_ttl(const unsigned char *abuf, int alen, int *_ttl)
+{
+    const unsigned char *aptr;
+    unsigned int qdcount;
+    unsigned int ancount;
+    unsigned int i;
+    uint32_t rr_ttl;
+    uint32_t ttl = UINT32_MAX;
+    char *name;
+    long len;
+    int ret;
+
+    if (abuf == NULL || alen < NS_HFIXEDSZ) {
+        return EINVAL;
+    }
+
+    qdcount = DNS_HEADER_QDCOUNT(abuf);
+    ancount = DNS_HEADER_ANCOUNT(abuf);
+    aptr = abuf + NS_HFIXEDSZ;
+
+    /* Skip the question section */
+    for (i = 0; i < qdcount; i++) {
+        ret = ares_expand_name(aptr, abuf, alen, &name, &len);
+        if (ret != ARES_SUCCESS) {
+            return EINVAL;
+        }
+        ares_free_string(name);
+
+        aptr += len + NS_QFIXEDSZ;
+        if (aptr > abuf + alen) {
+            return EINVAL;
+        }
+    }
+
+    for (i = 0; i < ancount; i++) {
+        ret = ares_expand_name(aptr, abuf, alen, &name, &len);
+        if (ret != ARES_SUCCESS) {
+            return EINVAL;
+        }
+        ares_free_string(name);
+
+        aptr += len;
+        if (aptr + NS_RRFIXEDSZ > abuf + alen) {
+            return EINVAL;
+        }
+
+        /* type (2), class (2), TTL (4), data length (2) */
+        rr_ttl = DNS__32BIT(aptr + 4);
+        aptr += NS_RRFIXEDSZ + DNS__16BIT(aptr + 8);
+        if (aptr > abuf + alen) {
+            return EINVAL;
+        }
+
+        if (rr_ttl < ttl) {
+            ttl = rr_ttl;
+        }
+    }
+
+    if (ttl == UINT32_MAX) {
+        return ENOENT;
+    }
+
+    *_ttl = ttl > INT_MAX ? INT_MAX : ttl;
+    return EOK;
+}
+
+/*
+ * Store an answer in the cache. For positive answers 'ttl' is the TTL
+ * reported by the DNS server, negative answers use the configured
+ * negative TTL.
+ */
+static void
+resolv_cache_store(struct resolv_ctx *ctx, enum resolv_cache_type type,
+                   const char *name, int status, int ttl,
+                   struct resolv_hostent *rhostent,
+                   struct ares_srv_reply *reply_list)
+{
+    struct resolv_cache *cache = ctx->cache;
+    struct resolv_cache_entry *entry;
+    time_t now;
+
+    if (cache == NULL || name == NULL) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        if (ttl > cache->max_ttl) {
+            ttl = cache->max_ttl;
+        }
+    } else if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+        ttl = cache->negative_ttl;
+    } else {
+        /* Only authoritative answers are cached */
+        return;
+    }
+
+    entry = resolv_cache_find(cache, type, name);
+    if (ttl <= 0) {
+        if (entry != NULL) {
+            /* Never free the entry here, this might be running from
+             * its own prefetch request. Lookups purge expired entries. */
+            entry->expire = 0;
+        }
+        return;
+    }
+
+    if (entry == NULL) {
+        entry = talloc_zero(cache, struct resolv_cache_entry);
+        if (entry == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot allocate cache entry\n"));
+            return;
+        }
+
+        entry->cache = cache;
+        entry->type = type;
+        entry->name = talloc_strdup(entry, name);
+        if (entry->name == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot allocate cache entry\n"));
+            talloc_free(entry);
+            return;
+        }
+
+        DLIST_ADD(cache->entries, entry);
+        talloc_set_destructor(entry, resolv_cache_entry_destructor);
+    } else {
+        /* The entry is refreshed in place so that a prefetch request
+         * which is allocated on the entry survives */
+        talloc_zfree(entry->rhostent);
+        talloc_zfree(entry->reply_list);
+    }
+
+    entry->status = status;
+    entry->expire = 0;
+    if (rhostent != NULL) {
+        entry->rhostent = resolv_cache_copy_hostent(entry, rhostent, -1);
+        if (entry->rhostent == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot copy the answer\n"));
+            return;
+        }
+    }
+    if (reply_list != NULL) {
+        entry->reply_list = resolv_cache_copy_srv_reply(entry, reply_list);
+        if (entry->reply_list == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot copy the answer\n"));
+            return;
+        }
+    }
+
+    now = time(NULL);
+    entry->expire = now + ttl;
+    entry->prefetch = entry->expire;
+    if (status == ARES_SUCCESS && cache->prefetch_percentage > 0) {
+        entry->prefetch = now + (ttl * cache->prefetch_percentage) / 100;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          ("Cached %s %s answer for '%s' for %d seconds\n",
+           status == ARES_SUCCESS ? "positive" : "negative",
+           resolv_cache_type_str(type), name, ttl));
+}
+
+static void resolv_cache_prefetch_done(struct tevent_req *subreq);
+
+static void
+resolv_cache_prefetch(struct tevent_context *ev,
+                      struct resolv_cache_entry *entry)
+{
+    struct tevent_req *subreq;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Refreshing cached %s answer for '%s'\n",
+                              resolv_cache_type_str(entry->type),
+                              entry->name));
+
+    switch (entry->type) {
+    case RESOLV_CACHE_A:
+        subreq = resolv_gethostbyname_dns_send(entry, ev, entry->cache->ctx,
+                                               entry->name, AF_INET, false);
+        break;
+    case RESOLV_CACHE_AAAA:
+        subreq = resolv_gethostbyname_dns_send(entry, ev, entry->cache->ctx,
+                                               entry->name, AF_INET6, false);
+        break;
+    case RESOLV_CACHE_SRV:
+        subreq = resolv_getsrv_send_ext(entry, ev, entry->cache->ctx,
+                                        entry->name, false);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unknown cache entry type\n"));
+        return;
+    }
+
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Cannot start the DNS prefetch\n"));
+        return;
+    }
+
+    tevent_req_set_callback(subreq, resolv_cache_prefetch_done, entry);
+    entry->prefetch_req = subreq;
+}
+
+static void
+resolv_cache_prefetch_done(struct tevent_req *subreq)
+{
+    struct resolv_cache_entry *entry = tevent_req_callback_data(subreq,
+                                                struct resolv_cache_entry);
+    int status = 0;
+    errno_t ret;
+
+    /* The query itself already stored the new answer in the cache */
+    if (entry->type == RESOLV_CACHE_SRV) {
+        ret = resolv_getsrv_recv(NULL, subreq, &status, NULL, NULL);
+    } else {
+        ret = resolv_gethostbyname_dns_recv(subreq, NULL, &status,
+                                            NULL, NULL);
+    }
+    talloc_zfree(subreq);
+    entry->prefetch_req = NULL;
+
+    if (ret != EOK && ret != ENOENT) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Refreshing the cached answer for '%s' failed [%d]: %s\n",
+               entry->name, status, resolv_strerror(status)));
+    }
+}
+
+/*
+ * Find a valid entry in the cache. Expired entries are removed and a
+ * background refresh is started for entries that are about to expire.
+ */
+static struct resolv_cache_entry *
+resolv_cache_lookup(struct resolv_ctx *ctx, struct tevent_context *ev,
+                    enum resolv_cache_type type, const char *name)
+{
+    struct resolv_cache_entry *entry;
+    time_t now;
+
+    if (ctx->cache == NULL) {
+        return NULL;
+    }
+
+    entry = resolv_cache_find(ctx->cache, type, name);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    now = time(NULL);
+    if (now >= entry->expire) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, ("Cached %s answer for '%s' expired\n",
+                                      resolv_cache_type_str(type), name));
+        talloc_free(entry);
+        return NULL;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Using cached %s %s answer for '%s'\n",
+                              entry->status == ARES_SUCCESS ? "positive"
+                                                            : "negative",
+                              resolv_cache_type_str(type), name));
+
+    if (now >= entry->prefetch && entry->prefetch_req == NULL) {
+        resolv_cache_prefetch(ev, entry);
+    }
+
+    return entry;
+}
+
 /* =================== Resolve host name in files =========================*/
 struct gethostbyname_files_state {
     struct resolv_ctx *resolv_ctx;
@@ -788,14 +1325,20 @@ static int
 resolv_gethostbyname_dns_parse(struct gethostbyname_dns_state *state, int status,
                                int timeouts, unsigned char *abuf, int alen);
 
+static errno_t
+resolv_gethostbyname_dns_cached(struct gethostbyname_dns_state *state,
+                                struct resolv_cache_entry *entry);
+
 static struct tevent_req *
 resolv_gethostbyname_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
                               struct resolv_ctx *ctx, const char *name,
-                              int family)
+                              int family, bool use_cache)
 {
     struct tevent_req *req, *subreq;
     struct gethostbyname_dns_state *state;
+    struct resolv_cache_entry *entry = NULL;
     struct timeval tv = { 0, 0 };
+    errno_t ret;
 
     if (ctx->channel == NULL) {
         DEBUG(1, ("Invalid ares channel - this is likely a bug\n"));
@@ -816,6 +1359,24 @@ resolv_gethostbyname_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
     state->retrying = 0;
     state->family = family;
 
+    if (use_cache) {
+        entry = resolv_cache_lookup(ctx, ev,
+                                    family == AF_INET ? RESOLV_CACHE_A
+                                                      : RESOLV_CACHE_AAAA,
+                                    name);
+    }
+
+    if (entry != NULL) {
+        ret = resolv_gethostbyname_dns_cached(state, entry);
+        if (ret == EOK) {
+            tevent_req_done(req);
+        } else {
+            tevent_req_error(req, ret);
+        }
+        tevent_req_post(req, ev);
+        return req;
+    }
+
     /* We need to have a wrapper around ares async calls, because
      * they can in some cases call it's callback immediately.
      * This would not let our caller to set a callback for req. */
@@ -830,6 +1391,41 @@ resolv_gethostbyname_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
     return req;
 }
 
+static errno_t
+resolv_gethostbyname_dns_cached(struct gethostbyname_dns_state *state,
+                                struct resolv_cache_entry *entry)
+{
+    state->status = entry->status;
+    if (entry->status != ARES_SUCCESS) {
+        /* Same as a negative answer from the server */
+        return ENOENT;
+    }
+
+    /* Hand out the remaining lifetime of the entry as the TTL */
+    state->rhostent = resolv_cache_copy_hostent(state, entry->rhostent,
+                                                entry->expire - time(NULL));
+    if (state->rhostent == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static int
+resolv_hostent_min_ttl(struct resolv_hostent *rhostent)
+{
+    int ttl = -1;
+    int i;
+
+    for (i = 0; rhostent->addr_list[i] != NULL; i++) {
+        if (ttl == -1 || rhostent->addr_list[i]->ttl < ttl) {
+            ttl = rhostent->addr_list[i]->ttl;
+        }
+    }
+
+    return ttl;
+}
+
 static void
 resolv_gethostbyname_dns_wakeup(struct tevent_req *subreq)
 {
@@ -910,6 +1506,11 @@ resolv_gethostbyname_dns_query_done(void *arg, int status, int timeouts,
     }
 
     if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+        resolv_cache_store(state->resolv_ctx,
+                           state->family == AF_INET ? RESOLV_CACHE_A
+                                                    : RESOLV_CACHE_AAAA,
+                           state->name, status, 0, NULL, NULL);
+
         /* Just say we didn't find anything and let the caller decide
          * about retrying */
         tevent_req_error(req, ENOENT);
@@ -930,6 +1531,15 @@ resolv_gethostbyname_dns_query_done(void *arg, int status, int timeouts,
         return;
     }
 
+    if (state->rhostent != NULL) {
+        resolv_cache_store(state->resolv_ctx,
+                           state->family == AF_INET ? RESOLV_CACHE_A
+                                                    : RESOLV_CACHE_AAAA,
+                           state->name, status,
+                           resolv_hostent_min_ttl(state->rhostent),
+                           state->rhostent, NULL);
+    }
+
     tevent_req_done(req);
 }
 
@@ -1294,7 +1904,7 @@ resolv_gethostbyname_step(struct tevent_req *req)
             subreq = resolv_gethostbyname_dns_send(state, state->ev,
                                                    state->resolv_ctx,
                                                    state->name,
-                                                   state->family);
+                                                   state->family, true);
             break;
         default:
             DEBUG(1, ("Invalid hosts database\n"));
@@ -1578,9 +2188,18 @@ resolv_getsrv_query(struct tevent_req *req,
 struct tevent_req *
 resolv_getsrv_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
                    struct resolv_ctx *ctx, const char *query)
+{
+    return resolv_getsrv_send_ext(mem_ctx, ev, ctx, query, true);
+}
+
+static struct tevent_req *
+resolv_getsrv_send_ext(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                       struct resolv_ctx *ctx, const char *query,
+                       bool use_cache)
 {
     struct tevent_req *req, *subreq;
     struct getsrv_state *state;
+    struct resolv_cache_entry *entry = NULL;
     struct timeval tv = { 0, 0 };
 
     DEBUG(4, ("Trying to resolve SRV record of '%s'\n", query));
@@ -1602,6 +2221,27 @@ resolv_getsrv_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
     state->retrying = 0;
     state->ev = ev;
 
+    if (use_cache) {
+        entry = resolv_cache_lookup(ctx, ev, RESOLV_CACHE_SRV, query);
+    }
+
+    if (entry != NULL) {
+        state->status = entry->status;
+        if (entry->status != ARES_SUCCESS) {
+            tevent_req_error(req, return_code(entry->status));
+        } else {
+            state->reply_list = resolv_cache_copy_srv_reply(state,
+                                                        entry->reply_list);
+            if (state->reply_list == NULL) {
+                tevent_req_error(req, ENOMEM);
+            } else {
+                tevent_req_done(req);
+            }
+        }
+        tevent_req_post(req, ev);
+        return req;
+    }
+
     subreq = tevent_wakeup_send(req, ev, tv);
     if (subreq == NULL) {
         DEBUG(1, ("Failed to add critical timer to run next operation!\n"));
@@ -1620,6 +2260,7 @@ resolv_getsrv_done(void *arg, int status, int timeouts, unsigned char *abuf, int
     struct tevent_req *req;
     struct getsrv_state *state;
     int ret;
+    int ttl;
     struct ares_srv_reply *reply_list;
 
     if (rreq->rwatch == NULL) {
@@ -1644,6 +2285,8 @@ resolv_getsrv_done(void *arg, int status, int timeouts, unsigned char *abuf, int
     state->timeouts = timeouts;
 
     if (status != ARES_SUCCESS) {
+        resolv_cache_store(state->resolv_ctx, RESOLV_CACHE_SRV, state->query,
+                           status, 0, NULL, NULL);
         ret = return_code(status);
         goto fail;
     }
@@ -1660,6 +2303,12 @@ resolv_getsrv_done(void *arg, int status, int timeouts, unsigned char *abuf, int
     }
     state->reply_list = reply_list;
 
+    if (state->reply_list != NULL &&
+        resolv_get_answer_ttl(abuf, alen, &ttl) == EOK) {
+        resolv_cache_store(state->resolv_ctx, RESOLV_CACHE_SRV, state->query,
+                           status, ttl, NULL, state->reply_list);
+    }
+
     tevent_req_done(req);
     return;
 
@@ -60,6 +60,24 @@ int resolv_init(TALLOC_CTX *mem_ctx, struct tevent_context *ev_ctx,
 
 void resolv_reread_configuration(struct resolv_ctx *ctx);
 
+/*
+ * Enable caching of A, AAAA and SRV answers in the resolver context.
+ *
+ * Positive answers are kept for their DNS TTL, but never longer than
+ * 'max_ttl' seconds. Negative answers (the name or record does not exist)
+ * are kept for 'negative_ttl' seconds. When a positive entry is read after
+ * 'prefetch_percentage' of its lifetime has passed, it is refreshed in the
+ * background so that callers never wait for an expired entry. Setting
+ * 'prefetch_percentage' to 0 disables the prefetching.
+ *
+ * Setting 'max_ttl' to 0 disables the cache.
+ */
+errno_t resolv_cache_init(struct resolv_ctx *ctx, int max_ttl,
+                          int negative_ttl, int prefetch_percentage);
+
+/* Drop all cached answers */
+void resolv_cache_flush(struct resolv_ctx *ctx);
+
 const char *resolv_strerror(int ares_code);
 
 struct resolv_hostent *
@@ -36,6 +36,7 @@ struct sbus_method monitor_autofs_methods[] = {
     { MON_CLI_METHOD_PING, monitor_common_pong },
     { MON_CLI_METHOD_RES_INIT, monitor_common_res_init },
     { MON_CLI_METHOD_ROTATE, responder_logrotate },
+    { MON_CLI_METHOD_GET_STATS, monitor_common_get_stats },
     { MON_CLI_METHOD_CLEAR_ENUM_CACHE, autofs_clean_hash_table },
     { NULL, NULL }
 };
@@ -1472,6 +1472,7 @@ struct sss_cmd_table *get_autofs_cmds(void)
 {
     static struct sss_cmd_table autofs_cmds[] = {
         { SSS_GET_VERSION, sss_cmd_get_version },
+        { SSS_GET_STATS, sss_cmd_get_stats },
         { SSS_AUTOFS_SETAUTOMNTENT, sss_autofs_cmd_setautomntent },
         { SSS_AUTOFS_GETAUTOMNTENT, sss_autofs_cmd_getautomntent },
         { SSS_AUTOFS_GETAUTOMNTBYNAME, sss_autofs_cmd_getautomntbyname },
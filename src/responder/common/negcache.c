@@ -20,6 +20,7 @@
 */
 
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "confdb/confdb.h"
 #include "responder/common/responder.h"
 #include <fcntl.h>
@@ -130,6 +131,10 @@ done:
         ret = ENOENT;
     }
 
+    if (ret == EEXIST) {
+        sss_stats_inc("negative_cache_hit");
+    }
+
     free(data.dptr);
     return ret;
 }
@@ -48,6 +48,9 @@ struct cli_request {
 
     /* reply data */
     struct sss_packet *out;
+
+    /* when the request started to arrive, for the statistics */
+    struct timeval start;
 };
 
 struct cli_protocol_version {
@@ -57,6 +60,9 @@ struct cli_protocol_version {
 };
 
 struct resp_ctx;
+struct dp_bin_conn;
+struct sss_dp_bin_call;
+struct sss_dp_batch;
 
 struct be_conn {
     struct be_conn *next;
@@ -70,6 +76,20 @@ struct be_conn {
     char *sbus_address;
     struct sbus_interface *intf;
     struct sbus_connection *conn;
+
+    /* Binary channel for the account requests, connected on first use.
+     * D-Bus is used until bin_retry after the channel failed. */
+    bool use_bin;
+    char *bin_address;
+    struct dp_bin_conn *bin;
+    time_t bin_retry;
+    struct sss_dp_bin_call *bin_calls;
+
+    /* User lookups by name wait up to batch_window milliseconds to be
+     * sent to the DP together, at most batch_max of them at once */
+    int batch_window;
+    int batch_max;
+    struct sss_dp_batch *batches;
 };
 
 struct resp_ctx {
@@ -180,11 +200,15 @@ int sss_cmd_send_empty(struct cli_ctx *cctx, TALLOC_CTX *freectx);
 int sss_cmd_send_error(struct cli_ctx *cctx, int err);
 void sss_cmd_done(struct cli_ctx *cctx, void *freectx);
 int sss_cmd_get_version(struct cli_ctx *cctx);
+const char *sss_cmd_name(enum sss_cli_command cmd);
 int sss_cmd_execute(struct cli_ctx *cctx,
                     enum sss_cli_command cmd,
                     struct sss_cmd_table *sss_cmds);
 struct cli_protocol_version *register_cli_protocol_version(void);
 
+/* responder_stats.c */
+int sss_cmd_get_stats(struct cli_ctx *cctx);
+
 struct setent_req_list;
 
 /* A facility for notifying setent requests */
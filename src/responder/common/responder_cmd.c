@@ -141,6 +141,102 @@ int sss_cmd_get_version(struct cli_ctx *cctx)
     return EOK;
 }
 
+const char *sss_cmd_name(enum sss_cli_command cmd)
+{
+    switch (cmd) {
+    case SSS_GET_VERSION:
+        return "get_version";
+    case SSS_GET_STATS:
+        return "get_stats";
+    case SSS_NSS_GETPWNAM:
+        return "getpwnam";
+    case SSS_NSS_GETPWUID:
+        return "getpwuid";
+    case SSS_NSS_SETPWENT:
+        return "setpwent";
+    case SSS_NSS_GETPWENT:
+        return "getpwent";
+    case SSS_NSS_ENDPWENT:
+        return "endpwent";
+    case SSS_NSS_GETGRNAM:
+        return "getgrnam";
+    case SSS_NSS_GETGRGID:
+        return "getgrgid";
+    case SSS_NSS_SETGRENT:
+        return "setgrent";
+    case SSS_NSS_GETGRENT:
+        return "getgrent";
+    case SSS_NSS_ENDGRENT:
+        return "endgrent";
+    case SSS_NSS_INITGR:
+        return "initgroups";
+    case SSS_NSS_SETNETGRENT:
+        return "setnetgrent";
+    case SSS_NSS_GETNETGRENT:
+        return "getnetgrent";
+    case SSS_NSS_ENDNETGRENT:
+        return "endnetgrent";
+    case SSS_NSS_INNETGR:
+        return "innetgr";
+    case SSS_NSS_GETSERVBYNAME:
+        return "getservbyname";
+    case SSS_NSS_GETSERVBYPORT:
+        return "getservbyport";
+    case SSS_NSS_SETSERVENT:
+        return "setservent";
+    case SSS_NSS_GETSERVENT:
+        return "getservent";
+    case SSS_NSS_ENDSERVENT:
+        return "endservent";
+    case SSS_SUDO_GET_SUDORULES:
+        return "sudo_get_rules";
+    case SSS_SUDO_GET_DEFAULTS:
+        return "sudo_get_defaults";
+    case SSS_AUTOFS_SETAUTOMNTENT:
+        return "setautomntent";
+    case SSS_AUTOFS_GETAUTOMNTENT:
+        return "getautomntent";
+    case SSS_AUTOFS_GETAUTOMNTBYNAME:
+        return "getautomntbyname";
+    case SSS_AUTOFS_ENDAUTOMNTENT:
+        return "endautomntent";
+    case SSS_SSH_GET_USER_PUBKEYS:
+        return "ssh_user_pubkeys";
+    case SSS_SSH_GET_HOST_PUBKEYS:
+        return "ssh_host_pubkeys";
+    case SSS_PAM_AUTHENTICATE:
+        return "pam_authenticate";
+    case SSS_PAM_SETCRED:
+        return "pam_setcred";
+    case SSS_PAM_ACCT_MGMT:
+        return "pam_acct_mgmt";
+    case SSS_PAM_OPEN_SESSION:
+        return "pam_open_session";
+    case SSS_PAM_CLOSE_SESSION:
+        return "pam_close_session";
+    case SSS_PAM_CHAUTHTOK:
+        return "pam_chauthtok";
+    case SSS_PAM_CHAUTHTOK_PRELIM:
+        return "pam_chauthtok_prelim";
+    case SSS_CMD_RENEW:
+        return "renew";
+    case SSS_PAC_ADD_PAC_USER:
+        return "pac_add_user";
+    case SSS_NSS_GETSIDBYNAME:
+        return "getsidbyname";
+    case SSS_NSS_GETSIDBYID:
+        return "getsidbyid";
+    case SSS_NSS_GETNAMEBYSID:
+        return "getnamebysid";
+    case SSS_NSS_GETIDBYSID:
+        return "getidbysid";
+    default:
+        break;
+    }
+
+    return "unknown";
+}
+
 int sss_cmd_execute(struct cli_ctx *cctx,
                     enum sss_cli_command cmd,
                     struct sss_cmd_table *sss_cmds)
@@ -34,6 +34,7 @@
 #include <popt.h>
 #include "util/util.h"
 #include "util/strtonum.h"
+#include "util/sss_stats.h"
 #include "db/sysdb.h"
 #include "confdb/confdb.h"
 #include "dbus/dbus.h"
@@ -255,6 +256,10 @@ static void client_send(struct cli_ctx *cctx)
     }
 
     /* ok all sent */
+    sss_stats_time(sss_cmd_name(sss_packet_get_cmd(cctx->creq->out)),
+                   &cctx->creq->start,
+                   sss_packet_get_error(cctx->creq->out) != EOK);
+
     TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
     TEVENT_FD_READABLE(cctx->cfde);
     talloc_free(cctx->creq);
@@ -281,6 +286,7 @@ static void client_recv(struct cli_ctx *cctx)
             talloc_free(cctx);
             return;
         }
+        sss_stats_start(&cctx->creq->start);
     }
 
     if (!cctx->creq->in) {
@@ -529,6 +535,7 @@ static int sss_dp_init(struct resp_ctx *rctx,
                        struct sss_domain_info *domain)
 {
     struct be_conn *be_conn;
+    char *conf_path;
     int ret;
 
     be_conn = talloc_zero(rctx, struct be_conn);
@@ -545,6 +552,51 @@ static int sss_dp_init(struct resp_ctx *rctx,
         DEBUG(0, ("Could not locate DP address.\n"));
         return ret;
     }
+
+    conf_path = talloc_asprintf(be_conn, CONFDB_DOMAIN_PATH_TMPL,
+                                domain->name);
+    if (!conf_path) return ENOMEM;
+
+    ret = confdb_get_bool(rctx->cdb, conf_path, CONFDB_DOMAIN_BINARY_IPC,
+                          false, &be_conn->use_bin);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read [%s] from confdb\n",
+                                    CONFDB_DOMAIN_BINARY_IPC));
+        talloc_free(conf_path);
+        return ret;
+    }
+
+    ret = confdb_get_int(rctx->cdb, conf_path, CONFDB_DOMAIN_DP_BATCH_WINDOW,
+                         0, &be_conn->batch_window);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read [%s] from confdb\n",
+                                    CONFDB_DOMAIN_DP_BATCH_WINDOW));
+        talloc_free(conf_path);
+        return ret;
+    }
+
+    ret = confdb_get_int(rctx->cdb, conf_path, CONFDB_DOMAIN_DP_BATCH_MAX,
+                         50, &be_conn->batch_max);
+    talloc_free(conf_path);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot read [%s] from confdb\n",
+                                    CONFDB_DOMAIN_DP_BATCH_MAX));
+        return ret;
+    }
+    if (be_conn->batch_max < 2) {
+        /* a batch of one is a plain request */
+        be_conn->batch_window = 0;
+    }
+
+    if (be_conn->use_bin) {
+        ret = dp_get_bin_address(be_conn, &be_conn->bin_address,
+                                 domain->name);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("Could not locate the DP binary channel.\n"));
+            return ret;
+        }
+    }
     ret = sbus_client_init(rctx, rctx->ev,
                            be_conn->sbus_address,
                            intf, &be_conn->conn,
@@ -23,6 +23,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "responder/common/responder_packet.h"
 #include "responder/common/responder.h"
 #include "providers/data_provider.h"
@@ -38,6 +39,57 @@ struct sss_dp_callback {
     struct sss_dp_req *sdp_req;
 };
 
+/* Request waiting for its reply on the binary channel */
+struct sss_dp_bin_call {
+    struct sss_dp_bin_call *prev;
+    struct sss_dp_bin_call *next;
+
+    struct be_conn *be_conn;
+    uint32_t serial;
+    struct tevent_timer *te;
+
+    /* the dp_internal_get request */
+    struct tevent_req *req;
+};
+
+/* Builds the binary equivalent of a D-Bus request */
+typedef errno_t (sss_dp_bin_constructor)(TALLOC_CTX *mem_ctx, void *pvt,
+                                         uint32_t *type, uint8_t **body,
+                                         size_t *body_len);
+
+/* How long to stay with D-Bus after the binary channel failed */
+#define SSS_DP_BIN_RETRY 30
+
+/* User lookups by name waiting to be sent to the DP in one message */
+struct sss_dp_batch {
+    struct sss_dp_batch *prev;
+    struct sss_dp_batch *next;
+
+    struct be_conn *be_conn;
+    struct sss_domain_info *dom;
+    uint32_t be_type;
+
+    /* set once no more lookups can join, the batch is then no longer
+     * in the list of the be_conn */
+    bool closed;
+    struct tevent_timer *te;
+    DBusPendingCall *pending_reply;
+
+    struct sss_dp_batch_member *members;
+    int count;
+};
+
+struct sss_dp_batch_member {
+    struct sss_dp_batch_member *prev;
+    struct sss_dp_batch_member *next;
+
+    struct sss_dp_batch *batch;
+    char *name;
+
+    /* the dp_internal_get request */
+    struct tevent_req *req;
+};
+
 struct sss_dp_req {
     struct resp_ctx *rctx;
     struct tevent_context *ev;
@@ -50,6 +102,8 @@ struct sss_dp_req {
     dbus_uint16_t dp_err;
     dbus_uint32_t dp_ret;
     char *err_msg;
+
+    struct timeval start;
 };
 
 static int sss_dp_callback_destructor(void *ptr)
@@ -243,16 +297,19 @@ static struct tevent_req *
 sss_dp_internal_get_send(struct resp_ctx *rctx,
                          hash_key_t *key,
                          struct sss_domain_info *dom,
-                         DBusMessage *msg);
+                         dbus_msg_constructor msg_create,
+                         sss_dp_bin_constructor bin_create,
+                         void *pvt);
 
 static void
 sss_dp_req_done(struct tevent_req *sidereq);
 
-errno_t
-sss_dp_issue_request(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
-                     const char *strkey, struct sss_domain_info *dom,
-                     dbus_msg_constructor msg_create, void *pvt,
-                     struct tevent_req *nreq)
+static errno_t
+sss_dp_issue_request_ext(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
+                         const char *strkey, struct sss_domain_info *dom,
+                         dbus_msg_constructor msg_create,
+                         sss_dp_bin_constructor bin_create, void *pvt,
+                         struct tevent_req *nreq)
 {
     int hret;
     hash_value_t value;
@@ -262,7 +319,6 @@ sss_dp_issue_request(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
     struct sss_dp_callback *cb;
     struct tevent_timer *te;
     struct timeval tv;
-    DBusMessage *msg;
     TALLOC_CTX *tmp_ctx = NULL;
     errno_t ret;
 
@@ -293,24 +349,18 @@ sss_dp_issue_request(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
         /* Request already in progress */
         DEBUG(SSSDBG_TRACE_FUNC,
               ("Identical request in progress: [%s]\n", key->str));
+        sss_stats_inc("dp_request_joined");
         break;
 
     case HASH_ERROR_KEY_NOT_FOUND:
         /* No such request in progress
          * Create a new request
          */
-        msg = msg_create(pvt);
-        if (!msg) {
-            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot create D-Bus message\n"));
-            ret = EIO;
-            goto fail;
-        }
-
         value.type = HASH_VALUE_PTR;
-        sidereq = sss_dp_internal_get_send(rctx, key, dom, msg);
-        dbus_message_unref(msg);
+        sidereq = sss_dp_internal_get_send(rctx, key, dom,
+                                           msg_create, bin_create, pvt);
         if (!sidereq) {
-            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot send D-Bus message\n"));
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot send the request\n"));
             ret = EIO;
             goto fail;
         }
@@ -377,6 +427,16 @@ fail:
     return ret;
 }
 
+errno_t
+sss_dp_issue_request(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
+                     const char *strkey, struct sss_domain_info *dom,
+                     dbus_msg_constructor msg_create, void *pvt,
+                     struct tevent_req *nreq)
+{
+    return sss_dp_issue_request_ext(mem_ctx, rctx, strkey, dom,
+                                    msg_create, NULL, pvt, nreq);
+}
+
 static void
 sss_dp_req_done(struct tevent_req *sidereq)
 {
@@ -421,6 +481,9 @@ sss_dp_req_recv(TALLOC_CTX *mem_ctx,
  * the data provider action.
  */
 static DBusMessage *sss_dp_get_account_msg(void *pvt);
+static errno_t sss_dp_get_account_bin(TALLOC_CTX *mem_ctx, void *pvt,
+                                      uint32_t *type, uint8_t **body,
+                                      size_t *body_len);
 
 struct sss_dp_account_info {
     struct sss_domain_info *dom;
@@ -495,8 +558,9 @@ sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
         goto error;
     }
 
-    ret = sss_dp_issue_request(state, rctx, key, dom, sss_dp_get_account_msg,
-                               info, req);
+    ret = sss_dp_issue_request_ext(state, rctx, key, dom,
+                                   sss_dp_get_account_msg,
+                                   sss_dp_get_account_bin, info, req);
     talloc_free(key);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
@@ -513,18 +577,13 @@ error:
     return req;
 }
 
-static DBusMessage *
-sss_dp_get_account_msg(void *pvt)
+static char *
+sss_dp_get_account_filter(struct sss_dp_account_info *info,
+                          uint32_t *_be_type)
 {
-    DBusMessage *msg;
-    dbus_bool_t dbret;
-    struct sss_dp_account_info *info;
     uint32_t be_type;
-    uint32_t attrs = BE_ATTR_CORE;
     char *filter;
 
-    info = talloc_get_type(pvt, struct sss_dp_account_info);
-
     switch (info->type) {
         case SSS_DP_USER:
             be_type = BE_REQ_USER;
@@ -585,6 +644,27 @@ sss_dp_get_account_msg(void *pvt)
         return NULL;
     }
 
+    *_be_type = be_type;
+    return filter;
+}
+
+static DBusMessage *
+sss_dp_get_account_msg(void *pvt)
+{
+    DBusMessage *msg;
+    dbus_bool_t dbret;
+    struct sss_dp_account_info *info;
+    uint32_t be_type;
+    uint32_t attrs = BE_ATTR_CORE;
+    char *filter;
+
+    info = talloc_get_type(pvt, struct sss_dp_account_info);
+
+    filter = sss_dp_get_account_filter(info, &be_type);
+    if (!filter) {
+        return NULL;
+    }
+
     msg = dbus_message_new_method_call(NULL,
                                        DP_PATH,
                                        DP_INTERFACE,
@@ -616,6 +696,48 @@ sss_dp_get_account_msg(void *pvt)
     return msg;
 }
 
+static errno_t
+sss_dp_get_account_bin(TALLOC_CTX *mem_ctx, void *pvt,
+                       uint32_t *type, uint8_t **body, size_t *body_len)
+{
+    struct sss_dp_account_info *info;
+    uint32_t be_type;
+    char *filter;
+    errno_t ret;
+
+    info = talloc_get_type(pvt, struct sss_dp_account_info);
+
+    filter = sss_dp_get_account_filter(info, &be_type);
+    if (!filter) {
+        return ENOMEM;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Creating binary request for [%s][%u][%d][%s]\n",
+           info->dom->name, be_type, BE_ATTR_CORE, filter));
+
+    *body = NULL;
+    *body_len = 0;
+    ret = dp_bin_add_uint32(mem_ctx, body, body_len, be_type);
+    if (ret == EOK) {
+        ret = dp_bin_add_uint32(mem_ctx, body, body_len, BE_ATTR_CORE);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_add_string(mem_ctx, body, body_len, filter);
+    }
+    if (ret == EOK) {
+        ret = dp_bin_add_string(mem_ctx, body, body_len, info->dom->name);
+    }
+    talloc_free(filter);
+    if (ret != EOK) {
+        talloc_zfree(*body);
+        return ret;
+    }
+
+    *type = DP_BIN_GETACCTINFO;
+    return EOK;
+}
+
 errno_t
 sss_dp_get_account_recv(TALLOC_CTX *mem_ctx,
                         struct tevent_req *req,
@@ -635,12 +757,22 @@ struct dp_internal_get_state {
 };
 
 static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr);
+static void sss_dp_internal_get_finish(struct tevent_req *req, errno_t ret);
+static errno_t sss_dp_bin_send(struct be_conn *be_conn,
+                               struct tevent_req *req,
+                               sss_dp_bin_constructor bin_create,
+                               void *pvt);
+static errno_t sss_dp_batch_add(struct be_conn *be_conn,
+                                struct tevent_req *req,
+                                struct sss_dp_account_info *info);
 
 static struct tevent_req *
 sss_dp_internal_get_send(struct resp_ctx *rctx,
                          hash_key_t *key,
                          struct sss_domain_info *dom,
-                         DBusMessage *msg)
+                         dbus_msg_constructor msg_create,
+                         sss_dp_bin_constructor bin_create,
+                         void *pvt)
 {
     errno_t ret;
     int hret;
@@ -648,6 +780,7 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
     struct dp_internal_get_state *state;
     struct be_conn *be_conn;
     hash_value_t value;
+    DBusMessage *msg;
 
     /* Internal requests need to be allocated on the responder context
      * so that they don't go away if a client disconnects. The worst-
@@ -669,6 +802,7 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
     }
     state->sdp_req->rctx = rctx;
     state->sdp_req->ev = rctx->ev;
+    sss_stats_start(&state->sdp_req->start);
 
     /* Copy the key to use when calling the destructor
      * It needs to be a copy because the original request
@@ -689,20 +823,41 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
         goto error;
     }
 
-    ret = sbus_conn_send(be_conn->conn, msg,
-                         SSS_CLI_SOCKET_TIMEOUT / 2,
-                         sss_dp_internal_get_done,
-                         req,
-                         &state->sdp_req->pending_reply);
+    ret = EAGAIN;
+    if (msg_create == sss_dp_get_account_msg) {
+        ret = sss_dp_batch_add(be_conn, req,
+                               talloc_get_type(pvt,
+                                               struct sss_dp_account_info));
+    }
+
+    if (ret != EOK && bin_create && be_conn->use_bin) {
+        ret = sss_dp_bin_send(be_conn, req, bin_create, pvt);
+    }
+
     if (ret != EOK) {
-        /*
-         * Critical Failure
-         * We can't communicate on this connection
-         */
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              ("D-BUS send failed.\n"));
-        ret = EIO;
-        goto error;
+        msg = msg_create(pvt);
+        if (!msg) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot create D-Bus message\n"));
+            ret = EIO;
+            goto error;
+        }
+
+        ret = sbus_conn_send(be_conn->conn, msg,
+                             SSS_CLI_SOCKET_TIMEOUT / 2,
+                             sss_dp_internal_get_done,
+                             req,
+                             &state->sdp_req->pending_reply);
+        dbus_message_unref(msg);
+        if (ret != EOK) {
+            /*
+             * Critical Failure
+             * We can't communicate on this connection
+             */
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("D-BUS send failed.\n"));
+            ret = EIO;
+            goto error;
+        }
     }
 
     /* Add this sdp_req to the hash table */
@@ -734,9 +889,7 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
     int ret;
     struct tevent_req *req;
     struct sss_dp_req *sdp_req;
-    struct sss_dp_callback *cb;
     struct dp_internal_get_state *state;
-    struct sss_dp_req_state *cb_state;
 
     req = talloc_get_type(ptr, struct tevent_req);
     state = tevent_req_data(req, struct dp_internal_get_state);
@@ -749,6 +902,20 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
                            &sdp_req->dp_err,
                            &sdp_req->dp_ret,
                            &sdp_req->err_msg);
+
+    sss_dp_internal_get_finish(req, ret);
+}
+
+static void sss_dp_internal_get_finish(struct tevent_req *req, errno_t ret)
+{
+    struct sss_dp_req *sdp_req;
+    struct sss_dp_callback *cb;
+    struct dp_internal_get_state *state;
+    struct sss_dp_req_state *cb_state;
+
+    state = tevent_req_data(req, struct dp_internal_get_state);
+    sdp_req = state->sdp_req;
+
     if (ret != EOK) {
         if (ret == ETIME) {
             sdp_req->dp_err = DP_ERR_TIMEOUT;
@@ -764,6 +931,9 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
         }
     }
 
+    sss_stats_time(SSS_STATS_DP_REQUEST, &sdp_req->start,
+                   ret != EOK || sdp_req->dp_err != DP_ERR_OK);
+
     /* Check whether we need to issue any callbacks */
     while ((cb = sdp_req->cb_list) != NULL) {
         cb_state = tevent_req_data(cb->req, struct sss_dp_req_state);
@@ -810,3 +980,458 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
         tevent_req_error(req, ret);
     }
 }
+
+/* Binary channel */
+
+static int sss_dp_bin_call_destructor(struct sss_dp_bin_call *call)
+{
+    if (call->be_conn) {
+        DLIST_REMOVE(call->be_conn->bin_calls, call);
+    }
+    return 0;
+}
+
+static int sss_dp_be_conn_destructor(struct be_conn *be_conn)
+{
+    struct sss_dp_bin_call *call;
+
+    /* the requests may outlive the connection when the responder shuts
+     * down */
+    for (call = be_conn->bin_calls; call; call = call->next) {
+        call->be_conn = NULL;
+    }
+    return 0;
+}
+
+static void sss_dp_bin_call_timeout(struct tevent_context *ev,
+                                    struct tevent_timer *te,
+                                    struct timeval t, void *ptr)
+{
+    struct sss_dp_bin_call *call;
+    struct tevent_req *req;
+
+    call = talloc_get_type(ptr, struct sss_dp_bin_call);
+    req = call->req;
+
+    DEBUG(SSSDBG_MINOR_FAILURE, ("Binary request [%u] timed out\n",
+                                 call->serial));
+
+    talloc_free(call);
+    sss_dp_internal_get_finish(req, ETIME);
+}
+
+static void sss_dp_bin_frame(struct dp_bin_conn *conn,
+                             uint32_t type, uint32_t serial,
+                             const uint8_t *body, size_t body_len,
+                             void *pvt)
+{
+    struct be_conn *be_conn = talloc_get_type(pvt, struct be_conn);
+    struct dp_internal_get_state *state;
+    struct sss_dp_bin_call *call;
+    struct sss_dp_req *sdp_req;
+    struct tevent_req *req;
+    uint32_t dp_err;
+    uint32_t dp_ret;
+    const char *err_msg;
+    size_t pos = 0;
+    errno_t ret;
+
+    for (call = be_conn->bin_calls; call; call = call->next) {
+        if (call->serial == serial) break;
+    }
+    if (!call) {
+        /* the request timed out or was cancelled */
+        DEBUG(SSSDBG_TRACE_FUNC, ("No request for binary reply [%u]\n",
+                                  serial));
+        return;
+    }
+
+    req = call->req;
+    state = tevent_req_data(req, struct dp_internal_get_state);
+    sdp_req = state->sdp_req;
+    talloc_free(call);
+
+    ret = EIO;
+    if (type == (DP_BIN_GETACCTINFO | DP_BIN_REPLY)) {
+        ret = dp_bin_get_uint32(body, body_len, &pos, &dp_err);
+        if (ret == EOK) {
+            ret = dp_bin_get_uint32(body, body_len, &pos, &dp_ret);
+        }
+        if (ret == EOK) {
+            ret = dp_bin_get_string(body, body_len, &pos, &err_msg);
+        }
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to parse binary reply [%u] "
+                                    "of type [%#x]\n", serial, type));
+        sss_dp_internal_get_finish(req, EIO);
+        return;
+    }
+
+    sdp_req->dp_err = dp_err;
+    sdp_req->dp_ret = dp_ret;
+    sdp_req->err_msg = talloc_strdup(sdp_req, err_msg);
+
+    DEBUG(SSSDBG_TRACE_LIBS,
+          ("Got binary reply from Data Provider - "
+           "DP error code: %u errno: %u error message: %s\n",
+           dp_err, dp_ret, err_msg));
+
+    sss_dp_internal_get_finish(req, EOK);
+}
+
+static void sss_dp_bin_close(struct dp_bin_conn *conn, void *pvt)
+{
+    struct be_conn *be_conn = talloc_get_type(pvt, struct be_conn);
+    struct sss_dp_bin_call *call;
+    struct tevent_req *req;
+
+    DEBUG(SSSDBG_MINOR_FAILURE,
+          ("Binary channel to [%s] closed, using D-Bus for %d seconds\n",
+           be_conn->domain->name, SSS_DP_BIN_RETRY));
+
+    talloc_zfree(be_conn->bin);
+    be_conn->bin_retry = time(NULL) + SSS_DP_BIN_RETRY;
+
+    /* same as when the D-Bus connection is lost */
+    while ((call = be_conn->bin_calls) != NULL) {
+        req = call->req;
+        talloc_free(call);
+        sss_dp_internal_get_finish(req, EIO);
+    }
+}
+
+static errno_t sss_dp_bin_get_conn(struct be_conn *be_conn)
+{
+    errno_t ret;
+
+    if (be_conn->bin) {
+        return EOK;
+    }
+
+    if (time(NULL) < be_conn->bin_retry) {
+        return EAGAIN;
+    }
+
+    ret = dp_bin_connect(be_conn, be_conn->rctx->ev, be_conn->bin_address,
+                         &be_conn->bin);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot open binary channel to [%s], using D-Bus for %d "
+               "seconds [%d]: %s\n", be_conn->domain->name,
+               SSS_DP_BIN_RETRY, ret, strerror(ret)));
+        be_conn->bin_retry = time(NULL) + SSS_DP_BIN_RETRY;
+        return ret;
+    }
+
+    dp_bin_set_handlers(be_conn->bin, sss_dp_bin_frame, sss_dp_bin_close,
+                        be_conn);
+    talloc_set_destructor(be_conn, sss_dp_be_conn_destructor);
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Opened binary channel to [%s]\n",
+                              be_conn->domain->name));
+    return EOK;
+}
+
+/* Returns an error if the request should go over D-Bus instead */
+static errno_t sss_dp_bin_send(struct be_conn *be_conn,
+                               struct tevent_req *req,
+                               sss_dp_bin_constructor bin_create,
+                               void *pvt)
+{
+    struct dp_internal_get_state *state;
+    struct sss_dp_bin_call *call;
+    struct timeval tv;
+    uint8_t *body = NULL;
+    size_t body_len = 0;
+    uint32_t type;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct dp_internal_get_state);
+
+    ret = sss_dp_bin_get_conn(be_conn);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    call = talloc_zero(state->sdp_req, struct sss_dp_bin_call);
+    if (!call) {
+        return ENOMEM;
+    }
+    call->be_conn = be_conn;
+    call->req = req;
+    call->serial = dp_bin_next_serial(be_conn->bin);
+
+    tv = tevent_timeval_current_ofs(SSS_CLI_SOCKET_TIMEOUT / 2000, 0);
+    call->te = tevent_add_timer(be_conn->rctx->ev, call, tv,
+                                sss_dp_bin_call_timeout, call);
+    if (!call->te) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = bin_create(call, pvt, &type, &body, &body_len);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = dp_bin_send(be_conn->bin, type, call->serial, body, body_len);
+    talloc_free(body);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Binary send failed [%d]: %s\n", ret, strerror(ret)));
+        goto done;
+    }
+
+    DLIST_ADD(be_conn->bin_calls, call);
+    talloc_set_destructor(call, sss_dp_bin_call_destructor);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(call);
+    }
+    return ret;
+}
+
+/* Batches */
+
+static int sss_dp_batch_member_destructor(struct sss_dp_batch_member *member)
+{
+    if (member->batch) {
+        DLIST_REMOVE(member->batch->members, member);
+        member->batch->count--;
+    }
+    return 0;
+}
+
+static int sss_dp_batch_destructor(struct sss_dp_batch *batch)
+{
+    struct sss_dp_batch_member *member;
+
+    if (batch->pending_reply) {
+        dbus_pending_call_cancel(batch->pending_reply);
+        batch->pending_reply = NULL;
+    }
+
+    if (!batch->closed) {
+        DLIST_REMOVE(batch->be_conn->batches, batch);
+    }
+
+    /* the requests still end with their own timeout */
+    for (member = batch->members; member; member = member->next) {
+        member->batch = NULL;
+    }
+    return 0;
+}
+
+static void sss_dp_batch_finish(struct sss_dp_batch *batch, errno_t ret,
+                                dbus_uint16_t dp_err, dbus_uint32_t dp_ret,
+                                const char *err_msg)
+{
+    struct sss_dp_batch_member *member;
+    struct dp_internal_get_state *state;
+    struct tevent_req *req;
+
+    /* all the names share the result of the batch */
+    while ((member = batch->members) != NULL) {
+        req = member->req;
+        state = tevent_req_data(req, struct dp_internal_get_state);
+        talloc_free(member);
+
+        if (ret == EOK) {
+            state->sdp_req->dp_err = dp_err;
+            state->sdp_req->dp_ret = dp_ret;
+            state->sdp_req->err_msg = talloc_strdup(state->sdp_req, err_msg);
+        }
+        sss_dp_internal_get_finish(req, ret);
+    }
+
+    talloc_free(batch);
+}
+
+static void sss_dp_batch_done(DBusPendingCall *pending, void *ptr)
+{
+    struct sss_dp_batch *batch = talloc_get_type(ptr, struct sss_dp_batch);
+    dbus_uint16_t dp_err;
+    dbus_uint32_t dp_ret;
+    char *err_msg = NULL;
+    errno_t ret;
+
+    /* prevent trying to cancel a reply that we already received */
+    batch->pending_reply = NULL;
+
+    ret = sss_dp_get_reply(pending, &dp_err, &dp_ret, &err_msg);
+
+    sss_dp_batch_finish(batch, ret, dp_err, dp_ret, err_msg);
+}
+
+static void sss_dp_batch_send(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval t, void *ptr)
+{
+    struct sss_dp_batch *batch = talloc_get_type(ptr, struct sss_dp_batch);
+    struct sss_dp_batch_member *member;
+    uint32_t attrs = BE_ATTR_CORE;
+    DBusMessage *msg;
+    dbus_bool_t dbret;
+    const char **names;
+    int count = 0;
+    errno_t ret;
+
+    batch->te = NULL;
+    if (!batch->closed) {
+        DLIST_REMOVE(batch->be_conn->batches, batch);
+        batch->closed = true;
+    }
+
+    if (batch->count == 0) {
+        /* all the requests went away in the meantime */
+        talloc_free(batch);
+        return;
+    }
+
+    names = talloc_array(batch, const char *, batch->count);
+    if (!names) {
+        ret = ENOMEM;
+        goto done;
+    }
+    for (member = batch->members; member; member = member->next) {
+        names[count++] = member->name;
+    }
+
+    msg = dbus_message_new_method_call(NULL,
+                                       DP_PATH,
+                                       DP_INTERFACE,
+                                       DP_METHOD_GETACCTINFO_BATCH);
+    if (msg == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory?!\n"));
+        ret = ENOMEM;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Creating batch request for [%s][%u][%d] with %d names\n",
+           batch->dom->name, batch->be_type, attrs, count));
+
+    dbret = dbus_message_append_args(msg,
+                                     DBUS_TYPE_UINT32, &batch->be_type,
+                                     DBUS_TYPE_UINT32, &attrs,
+                                     DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                     &names, count,
+                                     DBUS_TYPE_STRING, &batch->dom->name,
+                                     DBUS_TYPE_INVALID);
+    talloc_free(names);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to build message\n"));
+        dbus_message_unref(msg);
+        ret = EIO;
+        goto done;
+    }
+
+    ret = sbus_conn_send(batch->be_conn->conn, msg,
+                         SSS_CLI_SOCKET_TIMEOUT / 2,
+                         sss_dp_batch_done,
+                         batch,
+                         &batch->pending_reply);
+    dbus_message_unref(msg);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("D-BUS send failed.\n"));
+        ret = EIO;
+        goto done;
+    }
+
+    sss_stats_inc("dp_batch_sent");
+    return;
+
+done:
+    sss_dp_batch_finish(batch, ret, DP_ERR_FATAL, ret, NULL);
+}
+
+/* Returns an error if the request should be sent on its own */
+static errno_t sss_dp_batch_add(struct be_conn *be_conn,
+                                struct tevent_req *req,
+                                struct sss_dp_account_info *info)
+{
+    struct dp_internal_get_state *state;
+    struct sss_dp_batch_member *member;
+    struct sss_dp_batch *batch;
+    struct timeval tv;
+    uint32_t be_type;
+
+    /* the subdomains have their own lookups in the providers and the
+     * extra data cannot be batched */
+    if (be_conn->batch_window <= 0 || info == NULL ||
+        info->type != SSS_DP_USER || info->opt_name == NULL ||
+        info->extra != NULL || info->dom->parent != NULL) {
+        return EAGAIN;
+    }
+
+    state = tevent_req_data(req, struct dp_internal_get_state);
+
+    be_type = BE_REQ_USER;
+    if (info->fast_reply) {
+        be_type |= BE_REQ_FAST;
+    }
+
+    for (batch = be_conn->batches; batch; batch = batch->next) {
+        if (batch->be_type == be_type && batch->dom == info->dom) break;
+    }
+
+    if (!batch) {
+        batch = talloc_zero(be_conn, struct sss_dp_batch);
+        if (!batch) {
+            return ENOMEM;
+        }
+        batch->be_conn = be_conn;
+        batch->dom = info->dom;
+        batch->be_type = be_type;
+
+        tv = tevent_timeval_current_ofs(be_conn->batch_window / 1000,
+                                        (be_conn->batch_window % 1000) * 1000);
+        batch->te = tevent_add_timer(be_conn->rctx->ev, batch, tv,
+                                     sss_dp_batch_send, batch);
+        if (!batch->te) {
+            talloc_free(batch);
+            return ENOMEM;
+        }
+
+        DLIST_ADD(be_conn->batches, batch);
+        talloc_set_destructor(batch, sss_dp_batch_destructor);
+    }
+
+    member = talloc_zero(state->sdp_req, struct sss_dp_batch_member);
+    if (!member) {
+        return ENOMEM;
+    }
+    member->name = talloc_strdup(member, info->opt_name);
+    if (!member->name) {
+        talloc_free(member);
+        return ENOMEM;
+    }
+    member->req = req;
+    member->batch = batch;
+
+    DLIST_ADD_END(batch->members, member, struct sss_dp_batch_member *);
+    batch->count++;
+    talloc_set_destructor(member, sss_dp_batch_member_destructor);
+    sss_stats_inc("dp_request_batched");
+
+    if (batch->count >= be_conn->batch_max) {
+        /* full, send it as soon as we are back in the main loop */
+        DLIST_REMOVE(be_conn->batches, batch);
+        batch->closed = true;
+
+        talloc_zfree(batch->te);
+        batch->te = tevent_add_timer(be_conn->rctx->ev, batch,
+                                     tevent_timeval_current(),
+                                     sss_dp_batch_send, batch);
+        if (!batch->te) {
+            /* the requests end with their timeout */
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot schedule the batch\n"));
+        }
+    }
+
+    return EOK;
+}
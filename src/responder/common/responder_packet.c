@@ -264,3 +264,8 @@ void sss_packet_set_error(struct sss_packet *packet, int error)
 {
     *(packet->status) = error;
 }
+
+int sss_packet_get_error(struct sss_packet *packet)
+{
+    return *(packet->status);
+}
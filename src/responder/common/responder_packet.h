@@ -39,5 +39,6 @@ int sss_packet_send(struct sss_packet *packet, int fd);
 enum sss_cli_command sss_packet_get_cmd(struct sss_packet *packet);
 void sss_packet_get_body(struct sss_packet *packet, uint8_t **body, size_t *blen);
 void sss_packet_set_error(struct sss_packet *packet, int error);
+int sss_packet_get_error(struct sss_packet *packet);
 
 #endif /* __SSSSRV_PACKET_H__ */
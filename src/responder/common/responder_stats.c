@@ -0,0 +1,221 @@
+/*
+    SSSD
+
+    responder_stats.c
+
+    Returns the statistics of a responder and its data providers to a client
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "dbus/dbus.h"
+#include "sbus/sssd_dbus.h"
+#include "responder/common/responder.h"
+#include "responder/common/responder_packet.h"
+#include "providers/data_provider.h"
+
+struct sss_stats_cmd_state;
+
+struct sss_stats_be_call {
+    struct sss_stats_cmd_state *state;
+    struct be_conn *conn;
+    DBusPendingCall *pending_reply;
+};
+
+struct sss_stats_cmd_state {
+    struct cli_ctx *cctx;
+    char *out;
+    int num_pending;
+};
+
+static int sss_stats_be_call_destructor(struct sss_stats_be_call *call)
+{
+    /* the client went away before the data provider answered */
+    if (call->pending_reply) {
+        dbus_pending_call_cancel(call->pending_reply);
+        call->pending_reply = NULL;
+    }
+
+    return 0;
+}
+
+static void sss_stats_cmd_reply(struct sss_stats_cmd_state *state)
+{
+    struct cli_ctx *cctx = state->cctx;
+    uint8_t *body;
+    size_t blen;
+    size_t len;
+    int ret;
+
+    len = strlen(state->out) + 1;
+
+    ret = sss_packet_new(cctx->creq, len,
+                         sss_packet_get_cmd(cctx->creq->in),
+                         &cctx->creq->out);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Cannot create the reply packet\n"));
+        talloc_free(cctx);
+        return;
+    }
+
+    sss_packet_get_body(cctx->creq->out, &body, &blen);
+    memcpy(body, state->out, len);
+
+    sss_cmd_done(cctx, state);
+}
+
+static void sss_stats_be_done(DBusPendingCall *pending, void *ptr)
+{
+    struct sss_stats_be_call *call;
+    struct sss_stats_cmd_state *state;
+    DBusMessage *reply;
+    DBusError dbus_error;
+    const char *stats = NULL;
+    dbus_bool_t dbret;
+
+    call = talloc_get_type(ptr, struct sss_stats_be_call);
+    state = call->state;
+    call->pending_reply = NULL;
+
+    dbus_error_init(&dbus_error);
+
+    reply = dbus_pending_call_steal_reply(pending);
+    if (reply != NULL
+            && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+        dbret = dbus_message_get_args(reply, &dbus_error,
+                                      DBUS_TYPE_STRING, &stats,
+                                      DBUS_TYPE_INVALID);
+        if (!dbret) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Failed to parse the statistics of "
+                                      "[%s]\n", call->conn->domain->name));
+            if (dbus_error_is_set(&dbus_error)) dbus_error_free(&dbus_error);
+            stats = NULL;
+        }
+    }
+
+    state->out = talloc_asprintf_append(state->out, "\n== Domain %s ==\n%s",
+                                        call->conn->domain->name,
+                                        stats ? stats :
+                                            "Statistics not available\n");
+
+    if (reply) dbus_message_unref(reply);
+    dbus_pending_call_unref(pending);
+    talloc_free(call);
+
+    if (state->out == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory\n"));
+        talloc_free(state->cctx);
+        return;
+    }
+
+    state->num_pending--;
+    if (state->num_pending == 0) {
+        sss_stats_cmd_reply(state);
+    }
+}
+
+static errno_t sss_stats_be_send(struct sss_stats_cmd_state *state,
+                                 struct be_conn *conn)
+{
+    struct sss_stats_be_call *call;
+    DBusMessage *msg;
+    int ret;
+
+    call = talloc_zero(state, struct sss_stats_be_call);
+    if (call == NULL) {
+        return ENOMEM;
+    }
+    call->state = state;
+    call->conn = conn;
+
+    msg = dbus_message_new_method_call(NULL,
+                                       DP_PATH,
+                                       DP_INTERFACE,
+                                       DP_METHOD_GETSTATS);
+    if (msg == NULL) {
+        talloc_free(call);
+        return ENOMEM;
+    }
+
+    ret = sbus_conn_send(conn->conn, msg,
+                         SSS_CLI_SOCKET_TIMEOUT / 2,
+                         sss_stats_be_done, call,
+                         &call->pending_reply);
+    dbus_message_unref(msg);
+    if (ret != EOK) {
+        talloc_free(call);
+        return ret;
+    }
+
+    talloc_set_destructor(call, sss_stats_be_call_destructor);
+    state->num_pending++;
+
+    return EOK;
+}
+
+int sss_cmd_get_stats(struct cli_ctx *cctx)
+{
+    struct sss_stats_cmd_state *state;
+    struct be_conn *conn;
+    int ret;
+
+    if (cctx->client_euid != 0) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Statistics requested by uid [%d], "
+                                     "only root can see them\n",
+                                     cctx->client_euid));
+        ret = sss_cmd_send_error(cctx, EACCES);
+        if (ret != EOK) {
+            return ret;
+        }
+        sss_cmd_done(cctx, NULL);
+        return EOK;
+    }
+
+    /* the request context goes away with the client */
+    state = talloc_zero(cctx->creq, struct sss_stats_cmd_state);
+    if (state == NULL) {
+        return ENOMEM;
+    }
+    state->cctx = cctx;
+
+    state->out = sss_stats_dump(state);
+    if (state->out == NULL) {
+        talloc_free(state);
+        return ENOMEM;
+    }
+
+    for (conn = cctx->rctx->be_conns; conn != NULL; conn = conn->next) {
+        if (conn->conn == NULL) continue;
+
+        ret = sss_stats_be_send(state, conn);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Cannot ask [%s] for its statistics [%d]: %s\n",
+                   conn->domain->name, ret, strerror(ret)));
+        }
+    }
+
+    if (state->num_pending == 0) {
+        sss_stats_cmd_reply(state);
+    }
+
+    return EOK;
+}
@@ -60,6 +60,7 @@ struct sbus_method monitor_nss_methods[] = {
     { MON_CLI_METHOD_PING, monitor_common_pong },
     { MON_CLI_METHOD_RES_INIT, monitor_common_res_init },
     { MON_CLI_METHOD_ROTATE, responder_logrotate },
+    { MON_CLI_METHOD_GET_STATS, monitor_common_get_stats },
     { MON_CLI_METHOD_CLEAR_MEMCACHE, nss_clear_memcache},
     { NULL, NULL }
 };
@@ -453,6 +454,13 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = nss_refresh_init(nctx, cdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("Cannot set up the refresh of the cached entries\n"));
+        goto fail;
+    }
+
     /* Enable automatic reconnection to the Data Provider */
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
@@ -484,6 +492,15 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    /* Create the lookup table for the expanded netgroups */
+    hret = sss_hash_create(nctx, 10, &nctx->netgr_members);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("Unable to initialize netgroup members hash table\n"));
+        ret = EIO;
+        goto fail;
+    }
+
     /* create mmap caches */
     /* Remove the CLEAR_MC_FLAG file if exists. */
     ret = unlink(SSS_NSS_MCACHE_DIR"/"CLEAR_MC_FLAG);
@@ -38,6 +38,7 @@
 
 struct getent_ctx;
 struct sss_mc_ctx;
+struct nss_refresh_ctx;
 
 struct nss_ctx {
     struct resp_ctx *rctx;
@@ -46,6 +47,7 @@ struct nss_ctx {
     struct sss_nc_ctx *ncache;
 
     int cache_refresh_percent;
+    struct nss_refresh_ctx *refresh;
 
     int enum_cache_timeout;
 
@@ -53,6 +55,7 @@ struct nss_ctx {
     struct getent_ctx *gctx;
     struct getent_ctx *svcctx;
     hash_table_t *netgroups;
+    hash_table_t *netgr_members;
 
     bool filter_users_in_groups;
 
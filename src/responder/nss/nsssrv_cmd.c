@@ -21,6 +21,7 @@
 
 #include "util/util.h"
 #include "util/sss_nss.h"
+#include "util/sss_stats.h"
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_netgroup.h"
@@ -542,8 +543,16 @@ errno_t check_cache(struct nss_dom_ctx *dctx,
         /* if we have any reply let's check cache validity */
         ret = sss_cmd_check_cache(res->msgs[0], nctx->cache_refresh_percent,
                                   cacheExpire);
+        if (ret == EOK || ret == EAGAIN) {
+            nss_refresh_hit(nctx, dctx->domain, req_type,
+                            opt_name ? opt_name :
+                            ldb_msg_find_attr_as_string(res->msgs[0],
+                                                        SYSDB_NAME, NULL),
+                            cacheExpire);
+        }
         if (ret == EOK) {
             DEBUG(SSSDBG_TRACE_FUNC, ("Cached entry is valid, returning..\n"));
+            sss_stats_inc("cache_hit");
             return EOK;
         } else if (ret != EAGAIN && ret != ENOENT) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("Error checking cache: %d\n", ret));
@@ -563,6 +572,7 @@ errno_t check_cache(struct nss_dom_ctx *dctx,
          */
         DEBUG(SSSDBG_TRACE_FUNC,
              ("Performing midpoint cache update on [%s]\n", opt_name));
+        sss_stats_inc("cache_midpoint_refresh");
 
         req = sss_dp_get_account_send(cctx, cctx->rctx, dctx->domain, true,
                                       req_type, opt_name, opt_id, NULL);
@@ -587,6 +597,7 @@ errno_t check_cache(struct nss_dom_ctx *dctx,
 
         /* dont loop forever :-) */
         dctx->check_provider = false;
+        sss_stats_inc("cache_miss");
 
         /* keep around current data in case backend is offline */
         if (res->count) {
@@ -710,6 +721,7 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
     char *name = NULL;
     struct sysdb_ctx *sysdb;
     struct nss_ctx *nctx;
+    struct timeval search_start;
     int ret;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
@@ -765,7 +777,9 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
+        sss_stats_start(&search_start);
         ret = sysdb_getpwnam(cmdctx, sysdb, dom, name, &dctx->res);
+        sss_stats_time(SSS_STATS_SYSDB_SEARCH, &search_start, ret != EOK);
         if (ret != EOK) {
             DEBUG(1, ("Failed to make request to our cache!\n"));
             return EIO;
@@ -1227,6 +1241,7 @@ static int nss_cmd_getpwuid_search(struct nss_dom_ctx *dctx)
     struct cli_ctx *cctx = cmdctx->cctx;
     struct sysdb_ctx *sysdb;
     struct nss_ctx *nctx;
+    struct timeval search_start;
     int ret;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
@@ -1263,7 +1278,9 @@ static int nss_cmd_getpwuid_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
+        sss_stats_start(&search_start);
         ret = sysdb_getpwuid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+        sss_stats_time(SSS_STATS_SYSDB_SEARCH, &search_start, ret != EOK);
         if (ret != EOK) {
             DEBUG(1, ("Failed to make request to our cache!\n"));
             return EIO;
@@ -2539,6 +2556,7 @@ static int nss_cmd_getgrnam_search(struct nss_dom_ctx *dctx)
     char *name = NULL;
     struct sysdb_ctx *sysdb;
     struct nss_ctx *nctx;
+    struct timeval search_start;
     int ret;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
@@ -2594,7 +2612,9 @@ static int nss_cmd_getgrnam_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
+        sss_stats_start(&search_start);
         ret = sysdb_getgrnam(cmdctx, sysdb, dom, name, &dctx->res);
+        sss_stats_time(SSS_STATS_SYSDB_SEARCH, &search_start, ret != EOK);
         if (ret != EOK) {
             DEBUG(1, ("Failed to make request to our cache!\n"));
             return EIO;
@@ -2678,6 +2698,7 @@ static int nss_cmd_getgrgid_search(struct nss_dom_ctx *dctx)
     struct cli_ctx *cctx = cmdctx->cctx;
     struct sysdb_ctx *sysdb;
     struct nss_ctx *nctx;
+    struct timeval search_start;
     int ret;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
@@ -2714,7 +2735,9 @@ static int nss_cmd_getgrgid_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
+        sss_stats_start(&search_start);
         ret = sysdb_getgrgid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+        sss_stats_time(SSS_STATS_SYSDB_SEARCH, &search_start, ret != EOK);
         if (ret != EOK) {
             DEBUG(1, ("Failed to make request to our cache!\n"));
             return EIO;
@@ -3494,6 +3517,7 @@ static int nss_cmd_initgroups_search(struct nss_dom_ctx *dctx)
     char *name = NULL;
     struct sysdb_ctx *sysdb;
     struct nss_ctx *nctx;
+    struct timeval search_start;
     int ret;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
@@ -3549,7 +3573,9 @@ static int nss_cmd_initgroups_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
+        sss_stats_start(&search_start);
         ret = sysdb_initgroups(cmdctx, sysdb, dom, name, &dctx->res);
+        sss_stats_time(SSS_STATS_SYSDB_SEARCH, &search_start, ret != EOK);
         if (ret != EOK) {
             DEBUG(1, ("Failed to make request to our cache! [%d][%s]\n",
                       ret, strerror(ret)));
@@ -4296,6 +4322,7 @@ struct cli_protocol_version *register_cli_protocol_version(void)
 
 static struct sss_cmd_table nss_cmds[] = {
     {SSS_GET_VERSION, sss_cmd_get_version},
+    {SSS_GET_STATS, sss_cmd_get_stats},
     {SSS_NSS_GETPWNAM, nss_cmd_getpwnam},
     {SSS_NSS_GETPWUID, nss_cmd_getpwuid},
     {SSS_NSS_SETPWENT, nss_cmd_setpwent},
@@ -4310,6 +4337,7 @@ static struct sss_cmd_table nss_cmds[] = {
     {SSS_NSS_SETNETGRENT, nss_cmd_setnetgrent},
     {SSS_NSS_GETNETGRENT, nss_cmd_getnetgrent},
     {SSS_NSS_ENDNETGRENT, nss_cmd_endnetgrent},
+    {SSS_NSS_INNETGR, nss_cmd_innetgr},
     {SSS_NSS_GETSERVBYNAME, nss_cmd_getservbyname},
     {SSS_NSS_GETSERVBYPORT, nss_cmd_getservbyport},
     {SSS_NSS_SETSERVENT, nss_cmd_setservent},
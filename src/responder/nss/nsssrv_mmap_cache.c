@@ -20,6 +20,7 @@
 */
 
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "confdb/confdb.h"
 #include <sys/mman.h>
 #include <fcntl.h>
@@ -571,6 +572,7 @@ errno_t sss_mmap_cache_pw_store(struct sss_mc_ctx **_mcc,
     /* finally chain the rec in the hash table */
     sss_mmap_chain_in_rec(mcc, rec);
 
+    sss_stats_inc("mmap_store");
     return EOK;
 }
 
@@ -702,6 +704,7 @@ int sss_mmap_cache_gr_store(struct sss_mc_ctx **_mcc,
     /* finally chain the rec in the hash table */
     sss_mmap_chain_in_rec(mcc, rec);
 
+    sss_stats_inc("mmap_store");
     return EOK;
 }
 
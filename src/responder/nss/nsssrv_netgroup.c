@@ -24,6 +24,7 @@
 
 
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_netgroup.h"
@@ -994,3 +995,947 @@ int nss_cmd_endnetgrent(struct cli_ctx *client)
     sss_cmd_done(client, NULL);
     return EOK;
 }
+
+/* innetgr()
+ *
+ * Checking a membership through setnetgrent() and getnetgrent() makes the
+ * client walk the whole netgroup and request every nested netgroup on each
+ * call. The triples of a netgroup are instead expanded here once, nested
+ * netgroups included, and indexed by every combination of their fields, so
+ * that a membership test is at most eight hash lookups. The expansion is
+ * kept as long as the setnetgrent() results are.
+ */
+
+#define NETGR_FIELDS 3
+
+struct netgr_members_waiter;
+
+struct netgr_members {
+    struct nss_ctx *nctx;
+    struct tevent_context *ev;
+    char *name;
+    hash_table_t *lookup_table;
+
+    hash_table_t *index;
+    size_t num_triples;
+
+    bool ready;
+    bool found;
+    struct netgr_members_waiter *waiters;
+};
+
+struct netgr_members_waiter {
+    struct netgr_members_waiter *prev;
+    struct netgr_members_waiter *next;
+
+    struct netgr_members *members;
+    struct tevent_req *req;
+};
+
+static int netgr_members_destructor(struct netgr_members *members)
+{
+    struct netgr_members_waiter *w;
+    hash_key_t key;
+
+    for (w = members->waiters; w != NULL; w = w->next) {
+        w->members = NULL;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = members->name;
+    hash_delete(members->lookup_table, &key);
+
+    return 0;
+}
+
+/* The host and the domain are compared regardless of case, as glibc does.
+ * The fields of the key are length-prefixed, "*" stands for a field left
+ * out of the combination. */
+static char *netgr_index_key(TALLOC_CTX *mem_ctx,
+                             const char *fields[NETGR_FIELDS],
+                             int mask)
+{
+    char *key;
+    char *value;
+    int i;
+
+    key = talloc_strdup(mem_ctx, "");
+    for (i = 0; key != NULL && i < NETGR_FIELDS; i++) {
+        if (!(mask & (1 << i))) {
+            key = talloc_strdup_append(key, "*");
+            continue;
+        }
+
+        if (i == 1) {
+            key = talloc_asprintf_append(key, "%zu:%s",
+                                         strlen(fields[i]), fields[i]);
+            continue;
+        }
+
+        value = sss_tc_utf8_str_tolower(key, fields[i]);
+        if (value == NULL) {
+            talloc_free(key);
+            return NULL;
+        }
+        key = talloc_asprintf_append(key, "%zu:%s", strlen(value), value);
+    }
+
+    return key;
+}
+
+static errno_t netgr_index_add(struct netgr_members *members,
+                               const char *host,
+                               const char *user,
+                               const char *domain)
+{
+    const char *fields[NETGR_FIELDS];
+    hash_key_t key;
+    hash_value_t value;
+    int mask;
+    int hret;
+
+    /* An empty field of a triple matches any value */
+    fields[0] = host ? host : "";
+    fields[1] = user ? user : "";
+    fields[2] = domain ? domain : "";
+
+    value.type = HASH_VALUE_UNDEF;
+    key.type = HASH_KEY_STRING;
+
+    for (mask = 0; mask < (1 << NETGR_FIELDS); mask++) {
+        key.str = netgr_index_key(members, fields, mask);
+        if (key.str == NULL) {
+            return ENOMEM;
+        }
+
+        hret = hash_enter(members->index, &key, &value);
+        talloc_free(key.str);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("Cannot index the triple [%d][%s]\n",
+                   hret, hash_error_string(hret)));
+            return EIO;
+        }
+    }
+
+    members->num_triples++;
+    return EOK;
+}
+
+static errno_t netgr_index_match(struct netgr_members *members,
+                                 const char *host,
+                                 const char *user,
+                                 const char *domain,
+                                 bool *_match)
+{
+    const char *query[NETGR_FIELDS] = { host, user, domain };
+    const char *fields[NETGR_FIELDS];
+    hash_key_t key;
+    bool match;
+    int mask = 0;
+    int empty;
+    int i;
+
+    /* A field that was not asked for matches anything */
+    for (i = 0; i < NETGR_FIELDS; i++) {
+        if (query[i] != NULL) {
+            mask |= 1 << i;
+        }
+    }
+
+    /* Each asked field matches either the same value or an empty field
+     * of the triple, try all the combinations */
+    key.type = HASH_KEY_STRING;
+    empty = mask;
+    do {
+        for (i = 0; i < NETGR_FIELDS; i++) {
+            fields[i] = (empty & (1 << i)) ? "" : query[i];
+        }
+
+        key.str = netgr_index_key(members, fields, mask);
+        if (key.str == NULL) {
+            return ENOMEM;
+        }
+
+        match = hash_has_key(members->index, &key);
+        talloc_free(key.str);
+        if (match) {
+            break;
+        }
+
+        empty = (empty - 1) & mask;
+    } while (empty != mask);
+
+    *_match = match;
+    return EOK;
+}
+
+struct netgr_expand_state {
+    struct tevent_context *ev;
+    struct resp_ctx *rctx;
+    struct netgr_members *members;
+    struct sss_domain_info *dom;
+    bool check_next;
+    const char *shortname;
+
+    hash_table_t *seen;
+    char **names;
+    size_t num_names;
+    size_t cur;
+    bool dp_done;
+};
+
+static errno_t netgr_expand_add_name(struct netgr_expand_state *state,
+                                     const char *name)
+{
+    hash_key_t key;
+    hash_value_t value;
+    char *cased;
+    int hret;
+
+    cased = sss_get_cased_name(state, name, state->dom->case_sensitive);
+    if (cased == NULL) {
+        return ENOMEM;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = cased;
+
+    /* every netgroup is expanded once, this also breaks the loops */
+    if (hash_has_key(state->seen, &key)) {
+        talloc_free(cased);
+        return EOK;
+    }
+
+    value.type = HASH_VALUE_UNDEF;
+    hret = hash_enter(state->seen, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        talloc_free(cased);
+        return EIO;
+    }
+
+    state->names = talloc_realloc(state, state->names, char *,
+                                  state->num_names + 1);
+    if (state->names == NULL) {
+        return ENOMEM;
+    }
+    state->names[state->num_names] = talloc_steal(state->names, cased);
+    state->num_names++;
+
+    return EOK;
+}
+
+/* Returns the first domain starting with dom that may contain the
+ * netgroup, or NULL if there is none */
+static struct sss_domain_info *
+netgr_expand_first_domain(struct nss_ctx *nctx, struct sss_domain_info *dom,
+                          bool check_next, const char *shortname)
+{
+    char *name;
+    errno_t ret;
+
+    for (; dom != NULL; dom = check_next ? get_next_domain(dom, false) : NULL) {
+        /* if it is a domainless search, skip domains that require fully
+         * qualified names instead */
+        if (check_next && dom->fqnames) {
+            continue;
+        }
+
+        name = sss_get_cased_name(NULL, shortname, dom->case_sensitive);
+        if (name == NULL) {
+            /* let the lookup report it */
+            return dom;
+        }
+
+        ret = sss_ncache_check_netgr(nctx->ncache, nctx->neg_timeout,
+                                     dom->name, name);
+        if (ret == EEXIST) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  ("Netgroup [%s] does not exist in [%s]! (negative cache)\n",
+                   name, dom->name));
+            talloc_free(name);
+            continue;
+        }
+        talloc_free(name);
+
+        return dom;
+    }
+
+    return NULL;
+}
+
+static errno_t netgr_expand_set_domain(struct netgr_expand_state *state,
+                                       struct sss_domain_info *dom)
+{
+    errno_t ret;
+
+    dom = netgr_expand_first_domain(state->members->nctx, dom,
+                                    state->check_next, state->shortname);
+
+    state->dom = dom;
+    if (dom == NULL) {
+        return ENOENT;
+    }
+
+    talloc_zfree(state->seen);
+    talloc_zfree(state->names);
+    state->num_names = 0;
+    state->cur = 0;
+    state->dp_done = false;
+
+    ret = sss_hash_create(state, 10, &state->seen);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return netgr_expand_add_name(state, state->shortname);
+}
+
+static bool netgr_expand_is_expired(struct ldb_result *res)
+{
+    uint64_t now = time(NULL);
+    uint64_t expire;
+    int i;
+
+    if (res->count == 0) {
+        return true;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        expire = ldb_msg_find_attr_as_uint64(res->msgs[i],
+                                             SYSDB_CACHE_EXPIRE, 0);
+        if (expire < now) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static errno_t netgr_expand_add_entries(struct netgr_expand_state *state,
+                                        struct sysdb_netgroup_ctx **entries)
+{
+    errno_t ret;
+    int i;
+
+    for (i = 0; entries[i] != NULL; i++) {
+        if (entries[i]->type == SYSDB_NETGROUP_TRIPLE_VAL) {
+            ret = netgr_index_add(state->members,
+                                  entries[i]->value.triple.hostname,
+                                  entries[i]->value.triple.username,
+                                  entries[i]->value.triple.domainname);
+        } else if (entries[i]->type == SYSDB_NETGROUP_GROUP_VAL) {
+            if (entries[i]->value.groupname == NULL ||
+                entries[i]->value.groupname[0] == '\0') {
+                continue;
+            }
+            ret = netgr_expand_add_name(state, entries[i]->value.groupname);
+        } else {
+            continue;
+        }
+
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+static void netgr_expand_dp_done(struct tevent_req *subreq);
+
+static errno_t netgr_expand_step(struct tevent_req *req)
+{
+    struct netgr_expand_state *state = tevent_req_data(req,
+                                                struct netgr_expand_state);
+    struct sysdb_netgroup_ctx **entries;
+    struct ldb_result *res;
+    struct tevent_req *subreq;
+    const char *name;
+    errno_t ret;
+
+    while (state->cur < state->num_names) {
+        name = state->names[state->cur];
+
+        ret = sysdb_getnetgr(state, state->dom->sysdb, state->dom,
+                             name, &res);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Cannot read netgroup [%s@%s]\n",
+                                      name, state->dom->name));
+            return ret;
+        }
+
+        if (!state->dp_done && NEED_CHECK_PROVIDER(state->dom->provider)
+                && netgr_expand_is_expired(res)) {
+            talloc_free(res);
+
+            DEBUG(SSSDBG_TRACE_FUNC, ("Updating netgroup [%s@%s]\n",
+                                      name, state->dom->name));
+            subreq = sss_dp_get_account_send(state, state->rctx, state->dom,
+                                             true, SSS_DP_NETGR, name,
+                                             0, NULL);
+            if (subreq == NULL) {
+                return ENOMEM;
+            }
+            tevent_req_set_callback(subreq, netgr_expand_dp_done, req);
+            return EAGAIN;
+        }
+        state->dp_done = false;
+
+        ret = sysdb_netgr_to_entries(state, res, &entries);
+        talloc_free(res);
+        if (ret == ENOENT) {
+            if (state->cur == 0) {
+                /* This netgroup was not found in this domain */
+                ret = sss_ncache_set_netgr(state->members->nctx->ncache,
+                                           false, state->dom, name);
+                if (ret != EOK) {
+                    return ret;
+                }
+
+                ret = ENOENT;
+                if (state->check_next) {
+                    ret = netgr_expand_set_domain(state,
+                                    get_next_domain(state->dom, false));
+                }
+                if (ret != EOK) {
+                    return ret;
+                }
+                continue;
+            }
+
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Nested netgroup [%s@%s] does not exist, skipped\n",
+                   name, state->dom->name));
+            state->cur++;
+            continue;
+        } else if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Failed to convert results into entries\n"));
+            return ret;
+        }
+
+        ret = netgr_expand_add_entries(state, entries);
+        talloc_free(entries);
+        if (ret != EOK) {
+            return ret;
+        }
+        state->cur++;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Netgroup [%s@%s] expanded to %zu triples from %zu netgroups\n",
+           state->shortname, state->dom->name,
+           state->members->num_triples, state->num_names));
+    sss_stats_inc("netgroup_expand");
+    return EOK;
+}
+
+static struct tevent_req *netgr_expand_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct resp_ctx *rctx,
+                                            struct netgr_members *members,
+                                            struct sss_domain_info *dom,
+                                            bool check_next,
+                                            const char *shortname)
+{
+    struct netgr_expand_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct netgr_expand_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->ev = ev;
+    state->rctx = rctx;
+    state->members = members;
+    state->check_next = check_next;
+
+    state->shortname = talloc_strdup(state, shortname);
+    if (state->shortname == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = netgr_expand_set_domain(state, dom);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = netgr_expand_step(req);
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        tevent_req_post(req, ev);
+    }
+
+    return req;
+}
+
+static void netgr_expand_dp_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct netgr_expand_state *state = tevent_req_data(req,
+                                                struct netgr_expand_state);
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    char *err_msg;
+    errno_t ret;
+
+    ret = sss_dp_get_account_recv(state, subreq, &err_maj, &err_min,
+                                  &err_msg);
+    talloc_zfree(subreq);
+    if (ret != EOK || err_maj) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to get information from Data Provider\n"
+               "Error: %d, %u, %u, %s\n"
+               "Will try to use what we have in cache\n",
+               ret, (unsigned int) err_maj, (unsigned int) err_min,
+               ret == EOK && err_msg ? err_msg : "-"));
+    }
+
+    state->dp_done = true;
+
+    ret = netgr_expand_step(req);
+    if (ret == EAGAIN) {
+        return;
+    } else if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t netgr_expand_recv(struct tevent_req *req,
+                                 struct sss_domain_info **_dom)
+{
+    struct netgr_expand_state *state = tevent_req_data(req,
+                                                struct netgr_expand_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_dom = state->dom;
+    return EOK;
+}
+
+static void netgr_members_timeout(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval current_time,
+                                  void *pvt)
+{
+    struct netgr_members *members =
+            talloc_get_type(pvt, struct netgr_members);
+
+    /* The destructor removes it from the lookup table,
+     * the next innetgr() expands the netgroup again */
+    talloc_free(members);
+}
+
+static void innetgr_finish(struct tevent_req *req,
+                           struct netgr_members *members,
+                           errno_t ret);
+
+static void netgr_members_notify(struct netgr_members *members, errno_t ret)
+{
+    struct netgr_members_waiter *w;
+
+    while ((w = members->waiters) != NULL) {
+        DLIST_REMOVE(members->waiters, w);
+        w->members = NULL;
+
+        innetgr_finish(w->req, members, ret);
+    }
+}
+
+
+static void netgr_members_expanded(struct tevent_req *subreq)
+{
+    struct netgr_members *members = tevent_req_callback_data(subreq,
+                                                    struct netgr_members);
+    struct nss_ctx *nctx = members->nctx;
+    struct sss_domain_info *dom;
+    struct tevent_timer *te;
+    uint32_t lifetime;
+    errno_t ret;
+
+    ret = netgr_expand_recv(subreq, &dom);
+    talloc_zfree(subreq);
+    if (ret == EOK) {
+        members->found = true;
+        if (nctx->cache_refresh_percent) {
+            lifetime = dom->netgroup_timeout *
+                (nctx->cache_refresh_percent / 100.0);
+        } else {
+            lifetime = dom->netgroup_timeout;
+        }
+        if (lifetime < 10) lifetime = 10;
+    } else if (ret == ENOENT) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("No matching domain found for [%s]\n", members->name));
+        members->found = false;
+        lifetime = nctx->neg_timeout;
+    } else {
+        DEBUG(SSSDBG_OP_FAILURE, ("Cannot expand netgroup [%s] [%d]: %s\n",
+                                  members->name, ret, strerror(ret)));
+        netgr_members_notify(members, ret);
+        talloc_free(members);
+        return;
+    }
+
+    members->ready = true;
+
+    te = tevent_add_timer(members->ev, members,
+                          tevent_timeval_current_ofs(lifetime, 0),
+                          netgr_members_timeout, members);
+    if (te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Could not set up life timer for netgroup members. "
+               "Entries may become stale.\n"));
+    }
+
+    netgr_members_notify(members, EOK);
+}
+
+static int netgr_members_waiter_destructor(struct netgr_members_waiter *w)
+{
+    if (w->members != NULL) {
+        DLIST_REMOVE(w->members->waiters, w);
+    }
+    return 0;
+}
+
+struct innetgr_state {
+    const char *host;
+    const char *user;
+    const char *domain;
+
+    bool match;
+};
+
+static errno_t innetgr_wait(struct tevent_req *req,
+                            struct innetgr_state *state,
+                            struct netgr_members *members)
+{
+    struct netgr_members_waiter *w;
+
+    w = talloc_zero(state, struct netgr_members_waiter);
+    if (w == NULL) {
+        return ENOMEM;
+    }
+    w->members = members;
+    w->req = req;
+
+    DLIST_ADD_END(members->waiters, w, struct netgr_members_waiter *);
+    talloc_set_destructor(w, netgr_members_waiter_destructor);
+
+    return EOK;
+}
+
+static struct tevent_req *innetgr_send(TALLOC_CTX *mem_ctx,
+                                       struct nss_cmd_ctx *cmdctx,
+                                       const char *rawname,
+                                       const char *host,
+                                       const char *user,
+                                       const char *domain)
+{
+    struct cli_ctx *client = cmdctx->cctx;
+    struct nss_ctx *nctx =
+            talloc_get_type(client->rctx->pvt_ctx, struct nss_ctx);
+    struct sss_domain_info *dom;
+    struct netgr_members *members;
+    struct innetgr_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+    hash_key_t key;
+    hash_value_t value;
+    char *domname;
+    char *shortname;
+    bool check_next;
+    int hret;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct innetgr_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->host = host;
+    state->user = user;
+    state->domain = domain;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(rawname);
+
+    hret = hash_lookup(nctx->netgr_members, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        members = talloc_get_type(value.ptr, struct netgr_members);
+        if (members->ready) {
+            sss_stats_inc("netgroup_members_hit");
+            innetgr_finish(req, members, EOK);
+            tevent_req_post(req, client->rctx->ev);
+            return req;
+        }
+
+        /* The netgroup is being expanded for another request */
+        ret = innetgr_wait(req, state, members);
+        if (ret != EOK) {
+            goto error;
+        }
+        return req;
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Unexpected error reading from netgroup members hash "
+               "[%d][%s]\n", hret, hash_error_string(hret)));
+        ret = EIO;
+        goto error;
+    }
+
+    ret = sss_parse_name_for_domains(state, client->rctx->domains,
+                                     client->rctx->default_domain, rawname,
+                                     &domname, &shortname);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Invalid name received [%s]\n", rawname));
+        goto error;
+    }
+
+    if (domname) {
+        dom = responder_get_domain(client->rctx, domname);
+        if (dom == NULL) {
+            ret = EINVAL;
+            goto error;
+        }
+        check_next = false;
+    } else {
+        /* this is a multidomain search */
+        dom = client->rctx->domains;
+        check_next = true;
+    }
+
+    /* Do not expand a netgroup that is known not to exist */
+    dom = netgr_expand_first_domain(nctx, dom, check_next, shortname);
+    if (dom == NULL) {
+        ret = ENOENT;
+        goto error;
+    }
+
+    members = talloc_zero(nctx, struct netgr_members);
+    if (members == NULL) {
+        ret = ENOMEM;
+        goto error;
+    }
+    members->nctx = nctx;
+    members->ev = client->rctx->ev;
+    members->lookup_table = nctx->netgr_members;
+
+    members->name = talloc_strdup(members, rawname);
+    if (members->name == NULL) {
+        talloc_free(members);
+        ret = ENOMEM;
+        goto error;
+    }
+
+    ret = sss_hash_create(members, 10, &members->index);
+    if (ret != EOK) {
+        talloc_free(members);
+        goto error;
+    }
+
+    key.str = members->name;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = members;
+    hret = hash_enter(nctx->netgr_members, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Unable to add hash table entry for [%s] [%d][%s]\n",
+               key.str, hret, hash_error_string(hret)));
+        talloc_free(members);
+        ret = EIO;
+        goto error;
+    }
+    talloc_set_destructor(members, netgr_members_destructor);
+
+    ret = innetgr_wait(req, state, members);
+    if (ret != EOK) {
+        talloc_free(members);
+        goto error;
+    }
+
+    /* The expansion belongs to the result object, so that it
+     * completes even if this client goes away */
+    subreq = netgr_expand_send(members, client->rctx->ev, client->rctx,
+                               members, dom, check_next, shortname);
+    if (subreq == NULL) {
+        talloc_free(members);
+        ret = ENOMEM;
+        goto error;
+    }
+    tevent_req_set_callback(subreq, netgr_members_expanded, members);
+
+    return req;
+
+error:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, client->rctx->ev);
+    return req;
+}
+
+static void innetgr_finish(struct tevent_req *req,
+                           struct netgr_members *members,
+                           errno_t ret)
+{
+    struct innetgr_state *state = tevent_req_data(req,
+                                                  struct innetgr_state);
+
+    if (ret == EOK) {
+        if (members->found) {
+            ret = netgr_index_match(members, state->host, state->user,
+                                    state->domain, &state->match);
+        } else {
+            ret = ENOENT;
+        }
+    }
+
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t innetgr_recv(struct tevent_req *req, bool *_match)
+{
+    struct innetgr_state *state = tevent_req_data(req,
+                                                  struct innetgr_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_match = state->match;
+    return EOK;
+}
+
+static void nss_cmd_innetgr_done(struct tevent_req *req);
+
+/* The request is the netgroup name followed by the host, the user and the
+ * domain to look for, each one zero terminated. An empty host, user or
+ * domain matches any value, like a NULL argument of innetgr(). */
+int nss_cmd_innetgr(struct cli_ctx *client)
+{
+    struct nss_cmd_ctx *cmdctx;
+    struct tevent_req *req;
+    const char *fields[1 + NETGR_FIELDS];
+    uint8_t *body;
+    size_t blen;
+    size_t rp;
+    int i;
+    errno_t ret = EOK;
+
+    cmdctx = talloc_zero(client, struct nss_cmd_ctx);
+    if (!cmdctx) {
+        return ENOMEM;
+    }
+    cmdctx->cctx = client;
+
+    sss_packet_get_body(client->creq->in, &body, &blen);
+
+    /* if not terminated fail */
+    if (blen == 0 || body[blen - 1] != '\0') {
+        ret = EINVAL;
+        goto done;
+    }
+
+    /* If the body isn't valid UTF-8, fail */
+    if (!sss_utf8_check(body, blen - 1)) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    rp = 0;
+    for (i = 0; i < 1 + NETGR_FIELDS; i++) {
+        if (rp >= blen) {
+            ret = EINVAL;
+            goto done;
+        }
+        fields[i] = (const char *) &body[rp];
+        rp += strlen(fields[i]) + 1;
+
+        if (fields[i][0] == '\0') {
+            fields[i] = NULL;
+        }
+    }
+
+    if (rp != blen || fields[0] == NULL) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Checking (%s,%s,%s) in netgroup [%s]\n",
+                              fields[1] ? fields[1] : "",
+                              fields[2] ? fields[2] : "",
+                              fields[3] ? fields[3] : "", fields[0]));
+
+    req = innetgr_send(cmdctx, cmdctx, fields[0],
+                       fields[1], fields[2], fields[3]);
+    if (!req) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("Fatal error calling innetgr_send\n"));
+        ret = EIO;
+        goto done;
+    }
+    tevent_req_set_callback(req, nss_cmd_innetgr_done, cmdctx);
+
+done:
+    return nss_cmd_done(cmdctx, ret);
+}
+
+static void nss_cmd_innetgr_done(struct tevent_req *req)
+{
+    struct nss_cmd_ctx *cmdctx =
+            tevent_req_callback_data(req, struct nss_cmd_ctx);
+    struct sss_packet *packet;
+    uint8_t *body;
+    size_t blen;
+    size_t rp;
+    bool match;
+    errno_t ret;
+
+    ret = innetgr_recv(req, &match);
+    talloc_zfree(req);
+    if (ret != EOK) {
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_OP_FAILURE, ("innetgr failed\n"));
+        }
+        ret = nss_cmd_done(cmdctx, ret);
+        if (ret != EOK) {
+            NSS_CMD_FATAL_ERROR(cmdctx);
+        }
+        return;
+    }
+
+    ret = sss_packet_new(cmdctx->cctx->creq, 0,
+                         sss_packet_get_cmd(cmdctx->cctx->creq->in),
+                         &cmdctx->cctx->creq->out);
+    if (ret != EOK) {
+        NSS_CMD_FATAL_ERROR(cmdctx);
+    }
+    packet = cmdctx->cctx->creq->out;
+
+    ret = sss_packet_grow(packet, 3 * sizeof(uint32_t));
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Couldn't grow the packet\n"));
+        NSS_CMD_FATAL_ERROR(cmdctx);
+    }
+
+    sss_packet_get_body(packet, &body, &blen);
+    rp = 0;
+    SAFEALIGN_SET_UINT32(&body[rp], 1, &rp); /* num results */
+    SAFEALIGN_SET_UINT32(&body[rp], 0, &rp); /* reserved */
+    SAFEALIGN_SET_UINT32(&body[rp], match ? 1 : 0, &rp);
+
+    sss_cmd_done(cmdctx->cctx, cmdctx);
+}
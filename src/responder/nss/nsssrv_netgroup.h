@@ -30,5 +30,6 @@
 int nss_cmd_setnetgrent(struct cli_ctx *cctx);
 int nss_cmd_getnetgrent(struct cli_ctx *cctx);
 int nss_cmd_endnetgrent(struct cli_ctx *cctx);
+int nss_cmd_innetgr(struct cli_ctx *cctx);
 
 #endif /* NSSRV_NETGROUP_H_ */
@@ -125,6 +125,17 @@ errno_t check_cache(struct nss_dom_ctx *dctx,
                     sss_dp_callback_t callback,
                     void *pvt);
 
+/* from nsssrv_refresh.c */
+errno_t nss_refresh_init(struct nss_ctx *nctx, struct confdb_ctx *cdb);
+
+/* Counts a request answered from the cache; the entries requested often
+ * are refreshed in the background shortly before they expire */
+void nss_refresh_hit(struct nss_ctx *nctx,
+                     struct sss_domain_info *dom,
+                     int req_type,
+                     const char *name,
+                     uint64_t expire);
+
 void nss_update_pw_memcache(struct nss_ctx *nctx);
 void nss_update_gr_memcache(struct nss_ctx *nctx);
 void nss_update_initgr_memcache(struct nss_ctx *nctx,
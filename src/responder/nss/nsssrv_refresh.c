@@ -0,0 +1,333 @@
+/*
+    SSSD
+
+    nsssrv_refresh.c
+
+    Refreshing the frequently requested entries before they expire
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "responder/nss/nsssrv.h"
+#include "responder/nss/nsssrv_private.h"
+#include "confdb/confdb.h"
+#include "db/sysdb.h"
+#include "providers/data_provider.h"
+
+/* the table only keeps the entries requested since the last scans,
+ * this limits it when the clients walk through a large directory */
+#define NSS_REFRESH_MAX_ENTRIES 10000
+
+struct nss_refresh_ctx;
+
+struct nss_refresh_entry {
+    struct nss_refresh_entry *prev;
+    struct nss_refresh_entry *next;
+
+    struct nss_refresh_ctx *ctx;
+    char *key;
+    char *domain;
+    enum sss_dp_acct_type type;
+    char *name;
+
+    uint64_t expire;
+    unsigned int hits;
+    bool pending;
+};
+
+struct nss_refresh_ctx {
+    struct nss_ctx *nctx;
+
+    int ahead;
+    int min_hits;
+
+    hash_table_t *table;
+    struct nss_refresh_entry *entries;
+    size_t num_entries;
+};
+
+static void nss_refresh_scan(struct tevent_context *ev,
+                             struct tevent_timer *te,
+                             struct timeval tv, void *pvt);
+
+static errno_t nss_refresh_set_timer(struct nss_refresh_ctx *ctx)
+{
+    struct tevent_timer *te;
+    struct timeval tv;
+    int interval;
+
+    /* an entry is seen at least ahead/2 seconds before it expires */
+    interval = ctx->ahead / 2;
+    if (interval < 1) {
+        interval = 1;
+    }
+
+    tv = tevent_timeval_current_ofs(interval, 0);
+    te = tevent_add_timer(ctx->nctx->rctx->ev, ctx, tv,
+                          nss_refresh_scan, ctx);
+    if (te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Cannot schedule the refresh of the cached entries\n"));
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+errno_t nss_refresh_init(struct nss_ctx *nctx, struct confdb_ctx *cdb)
+{
+    struct nss_refresh_ctx *ctx;
+    int ahead;
+    int min_hits;
+    errno_t ret;
+
+    ret = confdb_get_int(cdb, CONFDB_NSS_CONF_ENTRY,
+                         CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD, 0, &ahead);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (ahead <= 0) {
+        return EOK;
+    }
+
+    ret = confdb_get_int(cdb, CONFDB_NSS_CONF_ENTRY,
+                         CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD_HITS, 3,
+                         &min_hits);
+    if (ret != EOK) {
+        return ret;
+    }
+    if (min_hits < 1) {
+        min_hits = 1;
+    }
+
+    ctx = talloc_zero(nctx, struct nss_refresh_ctx);
+    if (ctx == NULL) {
+        return ENOMEM;
+    }
+    ctx->nctx = nctx;
+    ctx->ahead = ahead;
+    ctx->min_hits = min_hits;
+
+    ret = sss_hash_create(ctx, 1024, &ctx->table);
+    if (ret != EOK) {
+        talloc_free(ctx);
+        return ret;
+    }
+
+    ret = nss_refresh_set_timer(ctx);
+    if (ret != EOK) {
+        talloc_free(ctx);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("Entries requested at least %d times are refreshed %d seconds "
+           "before they expire\n", min_hits, ahead));
+
+    nctx->refresh = ctx;
+    return EOK;
+}
+
+static int nss_refresh_entry_destructor(struct nss_refresh_entry *entry)
+{
+    struct nss_refresh_ctx *ctx = entry->ctx;
+    hash_key_t key;
+
+    key.type = HASH_KEY_STRING;
+    key.str = entry->key;
+    hash_delete(ctx->table, &key);
+
+    DLIST_REMOVE(ctx->entries, entry);
+    ctx->num_entries--;
+
+    return 0;
+}
+
+void nss_refresh_hit(struct nss_ctx *nctx,
+                     struct sss_domain_info *dom,
+                     int req_type,
+                     const char *name,
+                     uint64_t expire)
+{
+    struct nss_refresh_ctx *ctx = nctx->refresh;
+    struct nss_refresh_entry *entry;
+    hash_key_t key;
+    hash_value_t value;
+    char *strkey;
+    int hret;
+
+    if (ctx == NULL || name == NULL) {
+        return;
+    }
+
+    switch (req_type) {
+    case SSS_DP_USER:
+    case SSS_DP_GROUP:
+    case SSS_DP_INITGROUPS:
+    case SSS_DP_NETGR:
+        break;
+    default:
+        return;
+    }
+
+    strkey = talloc_asprintf(ctx, "%d:%s:%s", req_type, dom->name, name);
+    if (strkey == NULL) {
+        return;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = strkey;
+
+    hret = hash_lookup(ctx->table, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        entry = talloc_get_type(value.ptr, struct nss_refresh_entry);
+        entry->hits++;
+        if (!entry->pending) {
+            entry->expire = expire;
+        }
+        talloc_free(strkey);
+        return;
+    }
+
+    if (ctx->num_entries >= NSS_REFRESH_MAX_ENTRIES) {
+        talloc_free(strkey);
+        return;
+    }
+
+    entry = talloc_zero(ctx, struct nss_refresh_entry);
+    if (entry == NULL) {
+        talloc_free(strkey);
+        return;
+    }
+    entry->ctx = ctx;
+    entry->key = talloc_steal(entry, strkey);
+    entry->domain = talloc_strdup(entry, dom->name);
+    entry->name = talloc_strdup(entry, name);
+    if (entry->domain == NULL || entry->name == NULL) {
+        talloc_free(entry);
+        return;
+    }
+    entry->type = req_type;
+    entry->expire = expire;
+    entry->hits = 1;
+
+    key.str = entry->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+    hret = hash_enter(ctx->table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        talloc_free(entry);
+        return;
+    }
+
+    DLIST_ADD(ctx->entries, entry);
+    ctx->num_entries++;
+    talloc_set_destructor(entry, nss_refresh_entry_destructor);
+}
+
+static void nss_refresh_done(struct tevent_req *req)
+{
+    struct nss_refresh_entry *entry = tevent_req_callback_data(req,
+                                                struct nss_refresh_entry);
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    char *err_msg;
+    errno_t ret;
+
+    ret = sss_dp_get_account_recv(req, req, &err_maj, &err_min, &err_msg);
+    if (ret != EOK || err_maj != DP_ERR_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Refreshing [%s] failed: %d, %u, %s\n", entry->name,
+               ret, (unsigned int) err_maj,
+               ret == EOK && err_msg ? err_msg : "-"));
+    }
+    talloc_free(req);
+
+    /* the new expiration is learnt from the next request,
+     * only entries that stay popular are refreshed again */
+    entry->pending = false;
+    entry->expire = 0;
+}
+
+/* Returns ENOENT if the domain is gone and the entry was dropped */
+static errno_t nss_refresh_entry_send(struct nss_refresh_entry *entry)
+{
+    struct nss_ctx *nctx = entry->ctx->nctx;
+    struct sss_domain_info *dom;
+    struct tevent_req *req;
+
+    dom = responder_get_domain(nctx->rctx, entry->domain);
+    if (dom == NULL) {
+        talloc_free(entry);
+        return ENOENT;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Refreshing [%s@%s] before it expires\n",
+                              entry->name, entry->domain));
+
+    /* the user lookups by name are sent in batches
+     * when dp_batch_window is set for the domain */
+    req = sss_dp_get_account_send(entry, nctx->rctx, dom, true,
+                                  entry->type, entry->name, 0, NULL);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Out of memory sending data provider request\n"));
+        return ENOMEM;
+    }
+    tevent_req_set_callback(req, nss_refresh_done, entry);
+
+    entry->pending = true;
+    sss_stats_inc("cache_refresh_ahead");
+    return EOK;
+}
+
+static void nss_refresh_scan(struct tevent_context *ev,
+                             struct tevent_timer *te,
+                             struct timeval tv, void *pvt)
+{
+    struct nss_refresh_ctx *ctx = talloc_get_type(pvt,
+                                                  struct nss_refresh_ctx);
+    struct nss_refresh_entry *entry;
+    struct nss_refresh_entry *next;
+    uint64_t now;
+    errno_t ret;
+
+    now = time(NULL);
+
+    for (entry = ctx->entries; entry != NULL; entry = next) {
+        next = entry->next;
+
+        if (!entry->pending && entry->hits >= ctx->min_hits
+                && entry->expire > now
+                && entry->expire <= now + ctx->ahead) {
+            ret = nss_refresh_entry_send(entry);
+            if (ret == ENOENT) {
+                continue;
+            }
+        }
+
+        /* older requests count less */
+        entry->hits /= 2;
+        if (entry->hits == 0 && !entry->pending) {
+            talloc_free(entry);
+        }
+    }
+
+    nss_refresh_set_timer(ctx);
+}
@@ -151,3 +151,173 @@ errno_t pam_initgr_check_timeout(hash_table_t *id_table,
     return EOK;
 }
 
+
+struct pam_acct_cache_entry {
+    hash_table_t *acct_table;
+    char *key;
+    int pam_status;
+};
+
+static void pam_acct_cache_remove(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval tv,
+                                  void *pvt);
+
+static void pam_acct_cache_delete(hash_table_t *acct_table, const char *name)
+{
+    hash_key_t key;
+    hash_value_t val;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+
+    hret = hash_lookup(acct_table, &key, &val);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    hret = hash_delete(acct_table, &key);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Could not clear [%s] from the account cache: [%s]\n",
+               name, hash_error_string(hret)));
+        return;
+    }
+
+    /* This also frees the timer of the entry */
+    talloc_free(val.ptr);
+}
+
+errno_t pam_acct_cache_set(struct tevent_context *ev,
+                           hash_table_t *acct_table,
+                           const char *key_str,
+                           int pam_status,
+                           long timeout)
+{
+    errno_t ret;
+    hash_key_t key;
+    hash_value_t val;
+    int hret;
+    struct tevent_timer *te;
+    struct timeval tv;
+    struct pam_acct_cache_entry *entry;
+
+    /* An older decision for the same key would remove the new one when
+     * its timer fires */
+    pam_acct_cache_delete(acct_table, key_str);
+
+    entry = talloc_zero(acct_table, struct pam_acct_cache_entry);
+    if (!entry) return ENOMEM;
+
+    entry->acct_table = acct_table;
+    entry->pam_status = pam_status;
+    entry->key = talloc_strdup(entry, key_str);
+    if (!entry->key) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    tv = tevent_timeval_current_ofs(timeout, 0);
+    te = tevent_add_timer(ev, entry, tv, pam_acct_cache_remove, entry);
+    if (!te) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = entry->key;
+
+    val.type = HASH_VALUE_PTR;
+    val.ptr = entry;
+
+    hret = hash_enter(acct_table, &key, &val);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Could not update the account cache for [%s]: [%s]\n",
+               key_str, hash_error_string(hret)));
+        ret = EIO;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          ("Account management result [%d] for [%s] cached for %ld "
+           "seconds\n", pam_status, key_str, timeout));
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(entry);
+    }
+    return ret;
+}
+
+static void pam_acct_cache_remove(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval tv,
+                                  void *pvt)
+{
+    struct pam_acct_cache_entry *entry =
+            talloc_get_type(pvt, struct pam_acct_cache_entry);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          ("[%s] removed from the account cache\n", entry->key));
+
+    pam_acct_cache_delete(entry->acct_table, entry->key);
+}
+
+errno_t pam_acct_cache_get(hash_table_t *acct_table,
+                           const char *key_str,
+                           int *_pam_status)
+{
+    struct pam_acct_cache_entry *entry;
+    hash_key_t key;
+    hash_value_t val;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(key_str);
+
+    hret = hash_lookup(acct_table, &key, &val);
+    if (hret != HASH_SUCCESS
+            && hret != HASH_ERROR_KEY_NOT_FOUND) {
+        return EIO;
+    } else if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        return ENOENT;
+    }
+
+    entry = talloc_get_type(val.ptr, struct pam_acct_cache_entry);
+    if (entry == NULL) {
+        return EIO;
+    }
+
+    *_pam_status = entry->pam_status;
+    return EOK;
+}
+
+void pam_acct_cache_flush(hash_table_t *acct_table)
+{
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    int hret;
+
+    hret = hash_values(acct_table, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Could not list the account cache: [%s]\n",
+               hash_error_string(hret)));
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        pam_acct_cache_delete(acct_table,
+                              ((struct pam_acct_cache_entry *)
+                               values[i].ptr)->key);
+    }
+    talloc_free(values);
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Dropped %lu cached account management results\n", count));
+}
@@ -35,4 +35,24 @@ errno_t pam_initgr_cache_set(struct tevent_context *ev,
 errno_t pam_initgr_check_timeout(hash_table_t *id_table,
                               char *name);
 
+/* Remember the result of an account management check for the given key
+ * for timeout seconds.
+ */
+errno_t pam_acct_cache_set(struct tevent_context *ev,
+                           hash_table_t *acct_table,
+                           const char *key,
+                           int pam_status,
+                           long timeout);
+
+/* Returns EOK and sets _pam_status if there is a valid cached decision
+ * Returns ENOENT if there is none or it has expired
+ * May report other errors if the hash lookup fails.
+ */
+errno_t pam_acct_cache_get(hash_table_t *acct_table,
+                           const char *key,
+                           int *_pam_status);
+
+/* Drops all cached account management decisions */
+void pam_acct_cache_flush(hash_table_t *acct_table);
+
 #endif /* PAM_HELPERS_H_ */
@@ -42,6 +42,7 @@
 #include "monitor/monitor_interfaces.h"
 #include "sbus/sbus_client.h"
 #include "responder/pam/pamsrv.h"
+#include "responder/pam/pam_helpers.h"
 #include "responder/common/negcache.h"
 #include "responder/common/responder_sbus.h"
 
@@ -51,6 +52,7 @@ struct sbus_method monitor_pam_methods[] = {
     { MON_CLI_METHOD_PING, monitor_common_pong },
     { MON_CLI_METHOD_RES_INIT, monitor_common_res_init },
     { MON_CLI_METHOD_ROTATE, responder_logrotate },
+    { MON_CLI_METHOD_GET_STATS, monitor_common_get_stats },
     { NULL, NULL }
 };
 
@@ -62,7 +64,48 @@ struct sbus_interface monitor_pam_interface = {
     NULL
 };
 
+static int pam_acct_cache_flush_handler(DBusMessage *message,
+                                        struct sbus_connection *conn)
+{
+    struct resp_ctx *rctx = talloc_get_type(sbus_conn_get_private_data(conn),
+                                            struct resp_ctx);
+    struct pam_ctx *pctx = talloc_get_type(rctx->pvt_ctx, struct pam_ctx);
+    DBusError dbus_error;
+    dbus_bool_t dbret;
+    DBusMessage *reply;
+    char *domain;
+
+    dbus_error_init(&dbus_error);
+
+    dbret = dbus_message_get_args(message, &dbus_error,
+                                  DBUS_TYPE_STRING, &domain,
+                                  DBUS_TYPE_INVALID);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse message!\n"));
+        if (dbus_error_is_set(&dbus_error)) {
+            dbus_error_free(&dbus_error);
+        }
+        return EIO;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Access rules of domain [%s] changed\n", domain));
+
+    /* The cache is small and short lived, simply start over */
+    pam_acct_cache_flush(pctx->acct_table);
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) return ENOMEM;
+
+    /* send reply back */
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+
+    return EOK;
+}
+
 static struct sbus_method pam_dp_methods[] = {
+        { DP_REV_METHOD_ACCT_CACHE_FLUSH, pam_acct_cache_flush_handler },
         { NULL, NULL }
 };
 
@@ -111,8 +154,11 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
     struct sss_cmd_table *pam_cmds;
     struct be_conn *iter;
     struct pam_ctx *pctx;
+    struct sss_domain_info *dom;
     int ret, max_retries;
     int id_timeout;
+    int acct_cache_timeout;
+    int write_delay;
     int fd_limit;
 
     pam_cmds = get_pam_cmds();
@@ -190,6 +236,44 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    /* Set up the cache of account management decisions */
+    ret = confdb_get_int(cdb, CONFDB_PAM_CONF_ENTRY,
+                         CONFDB_PAM_ACCT_CACHE_TIMEOUT,
+                         CONFDB_DEFAULT_PAM_ACCT_CACHE_TIMEOUT,
+                         &acct_cache_timeout);
+    if (ret != EOK) goto done;
+
+    pctx->acct_cache_timeout = acct_cache_timeout > 0 ? acct_cache_timeout : 0;
+
+    ret = sss_hash_create(pctx, 10, &pctx->acct_table);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("Could not create account management hash table: [%s]",
+               strerror(ret)));
+        goto done;
+    }
+
+    /* Write the login information of cached authentications in batches */
+    ret = confdb_get_int(cdb, CONFDB_PAM_CONF_ENTRY,
+                         CONFDB_PAM_WRITE_DELAY,
+                         CONFDB_DEFAULT_PAM_WRITE_DELAY,
+                         &write_delay);
+    if (ret != EOK) goto done;
+
+    for (dom = rctx->domains; dom; dom = get_next_domain(dom, false)) {
+        if (!dom->cache_credentials || dom->sysdb == NULL) {
+            continue;
+        }
+
+        ret = sysdb_cache_auth_set_write_delay(dom->sysdb, ev, write_delay);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  ("Cannot set up delayed login information writes for "
+                   "domain [%s]\n", dom->name));
+            goto done;
+        }
+    }
+
     /* Set up file descriptor limits */
     ret = confdb_get_int(pctx->rctx->cdb,
                          CONFDB_PAM_CONF_ENTRY,
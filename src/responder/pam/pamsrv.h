@@ -37,6 +37,10 @@ struct pam_ctx {
     int neg_timeout;
     time_t id_timeout;
     hash_table_t *id_table;
+
+    /* Recent account management decisions per user, service and host */
+    time_t acct_cache_timeout;
+    hash_table_t *acct_table;
 };
 
 struct pam_auth_dp_req {
@@ -1140,8 +1140,113 @@ done:
     }
 }
 
+static char *pam_acct_cache_key(TALLOC_CTX *mem_ctx, struct pam_data *pd)
+{
+    return talloc_asprintf(mem_ctx, "%s@%s\n%s\n%s", pd->user, pd->domain,
+                           pd->service ? pd->service : "",
+                           pd->rhost ? pd->rhost : "");
+}
+
+/* Only plain answers of a reachable provider are remembered, and only if
+ * the provider flushes the cache when its policy changes */
+static bool pam_acct_mgmt_cacheable(struct pam_data *pd)
+{
+    struct response_data *resp;
+    bool cacheable = false;
+
+    /* The backend is offline, pam_reply() will assume success. This must
+     * be asked for again once the provider can answer. */
+    if (pd->pam_status == PAM_AUTHINFO_UNAVAIL || pd->offline_auth) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Not caching the account management "
+                                  "result of [%s@%s] while offline\n",
+                                  pd->user, pd->domain));
+        return false;
+    }
+
+    for (resp = pd->resp_list; resp != NULL; resp = resp->next) {
+        if (resp->type == SSS_ACCT_INFO_CACHEABLE) {
+            cacheable = true;
+        } else if (!(resp->type & SSS_SERVER_INFO)) {
+            /* Anything that carries a message for the user, e.g. an
+             * expiration warning, must be shown again */
+            return false;
+        }
+    }
+
+    if (!cacheable) {
+        return false;
+    }
+
+    return pd->pam_status == PAM_SUCCESS || pd->pam_status == PAM_PERM_DENIED;
+}
+
+static void pam_acct_mgmt_dp_done(struct pam_auth_req *preq)
+{
+    struct pam_ctx *pctx =
+            talloc_get_type(preq->cctx->rctx->pvt_ctx, struct pam_ctx);
+    struct pam_data *pd = preq->pd;
+    char *key;
+    errno_t ret;
+
+    if (pam_acct_mgmt_cacheable(pd)) {
+        key = pam_acct_cache_key(preq, pd);
+        if (key == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("talloc_asprintf failed.\n"));
+        } else {
+            ret = pam_acct_cache_set(preq->cctx->ev, pctx->acct_table, key,
+                                     pd->pam_status,
+                                     pctx->acct_cache_timeout);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("Could not cache the account management result "
+                       "[%d]: %s\n", ret, strerror(ret)));
+            }
+            talloc_free(key);
+        }
+    }
+
+    pam_reply(preq);
+}
+
+/* Returns true if the request was answered from the cache */
+static bool pam_acct_mgmt_from_cache(struct pam_auth_req *preq)
+{
+    struct pam_ctx *pctx =
+            talloc_get_type(preq->cctx->rctx->pvt_ctx, struct pam_ctx);
+    char *key;
+    int pam_status;
+    errno_t ret;
+
+    key = pam_acct_cache_key(preq, preq->pd);
+    if (key == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("talloc_asprintf failed.\n"));
+        return false;
+    }
+
+    ret = pam_acct_cache_get(pctx->acct_table, key, &pam_status);
+    talloc_free(key);
+    if (ret != EOK) {
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Could not look up the account cache [%d]: %s\n",
+                   ret, strerror(ret)));
+        }
+        return false;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Using cached account management result [%d] for [%s@%s]\n",
+           pam_status, preq->pd->user, preq->pd->domain));
+
+    preq->pd->pam_status = pam_status;
+    pam_reply(preq);
+    return true;
+}
+
 static void pam_dom_forwarder(struct pam_auth_req *preq)
 {
+    struct pam_ctx *pctx =
+            talloc_get_type(preq->cctx->rctx->pvt_ctx, struct pam_ctx);
     int ret;
 
     if (!preq->pd->domain) {
@@ -1152,6 +1257,16 @@ static void pam_dom_forwarder(struct pam_auth_req *preq)
         preq->callback = pam_reply;
         ret = LOCAL_pam_handler(preq);
     }
+    else if (preq->pd->cmd == SSS_PAM_ACCT_MGMT
+             && pctx->acct_cache_timeout > 0) {
+        if (pam_acct_mgmt_from_cache(preq)) {
+            return;
+        }
+
+        preq->callback = pam_acct_mgmt_dp_done;
+        ret = pam_dp_send_req(preq, SSS_CLI_SOCKET_TIMEOUT/2);
+        DEBUG(4, ("pam_dp_send_req returned %d\n", ret));
+    }
     else {
         preq->callback = pam_reply;
         ret = pam_dp_send_req(preq, SSS_CLI_SOCKET_TIMEOUT/2);
@@ -1215,6 +1330,7 @@ struct sss_cmd_table *get_pam_cmds(void)
 {
     static struct sss_cmd_table sss_cmds[] = {
         {SSS_GET_VERSION, sss_cmd_get_version},
+        {SSS_GET_STATS, sss_cmd_get_stats},
         {SSS_PAM_AUTHENTICATE, pam_cmd_authenticate},
         {SSS_PAM_SETCRED, pam_cmd_setcred},
         {SSS_PAM_ACCT_MGMT, pam_cmd_acct_mgmt},
@@ -948,6 +948,7 @@ struct cli_protocol_version *register_cli_protocol_version(void)
 struct sss_cmd_table *get_ssh_cmds(void) {
     static struct sss_cmd_table ssh_cmds[] = {
         {SSS_GET_VERSION, sss_cmd_get_version},
+        {SSS_GET_STATS, sss_cmd_get_stats},
         {SSS_SSH_GET_USER_PUBKEYS, sss_ssh_cmd_get_user_pubkeys},
         {SSS_SSH_GET_HOST_PUBKEYS, sss_ssh_cmd_get_host_pubkeys},
         {SSS_CLI_NULL, NULL}
@@ -32,6 +32,7 @@ struct sbus_method monitor_sudo_methods[] = {
     { MON_CLI_METHOD_PING, monitor_common_pong },
     { MON_CLI_METHOD_RES_INIT, monitor_common_res_init },
     { MON_CLI_METHOD_ROTATE, responder_logrotate },
+    { MON_CLI_METHOD_GET_STATS, monitor_common_get_stats },
     { NULL, NULL }
 };
 
@@ -43,7 +44,45 @@ struct sbus_interface monitor_sudo_interface = {
     NULL
 };
 
+static int sudo_rules_changed_handler(DBusMessage *message,
+                                      struct sbus_connection *conn)
+{
+    struct resp_ctx *rctx = talloc_get_type(sbus_conn_get_private_data(conn),
+                                            struct resp_ctx);
+    struct sudo_ctx *sudo_ctx = talloc_get_type(rctx->pvt_ctx,
+                                                struct sudo_ctx);
+    DBusError dbus_error;
+    dbus_bool_t dbret;
+    DBusMessage *reply;
+    char *domain;
+
+    dbus_error_init(&dbus_error);
+
+    dbret = dbus_message_get_args(message, &dbus_error,
+                                  DBUS_TYPE_STRING, &domain,
+                                  DBUS_TYPE_INVALID);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse message!\n"));
+        if (dbus_error_is_set(&dbus_error)) {
+            dbus_error_free(&dbus_error);
+        }
+        return EIO;
+    }
+
+    sudosrv_rule_index_invalidate(sudo_ctx, domain);
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) return ENOMEM;
+
+    /* send reply back */
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+
+    return EOK;
+}
+
 static struct sbus_method sudo_dp_methods[] = {
+    { DP_REV_METHOD_SUDO_RULES_CHANGED, sudo_rules_changed_handler },
     { NULL, NULL }
 };
 
@@ -72,6 +111,10 @@ static void sudo_dp_reconnect_init(struct sbus_connection *conn,
                                 "SUDO");
         /* all fine */
         if (ret == EOK) {
+            /* we might have missed a notification while disconnected */
+            sudosrv_rule_index_invalidate(
+                    talloc_get_type(be_conn->rctx->pvt_ctx, struct sudo_ctx),
+                    be_conn->domain->name);
             handle_requests_after_reconnect(be_conn->rctx);
             return;
         }
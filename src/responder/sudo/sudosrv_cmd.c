@@ -300,6 +300,7 @@ struct cli_protocol_version *register_cli_protocol_version(void)
 struct sss_cmd_table *get_sudo_cmds(void) {
     static struct sss_cmd_table sudo_cmds[] = {
         {SSS_GET_VERSION, sss_cmd_get_version},
+        {SSS_GET_STATS, sss_cmd_get_stats},
         {SSS_SUDO_GET_SUDORULES, sudosrv_cmd_get_sudorules},
         {SSS_SUDO_GET_DEFAULTS, sudosrv_cmd_get_defaults},
         {SSS_CLI_NULL, NULL}
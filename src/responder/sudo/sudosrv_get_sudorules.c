@@ -304,9 +304,8 @@ static void
 sudosrv_dp_req_done(struct tevent_req *req);
 
 static errno_t sudosrv_get_sudorules_query_cache(TALLOC_CTX *mem_ctx,
-                                                 struct sysdb_ctx *sysdb,
+                                                 struct sudo_ctx *sudo_ctx,
                                                  struct sss_domain_info *domain,
-                                                 const char **attrs,
                                                  unsigned int flags,
                                                  const char *username,
                                                  uid_t uid,
@@ -324,8 +323,6 @@ errno_t sudosrv_get_rules(struct sudo_cmd_ctx *cmd_ctx)
     struct sysdb_attrs **expired_rules = NULL;
     errno_t ret;
     unsigned int flags = SYSDB_SUDO_FILTER_NONE;
-    const char *attrs[] = { SYSDB_NAME,
-                            NULL };
 
     if (cmd_ctx->domain == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Domain is not set!\n"));
@@ -368,8 +365,8 @@ errno_t sudosrv_get_rules(struct sudo_cmd_ctx *cmd_ctx)
             | SYSDB_SUDO_FILTER_INCLUDE_DFL
             | SYSDB_SUDO_FILTER_ONLY_EXPIRED
             | SYSDB_SUDO_FILTER_USERINFO;
-    ret = sudosrv_get_sudorules_query_cache(tmp_ctx, cmd_ctx->domain->sysdb,
-                                            cmd_ctx->domain, attrs, flags,
+    ret = sudosrv_get_sudorules_query_cache(tmp_ctx, cmd_ctx->sudo_ctx,
+                                            cmd_ctx->domain, flags,
                                             cmd_ctx->orig_username,
                                             cmd_ctx->uid, groupnames,
                                             &expired_rules, &expired_rules_num);
@@ -531,18 +528,6 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
     unsigned int flags = SYSDB_SUDO_FILTER_NONE;
     struct sysdb_attrs **rules = NULL;
     uint32_t num_rules = 0;
-    const char *attrs[] = { SYSDB_OBJECTCLASS,
-                            SYSDB_SUDO_CACHE_AT_CN,
-                            SYSDB_SUDO_CACHE_AT_USER,
-                            SYSDB_SUDO_CACHE_AT_HOST,
-                            SYSDB_SUDO_CACHE_AT_COMMAND,
-                            SYSDB_SUDO_CACHE_AT_OPTION,
-                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
-                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
-                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
-                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
-                            SYSDB_SUDO_CACHE_AT_ORDER,
-                            NULL };
 
     if (cmd_ctx->domain == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Domain is not set!\n"));
@@ -576,8 +561,8 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
         break;
     }
 
-    ret = sudosrv_get_sudorules_query_cache(tmp_ctx, cmd_ctx->domain->sysdb,
-                                            cmd_ctx->domain, attrs, flags,
+    ret = sudosrv_get_sudorules_query_cache(tmp_ctx, cmd_ctx->sudo_ctx,
+                                            cmd_ctx->domain, flags,
                                             cmd_ctx->orig_username,
                                             cmd_ctx->uid, groupnames,
                                             &rules, &num_rules);
@@ -604,13 +589,9 @@ done:
     return ret;
 }
 
-static errno_t
-sort_sudo_rules(struct sysdb_attrs **rules, size_t count);
-
 static errno_t sudosrv_get_sudorules_query_cache(TALLOC_CTX *mem_ctx,
-                                                 struct sysdb_ctx *sysdb,
+                                                 struct sudo_ctx *sudo_ctx,
                                                  struct sss_domain_info *domain,
-                                                 const char **attrs,
                                                  unsigned int flags,
                                                  const char *username,
                                                  uid_t uid,
@@ -618,115 +599,21 @@ static errno_t sudosrv_get_sudorules_query_cache(TALLOC_CTX *mem_ctx,
                                                  struct sysdb_attrs ***_rules,
                                                  uint32_t *_count)
 {
-    TALLOC_CTX *tmp_ctx;
-    char *filter;
     errno_t ret;
-    size_t count;
-    struct sysdb_attrs **rules;
-    struct ldb_message **msgs;
-
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) return ENOMEM;
-
-    ret = sysdb_get_sudo_filter(tmp_ctx, username, uid, groupnames,
-                                flags, &filter);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              ("Could not construct the search filter [%d]: %s\n",
-               ret, strerror(ret)));
-        goto done;
-    }
-
-    DEBUG(SSSDBG_FUNC_DATA, ("Searching sysdb with [%s]\n", filter));
-
-    if (IS_SUBDOMAIN(domain)) {
-        /* rules are stored inside parent domain tree */
-        domain = domain->parent;
-    }
 
-    ret = sysdb_search_custom(tmp_ctx, sysdb, domain, filter,
-                              SUDORULE_SUBDIR, attrs,
-                              &count, &msgs);
-    if (ret != EOK && ret != ENOENT) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Error looking up SUDO rules"));
-        goto done;
-    } if (ret == ENOENT) {
-       *_rules = NULL;
-       *_count = 0;
-       ret = EOK;
-       goto done;
-    }
+    DEBUG(SSSDBG_FUNC_DATA, ("Looking up sudo rules of [%s] with flags "
+                             "[%#x] in the rule index\n",
+                             username ? username : "<none>", flags));
 
-    ret = sysdb_msg2attrs(tmp_ctx, count, msgs, &rules);
+    /* The rules are owned by the index and come already sorted by
+     * sudoOrder. They stay valid until the index is rebuilt. */
+    ret = sudosrv_rule_index_lookup(mem_ctx, sudo_ctx, domain, flags,
+                                    username, uid, groupnames,
+                                    _rules, _count);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              ("Could not convert ldb message to sysdb_attrs\n"));
-        goto done;
-    }
-
-    ret = sort_sudo_rules(rules, count);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              ("Could not sort rules by sudoOrder\n"));
-        goto done;
-    }
-
-    *_rules = talloc_steal(mem_ctx, rules);
-    *_count = (uint32_t)count;
-
-    ret = EOK;
-done:
-    talloc_free(tmp_ctx);
-    return ret;
-}
-
-static int
-sudo_order_cmp_fn(const void *a, const void *b)
-{
-    struct sysdb_attrs *r1, *r2;
-    uint32_t o1, o2;
-    int ret;
-
-    r1 = * (struct sysdb_attrs * const *) a;
-    r2 = * (struct sysdb_attrs * const *) b;
-    if (!r1 || !r2) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("BUG: Wrong data?\n"));
-        return 0;
-    }
-
-    ret = sysdb_attrs_get_uint32_t(r1, SYSDB_SUDO_CACHE_AT_ORDER, &o1);
-    if (ret == ENOENT) {
-        /* man sudoers-ldap: If the sudoOrder attribute is not present,
-         * a value of 0 is assumed */
-        o1 = 0;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Cannot get sudoOrder value\n"));
-        return 0;
-    }
-
-    ret = sysdb_attrs_get_uint32_t(r2, SYSDB_SUDO_CACHE_AT_ORDER, &o2);
-    if (ret == ENOENT) {
-        /* man sudoers-ldap: If the sudoOrder attribute is not present,
-         * a value of 0 is assumed */
-        o2 = 0;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("Cannot get sudoOrder value\n"));
-        return 0;
-    }
-
-    if (o1 > o2) {
-        return 1;
-    } else if (o1 < o2) {
-        return -1;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Error looking up SUDO rules\n"));
+        return ret;
     }
 
-    return 0;
-}
-
-static errno_t
-sort_sudo_rules(struct sysdb_attrs **rules, size_t count)
-{
-    qsort(rules, count, sizeof(struct sysdb_attrs *),
-          sudo_order_cmp_fn);
     return EOK;
 }
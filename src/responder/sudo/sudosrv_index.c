@@ -0,0 +1,549 @@
+/*
+    SSSD
+
+    sudosrv_index.c
+
+    In-memory index of the cached sudo rules
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "db/sysdb_sudo.h"
+#include "responder/sudo/sudosrv_private.h"
+
+/*
+ * All sudo rules of a domain are kept in memory sorted by sudoOrder.
+ * Every sudoUser value points to the positions of the rules that contain
+ * it, so a lookup only merges a few short lists instead of running an
+ * OR filter over the whole sysdb subtree and sorting the result. The
+ * index is dropped when the provider reports that it stored new rules
+ * and is built again with the next lookup.
+ */
+
+/* expiry of a rule that was stored without dataExpireTimestamp */
+#define SUDOSRV_RULE_NO_EXPIRE ((time_t) -1)
+
+struct sudosrv_rule_list {
+    size_t *pos;
+    size_t count;
+    size_t alloc;
+};
+
+struct sudosrv_rule_index {
+    struct sudosrv_rule_index *prev;
+    struct sudosrv_rule_index *next;
+
+    char *domain_name;
+    bool valid;
+
+    /* everything below is allocated on data */
+    TALLOC_CTX *data;
+
+    struct sysdb_attrs **rules;
+    /* the same rules without the attributes that are not sent to sudo */
+    struct sysdb_attrs *public_rules;
+    time_t *expire;
+    size_t num_rules;
+
+    /* sudoUser value -> struct sudosrv_rule_list */
+    hash_table_t *by_user;
+
+    struct sudosrv_rule_list all;
+    struct sudosrv_rule_list netgroups;
+    struct sudosrv_rule_list defaults;
+};
+
+static errno_t sudosrv_rule_list_add(TALLOC_CTX *mem_ctx,
+                                     struct sudosrv_rule_list *list,
+                                     size_t pos)
+{
+    size_t *tmp;
+
+    /* the rules are added in order, skip repeated values of one rule */
+    if (list->count > 0 && list->pos[list->count - 1] == pos) {
+        return EOK;
+    }
+
+    if (list->count == list->alloc) {
+        list->alloc = list->alloc ? list->alloc * 2 : 4;
+        tmp = talloc_realloc(mem_ctx, list->pos, size_t, list->alloc);
+        if (tmp == NULL) {
+            return ENOMEM;
+        }
+        list->pos = tmp;
+    }
+
+    list->pos[list->count++] = pos;
+    return EOK;
+}
+
+static errno_t sudosrv_rule_index_add_user(struct sudosrv_rule_index *index,
+                                           const char *value,
+                                           size_t pos)
+{
+    struct sudosrv_rule_list *list;
+    hash_key_t key;
+    hash_value_t hvalue;
+    int hret;
+
+    if (strcmp(value, "ALL") == 0) {
+        return sudosrv_rule_list_add(index->data, &index->all, pos);
+    }
+
+    if (value[0] == '+') {
+        return sudosrv_rule_list_add(index->data, &index->netgroups, pos);
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(index->by_user, &key, &hvalue);
+    if (hret == HASH_SUCCESS) {
+        list = talloc_get_type(hvalue.ptr, struct sudosrv_rule_list);
+    } else if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        list = talloc_zero(index->data, struct sudosrv_rule_list);
+        if (list == NULL) {
+            return ENOMEM;
+        }
+
+        hvalue.type = HASH_VALUE_PTR;
+        hvalue.ptr = list;
+
+        hret = hash_enter(index->by_user, &key, &hvalue);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Unable to index [%s]: %s\n",
+                                      value, hash_error_string(hret)));
+            return EIO;
+        }
+    } else {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to look up [%s]: %s\n",
+                                  value, hash_error_string(hret)));
+        return EIO;
+    }
+
+    return sudosrv_rule_list_add(list, list, pos);
+}
+
+static int sudosrv_rule_order_cmp(const void *a, const void *b)
+{
+    struct sysdb_attrs *r1, *r2;
+    uint32_t o1, o2;
+    int ret;
+
+    r1 = * (struct sysdb_attrs * const *) a;
+    r2 = * (struct sysdb_attrs * const *) b;
+
+    /* man sudoers-ldap: If the sudoOrder attribute is not present,
+     * a value of 0 is assumed */
+    ret = sysdb_attrs_get_uint32_t(r1, SYSDB_SUDO_CACHE_AT_ORDER, &o1);
+    if (ret != EOK) o1 = 0;
+
+    ret = sysdb_attrs_get_uint32_t(r2, SYSDB_SUDO_CACHE_AT_ORDER, &o2);
+    if (ret != EOK) o2 = 0;
+
+    if (o1 > o2) {
+        return 1;
+    } else if (o1 < o2) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Moves the attributes only needed by the responder to the end of the
+ * element array, so the public view of the rule can share it. */
+static void sudosrv_rule_index_split(struct sysdb_attrs *rule,
+                                     struct sysdb_attrs *public_rule)
+{
+    struct ldb_message_element tmp;
+    int last;
+    int i;
+
+    last = rule->num;
+    for (i = 0; i < last; i++) {
+        if (strcasecmp(rule->a[i].name, SYSDB_NAME) == 0
+                || strcasecmp(rule->a[i].name, SYSDB_CACHE_EXPIRE) == 0) {
+            last--;
+            tmp = rule->a[i];
+            rule->a[i] = rule->a[last];
+            rule->a[last] = tmp;
+            i--;
+        }
+    }
+
+    public_rule->num = last;
+    public_rule->a = rule->a;
+}
+
+static errno_t sudosrv_rule_index_build(struct sudosrv_rule_index *index,
+                                        struct sss_domain_info *domain)
+{
+    TALLOC_CTX *data;
+    struct ldb_message **msgs;
+    struct ldb_message_element *el;
+    const char *name;
+    const char *expire;
+    char *filter;
+    size_t count;
+    size_t i;
+    size_t j;
+    errno_t ret;
+    const char *attrs[] = { SYSDB_OBJECTCLASS,
+                            SYSDB_NAME,
+                            SYSDB_CACHE_EXPIRE,
+                            SYSDB_SUDO_CACHE_AT_CN,
+                            SYSDB_SUDO_CACHE_AT_USER,
+                            SYSDB_SUDO_CACHE_AT_HOST,
+                            SYSDB_SUDO_CACHE_AT_COMMAND,
+                            SYSDB_SUDO_CACHE_AT_OPTION,
+                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
+                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
+                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
+                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
+                            SYSDB_SUDO_CACHE_AT_ORDER,
+                            NULL };
+
+    talloc_zfree(index->data);
+    memset(&index->all, 0, sizeof(index->all));
+    memset(&index->netgroups, 0, sizeof(index->netgroups));
+    memset(&index->defaults, 0, sizeof(index->defaults));
+    index->rules = NULL;
+    index->public_rules = NULL;
+    index->expire = NULL;
+    index->num_rules = 0;
+    index->by_user = NULL;
+
+    data = talloc_new(index);
+    if (data == NULL) {
+        return ENOMEM;
+    }
+
+    filter = talloc_asprintf(data, "(%s=%s)",
+                             SYSDB_OBJECTCLASS, SYSDB_SUDO_CACHE_OC);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_custom(data, domain->sysdb, domain, filter,
+                              SUDORULE_SUBDIR, attrs, &count, &msgs);
+    if (ret == ENOENT) {
+        count = 0;
+        msgs = NULL;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Error looking up SUDO rules\n"));
+        goto done;
+    }
+
+    ret = sysdb_msg2attrs(data, count, msgs, &index->rules);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Could not convert ldb message to sysdb_attrs\n"));
+        goto done;
+    }
+    talloc_zfree(msgs);
+
+    qsort(index->rules, count, sizeof(struct sysdb_attrs *),
+          sudosrv_rule_order_cmp);
+
+    index->expire = talloc_zero_array(data, time_t, count + 1);
+    index->public_rules = talloc_zero_array(data, struct sysdb_attrs,
+                                            count + 1);
+    if (index->expire == NULL || index->public_rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_hash_create(data, count, &index->by_user);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    index->data = data;
+
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_string(index->rules[i], SYSDB_CACHE_EXPIRE,
+                                     &expire);
+        if (ret == EOK) {
+            index->expire[i] = (time_t) strtoll(expire, NULL, 10);
+        } else {
+            index->expire[i] = SUDOSRV_RULE_NO_EXPIRE;
+        }
+
+        ret = sysdb_attrs_get_string(index->rules[i], SYSDB_NAME, &name);
+        /* the name attribute is case insensitive in sysdb */
+        if (ret == EOK && strcasecmp(name, "defaults") == 0) {
+            ret = sudosrv_rule_list_add(data, &index->defaults, i);
+            if (ret != EOK) goto done;
+        }
+
+        ret = sysdb_attrs_get_el_ext(index->rules[i],
+                                     SYSDB_SUDO_CACHE_AT_USER, false, &el);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        for (j = 0; j < el->num_values; j++) {
+            ret = sudosrv_rule_index_add_user(index,
+                                              (const char *) el->values[j].data,
+                                              i);
+            if (ret != EOK) goto done;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        sudosrv_rule_index_split(index->rules[i], &index->public_rules[i]);
+    }
+
+    index->num_rules = count;
+    index->valid = true;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Indexed %zu sudo rules of domain [%s]\n",
+                              count, domain->name));
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(data);
+        index->data = NULL;
+        index->rules = NULL;
+        index->public_rules = NULL;
+        index->by_user = NULL;
+        index->num_rules = 0;
+    }
+    return ret;
+}
+
+static errno_t sudosrv_rule_index_get(struct sudo_ctx *sudo_ctx,
+                                      struct sss_domain_info *domain,
+                                      struct sudosrv_rule_index **_index)
+{
+    struct sudosrv_rule_index *index;
+    errno_t ret;
+
+    for (index = sudo_ctx->rule_index; index != NULL; index = index->next) {
+        if (strcmp(index->domain_name, domain->name) == 0) {
+            break;
+        }
+    }
+
+    if (index == NULL) {
+        index = talloc_zero(sudo_ctx, struct sudosrv_rule_index);
+        if (index == NULL) {
+            return ENOMEM;
+        }
+
+        index->domain_name = talloc_strdup(index, domain->name);
+        if (index->domain_name == NULL) {
+            talloc_free(index);
+            return ENOMEM;
+        }
+
+        DLIST_ADD(sudo_ctx->rule_index, index);
+    }
+
+    if (!index->valid) {
+        ret = sudosrv_rule_index_build(index, domain);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    *_index = index;
+    return EOK;
+}
+
+static void sudosrv_rule_index_mark(struct sudosrv_rule_list *list,
+                                    uint8_t *selected)
+{
+    size_t i;
+
+    for (i = 0; i < list->count; i++) {
+        selected[list->pos[i]] = 1;
+    }
+}
+
+static void sudosrv_rule_index_mark_user(struct sudosrv_rule_index *index,
+                                         const char *value,
+                                         uint8_t *selected)
+{
+    struct sudosrv_rule_list *list;
+    hash_key_t key;
+    hash_value_t hvalue;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(index->by_user, &key, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    list = talloc_get_type(hvalue.ptr, struct sudosrv_rule_list);
+    sudosrv_rule_index_mark(list, selected);
+}
+
+errno_t sudosrv_rule_index_lookup(TALLOC_CTX *mem_ctx,
+                                  struct sudo_ctx *sudo_ctx,
+                                  struct sss_domain_info *domain,
+                                  unsigned int flags,
+                                  const char *username,
+                                  uid_t uid,
+                                  char **groupnames,
+                                  struct sysdb_attrs ***_rules,
+                                  uint32_t *_count)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_rule_index *index;
+    struct sysdb_attrs **rules;
+    uint8_t *selected;
+    char *value;
+    time_t now;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    if (IS_SUBDOMAIN(domain)) {
+        /* rules are stored inside parent domain tree */
+        domain = domain->parent;
+    }
+
+    ret = sudosrv_rule_index_get(sudo_ctx, domain, &index);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) return ENOMEM;
+
+    selected = talloc_zero_array(tmp_ctx, uint8_t, index->num_rules + 1);
+    if (selected == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (flags & SYSDB_SUDO_FILTER_INCLUDE_ALL) {
+        sudosrv_rule_index_mark(&index->all, selected);
+    }
+
+    if (flags & SYSDB_SUDO_FILTER_INCLUDE_DFL) {
+        sudosrv_rule_index_mark(&index->defaults, selected);
+    }
+
+    if ((flags & SYSDB_SUDO_FILTER_USERNAME) && (username != NULL)) {
+        sudosrv_rule_index_mark_user(index, username, selected);
+    }
+
+    if ((flags & SYSDB_SUDO_FILTER_UID) && (uid != 0)) {
+        value = talloc_asprintf(tmp_ctx, "#%llu", (unsigned long long) uid);
+        if (value == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        sudosrv_rule_index_mark_user(index, value, selected);
+    }
+
+    if ((flags & SYSDB_SUDO_FILTER_GROUPS) && (groupnames != NULL)) {
+        for (i = 0; groupnames[i] != NULL; i++) {
+            value = talloc_asprintf(tmp_ctx, "%%%s", groupnames[i]);
+            if (value == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+            sudosrv_rule_index_mark_user(index, value, selected);
+            talloc_free(value);
+        }
+    }
+
+    if (flags & SYSDB_SUDO_FILTER_NGRS) {
+        sudosrv_rule_index_mark(&index->netgroups, selected);
+    }
+
+    if (flags & SYSDB_SUDO_FILTER_ONLY_EXPIRED) {
+        /* the same as (dataExpireTimestamp<=now), which never matches
+         * a rule without the attribute */
+        now = time(NULL);
+        for (i = 0; i < index->num_rules; i++) {
+            if (selected[i] && (index->expire[i] == SUDOSRV_RULE_NO_EXPIRE
+                                || index->expire[i] > now)) {
+                selected[i] = 0;
+            }
+        }
+    }
+
+    count = 0;
+    for (i = 0; i < index->num_rules; i++) {
+        if (selected[i]) count++;
+    }
+
+    rules = talloc_array(tmp_ctx, struct sysdb_attrs *, count + 1);
+    if (rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* The index is sorted by sudoOrder already. Expired rules are only
+     * looked up to be refreshed, which needs their names, everything else
+     * goes to sudo. */
+    count = 0;
+    for (i = 0; i < index->num_rules; i++) {
+        if (!selected[i]) continue;
+
+        if (flags & SYSDB_SUDO_FILTER_ONLY_EXPIRED) {
+            rules[count++] = index->rules[i];
+        } else {
+            rules[count++] = &index->public_rules[i];
+        }
+    }
+    rules[count] = NULL;
+
+    *_rules = talloc_steal(mem_ctx, rules);
+    *_count = (uint32_t) count;
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+void sudosrv_rule_index_invalidate(struct sudo_ctx *sudo_ctx,
+                                   const char *domain_name)
+{
+    struct sudosrv_rule_index *index;
+
+    for (index = sudo_ctx->rule_index; index != NULL; index = index->next) {
+        if (domain_name == NULL
+                || strcmp(index->domain_name, domain_name) == 0) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  ("Sudo rules of domain [%s] changed\n",
+                   index->domain_name));
+            index->valid = false;
+        }
+    }
+}
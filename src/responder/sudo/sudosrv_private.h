@@ -40,9 +40,14 @@ enum sss_sudo_type {
     SSS_SUDO_USER
 };
 
+struct sudosrv_rule_index;
+
 struct sudo_ctx {
     struct resp_ctx *rctx;
 
+    /* per-domain in-memory index of the cached rules */
+    struct sudosrv_rule_index *rule_index;
+
     /*
      * options
      */
@@ -88,6 +93,24 @@ errno_t sudosrv_get_sudorules(struct sudo_dom_ctx *dctx);
 
 errno_t sudosrv_get_rules(struct sudo_cmd_ctx *cmd_ctx);
 
+/* Returns the cached rules of the domain that match the sysdb sudo filter
+ * flags, sorted by sudoOrder. The rules belong to the index and must not be
+ * freed, they stay valid until the index is rebuilt. */
+errno_t sudosrv_rule_index_lookup(TALLOC_CTX *mem_ctx,
+                                  struct sudo_ctx *sudo_ctx,
+                                  struct sss_domain_info *domain,
+                                  unsigned int flags,
+                                  const char *username,
+                                  uid_t uid,
+                                  char **groupnames,
+                                  struct sysdb_attrs ***_rules,
+                                  uint32_t *_count);
+
+/* Drops the index of the domain, or of all domains if domain_name is NULL.
+ * It is built again with the next lookup. */
+void sudosrv_rule_index_invalidate(struct sudo_ctx *sudo_ctx,
+                                   const char *domain_name);
+
 struct tevent_req *sudosrv_parse_query_send(TALLOC_CTX *mem_ctx,
                                             struct resp_ctx *rctx,
                                             uint8_t *query_body,
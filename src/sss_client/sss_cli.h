@@ -71,6 +71,12 @@ enum sss_cli_command {
 /* version */
     SSS_GET_VERSION    = 0x0001,
 
+/* statistics */
+    SSS_GET_STATS      = 0x0002, /**< Returns the latency statistics of the
+                                  * responder and its data providers as a
+                                  * zero terminated string. Only available
+                                  * to root. */
+
 /* passwd */
 
     SSS_NSS_GETPWNAM       = 0x0011,
@@ -119,7 +125,13 @@ enum sss_cli_command {
     SSS_NSS_SETNETGRENT    = 0x0061,
     SSS_NSS_GETNETGRENT    = 0x0062,
     SSS_NSS_ENDNETGRENT    = 0x0063,
-    /* SSS_NSS_INNETGR     = 0x0064, */
+    SSS_NSS_INNETGR        = 0x0064, /**< Takes the zero terminated netgroup
+                                        * name, host, user and domain and
+                                        * returns an unsigned 32bit integer,
+                                        * 1 if the netgroup or one of its
+                                        * nested netgroups has a matching
+                                        * triple. An empty host, user or
+                                        * domain matches any value. */
 #if 0
 /* networks */
 
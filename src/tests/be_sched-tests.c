@@ -0,0 +1,283 @@
+/*
+   SSSD
+
+   Back end request priority tests
+
+   Copyright (C) 2013 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <check.h>
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/common_check.h"
+#include "tests/common.h"
+#include "util/util.h"
+#include "providers/dp_backend.h"
+
+struct sched_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct be_sched_hold *hold;
+
+    bool hold_released;
+    int finished;
+    int expected;
+    enum be_sched_class order[4];
+};
+
+struct sched_test_waiter {
+    struct sched_test_ctx *test_ctx;
+    enum be_sched_class cls;
+};
+
+static struct sched_test_ctx *setup_sched(void)
+{
+    struct sched_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_zero(global_talloc_context, struct sched_test_ctx);
+    fail_if(test_ctx == NULL, "Out of memory");
+
+    test_ctx->tctx = create_ev_test_ctx(test_ctx);
+    fail_if(test_ctx->tctx == NULL, "Cannot create the event context");
+
+    test_ctx->be_ctx = talloc_zero(test_ctx, struct be_ctx);
+    fail_if(test_ctx->be_ctx == NULL, "Out of memory");
+    test_ctx->be_ctx->ev = test_ctx->tctx->ev;
+
+    ret = be_sched_init(test_ctx->be_ctx);
+    fail_unless(ret == EOK, "be_sched_init failed [%d]", ret);
+
+    return test_ctx;
+}
+
+static void release_hold(struct tevent_context *ev, struct tevent_timer *te,
+                         struct timeval tv, void *pvt)
+{
+    struct sched_test_ctx *test_ctx = talloc_get_type(pvt,
+                                                      struct sched_test_ctx);
+
+    test_ctx->hold_released = true;
+    talloc_zfree(test_ctx->hold);
+}
+
+static void yield_done(struct tevent_req *req)
+{
+    struct sched_test_waiter *w = tevent_req_callback_data(req,
+                                                    struct sched_test_waiter);
+    struct sched_test_ctx *test_ctx = w->test_ctx;
+    errno_t ret;
+
+    ret = be_sched_yield_recv(req);
+    talloc_zfree(req);
+    fail_unless(ret == EOK, "be_sched_yield_recv failed [%d]", ret);
+
+    test_ctx->order[test_ctx->finished++] = w->cls;
+    if (test_ctx->finished == test_ctx->expected) {
+        test_ctx->tctx->done = true;
+    }
+}
+
+static void add_waiter(struct sched_test_ctx *test_ctx,
+                       enum be_sched_class cls)
+{
+    struct sched_test_waiter *w;
+    struct tevent_req *req;
+
+    w = talloc_zero(test_ctx, struct sched_test_waiter);
+    fail_if(w == NULL, "Out of memory");
+    w->test_ctx = test_ctx;
+    w->cls = cls;
+
+    req = be_sched_yield_send(test_ctx, test_ctx->be_ctx, cls);
+    fail_if(req == NULL, "be_sched_yield_send failed");
+    tevent_req_set_callback(req, yield_done, w);
+    test_ctx->expected++;
+}
+
+START_TEST(test_yield_not_busy)
+{
+    struct sched_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = setup_sched();
+
+    add_waiter(test_ctx, BE_SCHED_CLEANUP);
+    fail_unless(test_ctx->finished == 0, "Yield completed synchronously");
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->finished == 1, "Yield did not complete");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(test_yield_behind_interactive)
+{
+    struct sched_test_ctx *test_ctx;
+    struct tevent_timer *te;
+    errno_t ret;
+
+    test_ctx = setup_sched();
+
+    test_ctx->hold = be_sched_hold(test_ctx, test_ctx->be_ctx,
+                                   BE_SCHED_INTERACTIVE);
+    fail_if(test_ctx->hold == NULL, "be_sched_hold failed");
+
+    add_waiter(test_ctx, BE_SCHED_CLEANUP);
+    add_waiter(test_ctx, BE_SCHED_REFRESH);
+
+    te = tevent_add_timer(test_ctx->tctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(0, 20000),
+                          release_hold, test_ctx);
+    fail_if(te == NULL, "tevent_add_timer failed");
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->hold_released,
+                "A background task ran before the lookup finished");
+    fail_unless(test_ctx->finished == 2, "Got %d tasks", test_ctx->finished);
+    fail_unless(test_ctx->order[0] == BE_SCHED_REFRESH &&
+                test_ctx->order[1] == BE_SCHED_CLEANUP,
+                "The refresh did not go before the cleanup");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(test_yield_same_class)
+{
+    struct sched_test_ctx *test_ctx;
+    struct be_sched_hold *hold;
+    errno_t ret;
+
+    test_ctx = setup_sched();
+
+    /* running tasks of the same or a less important class do not block */
+    hold = be_sched_hold(test_ctx, test_ctx->be_ctx, BE_SCHED_ENUMERATION);
+    fail_if(hold == NULL, "be_sched_hold failed");
+    test_ctx->hold = be_sched_hold(test_ctx, test_ctx->be_ctx,
+                                   BE_SCHED_CLEANUP);
+    fail_if(test_ctx->hold == NULL, "be_sched_hold failed");
+
+    add_waiter(test_ctx, BE_SCHED_ENUMERATION);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->finished == 1, "Yield did not complete");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(test_cancel_waiter)
+{
+    struct sched_test_ctx *test_ctx;
+    struct tevent_req *req;
+    struct tevent_timer *te;
+    errno_t ret;
+
+    test_ctx = setup_sched();
+
+    test_ctx->hold = be_sched_hold(test_ctx, test_ctx->be_ctx,
+                                   BE_SCHED_INTERACTIVE);
+    fail_if(test_ctx->hold == NULL, "be_sched_hold failed");
+
+    /* a task cancelled while waiting must not hold back the others */
+    req = be_sched_yield_send(test_ctx, test_ctx->be_ctx, BE_SCHED_REFRESH);
+    fail_if(req == NULL, "be_sched_yield_send failed");
+    add_waiter(test_ctx, BE_SCHED_CLEANUP);
+    talloc_free(req);
+
+    te = tevent_add_timer(test_ctx->tctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(0, 10000),
+                          release_hold, test_ctx);
+    fail_if(te == NULL, "tevent_add_timer failed");
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->finished == 1 &&
+                test_ctx->order[0] == BE_SCHED_CLEANUP,
+                "The cleanup did not run");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+Suite *be_sched_suite(void)
+{
+    Suite *s = suite_create("be_sched");
+
+    TCase *tc_be_sched = tcase_create("be_sched");
+    tcase_add_checked_fixture(tc_be_sched,
+                              ck_leak_check_setup,
+                              ck_leak_check_teardown);
+    tcase_add_test(tc_be_sched, test_yield_not_busy);
+    tcase_add_test(tc_be_sched, test_yield_behind_interactive);
+    tcase_add_test(tc_be_sched, test_yield_same_class);
+    tcase_add_test(tc_be_sched, test_cancel_waiter);
+    suite_add_tcase(s, tc_be_sched);
+
+    return s;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int failure_count;
+    Suite *suite;
+    SRunner *sr;
+    int debug = 0;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "debug-level", 'd', POPT_ARG_INT, &debug, 0, "Set debug level", NULL },
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug);
+
+    tests_set_cwd();
+
+    suite = be_sched_suite();
+    sr = srunner_create(suite);
+    srunner_set_fork_status(sr, CK_FORK);
+    /* If CK_VERBOSITY is set, use that, otherwise it defaults to CK_NORMAL */
+    srunner_run_all(sr, CK_ENV);
+    failure_count = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (failure_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
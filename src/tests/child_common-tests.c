@@ -0,0 +1,329 @@
+/*
+    SSSD
+
+    child_common-tests.c
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <popt.h>
+#include <talloc.h>
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "util/util.h"
+#include "util/child_common.h"
+#include "util/atomic_io.h"
+#include "tests/common_check.h"
+
+#define CAT_PATH "/bin/cat"
+#define ECHO_PATH "/bin/echo"
+#define TRUE_PATH "/bin/true"
+
+#define BENCH_ROUNDS 200
+
+static void make_pipes(int *to, int *from)
+{
+    int ret;
+
+    ret = pipe(to);
+    fail_unless(ret == 0, "pipe failed [%d][%s].", errno, strerror(errno));
+    ret = pipe(from);
+    fail_unless(ret == 0, "pipe failed [%d][%s].", errno, strerror(errno));
+}
+
+static int wait_for(pid_t pid)
+{
+    pid_t wpid;
+    int status;
+
+    do {
+        wpid = waitpid(pid, &status, 0);
+    } while (wpid == -1 && errno == EINTR);
+    fail_unless(wpid == pid, "waitpid failed [%d][%s].",
+                errno, strerror(errno));
+
+    return status;
+}
+
+START_TEST(test_sss_spawn_pipes)
+{
+    char *cat_argv[] = { discard_const(CAT_PATH), NULL };
+    const char msg[] = "sssd child test";
+    char buf[sizeof(msg)];
+    int to[2];
+    int from[2];
+    ssize_t len;
+    pid_t pid;
+    int status;
+    errno_t ret;
+
+    make_pipes(to, from);
+
+    ret = sss_spawn(CAT_PATH, cat_argv, to, from, 0, &pid);
+    fail_unless(ret == EOK, "sss_spawn failed [%d][%s].", ret, strerror(ret));
+    close(to[0]);
+    close(from[1]);
+
+    len = sss_atomic_write_s(to[1], discard_const(msg), sizeof(msg));
+    fail_unless(len == sizeof(msg), "Short write to the child.");
+    close(to[1]);
+
+    len = sss_atomic_read_s(from[0], buf, sizeof(buf));
+    fail_unless(len == sizeof(msg), "Short read from the child.");
+    fail_unless(memcmp(buf, msg, sizeof(msg)) == 0,
+                "Unexpected data from the child.");
+    close(from[0]);
+
+    status = wait_for(pid);
+    fail_unless(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                "Child did not exit cleanly.");
+}
+END_TEST
+
+START_TEST(test_sss_spawn_new_pgroup)
+{
+    char *cat_argv[] = { discard_const(CAT_PATH), NULL };
+    int to[2];
+    int from[2];
+    pid_t pid;
+    errno_t ret;
+
+    make_pipes(to, from);
+
+    ret = sss_spawn(CAT_PATH, cat_argv, to, from, SSS_SPAWN_NEW_PGROUP, &pid);
+    fail_unless(ret == EOK, "sss_spawn failed [%d][%s].", ret, strerror(ret));
+    close(to[0]);
+    close(from[1]);
+
+    /* cat runs until its stdin is closed */
+    fail_unless(getpgid(pid) == pid,
+                "Child is not the leader of a new process group.");
+    fail_unless(getpgid(pid) != getpgid(0),
+                "Child shares the process group of the parent.");
+
+    close(to[1]);
+    close(from[0]);
+    wait_for(pid);
+}
+END_TEST
+
+START_TEST(test_sss_spawn_missing_binary)
+{
+    char *argv[] = { discard_const("/nonexistent/sssd_child"), NULL };
+    pid_t pid;
+    int status;
+    errno_t ret;
+
+    ret = sss_spawn(argv[0], argv, NULL, NULL, 0, &pid);
+    if (ret == EOK) {
+        /* Older C libraries cannot report a failed exec to the parent,
+         * the child exits with 127 instead */
+        status = wait_for(pid);
+        fail_unless(WIFEXITED(status) && WEXITSTATUS(status) == 127,
+                    "Spawning a missing binary succeeded.");
+    } else {
+        fail_unless(ret == ENOENT, "Unexpected error [%d][%s].",
+                    ret, strerror(ret));
+    }
+}
+END_TEST
+
+START_TEST(test_spawn_child_args)
+{
+    const char *extra_args[] = { "--uid=1000", "--gid=1000", NULL };
+    char buf[1024];
+    int to[2];
+    int from[2];
+    ssize_t len;
+    pid_t pid;
+    errno_t ret;
+
+    make_pipes(to, from);
+
+    ret = spawn_child(global_talloc_context, to, from, ECHO_PATH, -1,
+                      extra_args, 0, &pid);
+    fail_unless(ret == EOK, "spawn_child failed [%d][%s].",
+                ret, strerror(ret));
+    close(to[0]);
+    close(from[1]);
+    close(to[1]);
+
+    len = sss_atomic_read_s(from[0], buf, sizeof(buf) - 1);
+    fail_unless(len > 0, "Nothing read from the child.");
+    buf[len] = '\0';
+    close(from[0]);
+    wait_for(pid);
+
+    fail_unless(strstr(buf, "--debug-level=") != NULL,
+                "Debug level not passed to the child: [%s].", buf);
+    fail_unless(strstr(buf, "--debug-microseconds=") != NULL,
+                "Debug microseconds not passed to the child: [%s].", buf);
+    fail_unless(strstr(buf, "--uid=1000\n--gid=1000\n") != NULL,
+                "Extra arguments not passed last to the child: [%s].", buf);
+}
+END_TEST
+
+Suite *child_common_suite(void)
+{
+    Suite *s = suite_create("child_common");
+
+    TCase *tc_spawn = tcase_create("spawn");
+    tcase_add_checked_fixture(tc_spawn,
+                              ck_leak_check_setup,
+                              ck_leak_check_teardown);
+    tcase_add_test(tc_spawn, test_sss_spawn_pipes);
+    tcase_add_test(tc_spawn, test_sss_spawn_new_pgroup);
+    tcase_add_test(tc_spawn, test_sss_spawn_missing_binary);
+    tcase_add_test(tc_spawn, test_spawn_child_args);
+    suite_add_tcase(s, tc_spawn);
+
+    return s;
+}
+
+/* Compare the cost of starting a helper with fork()+exec() against
+ * posix_spawn() for a parent with a growing amount of touched memory,
+ * which is what a long running sssd_be looks like. Not run by default. */
+static uint64_t bench_usec(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000ULL
+           + end->tv_usec - start->tv_usec;
+}
+
+static int run_benchmark(void)
+{
+    char *true_argv[] = { discard_const(TRUE_PATH), NULL };
+    size_t heap_mb[] = { 0, 32, 128 };
+    struct timeval start;
+    struct timeval end;
+    uint64_t fork_usec;
+    uint64_t spawn_usec;
+    char *heap;
+    pid_t pid;
+    size_t i;
+    int r;
+    errno_t ret;
+
+    printf("%10s %15s %15s\n", "heap [MB]", "fork+exec [us]", "spawn [us]");
+
+    for (i = 0; i < sizeof(heap_mb) / sizeof(heap_mb[0]); i++) {
+        heap = NULL;
+        if (heap_mb[i] > 0) {
+            heap = malloc(heap_mb[i] * 1024 * 1024);
+            if (heap == NULL) {
+                fprintf(stderr, "Cannot allocate %zu MB.\n", heap_mb[i]);
+                return EXIT_FAILURE;
+            }
+            /* make sure the pages are really mapped */
+            memset(heap, 0x5a, heap_mb[i] * 1024 * 1024);
+        }
+
+        gettimeofday(&start, NULL);
+        for (r = 0; r < BENCH_ROUNDS; r++) {
+            pid = fork();
+            if (pid == 0) {
+                execv(TRUE_PATH, true_argv);
+                _exit(127);
+            } else if (pid < 0) {
+                fprintf(stderr, "fork failed [%d].\n", errno);
+                free(heap);
+                return EXIT_FAILURE;
+            }
+            waitpid(pid, NULL, 0);
+        }
+        gettimeofday(&end, NULL);
+        fork_usec = bench_usec(&start, &end) / BENCH_ROUNDS;
+
+        gettimeofday(&start, NULL);
+        for (r = 0; r < BENCH_ROUNDS; r++) {
+            ret = sss_spawn(TRUE_PATH, true_argv, NULL, NULL, 0, &pid);
+            if (ret != EOK) {
+                fprintf(stderr, "sss_spawn failed [%d].\n", ret);
+                free(heap);
+                return EXIT_FAILURE;
+            }
+            waitpid(pid, NULL, 0);
+        }
+        gettimeofday(&end, NULL);
+        spawn_usec = bench_usec(&start, &end) / BENCH_ROUNDS;
+
+        printf("%10zu %15llu %15llu\n", heap_mb[i],
+               (unsigned long long) fork_usec,
+               (unsigned long long) spawn_usec);
+
+        free(heap);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    int failure_count;
+    int benchmark = 0;
+    poptContext pc;
+    Suite *s;
+    SRunner *sr;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_MAIN_OPTS
+        {"benchmark", 0, POPT_ARG_NONE, &benchmark, 0,
+         "Compare fork()+exec() with posix_spawn() instead of running "
+         "the tests", NULL},
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    if (benchmark) {
+        return run_benchmark();
+    }
+
+    tests_set_cwd();
+
+    s = child_common_suite();
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_ENV);
+    failure_count = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    if (failure_count == 0) {
+        return EXIT_SUCCESS;
+    }
+    return  EXIT_FAILURE;
+}
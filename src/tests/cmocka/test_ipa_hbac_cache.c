@@ -0,0 +1,316 @@
+/*
+    SSSD
+
+    Copyright (C) 2013 Red Hat
+
+    SSSD tests: Keeping the prepared HBAC rules up to date
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ipa/ipa_hbac_private.h"
+
+#define TESTS_PATH "tests_ipa_hbac_cache"
+#define TEST_CONF_DB "test_ipa_hbac_cache_conf.ldb"
+#define TEST_SYSDB_FILE "cache_ipa_hbac_cache_test.ldb"
+#define TEST_DOM_NAME "ipa_hbac_cache_test"
+#define TEST_ID_PROVIDER "ipa"
+
+#define TEST_USER "hbac_user"
+#define TEST_UID 16001
+#define TEST_GROUP "hbac_group"
+#define TEST_GID 16002
+#define TEST_GROUP_DN "cn="TEST_GROUP",cn=groups,dc=example,dc=com"
+#define OTHER_GROUP "hbac_other_group"
+#define OTHER_GID 16003
+#define OTHER_GROUP_DN "cn="OTHER_GROUP",cn=groups,dc=example,dc=com"
+
+struct hbac_cache_test_ctx {
+    struct sss_test_ctx *tctx;
+};
+
+static struct hbac_cache_test_ctx *hbac_test_ctx;
+
+static struct sysdb_attrs *make_rule(const char *name, const char *user1,
+                                     const char *user2)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+
+    rule = sysdb_new_attrs(hbac_test_ctx);
+    assert_non_null(rule);
+
+    ret = sysdb_attrs_add_string(rule, IPA_CN, name);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(rule, IPA_MEMBER_USER, user1);
+    assert_int_equal(ret, EOK);
+    if (user2 != NULL) {
+        ret = sysdb_attrs_add_string(rule, IPA_MEMBER_USER, user2);
+        assert_int_equal(ret, EOK);
+    }
+    ret = sysdb_attrs_add_string(rule, IPA_ENABLED_FLAG, IPA_TRUE_VALUE);
+    assert_int_equal(ret, EOK);
+
+    return rule;
+}
+
+static uint64_t rules_digest(size_t count, struct sysdb_attrs **rules)
+{
+    return ipa_hbac_objects_digest(0, IPA_HBAC_DIGEST_RULES, count, rules);
+}
+
+void test_hbac_digest_unchanged(void **state)
+{
+    struct sysdb_attrs *first[2];
+    struct sysdb_attrs *second[2];
+    struct sysdb_attrs *reordered;
+    errno_t ret;
+
+    first[0] = make_rule("allow_admins", "uid=a", "uid=b");
+    first[1] = make_rule("allow_users", "uid=c", NULL);
+
+    /* The same rules in a different order, with the values and attributes
+     * of a rule reordered as well, must keep the prepared rules */
+    reordered = sysdb_new_attrs(hbac_test_ctx);
+    assert_non_null(reordered);
+    ret = sysdb_attrs_add_string(reordered, IPA_ENABLED_FLAG, IPA_TRUE_VALUE);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(reordered, IPA_MEMBER_USER, "uid=b");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(reordered, IPA_MEMBER_USER, "uid=a");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(reordered, IPA_CN, "allow_admins");
+    assert_int_equal(ret, EOK);
+
+    second[0] = make_rule("allow_users", "uid=c", NULL);
+    second[1] = reordered;
+
+    assert_true(rules_digest(2, first) == rules_digest(2, second));
+    assert_true(rules_digest(0, NULL) == rules_digest(0, NULL));
+
+    talloc_free(first[0]);
+    talloc_free(first[1]);
+    talloc_free(second[0]);
+    talloc_free(second[1]);
+}
+
+void test_hbac_digest_changed(void **state)
+{
+    struct sysdb_attrs *rules[2];
+    struct sysdb_attrs *changed[2];
+    uint64_t digest;
+
+    rules[0] = make_rule("allow_admins", "uid=a", "uid=b");
+    rules[1] = make_rule("allow_users", "uid=c", NULL);
+    digest = rules_digest(2, rules);
+
+    /* no rules at all */
+    assert_false(digest == rules_digest(0, NULL));
+
+    /* a rule was removed */
+    assert_false(digest == rules_digest(1, rules));
+
+    /* the same objects downloaded as another kind */
+    assert_false(digest == ipa_hbac_objects_digest(0, IPA_HBAC_DIGEST_HOSTS,
+                                                   2, rules));
+
+    /* a member was changed */
+    changed[0] = make_rule("allow_admins", "uid=a", "uid=d");
+    changed[1] = rules[1];
+    assert_false(digest == rules_digest(2, changed));
+    talloc_free(changed[0]);
+
+    /* a member moved from one rule to the other */
+    changed[0] = make_rule("allow_admins", "uid=a", NULL);
+    changed[1] = make_rule("allow_users", "uid=c", "uid=b");
+    assert_false(digest == rules_digest(2, changed));
+    talloc_free(changed[0]);
+    talloc_free(changed[1]);
+
+    talloc_free(rules[0]);
+    talloc_free(rules[1]);
+}
+
+static void store_group(const char *name, gid_t gid, const char *orig_dn,
+                        time_t now)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(hbac_test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_ORIG_DN, orig_dn);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_group(hbac_test_ctx->tctx->sysdb,
+                            hbac_test_ctx->tctx->dom,
+                            name, gid, attrs, 300, now);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static void store_user(time_t now)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(hbac_test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_ORIG_MEMBEROF, TEST_GROUP_DN);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_user(hbac_test_ctx->tctx->sysdb,
+                           hbac_test_ctx->tctx->dom,
+                           TEST_USER, NULL, TEST_UID, TEST_GID,
+                           TEST_USER, "/", "/bin/sh",
+                           NULL, attrs, NULL, 300, now);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static bool entries_updated(const char *name, time_t since)
+{
+    bool updated;
+    errno_t ret;
+
+    ret = ipa_hbac_entries_updated(hbac_test_ctx->tctx->dom,
+                                   hbac_test_ctx->tctx->dom,
+                                   name, since, &updated);
+    assert_int_equal(ret, EOK);
+
+    return updated;
+}
+
+void test_hbac_entries_updated_user(void **state)
+{
+    store_group(TEST_GROUP, TEST_GID, TEST_GROUP_DN, 1000);
+    store_user(2000);
+
+    /* The rules were prepared before the user was cached */
+    assert_true(entries_updated(TEST_USER, 1500));
+    assert_true(entries_updated(TEST_USER, 2000));
+
+    /* The rules already knew the user, a denial is final */
+    assert_false(entries_updated(TEST_USER, 2500));
+
+    /* An unknown user cannot be a member the rules missed */
+    assert_false(entries_updated("hbac_unknown_user", 1500));
+}
+
+void test_hbac_entries_updated_group(void **state)
+{
+    store_user(1000);
+    store_group(TEST_GROUP, TEST_GID, TEST_GROUP_DN, 2000);
+    store_group(OTHER_GROUP, OTHER_GID, OTHER_GROUP_DN, 3000);
+
+    /* A group of the user was cached after the rules were prepared */
+    assert_true(entries_updated(TEST_USER, 1500));
+
+    /* Groups the user is not a member of do not matter */
+    assert_false(entries_updated(TEST_USER, 2500));
+}
+
+/* Testsuite setup and teardown */
+void hbac_cache_test_setup(void **state)
+{
+    assert_true(leak_check_setup());
+    hbac_test_ctx = talloc_zero(global_talloc_context,
+                                struct hbac_cache_test_ctx);
+    assert_non_null(hbac_test_ctx);
+
+    hbac_test_ctx->tctx = create_dom_test_ctx(hbac_test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, TEST_SYSDB_FILE,
+                                              TEST_DOM_NAME,
+                                              TEST_ID_PROVIDER, NULL);
+    assert_non_null(hbac_test_ctx->tctx);
+}
+
+void hbac_cache_test_teardown(void **state)
+{
+    /* The entries may or may not have been added by the test */
+    sysdb_delete_user(hbac_test_ctx->tctx->sysdb,
+                      hbac_test_ctx->tctx->dom, TEST_USER, 0);
+    sysdb_delete_group(hbac_test_ctx->tctx->sysdb,
+                       hbac_test_ctx->tctx->dom, TEST_GROUP, 0);
+    sysdb_delete_group(hbac_test_ctx->tctx->sysdb,
+                       hbac_test_ctx->tctx->dom, OTHER_GROUP, 0);
+
+    talloc_free(hbac_test_ctx);
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_hbac_digest_unchanged,
+                                 hbac_cache_test_setup,
+                                 hbac_cache_test_teardown),
+        unit_test_setup_teardown(test_hbac_digest_changed,
+                                 hbac_cache_test_setup,
+                                 hbac_cache_test_teardown),
+        unit_test_setup_teardown(test_hbac_entries_updated_user,
+                                 hbac_cache_test_setup,
+                                 hbac_cache_test_teardown),
+        unit_test_setup_teardown(test_hbac_entries_updated_group,
+                                 hbac_cache_test_setup,
+                                 hbac_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
@@ -0,0 +1,296 @@
+/*
+    SSSD
+
+    Copyright (C) 2013 Red Hat
+
+    SSSD tests: LDAP cache cleanup tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+/* In order to access opaque types */
+#include "providers/ldap/ldap_id_cleanup.c"
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+#define TESTS_PATH "tests_ldap_id_cleanup"
+#define TEST_CONF_DB "test_ldap_id_cleanup_conf.ldb"
+#define TEST_SYSDB_FILE "cache_ldap_id_cleanup_test.ldb"
+#define TEST_DOM_NAME "ldap_id_cleanup_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define EXPIRED_USER "expired_user"
+#define EXPIRED_UID 15001
+#define KEPT_USER "kept_user"
+#define KEPT_UID 15002
+
+struct cleanup_test_ctx {
+    struct sss_test_ctx *tctx;
+
+    struct be_ctx *be_ctx;
+    struct sdap_id_ctx *id_ctx;
+    struct be_sched_hold *hold;
+};
+
+static struct cleanup_test_ctx *cleanup_test_ctx;
+
+/* The back end is never offline in these tests */
+bool be_is_offline(struct be_ctx *ctx)
+{
+    return false;
+}
+
+static void add_expired_user(const char *name, uid_t uid)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    ret = sysdb_store_user(cleanup_test_ctx->tctx->sysdb,
+                           cleanup_test_ctx->tctx->dom,
+                           name, NULL, uid, uid, name, "/", "/bin/sh",
+                           NULL, NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    attrs = sysdb_new_attrs(cleanup_test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE, 1);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_set_user_attr(cleanup_test_ctx->tctx->sysdb,
+                              cleanup_test_ctx->tctx->dom,
+                              name, attrs, SYSDB_MOD_REP);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static void set_user_time_attr(const char *name, const char *attr,
+                               time_t value)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(cleanup_test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_time_t(attrs, attr, value);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_set_user_attr(cleanup_test_ctx->tctx->sysdb,
+                              cleanup_test_ctx->tctx->dom,
+                              name, attrs, SYSDB_MOD_REP);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static void assert_user_cached(const char *name, unsigned expected)
+{
+    struct ldb_result *res;
+    errno_t ret;
+
+    ret = sysdb_getpwnam(cleanup_test_ctx, cleanup_test_ctx->tctx->sysdb,
+                         cleanup_test_ctx->tctx->dom, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, expected);
+    talloc_free(res);
+}
+
+static void cleanup_test_done(struct tevent_req *req)
+{
+    struct cleanup_test_ctx *test_ctx =
+            tevent_req_callback_data(req, struct cleanup_test_ctx);
+
+    talloc_free(req);
+    test_ctx->tctx->done = true;
+}
+
+/* Starts the cleanup while a more important request keeps it from running
+ * its first chunk, so that the test can change the cache after the
+ * expired entries were looked up. */
+static void start_held_cleanup(void)
+{
+    struct tevent_req *req;
+
+    cleanup_test_ctx->hold = be_sched_hold(cleanup_test_ctx,
+                                           cleanup_test_ctx->be_ctx,
+                                           BE_SCHED_INTERACTIVE);
+    assert_non_null(cleanup_test_ctx->hold);
+
+    req = ldap_id_cleanup_send(cleanup_test_ctx,
+                               cleanup_test_ctx->tctx->ev,
+                               cleanup_test_ctx->id_ctx,
+                               BE_SCHED_CLEANUP);
+    assert_non_null(req);
+    tevent_req_set_callback(req, cleanup_test_done, cleanup_test_ctx);
+
+    /* Both users were found, none was deleted yet */
+    assert_user_cached(EXPIRED_USER, 1);
+    assert_user_cached(KEPT_USER, 1);
+}
+
+static void finish_held_cleanup(void)
+{
+    errno_t ret;
+
+    talloc_zfree(cleanup_test_ctx->hold);
+
+    ret = test_ev_loop(cleanup_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+void test_cleanup_expired(void **state)
+{
+    add_expired_user(EXPIRED_USER, EXPIRED_UID);
+    add_expired_user(KEPT_USER, KEPT_UID);
+
+    start_held_cleanup();
+    finish_held_cleanup();
+
+    assert_user_cached(EXPIRED_USER, 0);
+    assert_user_cached(KEPT_USER, 0);
+}
+
+void test_cleanup_refreshed(void **state)
+{
+    add_expired_user(EXPIRED_USER, EXPIRED_UID);
+    add_expired_user(KEPT_USER, KEPT_UID);
+
+    start_held_cleanup();
+    set_user_time_attr(KEPT_USER, SYSDB_CACHE_EXPIRE, time(NULL) + 3600);
+    finish_held_cleanup();
+
+    assert_user_cached(EXPIRED_USER, 0);
+    assert_user_cached(KEPT_USER, 1);
+}
+
+void test_cleanup_logged_in(void **state)
+{
+    add_expired_user(EXPIRED_USER, EXPIRED_UID);
+    add_expired_user(KEPT_USER, KEPT_UID);
+
+    start_held_cleanup();
+    set_user_time_attr(KEPT_USER, SYSDB_LAST_LOGIN, time(NULL));
+    finish_held_cleanup();
+
+    assert_user_cached(EXPIRED_USER, 0);
+    assert_user_cached(KEPT_USER, 1);
+}
+
+/* Testsuite setup and teardown */
+void cleanup_test_setup(void **state)
+{
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+    cleanup_test_ctx = talloc_zero(global_talloc_context,
+                                   struct cleanup_test_ctx);
+    assert_non_null(cleanup_test_ctx);
+
+    cleanup_test_ctx->tctx = create_dom_test_ctx(cleanup_test_ctx, TESTS_PATH,
+                                                 TEST_CONF_DB, TEST_SYSDB_FILE,
+                                                 TEST_DOM_NAME,
+                                                 TEST_ID_PROVIDER, NULL);
+    assert_non_null(cleanup_test_ctx->tctx);
+
+    cleanup_test_ctx->be_ctx = talloc_zero(cleanup_test_ctx, struct be_ctx);
+    assert_non_null(cleanup_test_ctx->be_ctx);
+    cleanup_test_ctx->be_ctx->ev = cleanup_test_ctx->tctx->ev;
+    cleanup_test_ctx->be_ctx->domain = cleanup_test_ctx->tctx->dom;
+
+    ret = be_sched_init(cleanup_test_ctx->be_ctx);
+    assert_int_equal(ret, EOK);
+
+    cleanup_test_ctx->id_ctx = talloc_zero(cleanup_test_ctx,
+                                           struct sdap_id_ctx);
+    assert_non_null(cleanup_test_ctx->id_ctx);
+    cleanup_test_ctx->id_ctx->be = cleanup_test_ctx->be_ctx;
+
+    cleanup_test_ctx->id_ctx->opts = talloc_zero(cleanup_test_ctx->id_ctx,
+                                                 struct sdap_options);
+    assert_non_null(cleanup_test_ctx->id_ctx->opts);
+
+    ret = dp_copy_options(cleanup_test_ctx->id_ctx->opts, default_basic_opts,
+                          SDAP_OPTS_BASIC,
+                          &cleanup_test_ctx->id_ctx->opts->basic);
+    assert_int_equal(ret, EOK);
+}
+
+void cleanup_test_teardown(void **state)
+{
+    /* The users may or may not have been removed by the test */
+    sysdb_delete_user(cleanup_test_ctx->tctx->sysdb,
+                      cleanup_test_ctx->tctx->dom, EXPIRED_USER, 0);
+    sysdb_delete_user(cleanup_test_ctx->tctx->sysdb,
+                      cleanup_test_ctx->tctx->dom, KEPT_USER, 0);
+
+    talloc_free(cleanup_test_ctx);
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_cleanup_expired,
+                                 cleanup_test_setup, cleanup_test_teardown),
+        unit_test_setup_teardown(test_cleanup_refreshed,
+                                 cleanup_test_setup, cleanup_test_teardown),
+        unit_test_setup_teardown(test_cleanup_logged_in,
+                                 cleanup_test_setup, cleanup_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
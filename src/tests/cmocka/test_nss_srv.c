@@ -25,6 +25,9 @@
 #include <errno.h>
 #include <popt.h>
 
+/* In order to access opaque types */
+#include "responder/nss/nsssrv_refresh.c"
+
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
 #include "responder/common/negcache.h"
@@ -46,6 +49,7 @@ struct nss_test_ctx {
     struct nss_ctx *nctx;
 
     bool ncache_hit;
+    int refreshed;
 };
 
 struct nss_test_ctx *nss_test_ctx;
@@ -69,6 +73,12 @@ mock_nctx(TALLOC_CTX *mem_ctx)
     }
     nctx->neg_timeout = 10;
 
+    ret = sss_hash_create(nctx, 10, &nctx->netgr_members);
+    if (ret != EOK) {
+        talloc_free(nctx);
+        return NULL;
+    }
+
     return nctx;
 }
 
@@ -88,7 +98,7 @@ void __wrap_sss_packet_get_body(struct sss_packet *packet,
     }
 
     *body = sss_mock_ptr_type(uint8_t *);
-    *blen = strlen((const char *) *body)+1;
+    *blen = sss_mock_type(size_t);
     return;
 }
 
@@ -148,6 +158,26 @@ static void mock_input_user(const char *username)
 {
     will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
     will_return(__wrap_sss_packet_get_body, username);
+    will_return(__wrap_sss_packet_get_body, strlen(username) + 1);
+}
+
+/* The netgroup name, host, user and domain, each zero terminated */
+static void mock_input_innetgr(const char *netgroup, const char *host,
+                               const char *user, const char *domain)
+{
+    uint8_t *body;
+    size_t blen;
+
+    body = (uint8_t *) talloc_asprintf(nss_test_ctx, "%s%c%s%c%s%c%s",
+                                       netgroup, '\0', host, '\0',
+                                       user, '\0', domain);
+    assert_non_null(body);
+    blen = strlen(netgroup) + strlen(host) + strlen(user)
+           + strlen(domain) + 4;
+
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, body);
+    will_return(__wrap_sss_packet_get_body, blen);
 }
 
 static void mock_fill_user(void)
@@ -411,6 +441,329 @@ void test_nss_getpwnam_update(void **state)
     assert_string_equal(shell, "/bin/ksh");
 }
 
+static void add_netgroup(const char *name, const char *triple,
+                         const char *member, int cache_timeout)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(nss_test_ctx);
+    assert_non_null(attrs);
+
+    if (triple) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_NETGROUP_TRIPLE, triple);
+        assert_int_equal(ret, EOK);
+    }
+
+    if (member) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_NETGROUP_MEMBER, member);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = sysdb_add_netgroup(nss_test_ctx->tctx->sysdb,
+                             nss_test_ctx->tctx->dom,
+                             name, NULL, attrs, NULL, cache_timeout, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static int test_nss_innetgr_check(uint8_t *body, size_t blen, uint32_t exp)
+{
+    uint32_t num;
+    uint32_t member;
+    size_t rp = 0;
+
+    assert_int_equal(blen, 3 * sizeof(uint32_t));
+
+    SAFEALIGN_COPY_UINT32(&num, body+rp, &rp);
+    assert_int_equal(num, 1);
+    rp += sizeof(uint32_t); /* reserved */
+    SAFEALIGN_COPY_UINT32(&member, body+rp, &rp);
+    assert_int_equal(member, exp);
+
+    return EOK;
+}
+
+static int test_nss_innetgr_member_check(uint8_t *body, size_t blen)
+{
+    return test_nss_innetgr_check(body, blen, 1);
+}
+
+static int test_nss_innetgr_nonmember_check(uint8_t *body, size_t blen)
+{
+    return test_nss_innetgr_check(body, blen, 0);
+}
+
+static void run_innetgr(const char *netgroup, const char *host,
+                        const char *user, const char *domain,
+                        cmd_cb_fn_t check_cb)
+{
+    errno_t ret;
+
+    mock_input_innetgr(netgroup, host, user, domain);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_INNETGR);
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+    set_cmd_cb(check_cb);
+
+    nss_test_ctx->tctx->done = false;
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_INNETGR,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+/* Check the triples of a nested netgroup are matched from the expansion
+ * of its parent, without going to the Data Provider
+ */
+void test_nss_innetgr(void **state)
+{
+    add_netgroup("ng_inner", "(host1,user1,)", NULL, 300);
+    add_netgroup("ng_outer", "(host2,-,example.com)", "ng_inner", 300);
+
+    /* the host is compared regardless of case */
+    run_innetgr("ng_outer", "HOST1", "", "", test_nss_innetgr_member_check);
+
+    /* an empty domain of the triple matches any domain */
+    run_innetgr("ng_outer", "host1", "user1", "any.com",
+                test_nss_innetgr_member_check);
+
+    /* the user is compared with the case */
+    run_innetgr("ng_outer", "host1", "USER1", "",
+                test_nss_innetgr_nonmember_check);
+
+    /* "-" matches no user */
+    run_innetgr("ng_outer", "host2", "user1", "",
+                test_nss_innetgr_nonmember_check);
+
+    run_innetgr("ng_outer", "host2", "", "example.com",
+                test_nss_innetgr_member_check);
+
+    run_innetgr("ng_outer", "nohost", "", "",
+                test_nss_innetgr_nonmember_check);
+}
+
+/* Check that a nested netgroup missing in the cache is requested from
+ * the Data Provider during the expansion
+ */
+static int test_nss_innetgr_nested_acct_cb(void *pvt)
+{
+    add_netgroup("ng_remote", "(remotehost,,)", "ng_loop", 300);
+    return EOK;
+}
+
+void test_nss_innetgr_nested(void **state)
+{
+    /* the loop back to the parent is expanded only once */
+    add_netgroup("ng_loop", "(loophost,,)", "ng_remote", 300);
+
+    mock_account_recv(0, 0, NULL, test_nss_innetgr_nested_acct_cb,
+                      nss_test_ctx);
+    run_innetgr("ng_loop", "remotehost", "", "",
+                test_nss_innetgr_member_check);
+}
+
+/* Test that a nonexistent netgroup yields ENOENT */
+void test_nss_innetgr_neg(void **state)
+{
+    errno_t ret;
+
+    mock_input_innetgr("ng_missing", "host1", "", "");
+    mock_account_recv_simple();
+
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_INNETGR,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with ENOENT */
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, ENOENT);
+}
+
+/* Turns on the refresh ahead of expiration. The scans are started by the
+ * tests directly instead of waiting for the timer. */
+static void setup_refresh(const char *ahead, const char *hits)
+{
+    const char *val[2] = { NULL, NULL };
+    errno_t ret;
+
+    val[0] = ahead;
+    ret = confdb_add_param(nss_test_ctx->tctx->confdb, true,
+                           CONFDB_NSS_CONF_ENTRY,
+                           CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD, val);
+    assert_int_equal(ret, EOK);
+
+    val[0] = hits;
+    ret = confdb_add_param(nss_test_ctx->tctx->confdb, true,
+                           CONFDB_NSS_CONF_ENTRY,
+                           CONFDB_NSS_ENTRY_CACHE_REFRESH_AHEAD_HITS, val);
+    assert_int_equal(ret, EOK);
+
+    nss_test_ctx->nctx->rctx = nss_test_ctx->rctx;
+    ret = nss_refresh_init(nss_test_ctx->nctx, nss_test_ctx->tctx->confdb);
+    assert_int_equal(ret, EOK);
+    assert_non_null(nss_test_ctx->nctx->refresh);
+}
+
+static int test_nss_refresh_check(uint8_t *body, size_t blen)
+{
+    struct passwd pwd;
+    errno_t ret;
+
+    ret = parse_user_packet(body, blen, &pwd);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(pwd.pw_uid, 321);
+    assert_string_equal(pwd.pw_name, "testuser_refresh");
+    return EOK;
+}
+
+/* Stores testuser_refresh expiring in cache_timeout seconds and requests
+ * it from the cache num_hits times */
+static void request_cached_user(int cache_timeout, int num_hits)
+{
+    errno_t ret;
+    int i;
+
+    ret = sysdb_store_user(nss_test_ctx->tctx->sysdb,
+                           nss_test_ctx->tctx->dom,
+                           "testuser_refresh", NULL, 321, 654, "test user",
+                           "/home/testuser", "/bin/sh", NULL,
+                           NULL, NULL, cache_timeout, 0);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; i < num_hits; i++) {
+        mock_input_user("testuser_refresh");
+        will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWNAM);
+        mock_fill_user();
+        set_cmd_cb(test_nss_refresh_check);
+
+        nss_test_ctx->tctx->done = false;
+        ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETPWNAM,
+                              nss_test_ctx->nss_cmds);
+        assert_int_equal(ret, EOK);
+
+        ret = test_ev_loop(nss_test_ctx->tctx);
+        assert_int_equal(ret, EOK);
+    }
+}
+
+static struct nss_refresh_entry *find_refresh_entry(const char *name)
+{
+    struct nss_refresh_ctx *ctx = nss_test_ctx->nctx->refresh;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = talloc_asprintf(nss_test_ctx, "%d:%s:%s", SSS_DP_USER,
+                              nss_test_ctx->tctx->dom->name, name);
+    assert_non_null(key.str);
+
+    hret = hash_lookup(ctx->table, &key, &value);
+    talloc_free(key.str);
+    if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        return NULL;
+    }
+    assert_int_equal(hret, HASH_SUCCESS);
+
+    return talloc_get_type(value.ptr, struct nss_refresh_entry);
+}
+
+static void run_refresh_scan(void)
+{
+    nss_refresh_scan(nss_test_ctx->tctx->ev, NULL, tevent_timeval_current(),
+                     nss_test_ctx->nctx->refresh);
+}
+
+static int test_nss_refresh_acct_cb(void *pvt)
+{
+    struct nss_test_ctx *ctx = talloc_get_type(pvt, struct nss_test_ctx);
+
+    ctx->refreshed++;
+    ctx->tctx->done = true;
+    return EOK;
+}
+
+/* Check that an entry requested often enough is refreshed when it is
+ * about to expire */
+void test_nss_refresh_ahead(void **state)
+{
+    struct nss_refresh_entry *entry;
+    errno_t ret;
+
+    setup_refresh("60", "2");
+    request_cached_user(30, 2);
+
+    entry = find_refresh_entry("testuser_refresh");
+    assert_non_null(entry);
+    assert_int_equal(entry->hits, 2);
+
+    mock_account_recv(0, 0, NULL, test_nss_refresh_acct_cb, nss_test_ctx);
+    run_refresh_scan();
+    assert_true(entry->pending);
+
+    nss_test_ctx->tctx->done = false;
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(nss_test_ctx->refreshed, 1);
+
+    /* Not refreshed again until a request tells the new expiration */
+    entry = find_refresh_entry("testuser_refresh");
+    assert_non_null(entry);
+    assert_false(entry->pending);
+    assert_int_equal(entry->expire, 0);
+    run_refresh_scan();
+}
+
+/* Check that the entries are left alone when they are requested less
+ * than entry_cache_refresh_ahead_hits times or expire later */
+void test_nss_refresh_ahead_ignored(void **state)
+{
+    struct nss_refresh_entry *entry;
+
+    setup_refresh("60", "3");
+    request_cached_user(30, 2);
+
+    /* The Data Provider is not mocked, a refresh would fail the test */
+    run_refresh_scan();
+
+    entry = find_refresh_entry("testuser_refresh");
+    assert_non_null(entry);
+    assert_false(entry->pending);
+    assert_int_equal(entry->hits, 1);
+
+    /* Requested often enough, but expires after the window */
+    request_cached_user(300, 2);
+    run_refresh_scan();
+
+    entry = find_refresh_entry("testuser_refresh");
+    assert_non_null(entry);
+    assert_false(entry->pending);
+    assert_int_equal(nss_test_ctx->refreshed, 0);
+}
+
+/* Check that the entries which are not requested anymore decay and are
+ * dropped from the table */
+void test_nss_refresh_ahead_decay(void **state)
+{
+    struct nss_refresh_entry *entry;
+
+    setup_refresh("60", "2");
+    request_cached_user(300, 2);
+
+    run_refresh_scan();
+    entry = find_refresh_entry("testuser_refresh");
+    assert_non_null(entry);
+    assert_int_equal(entry->hits, 1);
+
+    run_refresh_scan();
+    assert_null(find_refresh_entry("testuser_refresh"));
+    assert_int_equal(nss_test_ctx->nctx->refresh->num_entries, 0);
+    assert_int_equal(nss_test_ctx->refreshed, 0);
+}
+
 /* Testsuite setup and teardown */
 void nss_test_setup(void **state)
 {
@@ -479,6 +832,18 @@ int main(int argc, const char *argv[])
                                  nss_test_setup, nss_test_teardown),
         unit_test_setup_teardown(test_nss_getpwnam_update,
                                  nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_innetgr,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_innetgr_nested,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_innetgr_neg,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_refresh_ahead,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_refresh_ahead_ignored,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_refresh_ahead_decay,
+                                 nss_test_setup, nss_test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
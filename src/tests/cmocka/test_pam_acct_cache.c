@@ -0,0 +1,234 @@
+/*
+    SSSD
+
+    PAM responder - account management cache tests
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <security/pam_appl.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/pam/pam_helpers.h"
+
+#define ALICE_KEY "alice@test\nsshd\nclient.example.com"
+#define BOB_KEY "bob@test\nsshd\nclient.example.com"
+
+struct acct_cache_test_ctx {
+    struct sss_test_ctx *tctx;
+    hash_table_t *acct_table;
+};
+
+static struct acct_cache_test_ctx *acct_test_ctx;
+
+static void assert_cached(const char *key, int expected)
+{
+    int pam_status;
+    errno_t ret;
+
+    ret = pam_acct_cache_get(acct_test_ctx->acct_table, key, &pam_status);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(pam_status, expected);
+}
+
+static void assert_not_cached(const char *key)
+{
+    int pam_status;
+    errno_t ret;
+
+    ret = pam_acct_cache_get(acct_test_ctx->acct_table, key, &pam_status);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void acct_cache_test_wakeup(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval tv,
+                                   void *pvt)
+{
+    struct sss_test_ctx *tctx = talloc_get_type(pvt, struct sss_test_ctx);
+
+    tctx->done = true;
+}
+
+/* Runs the event loop so that the expiration timers can fire */
+static void wait_seconds(long sec, long usec)
+{
+    struct tevent_timer *te;
+    errno_t ret;
+
+    acct_test_ctx->tctx->done = false;
+    te = tevent_add_timer(acct_test_ctx->tctx->ev, acct_test_ctx->tctx,
+                          tevent_timeval_current_ofs(sec, usec),
+                          acct_cache_test_wakeup, acct_test_ctx->tctx);
+    assert_non_null(te);
+
+    ret = test_ev_loop(acct_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+void test_acct_cache_set_get(void **state)
+{
+    errno_t ret;
+
+    assert_not_cached(ALICE_KEY);
+
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             ALICE_KEY, PAM_SUCCESS, 10);
+    assert_int_equal(ret, EOK);
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             BOB_KEY, PAM_PERM_DENIED, 10);
+    assert_int_equal(ret, EOK);
+
+    assert_cached(ALICE_KEY, PAM_SUCCESS);
+    assert_cached(BOB_KEY, PAM_PERM_DENIED);
+    assert_not_cached("alice@test\nsshd\n");
+}
+
+void test_acct_cache_expire(void **state)
+{
+    errno_t ret;
+
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             ALICE_KEY, PAM_SUCCESS, 1);
+    assert_int_equal(ret, EOK);
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             BOB_KEY, PAM_SUCCESS, 10);
+    assert_int_equal(ret, EOK);
+
+    wait_seconds(1, 500000);
+
+    assert_not_cached(ALICE_KEY);
+    assert_cached(BOB_KEY, PAM_SUCCESS);
+}
+
+void test_acct_cache_replace(void **state)
+{
+    errno_t ret;
+
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             ALICE_KEY, PAM_SUCCESS, 1);
+    assert_int_equal(ret, EOK);
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             ALICE_KEY, PAM_PERM_DENIED, 10);
+    assert_int_equal(ret, EOK);
+
+    assert_cached(ALICE_KEY, PAM_PERM_DENIED);
+
+    /* The timer of the replaced decision must not remove the new one */
+    wait_seconds(1, 500000);
+    assert_cached(ALICE_KEY, PAM_PERM_DENIED);
+}
+
+void test_acct_cache_flush(void **state)
+{
+    errno_t ret;
+
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             ALICE_KEY, PAM_SUCCESS, 1);
+    assert_int_equal(ret, EOK);
+    ret = pam_acct_cache_set(acct_test_ctx->tctx->ev,
+                             acct_test_ctx->acct_table,
+                             BOB_KEY, PAM_PERM_DENIED, 10);
+    assert_int_equal(ret, EOK);
+
+    pam_acct_cache_flush(acct_test_ctx->acct_table);
+
+    assert_not_cached(ALICE_KEY);
+    assert_not_cached(BOB_KEY);
+
+    /* The timers went away with the entries */
+    wait_seconds(1, 500000);
+    assert_not_cached(ALICE_KEY);
+}
+
+/* Testsuite setup and teardown */
+void acct_cache_test_setup(void **state)
+{
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+    acct_test_ctx = talloc_zero(global_talloc_context,
+                                struct acct_cache_test_ctx);
+    assert_non_null(acct_test_ctx);
+
+    acct_test_ctx->tctx = create_ev_test_ctx(acct_test_ctx);
+    assert_non_null(acct_test_ctx->tctx);
+
+    ret = sss_hash_create(acct_test_ctx, 10, &acct_test_ctx->acct_table);
+    assert_int_equal(ret, EOK);
+}
+
+void acct_cache_test_teardown(void **state)
+{
+    talloc_free(acct_test_ctx);
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_acct_cache_set_get,
+                                 acct_cache_test_setup,
+                                 acct_cache_test_teardown),
+        unit_test_setup_teardown(test_acct_cache_expire,
+                                 acct_cache_test_setup,
+                                 acct_cache_test_teardown),
+        unit_test_setup_teardown(test_acct_cache_replace,
+                                 acct_cache_test_setup,
+                                 acct_cache_test_teardown),
+        unit_test_setup_teardown(test_acct_cache_flush,
+                                 acct_cache_test_setup,
+                                 acct_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    return run_tests(tests);
+}
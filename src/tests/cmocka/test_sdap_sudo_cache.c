@@ -0,0 +1,324 @@
+/*
+    SSSD
+
+    Copyright (C) 2013 Red Hat
+
+    SSSD tests: Incremental synchronization of cached sudo rules
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "db/sysdb_sudo.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/ldap_opts.h"
+#include "providers/ldap/sdap_sudo_cache.h"
+
+#define TESTS_PATH "tests_sdap_sudo_cache"
+#define TEST_CONF_DB "test_sdap_sudo_cache_conf.ldb"
+#define TEST_SYSDB_FILE "cache_sdap_sudo_cache_test.ldb"
+#define TEST_DOM_NAME "sdap_sudo_cache_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_SUDO_TIMEOUT 100
+#define TEST_FULL_FILTER "("SYSDB_OBJECTCLASS"="SYSDB_SUDO_CACHE_OC")"
+
+#define RULE_KEPT "kept_rule"
+#define RULE_MODIFIED "modified_rule"
+#define RULE_DELETED "deleted_rule"
+
+struct sudo_cache_test_ctx {
+    struct sss_test_ctx *tctx;
+};
+
+static struct sudo_cache_test_ctx *sudo_test_ctx;
+
+/* A rule as it is returned by the LDAP search. The USN is added first on
+ * purpose, it must not have any influence on the content hash. */
+static struct sysdb_attrs *make_rule(const char *name, const char *command,
+                                     const char *usn)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+
+    rule = sysdb_new_attrs(sudo_test_ctx);
+    assert_non_null(rule);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_USN, usn);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_CN, name);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_USER, "ALL");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_COMMAND, command);
+    assert_int_equal(ret, EOK);
+
+    return rule;
+}
+
+static void sync_rules(const char *filter, struct sysdb_attrs **rules,
+                       size_t rules_count, time_t now,
+                       struct sdap_sudo_sync_stats *stats)
+{
+    char *usn = NULL;
+    errno_t ret;
+
+    ret = sdap_sudo_sync_rules(sudo_test_ctx, sudo_test_ctx->tctx->sysdb,
+                               sudo_test_ctx->tctx->dom, native_sudorule_map,
+                               filter, rules, rules_count,
+                               TEST_SUDO_TIMEOUT, now, &usn, stats);
+    assert_int_equal(ret, EOK);
+    talloc_free(usn);
+}
+
+/* Returns the cached rule or NULL if there is none */
+static struct ldb_message *get_cached_rule(const char *name)
+{
+    const char *attrs[] = { SYSDB_SUDO_CACHE_AT_CN,
+                            SYSDB_SUDO_CACHE_AT_COMMAND,
+                            SYSDB_CACHE_EXPIRE,
+                            NULL };
+    struct ldb_message **msgs;
+    size_t count;
+    errno_t ret;
+
+    ret = sysdb_search_custom_by_name(sudo_test_ctx,
+                                      sudo_test_ctx->tctx->sysdb,
+                                      sudo_test_ctx->tctx->dom,
+                                      name, SUDORULE_SUBDIR, attrs,
+                                      &count, &msgs);
+    if (ret == ENOENT) {
+        return NULL;
+    }
+    assert_int_equal(ret, EOK);
+    assert_int_equal(count, 1);
+
+    return msgs[0];
+}
+
+static void assert_rule(const char *name, const char *command,
+                        time_t expire)
+{
+    struct ldb_message *msg;
+
+    msg = get_cached_rule(name);
+    assert_non_null(msg);
+    assert_string_equal(ldb_msg_find_attr_as_string(msg,
+                                            SYSDB_SUDO_CACHE_AT_COMMAND, ""),
+                        command);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(msg, SYSDB_CACHE_EXPIRE, 0),
+                     expire);
+    talloc_free(msg);
+}
+
+static void store_initial_rules(time_t now)
+{
+    struct sdap_sudo_sync_stats stats;
+    struct sysdb_attrs *rules[3];
+
+    rules[0] = make_rule(RULE_KEPT, "/bin/true", "1");
+    rules[1] = make_rule(RULE_MODIFIED, "/bin/false", "2");
+    rules[2] = make_rule(RULE_DELETED, "/bin/ls", "3");
+
+    sync_rules(TEST_FULL_FILTER, rules, 3, now, &stats);
+
+    assert_int_equal(stats.added, 3);
+    assert_int_equal(stats.modified, 0);
+    assert_int_equal(stats.unchanged, 0);
+    assert_int_equal(stats.deleted, 0);
+
+    talloc_free(rules[0]);
+    talloc_free(rules[1]);
+    talloc_free(rules[2]);
+}
+
+void test_sudo_sync_full(void **state)
+{
+    struct sdap_sudo_sync_stats stats;
+    struct sysdb_attrs *rules[3];
+
+    store_initial_rules(1000);
+
+    /* The kept rule only has a new USN */
+    rules[0] = make_rule(RULE_MODIFIED, "/bin/echo", "5");
+    rules[1] = make_rule(RULE_KEPT, "/bin/true", "4");
+    rules[2] = make_rule("new_rule", "/bin/cat", "6");
+
+    sync_rules(TEST_FULL_FILTER, rules, 3, 2000, &stats);
+
+    assert_int_equal(stats.added, 1);
+    assert_int_equal(stats.modified, 1);
+    assert_int_equal(stats.unchanged, 1);
+    assert_int_equal(stats.deleted, 1);
+
+    assert_rule(RULE_KEPT, "/bin/true", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule(RULE_MODIFIED, "/bin/echo", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule("new_rule", "/bin/cat", 2000 + TEST_SUDO_TIMEOUT);
+    assert_null(get_cached_rule(RULE_DELETED));
+
+    talloc_free(rules[0]);
+    talloc_free(rules[1]);
+    talloc_free(rules[2]);
+}
+
+void test_sudo_sync_renamed_case(void **state)
+{
+    struct sdap_sudo_sync_stats stats;
+    struct sysdb_attrs *rules[3];
+    struct ldb_message *msg;
+
+    store_initial_rules(1000);
+
+    /* The server changed only the case of a rule name */
+    rules[0] = make_rule("KEPT_RULE", "/bin/true", "4");
+    rules[1] = make_rule(RULE_MODIFIED, "/bin/false", "2");
+    rules[2] = make_rule(RULE_DELETED, "/bin/ls", "3");
+
+    sync_rules(TEST_FULL_FILTER, rules, 3, 2000, &stats);
+
+    assert_int_equal(stats.added, 0);
+    assert_int_equal(stats.modified, 1);
+    assert_int_equal(stats.unchanged, 2);
+    assert_int_equal(stats.deleted, 0);
+
+    /* The renamed rule is cached once, with the new name */
+    msg = get_cached_rule("KEPT_RULE");
+    assert_non_null(msg);
+    assert_string_equal(ldb_msg_find_attr_as_string(msg,
+                                                SYSDB_SUDO_CACHE_AT_CN, ""),
+                        "KEPT_RULE");
+    talloc_free(msg);
+
+    assert_rule("KEPT_RULE", "/bin/true", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule(RULE_MODIFIED, "/bin/false", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule(RULE_DELETED, "/bin/ls", 2000 + TEST_SUDO_TIMEOUT);
+
+    talloc_free(rules[0]);
+    talloc_free(rules[1]);
+    talloc_free(rules[2]);
+}
+
+void test_sudo_sync_no_filter(void **state)
+{
+    struct sdap_sudo_sync_stats stats;
+    struct sysdb_attrs *rules[2];
+
+    store_initial_rules(1000);
+
+    rules[0] = make_rule(RULE_KEPT, "/bin/true", "4");
+    rules[1] = make_rule(RULE_MODIFIED, "/bin/echo", "5");
+
+    /* Without a filter only the downloaded rules are looked at */
+    sync_rules(NULL, rules, 2, 2000, &stats);
+
+    assert_int_equal(stats.added, 0);
+    assert_int_equal(stats.modified, 1);
+    assert_int_equal(stats.unchanged, 1);
+    assert_int_equal(stats.deleted, 0);
+
+    assert_rule(RULE_KEPT, "/bin/true", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule(RULE_MODIFIED, "/bin/echo", 2000 + TEST_SUDO_TIMEOUT);
+    assert_rule(RULE_DELETED, "/bin/ls", 1000 + TEST_SUDO_TIMEOUT);
+
+    talloc_free(rules[0]);
+    talloc_free(rules[1]);
+}
+
+/* Testsuite setup and teardown */
+void sudo_cache_test_setup(void **state)
+{
+    assert_true(leak_check_setup());
+    sudo_test_ctx = talloc_zero(global_talloc_context,
+                                struct sudo_cache_test_ctx);
+    assert_non_null(sudo_test_ctx);
+
+    sudo_test_ctx->tctx = create_dom_test_ctx(sudo_test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, TEST_SYSDB_FILE,
+                                              TEST_DOM_NAME,
+                                              TEST_ID_PROVIDER, NULL);
+    assert_non_null(sudo_test_ctx->tctx);
+}
+
+void sudo_cache_test_teardown(void **state)
+{
+    errno_t ret;
+
+    ret = sysdb_sudo_purge_byfilter(sudo_test_ctx->tctx->sysdb,
+                                    sudo_test_ctx->tctx->dom, NULL);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(sudo_test_ctx);
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_sudo_sync_full,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+        unit_test_setup_teardown(test_sudo_sync_renamed_case,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+        unit_test_setup_teardown(test_sudo_sync_no_filter,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
@@ -0,0 +1,132 @@
+/*
+    SSSD
+
+    Copyright (C) 2013 Red Hat
+
+    SSSD tests: LDAP operation statistics tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async_private.h"
+
+static void check_shape(const char *filter, const char *expected)
+{
+    TALLOC_CTX *tmp_ctx;
+    char *shape;
+
+    tmp_ctx = talloc_new(global_talloc_context);
+    assert_non_null(tmp_ctx);
+
+    shape = sdap_filter_shape(tmp_ctx, filter);
+    assert_non_null(shape);
+    assert_string_equal(shape, expected);
+
+    talloc_free(tmp_ctx);
+}
+
+void test_filter_shape_values(void **state)
+{
+    /* searches for different users have the same shape */
+    check_shape("(&(uid=alice)(objectclass=posixAccount))",
+                "(&(uid=?)(objectclass=posixAccount))");
+    check_shape("(&(uid=bob)(objectclass=posixAccount))",
+                "(&(uid=?)(objectclass=posixAccount))");
+
+    /* the object class tells the searches apart, in any case */
+    check_shape("(&(cn=admins)(objectClass=group))",
+                "(&(cn=?)(objectClass=group))");
+
+    /* presence filters are kept, substrings are not */
+    check_shape("(&(uid=*)(cn=adm*))", "(&(uid=*)(cn=?))");
+
+    /* values may contain '=' and escaped parentheses */
+    check_shape("(|(member=cn=alice,dc=example,dc=com)(cn=a\\28b\\29))",
+                "(|(member=?)(cn=?))");
+
+    /* comparisons keep their operator */
+    check_shape("(&(objectclass=posixAccount)(modifyTimestamp>=20130101))",
+                "(&(objectclass=posixAccount)(modifyTimestamp>=?))");
+}
+
+void test_filter_shape_corner_cases(void **state)
+{
+    check_shape(NULL, "");
+    check_shape("", "");
+
+    /* an empty value is the only one that grows */
+    check_shape("(uid=)", "(uid=?)");
+    check_shape("(&(a=)(b=)(c=))", "(&(a=?)(b=?)(c=?))");
+
+    /* a filter without parentheses */
+    check_shape("uid=alice", "uid=?");
+
+    /* a truncated filter does not read past its end */
+    check_shape("(&(uid=alice", "(&(uid=?");
+}
+
+void sdap_trace_test_setup(void **state)
+{
+    assert_true(leak_check_setup());
+}
+
+void sdap_trace_test_teardown(void **state)
+{
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_filter_shape_values,
+                                 sdap_trace_test_setup,
+                                 sdap_trace_test_teardown),
+        unit_test_setup_teardown(test_filter_shape_corner_cases,
+                                 sdap_trace_test_setup,
+                                 sdap_trace_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    return run_tests(tests);
+}
@@ -0,0 +1,420 @@
+/*
+    SSSD
+
+    Copyright (C) 2013 Red Hat
+
+    SSSD tests: In-memory index of the cached sudo rules
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+/* In order to access opaque types */
+#include "responder/sudo/sudosrv_index.c"
+
+#include "tests/cmocka/common_mock.h"
+
+#define TESTS_PATH "tests_sudosrv_index"
+#define TEST_CONF_DB "test_sudosrv_index_conf.ldb"
+#define TEST_SYSDB_FILE "cache_sudosrv_index_test.ldb"
+#define TEST_DOM_NAME "sudosrv_index_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_USER "alice"
+#define TEST_UID 1234
+
+#define NO_EXPIRE -1
+
+struct sudo_index_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sudo_ctx *sudo_ctx;
+};
+
+static struct sudo_index_test_ctx *index_test_ctx;
+
+static void store_rule(const char *name, const char *user,
+                       const char *order, time_t expire)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(index_test_ctx);
+    assert_non_null(attrs);
+
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_CN, name);
+    assert_int_equal(ret, EOK);
+    if (user != NULL) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_USER, user);
+        assert_int_equal(ret, EOK);
+    } else {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_OPTION,
+                                     "!authenticate");
+        assert_int_equal(ret, EOK);
+    }
+    if (order != NULL) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_ORDER, order);
+        assert_int_equal(ret, EOK);
+    }
+    if (expire != NO_EXPIRE) {
+        ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE, expire);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = sysdb_save_sudorule(index_test_ctx->tctx->sysdb,
+                              index_test_ctx->tctx->dom, name, attrs);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+/* The rules sorted by sudoOrder are:
+ * defaults, group_rule, netgroup_rule, user_rule, uid_rule, all_rule */
+static void store_rules(void)
+{
+    time_t now = time(NULL);
+
+    store_rule("user_rule", TEST_USER, "3", 1000);
+    store_rule("group_rule", "%admins", "1", now + 3600);
+    store_rule("netgroup_rule", "+hosts", "2", NO_EXPIRE);
+    store_rule("all_rule", "ALL", "5", 1000);
+    store_rule("uid_rule", "#1234", "4", now + 3600);
+    store_rule("defaults", NULL, NULL, 1000);
+}
+
+static void check_lookup(unsigned int flags, const char *username, uid_t uid,
+                         char **groupnames, const char **expected)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs **rules;
+    uint32_t count;
+    const char *name;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(index_test_ctx);
+    assert_non_null(tmp_ctx);
+
+    ret = sudosrv_rule_index_lookup(tmp_ctx, index_test_ctx->sudo_ctx,
+                                    index_test_ctx->tctx->dom, flags,
+                                    username, uid, groupnames,
+                                    &rules, &count);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; expected[i] != NULL; i++) {
+        assert_true(i < count);
+        ret = sysdb_attrs_get_string(rules[i], SYSDB_SUDO_CACHE_AT_CN, &name);
+        assert_int_equal(ret, EOK);
+        assert_string_equal(name, expected[i]);
+
+        /* expired rules are refreshed by their name, the rules sent to
+         * sudo do not carry it */
+        ret = sysdb_attrs_get_string(rules[i], SYSDB_NAME, &name);
+        if (flags & SYSDB_SUDO_FILTER_ONLY_EXPIRED) {
+            assert_int_equal(ret, EOK);
+            assert_string_equal(name, expected[i]);
+        } else {
+            assert_int_equal(ret, ENOENT);
+        }
+    }
+    assert_int_equal(count, i);
+    assert_null(rules[count]);
+
+    talloc_free(tmp_ctx);
+}
+
+void test_index_build(void **state)
+{
+    struct sudosrv_rule_index *index;
+    hash_key_t key;
+    hash_value_t value;
+    const char *order;
+    int hret;
+    errno_t ret;
+
+    store_rules();
+
+    ret = sudosrv_rule_index_get(index_test_ctx->sudo_ctx,
+                                 index_test_ctx->tctx->dom, &index);
+    assert_int_equal(ret, EOK);
+    assert_true(index->valid);
+    assert_int_equal(index->num_rules, 6);
+
+    ret = sysdb_attrs_get_string(index->rules[1], SYSDB_SUDO_CACHE_AT_ORDER,
+                                 &order);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(order, "1");
+    ret = sysdb_attrs_get_string(index->rules[5], SYSDB_SUDO_CACHE_AT_ORDER,
+                                 &order);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(order, "5");
+
+    assert_int_equal(index->all.count, 1);
+    assert_int_equal(index->all.pos[0], 5);
+    assert_int_equal(index->netgroups.count, 1);
+    assert_int_equal(index->netgroups.pos[0], 2);
+    assert_int_equal(index->defaults.count, 1);
+    assert_int_equal(index->defaults.pos[0], 0);
+
+    assert_int_equal(hash_count(index->by_user), 3);
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const("%admins");
+    hret = hash_lookup(index->by_user, &key, &value);
+    assert_int_equal(hret, HASH_SUCCESS);
+
+    assert_true(index->expire[0] == 1000);
+    assert_true(index->expire[2] == SUDOSRV_RULE_NO_EXPIRE);
+
+    /* the index is reused until it is invalidated */
+    store_rule("new_rule", "ALL", "6", NO_EXPIRE);
+    ret = sudosrv_rule_index_get(index_test_ctx->sudo_ctx,
+                                 index_test_ctx->tctx->dom, &index);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(index->num_rules, 6);
+
+    sudosrv_rule_index_invalidate(index_test_ctx->sudo_ctx, TEST_DOM_NAME);
+    ret = sudosrv_rule_index_get(index_test_ctx->sudo_ctx,
+                                 index_test_ctx->tctx->dom, &index);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(index->num_rules, 7);
+    assert_int_equal(index->all.count, 2);
+}
+
+void test_index_select_user(void **state)
+{
+    const char *by_name[] = { "user_rule", NULL };
+    const char *by_uid[] = { "uid_rule", NULL };
+    const char *with_all[] = { "user_rule", "uid_rule", "all_rule", NULL };
+    const char *none[] = { NULL };
+
+    store_rules();
+
+    check_lookup(SYSDB_SUDO_FILTER_USERNAME, TEST_USER, 0, NULL, by_name);
+    check_lookup(SYSDB_SUDO_FILTER_UID, NULL, TEST_UID, NULL, by_uid);
+    check_lookup(SYSDB_SUDO_FILTER_USERNAME | SYSDB_SUDO_FILTER_UID
+                 | SYSDB_SUDO_FILTER_INCLUDE_ALL,
+                 TEST_USER, TEST_UID, NULL, with_all);
+
+    /* the values of sudoUser are not matched against each other */
+    check_lookup(SYSDB_SUDO_FILTER_USERNAME, "bob", 0, NULL, none);
+    check_lookup(SYSDB_SUDO_FILTER_USERNAME, "ALL", 0, NULL, none);
+}
+
+void test_index_select_group(void **state)
+{
+    char *groups[] = { discard_const("users"), discard_const("admins"), NULL };
+    char *other_groups[] = { discard_const("users"), NULL };
+    const char *by_group[] = { "group_rule", NULL };
+    const char *none[] = { NULL };
+
+    store_rules();
+
+    check_lookup(SYSDB_SUDO_FILTER_GROUPS, TEST_USER, 0, groups, by_group);
+    check_lookup(SYSDB_SUDO_FILTER_GROUPS, TEST_USER, 0, other_groups, none);
+
+    /* a group is not mistaken for a user of the same name */
+    check_lookup(SYSDB_SUDO_FILTER_USERNAME, "admins", 0, NULL, none);
+}
+
+void test_index_select_netgroup(void **state)
+{
+    const char *by_netgroup[] = { "netgroup_rule", NULL };
+    const char *user_info[] = { "group_rule", "netgroup_rule", "user_rule",
+                                "uid_rule", NULL };
+    char *groups[] = { discard_const("admins"), NULL };
+
+    store_rules();
+
+    check_lookup(SYSDB_SUDO_FILTER_NGRS, NULL, 0, NULL, by_netgroup);
+    check_lookup(SYSDB_SUDO_FILTER_USERINFO, TEST_USER, TEST_UID, groups,
+                 user_info);
+}
+
+void test_index_select_defaults(void **state)
+{
+    const char *defaults[] = { "defaults", NULL };
+    const char *with_all[] = { "defaults", "all_rule", NULL };
+
+    store_rules();
+
+    check_lookup(SYSDB_SUDO_FILTER_INCLUDE_DFL, NULL, 0, NULL, defaults);
+    check_lookup(SYSDB_SUDO_FILTER_INCLUDE_DFL | SYSDB_SUDO_FILTER_INCLUDE_ALL,
+                 NULL, 0, NULL, with_all);
+}
+
+void test_index_select_expired(void **state)
+{
+    const char *expired[] = { "defaults", "user_rule", "all_rule", NULL };
+    const char *user_expired[] = { "user_rule", NULL };
+    char *groups[] = { discard_const("admins"), NULL };
+
+    store_rules();
+
+    /* Neither the rule that expires later nor the one stored without an
+     * expiration are refreshed */
+    check_lookup(SYSDB_SUDO_FILTER_ONLY_EXPIRED
+                 | SYSDB_SUDO_FILTER_INCLUDE_ALL
+                 | SYSDB_SUDO_FILTER_INCLUDE_DFL
+                 | SYSDB_SUDO_FILTER_USERINFO,
+                 TEST_USER, TEST_UID, groups, expired);
+    check_lookup(SYSDB_SUDO_FILTER_ONLY_EXPIRED | SYSDB_SUDO_FILTER_USERINFO,
+                 TEST_USER, TEST_UID, groups, user_expired);
+}
+
+void test_index_split(void **state)
+{
+    struct sysdb_attrs *rule;
+    struct sysdb_attrs public_rule;
+    const char *names[] = { SYSDB_SUDO_CACHE_AT_CN,
+                            SYSDB_NAME,
+                            SYSDB_SUDO_CACHE_AT_USER,
+                            SYSDB_CACHE_EXPIRE,
+                            SYSDB_SUDO_CACHE_AT_ORDER,
+                            NULL };
+    const char *value;
+    int i;
+    errno_t ret;
+
+    rule = sysdb_new_attrs(index_test_ctx);
+    assert_non_null(rule);
+    for (i = 0; names[i] != NULL; i++) {
+        ret = sysdb_attrs_add_string(rule, names[i], names[i]);
+        assert_int_equal(ret, EOK);
+    }
+
+    sudosrv_rule_index_split(rule, &public_rule);
+
+    /* the public view shares the elements of the rule */
+    assert_int_equal(public_rule.num, 3);
+    assert_true(public_rule.a == rule->a);
+    for (i = 0; i < public_rule.num; i++) {
+        assert_true(strcasecmp(public_rule.a[i].name, SYSDB_NAME) != 0);
+        assert_true(strcasecmp(public_rule.a[i].name,
+                               SYSDB_CACHE_EXPIRE) != 0);
+    }
+    ret = sysdb_attrs_get_string(&public_rule, SYSDB_SUDO_CACHE_AT_USER,
+                                 &value);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(value, SYSDB_SUDO_CACHE_AT_USER);
+
+    /* the elements were only reordered, the rule still has all of them */
+    assert_int_equal(rule->num, 5);
+    for (i = 0; names[i] != NULL; i++) {
+        ret = sysdb_attrs_get_string(rule, names[i], &value);
+        assert_int_equal(ret, EOK);
+        assert_string_equal(value, names[i]);
+    }
+
+    talloc_free(rule);
+}
+
+/* Testsuite setup and teardown */
+void sudo_index_test_setup(void **state)
+{
+    assert_true(leak_check_setup());
+    index_test_ctx = talloc_zero(global_talloc_context,
+                                 struct sudo_index_test_ctx);
+    assert_non_null(index_test_ctx);
+
+    index_test_ctx->tctx = create_dom_test_ctx(index_test_ctx, TESTS_PATH,
+                                               TEST_CONF_DB, TEST_SYSDB_FILE,
+                                               TEST_DOM_NAME,
+                                               TEST_ID_PROVIDER, NULL);
+    assert_non_null(index_test_ctx->tctx);
+
+    index_test_ctx->sudo_ctx = talloc_zero(index_test_ctx, struct sudo_ctx);
+    assert_non_null(index_test_ctx->sudo_ctx);
+}
+
+void sudo_index_test_teardown(void **state)
+{
+    errno_t ret;
+
+    ret = sysdb_sudo_purge_byfilter(index_test_ctx->tctx->sysdb,
+                                    index_test_ctx->tctx->dom, NULL);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(index_test_ctx);
+    assert_true(leak_check_teardown());
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_index_build,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_select_user,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_select_group,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_select_netgroup,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_select_defaults,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_select_expired,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+        unit_test_setup_teardown(test_index_split,
+                                 sudo_index_test_setup,
+                                 sudo_index_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
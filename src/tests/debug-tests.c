@@ -988,6 +988,186 @@ START_TEST(test_debug_is_set_false)
 }
 END_TEST
 
+static char *test_helper_debug_ring_read(TALLOC_CTX *mem_ctx, FILE *file)
+{
+    char *msg;
+    long filesize;
+    size_t fsize;
+
+    fflush(file);
+    fail_if(fseek(file, 0, SEEK_END) == -1, "fseek failed");
+    filesize = ftell(file);
+    fail_if(filesize == -1, "ftell failed");
+    rewind(file);
+
+    msg = talloc_array(mem_ctx, char, filesize + 1);
+    fail_if(msg == NULL, "Out of memory");
+    fsize = fread(msg, sizeof(char), filesize, file);
+    fail_unless(fsize == filesize, "Short read");
+    msg[fsize] = '\0';
+
+    return msg;
+}
+
+static FILE *test_helper_debug_ring_setup(char *filename)
+{
+    mode_t old_umask;
+    FILE *file;
+    int fd;
+    int ret;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+
+    old_umask = umask(077);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+
+    /* flush whatever an earlier test left in the ring */
+    debug_ring_level = 0;
+    debug_ring_flush();
+
+    return file;
+}
+
+START_TEST(test_debug_ring_flush_on_demand)
+{
+    TALLOC_CTX *tmp_ctx;
+    char filename[24] = {'\0'};
+    FILE *file;
+    char *msg;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    fail_if(tmp_ctx == NULL, "Out of memory");
+
+    ret = debug_ring_init();
+    fail_unless(ret == EOK, "debug_ring_init failed");
+
+    file = test_helper_debug_ring_setup(filename);
+
+    debug_level = SSSDBG_FATAL_FAILURE;
+    debug_ring_level = SSSDBG_TRACE_FUNC;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("ring message %d\n", 1));
+    DEBUG(SSSDBG_TRACE_ALL, ("not recorded\n"));
+
+    msg = test_helper_debug_ring_read(tmp_ctx, file);
+    fail_unless(msg[0] == '\0', "Buffered message written: [%s]", msg);
+
+    debug_ring_flush();
+
+    msg = test_helper_debug_ring_read(tmp_ctx, file);
+    fail_if(strstr(msg, "[sssd] [test_debug_ring_flush_on_demand] "
+                        "(0x0400): ring message 1\n") == NULL,
+            "Buffered message missing: [%s]", msg);
+    fail_unless(strstr(msg, "not recorded") == NULL,
+                "Message of a disabled level recorded: [%s]", msg);
+
+    /* a second flush does not repeat the messages */
+    debug_ring_flush();
+    fail_unless(strcmp(msg, test_helper_debug_ring_read(tmp_ctx, file)) == 0,
+                "Messages written twice");
+
+    debug_ring_level = 0;
+    fclose(file);
+    remove(filename);
+    talloc_free(tmp_ctx);
+}
+END_TEST
+
+START_TEST(test_debug_ring_flush_on_error)
+{
+    TALLOC_CTX *tmp_ctx;
+    char filename[24] = {'\0'};
+    FILE *file;
+    char *msg;
+    char *before;
+    char *error;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    fail_if(tmp_ctx == NULL, "Out of memory");
+
+    ret = debug_ring_init();
+    fail_unless(ret == EOK, "debug_ring_init failed");
+
+    file = test_helper_debug_ring_setup(filename);
+
+    debug_level = SSSDBG_FATAL_FAILURE | SSSDBG_CRIT_FAILURE;
+    debug_ring_level = SSSDBG_MASK_ALL;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("what happened before\n"));
+    DEBUG(SSSDBG_CRIT_FAILURE, ("the error\n"));
+
+    msg = test_helper_debug_ring_read(tmp_ctx, file);
+    before = strstr(msg, "what happened before");
+    error = strstr(msg, "the error");
+    fail_if(before == NULL || error == NULL,
+            "Messages missing: [%s]", msg);
+    fail_unless(before < error, "Buffered message not written first");
+
+    debug_ring_level = 0;
+    fclose(file);
+    remove(filename);
+    talloc_free(tmp_ctx);
+}
+END_TEST
+
+START_TEST(test_debug_async)
+{
+    TALLOC_CTX *tmp_ctx;
+    char filename[24] = {'\0'};
+    FILE *file;
+    char *msg;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    fail_if(tmp_ctx == NULL, "Out of memory");
+
+    file = test_helper_debug_ring_setup(filename);
+
+    debug_level = SSSDBG_TRACE_FUNC;
+
+    ret = debug_async_start();
+    fail_unless(ret == EOK, "debug_async_start failed");
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("async message %d\n", 1));
+    DEBUG_MSG(SSSDBG_TRACE_FUNC, "test_function", "async message 2");
+
+    /* waits until the writer has written everything */
+    debug_async_stop();
+
+    msg = test_helper_debug_ring_read(tmp_ctx, file);
+    fail_unless(strcmp(msg, "[sssd] [test_debug_async] (0x0400): "
+                            "async message 1\n"
+                            "[sssd] [test_function] (0x0400): "
+                            "async message 2\n") == 0,
+                "Unexpected log content: [%s]", msg);
+
+    /* without the writer the messages are written directly */
+    DEBUG(SSSDBG_TRACE_FUNC, ("direct message\n"));
+    msg = test_helper_debug_ring_read(tmp_ctx, file);
+    fail_if(strstr(msg, "direct message") == NULL,
+            "Message not written: [%s]", msg);
+
+    fclose(file);
+    remove(filename);
+    talloc_free(tmp_ctx);
+}
+END_TEST
+
 Suite *debug_suite(void)
 {
     Suite *s = suite_create("debug");
@@ -1012,6 +1192,9 @@ Suite *debug_suite(void)
     tcase_add_test(tc_debug, test_debug_msg_is_notset_timestamp_microseconds);
     tcase_add_test(tc_debug, test_debug_is_set_true);
     tcase_add_test(tc_debug, test_debug_is_set_false);
+    tcase_add_test(tc_debug, test_debug_ring_flush_on_demand);
+    tcase_add_test(tc_debug, test_debug_ring_flush_on_error);
+    tcase_add_test(tc_debug, test_debug_async);
     tcase_set_timeout(tc_debug, 60);
 
     suite_add_tcase(s, tc_debug);
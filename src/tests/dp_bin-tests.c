@@ -0,0 +1,330 @@
+/*
+   SSSD
+
+   Data Provider binary channel tests
+
+   Copyright (C) 2013 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <check.h>
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/common_check.h"
+#include "tests/common.h"
+#include "util/util.h"
+#include "providers/data_provider.h"
+
+#define BIG_BODY_LEN 60000
+
+struct bin_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct dp_bin_conn *a;
+    struct dp_bin_conn *b;
+    int peer_fd;
+
+    int frames;
+    int expected;
+    uint32_t types[4];
+    uint32_t serials[4];
+    size_t lens[4];
+    bool closed;
+};
+
+static struct bin_test_ctx *setup_pair(void)
+{
+    struct bin_test_ctx *test_ctx;
+    int fds[2];
+    errno_t ret;
+
+    test_ctx = talloc_zero(global_talloc_context, struct bin_test_ctx);
+    fail_if(test_ctx == NULL, "Out of memory");
+
+    test_ctx->tctx = create_ev_test_ctx(test_ctx);
+    fail_if(test_ctx->tctx == NULL, "Cannot create the event context");
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    fail_if(ret != 0, "socketpair failed");
+
+    ret = dp_bin_conn_setup(test_ctx, test_ctx->tctx->ev, fds[0],
+                            &test_ctx->a);
+    fail_if(ret != EOK, "dp_bin_conn_setup failed [%d]", ret);
+    ret = dp_bin_conn_setup(test_ctx, test_ctx->tctx->ev, fds[1],
+                            &test_ctx->b);
+    fail_if(ret != EOK, "dp_bin_conn_setup failed [%d]", ret);
+
+    return test_ctx;
+}
+
+static void record_frame(struct dp_bin_conn *conn,
+                         uint32_t type, uint32_t serial,
+                         const uint8_t *body, size_t body_len,
+                         void *pvt)
+{
+    struct bin_test_ctx *test_ctx = talloc_get_type(pvt,
+                                                    struct bin_test_ctx);
+    size_t i;
+
+    fail_if(test_ctx->frames >= 4, "Too many frames");
+
+    /* the big body is filled with its offsets */
+    for (i = 0; i < body_len; i++) {
+        fail_unless(body[i] == (uint8_t) i,
+                    "Corrupted body at %zu", i);
+    }
+
+    test_ctx->types[test_ctx->frames] = type;
+    test_ctx->serials[test_ctx->frames] = serial;
+    test_ctx->lens[test_ctx->frames] = body_len;
+    test_ctx->frames++;
+
+    if (test_ctx->frames == test_ctx->expected) {
+        test_ctx->tctx->done = true;
+    }
+}
+
+static void record_close(struct dp_bin_conn *conn, void *pvt)
+{
+    struct bin_test_ctx *test_ctx = talloc_get_type(pvt,
+                                                    struct bin_test_ctx);
+
+    test_ctx->closed = true;
+    test_ctx->tctx->done = true;
+    talloc_free(conn);
+}
+
+START_TEST(test_body_encoding)
+{
+    TALLOC_CTX *tmp_ctx;
+    uint8_t *body = NULL;
+    size_t body_len = 0;
+    size_t pos = 0;
+    uint32_t val;
+    const char *str;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    fail_if(tmp_ctx == NULL, "Out of memory");
+
+    ret = dp_bin_add_uint32(tmp_ctx, &body, &body_len, 42);
+    fail_unless(ret == EOK, "dp_bin_add_uint32 failed");
+    ret = dp_bin_add_string(tmp_ctx, &body, &body_len, "name=foo");
+    fail_unless(ret == EOK, "dp_bin_add_string failed");
+    ret = dp_bin_add_string(tmp_ctx, &body, &body_len, NULL);
+    fail_unless(ret == EOK, "dp_bin_add_string failed");
+    fail_unless(body_len == 4 + 4 + 9 + 4 + 1,
+                "Unexpected body length %zu", body_len);
+
+    ret = dp_bin_get_uint32(body, body_len, &pos, &val);
+    fail_unless(ret == EOK && val == 42, "Wrong number");
+    ret = dp_bin_get_string(body, body_len, &pos, &str);
+    fail_unless(ret == EOK && strcmp(str, "name=foo") == 0, "Wrong string");
+    ret = dp_bin_get_string(body, body_len, &pos, &str);
+    fail_unless(ret == EOK && str[0] == '\0', "Wrong empty string");
+    fail_unless(pos == body_len, "Body not consumed");
+
+    ret = dp_bin_get_uint32(body, body_len, &pos, &val);
+    fail_unless(ret == EBADMSG, "Read past the end");
+
+    /* cut the first string */
+    pos = 4;
+    ret = dp_bin_get_string(body, 4 + 4 + 5, &pos, &str);
+    fail_unless(ret == EBADMSG, "Truncated string accepted");
+    fail_unless(pos == 4, "Position moved on failure");
+
+    /* remove the terminating NUL */
+    body[4 + 4 + 8] = 'x';
+    ret = dp_bin_get_string(body, body_len, &pos, &str);
+    fail_unless(ret == EBADMSG, "Unterminated string accepted");
+
+    talloc_free(tmp_ctx);
+}
+END_TEST
+
+START_TEST(test_frames)
+{
+    struct bin_test_ctx *test_ctx;
+    uint8_t *big;
+    uint32_t serial;
+    size_t i;
+    errno_t ret;
+
+    test_ctx = setup_pair();
+    dp_bin_set_handlers(test_ctx->b, record_frame, record_close, test_ctx);
+
+    big = talloc_size(test_ctx, BIG_BODY_LEN);
+    fail_if(big == NULL, "Out of memory");
+    for (i = 0; i < BIG_BODY_LEN; i++) {
+        big[i] = (uint8_t) i;
+    }
+
+    serial = dp_bin_next_serial(test_ctx->a);
+    fail_unless(serial == 1, "Unexpected first serial %u", serial);
+
+    /* queued back to back, they arrive in one read or split anywhere */
+    ret = dp_bin_send(test_ctx->a, DP_BIN_GETACCTINFO, serial, NULL, 0);
+    fail_unless(ret == EOK, "dp_bin_send failed [%d]", ret);
+    ret = dp_bin_send(test_ctx->a, DP_BIN_GETACCTINFO | DP_BIN_REPLY,
+                      2, big, BIG_BODY_LEN);
+    fail_unless(ret == EOK, "dp_bin_send failed [%d]", ret);
+    ret = dp_bin_send(test_ctx->a, 7, 3, big, 16);
+    fail_unless(ret == EOK, "dp_bin_send failed [%d]", ret);
+
+    ret = dp_bin_send(test_ctx->a, 7, 4, big, DP_BIN_MAX_FRAME);
+    fail_unless(ret == EMSGSIZE, "Oversized frame accepted");
+
+    test_ctx->expected = 3;
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+
+    fail_unless(test_ctx->frames == 3, "Got %d frames", test_ctx->frames);
+    fail_unless(test_ctx->types[0] == DP_BIN_GETACCTINFO &&
+                test_ctx->serials[0] == 1 && test_ctx->lens[0] == 0,
+                "Wrong first frame");
+    fail_unless(test_ctx->types[1] == (DP_BIN_GETACCTINFO | DP_BIN_REPLY) &&
+                test_ctx->serials[1] == 2 &&
+                test_ctx->lens[1] == BIG_BODY_LEN,
+                "Wrong second frame");
+    fail_unless(test_ctx->types[2] == 7 &&
+                test_ctx->serials[2] == 3 && test_ctx->lens[2] == 16,
+                "Wrong third frame");
+    fail_if(test_ctx->closed, "Connection closed");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(test_peer_close)
+{
+    struct bin_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = setup_pair();
+    dp_bin_set_handlers(test_ctx->b, record_frame, record_close, test_ctx);
+
+    talloc_zfree(test_ctx->a);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->closed, "Close handler not called");
+    fail_unless(test_ctx->frames == 0, "Unexpected frame");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(test_bad_length)
+{
+    struct bin_test_ctx *test_ctx;
+    uint32_t header[3];
+    int fds[2];
+    ssize_t len;
+    errno_t ret;
+
+    test_ctx = talloc_zero(global_talloc_context, struct bin_test_ctx);
+    fail_if(test_ctx == NULL, "Out of memory");
+    test_ctx->tctx = create_ev_test_ctx(test_ctx);
+    fail_if(test_ctx->tctx == NULL, "Cannot create the event context");
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    fail_if(ret != 0, "socketpair failed");
+
+    ret = dp_bin_conn_setup(test_ctx, test_ctx->tctx->ev, fds[1],
+                            &test_ctx->b);
+    fail_if(ret != EOK, "dp_bin_conn_setup failed [%d]", ret);
+    dp_bin_set_handlers(test_ctx->b, record_frame, record_close, test_ctx);
+
+    /* shorter than its own header */
+    header[0] = 4;
+    header[1] = DP_BIN_GETACCTINFO;
+    header[2] = 1;
+    len = write(fds[0], header, sizeof(header));
+    fail_unless(len == sizeof(header), "write failed");
+
+    ret = test_ev_loop(test_ctx->tctx);
+    fail_unless(ret == EOK, "test_ev_loop failed");
+    fail_unless(test_ctx->closed, "Invalid frame did not close the channel");
+    fail_unless(test_ctx->frames == 0, "Unexpected frame");
+
+    close(fds[0]);
+    talloc_free(test_ctx);
+}
+END_TEST
+
+Suite *dp_bin_suite(void)
+{
+    Suite *s = suite_create("dp_bin");
+
+    TCase *tc_dp_bin = tcase_create("dp_bin");
+    tcase_add_checked_fixture(tc_dp_bin,
+                              ck_leak_check_setup,
+                              ck_leak_check_teardown);
+    tcase_add_test(tc_dp_bin, test_body_encoding);
+    tcase_add_test(tc_dp_bin, test_frames);
+    tcase_add_test(tc_dp_bin, test_peer_close);
+    tcase_add_test(tc_dp_bin, test_bad_length);
+    suite_add_tcase(s, tc_dp_bin);
+
+    return s;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int failure_count;
+    Suite *suite;
+    SRunner *sr;
+    int debug = 0;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "debug-level", 'd', POPT_ARG_INT, &debug, 0, "Set debug level", NULL },
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug);
+
+    tests_set_cwd();
+
+    suite = dp_bin_suite();
+    sr = srunner_create(suite);
+    srunner_set_fork_status(sr, CK_FORK);
+    /* If CK_VERBOSITY is set, use that, otherwise it defaults to CK_NORMAL */
+    srunner_run_all(sr, CK_ENV);
+    failure_count = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (failure_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,515 @@
+/*
+   SSSD
+
+   Compares the round trip of an account request between a responder and
+   a data provider over D-Bus and over the binary channel
+
+   Copyright (C) 2013 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "sbus/sssd_dbus.h"
+#include "providers/data_provider.h"
+
+#define BENCH_DOMAIN "BENCH"
+
+/* Both ends run in this process, so the numbers include the work of the
+ * responder and of the data provider. The D-Bus server requires its
+ * socket to be owned by root, run the benchmark as root. */
+
+struct bench_ctx {
+    struct tevent_context *ev;
+    const char *name;
+
+    int requests;
+    int parallel;
+
+    int sent;
+    int received;
+    int failed;
+    bool done;
+
+    struct sbus_connection *sbus_cli;
+    struct dp_bin_conn *bin_cli;
+    struct dp_bin_conn *bin_srv;
+};
+
+static int bench_build_filter(TALLOC_CTX *mem_ctx, int i, char **filter)
+{
+    *filter = talloc_asprintf(mem_ctx, "name=user%d", i);
+    return *filter ? EOK : ENOMEM;
+}
+
+/* D-Bus */
+
+static int bench_sbus_getaccountinfo(DBusMessage *message,
+                                     struct sbus_connection *conn)
+{
+    DBusMessage *reply;
+    DBusError dbus_error;
+    dbus_bool_t dbret;
+    uint32_t type;
+    uint32_t attr_type;
+    char *filter;
+    char *domain;
+    dbus_uint16_t err_maj = DP_ERR_OK;
+    dbus_uint32_t err_min = EOK;
+    const char *err_msg = "Success";
+
+    dbus_error_init(&dbus_error);
+    dbret = dbus_message_get_args(message, &dbus_error,
+                                  DBUS_TYPE_UINT32, &type,
+                                  DBUS_TYPE_UINT32, &attr_type,
+                                  DBUS_TYPE_STRING, &filter,
+                                  DBUS_TYPE_STRING, &domain,
+                                  DBUS_TYPE_INVALID);
+    if (!dbret) {
+        if (dbus_error_is_set(&dbus_error)) dbus_error_free(&dbus_error);
+        return EIO;
+    }
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) return ENOMEM;
+
+    dbret = dbus_message_append_args(reply,
+                                     DBUS_TYPE_UINT16, &err_maj,
+                                     DBUS_TYPE_UINT32, &err_min,
+                                     DBUS_TYPE_STRING, &err_msg,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) {
+        dbus_message_unref(reply);
+        return EIO;
+    }
+
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+    return EOK;
+}
+
+static struct sbus_method bench_methods[] = {
+    { DP_METHOD_GETACCTINFO, bench_sbus_getaccountinfo },
+    { NULL, NULL }
+};
+
+static struct sbus_interface bench_interface = {
+    DP_INTERFACE,
+    DP_PATH,
+    SBUS_DEFAULT_VTABLE,
+    bench_methods,
+    NULL
+};
+
+static int bench_sbus_conn_init(struct sbus_connection *conn, void *data)
+{
+    return EOK;
+}
+
+static void bench_sbus_next(struct bench_ctx *ctx);
+
+static void bench_sbus_done(DBusPendingCall *pending, void *ptr)
+{
+    struct bench_ctx *ctx = talloc_get_type(ptr, struct bench_ctx);
+    DBusMessage *reply;
+    DBusError dbus_error;
+    dbus_uint16_t dp_err;
+    dbus_uint32_t dp_ret;
+    char *err_msg;
+    dbus_bool_t dbret = false;
+
+    dbus_error_init(&dbus_error);
+
+    reply = dbus_pending_call_steal_reply(pending);
+    if (reply != NULL
+            && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+        dbret = dbus_message_get_args(reply, &dbus_error,
+                                      DBUS_TYPE_UINT16, &dp_err,
+                                      DBUS_TYPE_UINT32, &dp_ret,
+                                      DBUS_TYPE_STRING, &err_msg,
+                                      DBUS_TYPE_INVALID);
+        if (dbus_error_is_set(&dbus_error)) dbus_error_free(&dbus_error);
+    }
+    if (!dbret) {
+        ctx->failed++;
+    }
+
+    if (reply) dbus_message_unref(reply);
+    dbus_pending_call_unref(pending);
+
+    ctx->received++;
+    bench_sbus_next(ctx);
+}
+
+static void bench_sbus_next(struct bench_ctx *ctx)
+{
+    DBusMessage *msg;
+    dbus_bool_t dbret;
+    uint32_t be_type = BE_REQ_USER;
+    uint32_t attrs = BE_ATTR_CORE;
+    const char *domain = BENCH_DOMAIN;
+    char *filter;
+    int ret;
+
+    if (ctx->received == ctx->requests) {
+        ctx->done = true;
+        return;
+    }
+
+    if (ctx->sent == ctx->requests) {
+        return;
+    }
+
+    ret = bench_build_filter(ctx, ctx->sent, &filter);
+    if (ret != EOK) goto fail;
+
+    msg = dbus_message_new_method_call(NULL, DP_PATH, DP_INTERFACE,
+                                       DP_METHOD_GETACCTINFO);
+    if (msg == NULL) goto fail;
+
+    dbret = dbus_message_append_args(msg,
+                                     DBUS_TYPE_UINT32, &be_type,
+                                     DBUS_TYPE_UINT32, &attrs,
+                                     DBUS_TYPE_STRING, &filter,
+                                     DBUS_TYPE_STRING, &domain,
+                                     DBUS_TYPE_INVALID);
+    talloc_free(filter);
+    if (!dbret) {
+        dbus_message_unref(msg);
+        goto fail;
+    }
+
+    ret = sbus_conn_send(ctx->sbus_cli, msg, 30000,
+                         bench_sbus_done, ctx, NULL);
+    dbus_message_unref(msg);
+    if (ret != EOK) goto fail;
+
+    ctx->sent++;
+    return;
+
+fail:
+    fprintf(stderr, "Cannot send the D-Bus request\n");
+    ctx->failed++;
+    ctx->done = true;
+}
+
+static errno_t bench_sbus_setup(struct bench_ctx *ctx, const char *dir)
+{
+    struct sbus_connection *server;
+    char *address;
+    int ret;
+
+    address = talloc_asprintf(ctx, "unix:path=%s/sbus-bench", dir);
+    if (address == NULL) return ENOMEM;
+
+    ret = sbus_new_server(ctx, ctx->ev, address, &bench_interface, false,
+                          &server, bench_sbus_conn_init, ctx);
+    if (ret != EOK) {
+        fprintf(stderr, "Cannot set up the D-Bus server, "
+                        "are you running as root?\n");
+        return ret;
+    }
+
+    return sbus_new_connection(ctx, ctx->ev, address, &bench_interface,
+                               &ctx->sbus_cli);
+}
+
+/* Binary channel */
+
+static void bench_bin_next(struct bench_ctx *ctx);
+
+static void bench_bin_srv_frame(struct dp_bin_conn *conn,
+                                uint32_t type, uint32_t serial,
+                                const uint8_t *body, size_t body_len,
+                                void *pvt)
+{
+    struct bench_ctx *ctx = talloc_get_type(pvt, struct bench_ctx);
+    uint32_t be_type;
+    uint32_t attr_type;
+    const char *filter;
+    const char *domain;
+    uint8_t *reply = NULL;
+    size_t reply_len = 0;
+    size_t pos = 0;
+    errno_t ret;
+
+    ret = dp_bin_get_uint32(body, body_len, &pos, &be_type);
+    if (ret == EOK) ret = dp_bin_get_uint32(body, body_len, &pos, &attr_type);
+    if (ret == EOK) ret = dp_bin_get_string(body, body_len, &pos, &filter);
+    if (ret == EOK) ret = dp_bin_get_string(body, body_len, &pos, &domain);
+    if (ret != EOK) return;
+
+    ret = dp_bin_add_uint32(ctx, &reply, &reply_len, DP_ERR_OK);
+    if (ret == EOK) ret = dp_bin_add_uint32(ctx, &reply, &reply_len, EOK);
+    if (ret == EOK) ret = dp_bin_add_string(ctx, &reply, &reply_len,
+                                            "Success");
+    if (ret == EOK) {
+        dp_bin_send(conn, type | DP_BIN_REPLY, serial, reply, reply_len);
+    }
+    talloc_free(reply);
+}
+
+static void bench_bin_close(struct dp_bin_conn *conn, void *pvt)
+{
+    struct bench_ctx *ctx = talloc_get_type(pvt, struct bench_ctx);
+
+    fprintf(stderr, "The binary channel was closed\n");
+    ctx->done = true;
+}
+
+static void bench_bin_accept(struct dp_bin_conn *conn, void *pvt)
+{
+    struct bench_ctx *ctx = talloc_get_type(pvt, struct bench_ctx);
+
+    ctx->bin_srv = talloc_steal(ctx, conn);
+    dp_bin_set_handlers(conn, bench_bin_srv_frame, bench_bin_close, ctx);
+}
+
+static void bench_bin_cli_frame(struct dp_bin_conn *conn,
+                                uint32_t type, uint32_t serial,
+                                const uint8_t *body, size_t body_len,
+                                void *pvt)
+{
+    struct bench_ctx *ctx = talloc_get_type(pvt, struct bench_ctx);
+    uint32_t dp_err;
+    uint32_t dp_ret;
+    const char *err_msg;
+    size_t pos = 0;
+    errno_t ret;
+
+    ret = dp_bin_get_uint32(body, body_len, &pos, &dp_err);
+    if (ret == EOK) ret = dp_bin_get_uint32(body, body_len, &pos, &dp_ret);
+    if (ret == EOK) ret = dp_bin_get_string(body, body_len, &pos, &err_msg);
+    if (ret != EOK) {
+        ctx->failed++;
+    }
+
+    ctx->received++;
+    bench_bin_next(ctx);
+}
+
+static void bench_bin_next(struct bench_ctx *ctx)
+{
+    uint8_t *body = NULL;
+    size_t body_len = 0;
+    char *filter;
+    errno_t ret;
+
+    if (ctx->received == ctx->requests) {
+        ctx->done = true;
+        return;
+    }
+
+    if (ctx->sent == ctx->requests) {
+        return;
+    }
+
+    ret = bench_build_filter(ctx, ctx->sent, &filter);
+    if (ret == EOK) ret = dp_bin_add_uint32(ctx, &body, &body_len,
+                                            BE_REQ_USER);
+    if (ret == EOK) ret = dp_bin_add_uint32(ctx, &body, &body_len,
+                                            BE_ATTR_CORE);
+    if (ret == EOK) ret = dp_bin_add_string(ctx, &body, &body_len, filter);
+    if (ret == EOK) ret = dp_bin_add_string(ctx, &body, &body_len,
+                                            BENCH_DOMAIN);
+    if (ret == EOK) {
+        ret = dp_bin_send(ctx->bin_cli, DP_BIN_GETACCTINFO,
+                          dp_bin_next_serial(ctx->bin_cli), body, body_len);
+    }
+    talloc_free(filter);
+    talloc_free(body);
+    if (ret != EOK) {
+        fprintf(stderr, "Cannot send the binary request\n");
+        ctx->failed++;
+        ctx->done = true;
+        return;
+    }
+
+    ctx->sent++;
+}
+
+static errno_t bench_bin_setup(struct bench_ctx *ctx, const char *dir)
+{
+    char *address;
+    int ret;
+
+    address = talloc_asprintf(ctx, "%s/dp-bin-bench", dir);
+    if (address == NULL) return ENOMEM;
+
+    ret = dp_bin_listen(ctx, ctx->ev, address, bench_bin_accept, ctx);
+    if (ret != EOK) return ret;
+
+    ret = dp_bin_connect(ctx, ctx->ev, address, &ctx->bin_cli);
+    if (ret != EOK) return ret;
+
+    dp_bin_set_handlers(ctx->bin_cli, bench_bin_cli_frame,
+                        bench_bin_close, ctx);
+    return EOK;
+}
+
+/* Driver */
+
+static double bench_tv_usec(const struct timeval *tv)
+{
+    return (double) tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static int bench_run(struct bench_ctx *ctx, void (*next)(struct bench_ctx *))
+{
+    struct timeval start;
+    struct timeval end;
+    struct rusage ru_start;
+    struct rusage ru_end;
+    double wall;
+    double cpu;
+    int i;
+
+    ctx->sent = 0;
+    ctx->received = 0;
+    ctx->failed = 0;
+    ctx->done = false;
+
+    getrusage(RUSAGE_SELF, &ru_start);
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < ctx->parallel; i++) {
+        next(ctx);
+    }
+
+    while (!ctx->done) {
+        if (tevent_loop_once(ctx->ev) != 0) {
+            fprintf(stderr, "tevent_loop_once failed\n");
+            return EIO;
+        }
+    }
+
+    gettimeofday(&end, NULL);
+    getrusage(RUSAGE_SELF, &ru_end);
+
+    wall = bench_tv_usec(&end) - bench_tv_usec(&start);
+    cpu = bench_tv_usec(&ru_end.ru_utime) - bench_tv_usec(&ru_start.ru_utime)
+          + bench_tv_usec(&ru_end.ru_stime)
+          - bench_tv_usec(&ru_start.ru_stime);
+
+    printf("%-8s %9d %7d %12.1f %14.2f %14.2f %14.0f\n",
+           ctx->name, ctx->received, ctx->failed, wall / 1000,
+           wall * ctx->parallel / ctx->received, cpu / ctx->received,
+           ctx->received / (wall / 1000000));
+
+    return ctx->failed ? EIO : EOK;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    int ret;
+    int requests = 100000;
+    int parallel = 1;
+    char dir[] = "/tmp/dp_ipc-bench-XXXXXX";
+    char path[PATH_MAX];
+    poptContext pc;
+    struct bench_ctx *ctx;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_MAIN_OPTS
+        { "requests", 'n', POPT_ARG_INT, &requests, 0,
+          "How many requests to send over each transport (default 100000)",
+          NULL },
+        { "parallel", 'p', POPT_ARG_INT, &parallel, 0,
+          "How many requests to keep in flight (default 1)", NULL },
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            poptFreeContext(pc);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (requests <= 0 || parallel <= 0 || parallel > requests) {
+        fprintf(stderr, "Invalid number of requests\n");
+        return 1;
+    }
+
+    DEBUG_INIT(debug_level);
+
+    if (mkdtemp(dir) == NULL) {
+        ret = errno;
+        fprintf(stderr, "mkdtemp failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+
+    ctx = talloc_zero(NULL, struct bench_ctx);
+    if (ctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    ctx->requests = requests;
+    ctx->parallel = parallel;
+
+    ctx->ev = tevent_context_init(ctx);
+    if (ctx->ev == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = bench_sbus_setup(ctx, dir);
+    if (ret != EOK) goto done;
+
+    ret = bench_bin_setup(ctx, dir);
+    if (ret != EOK) goto done;
+
+    printf("%-8s %9s %7s %12s %14s %14s %14s\n",
+           "Channel", "Requests", "Failed", "Total(ms)",
+           "Latency(us)", "CPU/req(us)", "Requests/s");
+
+    ctx->name = "D-Bus";
+    ret = bench_run(ctx, bench_sbus_next);
+    if (ret != EOK) goto done;
+
+    ctx->name = "binary";
+    ret = bench_run(ctx, bench_bin_next);
+
+done:
+    talloc_free(ctx);
+    snprintf(path, sizeof(path), "%s/sbus-bench", dir);
+    unlink(path);
+    rmdir(dir);
+    if (ret != EOK) {
+        fprintf(stderr, "The benchmark failed [%d]: %s\n",
+                ret, strerror(ret));
+        return 1;
+    }
+    return 0;
+}
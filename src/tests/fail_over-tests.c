@@ -23,6 +23,10 @@
 */
 
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <check.h>
 #include <popt.h>
@@ -44,6 +48,7 @@ struct test_ctx {
     struct tevent_context *ev;
     struct resolv_ctx *resolv;
     struct fo_ctx *fo_ctx;
+    struct fo_server *last_server;
     int tasks;
 };
 
@@ -57,7 +62,7 @@ struct task {
 };
 
 static struct test_ctx *
-setup_test(void)
+setup_test(int probe_count)
 {
     struct test_ctx *ctx;
     struct fo_options fopts;
@@ -81,6 +86,10 @@ setup_test(void)
     memset(&fopts, 0, sizeof(fopts));
     fopts.retry_timeout = 30;
     fopts.family_order  = IPV4_FIRST;
+    fopts.service_resolv_timeout = 5;
+    fopts.probe_count = probe_count;
+    fopts.probe_delay = 50;
+    fopts.probe_timeout = 2;
 
     ctx->fo_ctx = fo_context_init(ctx, &fopts);
     if (ctx->fo_ctx == NULL) {
@@ -106,7 +115,7 @@ START_TEST(test_fo_new_service)
     struct fo_service *service;
     struct fo_service *services[10];
 
-    ctx = setup_test();
+    ctx = setup_test(0);
     ck_leaks_push(ctx);
 
     for (i = 0; i < 10; i++) {
@@ -161,6 +170,7 @@ test_resolve_service_callback(struct tevent_req *req)
     if (recv_status != EOK)
         return;
     fail_if(server == NULL);
+    task->test_ctx->last_server = server;
     port = fo_get_server_port(server);
     fail_if(port != task->port, "%s: Expected port %d, got %d", task->location,
             task->port, port);
@@ -219,7 +229,7 @@ START_TEST(test_fo_resolve_service)
     struct test_ctx *ctx;
     struct fo_service *service[3];
 
-    ctx = setup_test();
+    ctx = setup_test(0);
     fail_if(ctx == NULL);
 
     /* Add service. */
@@ -257,6 +267,174 @@ START_TEST(test_fo_resolve_service)
 }
 END_TEST
 
+START_TEST(test_fo_latency)
+{
+    struct test_ctx *ctx;
+    struct fo_service *service;
+    struct fo_server *a;
+    struct fo_server *b;
+    struct fo_server *c;
+
+    ctx = setup_test(0);
+    fail_if(ctx == NULL);
+
+    fail_if(fo_new_service(ctx->fo_ctx, "ldap", NULL, &service) != EOK);
+    fail_if(fo_add_server(service, "localhost", 10, NULL, true) != EOK);
+    fail_if(fo_add_server(service, "127.0.0.1", 20, NULL, true) != EOK);
+    fail_if(fo_add_server(service, "localhost", 30, NULL, true) != EOK);
+
+    /* Nothing was measured, the order of the list is used */
+    get_request(ctx, service, EOK, 10, PORT_NOT_WORKING, -1);
+    a = ctx->last_server;
+    get_request(ctx, service, EOK, 20, PORT_NOT_WORKING, -1);
+    b = ctx->last_server;
+    get_request(ctx, service, EOK, 30, PORT_NOT_WORKING, -1);
+    c = ctx->last_server;
+
+    fail_if(fo_get_server_latency(a, FO_LATENCY_CONNECT) != -1);
+    fo_add_server_latency(a, FO_LATENCY_CONNECT, 80);
+    fo_add_server_latency(b, FO_LATENCY_CONNECT, 50);
+    fo_add_server_latency(c, FO_LATENCY_CONNECT, 1);
+    fo_add_server_latency(b, FO_LATENCY_CONNECT, 58);
+    fail_if(fo_get_server_latency(b, FO_LATENCY_CONNECT) != 51);
+    fail_if(fo_get_server_latency(b, FO_LATENCY_SEARCH) != -1);
+
+    /* The fastest server does not work, the next fastest one wins */
+    fo_set_port_status(a, PORT_NEUTRAL);
+    fo_set_port_status(b, PORT_NEUTRAL);
+    get_request(ctx, service, EOK, 20, -1, -1);
+
+    /* The search latency takes precedence over the connect one */
+    fo_add_server_latency(b, FO_LATENCY_SEARCH, 200);
+    get_request(ctx, service, EOK, 10, -1, -1);
+
+    talloc_free(ctx);
+}
+END_TEST
+
+/* Returns a socket listening on a random port of the loopback */
+static int
+listen_on_loopback(int *_port)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    fail_if(fd == -1, "socket() failed");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    fail_if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0,
+            "bind() failed");
+    fail_if(getsockname(fd, (struct sockaddr *) &addr, &len) != 0,
+            "getsockname() failed");
+
+    *_port = ntohs(addr.sin_port);
+    return fd;
+}
+
+START_TEST(test_fo_probe_service)
+{
+    struct test_ctx *ctx;
+    struct fo_service *service;
+    int closed_fd;
+    int closed_port;
+    int listen_fd;
+    int listen_port;
+
+    ctx = setup_test(3);
+    fail_if(ctx == NULL);
+
+    /* Bound but not listening, connections are refused */
+    closed_fd = listen_on_loopback(&closed_port);
+    listen_fd = listen_on_loopback(&listen_port);
+    fail_if(listen(listen_fd, 5) != 0, "listen() failed");
+
+    fail_if(fo_new_service(ctx->fo_ctx, "ldap", NULL, &service) != EOK);
+    fo_set_service_probing(service, 389);
+
+    fail_if(fo_add_server(service, "127.0.0.1", closed_port,
+                          NULL, true) != EOK);
+    fail_if(fo_add_server(service, "localhost", listen_port,
+                          NULL, true) != EOK);
+
+    /* The first server refuses the connection, the probe must pick the
+     * second one and mark the first one as not working */
+    get_request(ctx, service, EOK, listen_port, -1, -1);
+    get_request(ctx, service, EOK, listen_port, PORT_WORKING, -1);
+    get_request(ctx, service, EOK, listen_port, PORT_NOT_WORKING, -1);
+    get_request(ctx, service, ENOENT, 0, -1, -1);
+
+    close(listen_fd);
+    close(closed_fd);
+    talloc_free(ctx);
+}
+END_TEST
+
+static void
+test_reprobe_done(struct tevent_req *req)
+{
+    struct test_ctx *ctx = tevent_req_callback_data(req, struct test_ctx);
+    int ret;
+
+    ret = fo_reprobe_service_recv(req);
+    talloc_free(req);
+    fail_if(ret != EOK, "fo_reprobe_service_recv failed [%d]", ret);
+    ctx->tasks--;
+}
+
+START_TEST(test_fo_reprobe_disabled)
+{
+    struct test_ctx *ctx;
+    struct fo_service *service;
+    struct tevent_req *req;
+    struct pollfd pfd;
+    int closed_fd;
+    int closed_port;
+    int listen_fd;
+    int listen_port;
+
+    /* failover_probe_servers = 0 */
+    ctx = setup_test(0);
+    fail_if(ctx == NULL);
+
+    closed_fd = listen_on_loopback(&closed_port);
+    listen_fd = listen_on_loopback(&listen_port);
+    fail_if(listen(listen_fd, 5) != 0, "listen() failed");
+
+    fail_if(fo_new_service(ctx->fo_ctx, "ldap", NULL, &service) != EOK);
+    fo_set_service_probing(service, 389);
+
+    fail_if(fo_add_server(service, "127.0.0.1", closed_port,
+                          NULL, true) != EOK);
+    fail_if(fo_add_server(service, "localhost", listen_port,
+                          NULL, true) != EOK);
+
+    req = fo_reprobe_service_send(ctx, ctx->ev, ctx->resolv,
+                                  ctx->fo_ctx, service);
+    fail_if(req == NULL, "fo_reprobe_service_send failed");
+    tevent_req_set_callback(req, test_reprobe_done, ctx);
+    ctx->tasks++;
+    test_loop(ctx);
+
+    /* No connection was attempted */
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    fail_if(poll(&pfd, 1, 0) != 0, "The listening server was probed");
+
+    /* The refusing server was not marked as not working */
+    get_request(ctx, service, EOK, closed_port, -1, -1);
+
+    close(listen_fd);
+    close(closed_fd);
+    talloc_free(ctx);
+}
+END_TEST
+
 Suite *
 create_suite(void)
 {
@@ -268,6 +446,9 @@ create_suite(void)
     /* Do some testing */
     tcase_add_test(tc, test_fo_new_service);
     tcase_add_test(tc, test_fo_resolve_service);
+    tcase_add_test(tc, test_fo_latency);
+    tcase_add_test(tc, test_fo_probe_service);
+    tcase_add_test(tc, test_fo_reprobe_disabled);
     if (use_net_test) {
     }
     /* Add all test cases to the test suite */
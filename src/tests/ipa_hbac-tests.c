@@ -20,10 +20,13 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <stdlib.h>
+#include <stdio.h>
+#include <popt.h>
 #include <check.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <talloc.h>
 
 #include "tests/common_check.h"
@@ -66,6 +69,9 @@ const uint8_t srchost_utf8_upcase[] = { 0xCE, 0x91, 0xCE, 0x92, 0xCE, 0x93, 0x0
 /* Turkish "capital I" and "dotless i" */
 const uint8_t user_lowcase_tr[] = { 0xC4, 0xB1, 0x0 };
 const uint8_t user_upcase_tr[] = { 0x49, 0x0 };
+/* German "Strasse" - sharp s folds to "ss" but has no upper case */
+const uint8_t user_utf8_sharp_s[] = { 's', 't', 'r', 'a', 0xC3, 0x9F, 'e', 0x0 };
+const uint8_t user_utf8_double_s[] = { 'S', 'T', 'R', 'A', 'S', 'S', 'E', 0x0 };
 
 static void get_allow_all_rule(TALLOC_CTX *mem_ctx,
                                struct hbac_rule **allow_rule)
@@ -809,6 +815,186 @@ START_TEST(ipa_hbac_test_incomplete)
 }
 END_TEST
 
+static void check_compiled(struct hbac_rule **rules,
+                           struct hbac_eval_req *eval_req,
+                           enum hbac_eval_result expected,
+                           const char *expected_rule)
+{
+    enum hbac_eval_result result;
+    struct hbac_compiled_rules *compiled;
+    struct hbac_info *info;
+
+    compiled = hbac_compile_rules(rules);
+    fail_if(compiled == NULL);
+
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    fail_unless(result == expected,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(expected),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    if (expected_rule == NULL) {
+        fail_unless(info->rule_name == NULL,
+                    "Unexpected rule [%s]", info->rule_name);
+    } else {
+        fail_if(info->rule_name == NULL);
+        fail_unless(strcmp(info->rule_name, expected_rule) == 0,
+                    "Expected rule [%s], got [%s]",
+                    expected_rule, info->rule_name);
+    }
+    hbac_free_info(info);
+
+    /* The plain evaluation must agree */
+    result = hbac_evaluate(rules, eval_req, &info);
+    fail_unless(result == expected,
+                "hbac_evaluate returned [%s]", hbac_result_string(result));
+    hbac_free_info(info);
+
+    hbac_free_compiled_rules(compiled);
+}
+
+START_TEST(ipa_hbac_test_compiled)
+{
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_rule_element *srchosts;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL);
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    rules = talloc_array(test_ctx, struct hbac_rule *, 5);
+    fail_if (rules == NULL);
+
+    /* A rule for somebody else */
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = "Other user";
+    rules[0]->users->category = HBAC_CATEGORY_NULL;
+    rules[0]->users->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->users->names == NULL);
+    rules[0]->users->names[0] = HBAC_TEST_INVALID_USER;
+    rules[0]->users->names[1] = NULL;
+
+    /* A disabled rule that would allow everybody */
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->name = "Disabled";
+    rules[1]->enabled = false;
+
+    /* A rule for one of the groups of the user, written in upper case */
+    get_allow_all_rule(rules, &rules[2]);
+    rules[2]->name = "Allow group";
+    rules[2]->users->category = HBAC_CATEGORY_NULL;
+    rules[2]->users->groups = talloc_array(rules[2], const char *, 3);
+    fail_if(rules[2]->users->groups == NULL);
+    rules[2]->users->groups[0] = HBAC_TEST_INVALID_GROUP;
+    rules[2]->users->groups[1] = "TESTGROUP2";
+    rules[2]->users->groups[2] = NULL;
+    rules[2]->services->category = HBAC_CATEGORY_NULL;
+    rules[2]->services->groups = talloc_array(rules[2], const char *, 2);
+    fail_if(rules[2]->services->groups == NULL);
+    rules[2]->services->groups[0] = HBAC_TEST_SERVICEGROUP1;
+    rules[2]->services->groups[1] = NULL;
+
+    /* Allows everybody, but comes later */
+    get_allow_all_rule(rules, &rules[3]);
+    rules[3]->name = "Allow all";
+    rules[4] = NULL;
+
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Allow group");
+
+    /* Without the last rule nothing but the group rule matches */
+    rules[3] = NULL;
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Allow group");
+
+    /* A different service */
+    eval_req->service->groups[0] = HBAC_TEST_INVALID_SERVICEGROUP;
+    check_compiled(rules, eval_req, HBAC_EVAL_DENY, NULL);
+    eval_req->service->groups[0] = HBAC_TEST_SERVICEGROUP1;
+
+    /* An incomplete rule before the matching one is an error... */
+    srchosts = rules[0]->srchosts;
+    rules[0]->srchosts = NULL;
+    check_compiled(rules, eval_req, HBAC_EVAL_ERROR, "Other user");
+
+    /* ...but not after it */
+    rules[0]->srchosts = srchosts;
+    rules[1]->enabled = true;
+    rules[1]->srchosts = NULL;
+    rules[0]->users->names[0] = HBAC_TEST_USER;
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Other user");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(ipa_hbac_test_compiled_utf8)
+{
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL);
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    eval_req->user->name = (const char *) &user_utf8_lowcase;
+    eval_req->service->name = (const char *) &service_utf8_lowcase;
+
+    rules = talloc_array(test_ctx, struct hbac_rule *, 2);
+    fail_if (rules == NULL);
+
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = "Allow user";
+    rules[0]->users->category = HBAC_CATEGORY_NULL;
+    rules[0]->users->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->users->names == NULL);
+    rules[0]->users->names[0] = (const char *) &user_utf8_upcase;
+    rules[0]->users->names[1] = NULL;
+    rules[0]->services->category = HBAC_CATEGORY_NULL;
+    rules[0]->services->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->services->names == NULL);
+    rules[0]->services->names[0] = (const char *) &service_utf8_upcase;
+    rules[0]->services->names[1] = NULL;
+    rules[1] = NULL;
+
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Allow user");
+
+    /* Negative test - a different letter */
+    rules[0]->users->names[0] = (const char *) &user_utf8_lowcase_neg;
+    check_compiled(rules, eval_req, HBAC_EVAL_DENY, NULL);
+
+    /* Negative test - Turkish dotless i */
+    eval_req->user->name = (const char *) &user_lowcase_tr;
+    rules[0]->users->names[0] = (const char *) &user_upcase_tr;
+    check_compiled(rules, eval_req, HBAC_EVAL_DENY, NULL);
+
+    /* Lowercasing keeps the sharp s, case folding does not */
+    eval_req->user->name = (const char *) &user_utf8_double_s;
+    rules[0]->users->names[0] = (const char *) &user_utf8_sharp_s;
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Allow user");
+
+    eval_req->user->name = (const char *) &user_utf8_sharp_s;
+    rules[0]->users->names[0] = (const char *) &user_utf8_double_s;
+    check_compiled(rules, eval_req, HBAC_EVAL_ALLOW, "Allow user");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 Suite *hbac_test_suite (void)
 {
     Suite *s = suite_create ("HBAC");
@@ -827,14 +1013,193 @@ Suite *hbac_test_suite (void)
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_srchostgroup);
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_utf8);
     tcase_add_test(tc_hbac, ipa_hbac_test_incomplete);
+    tcase_add_test(tc_hbac, ipa_hbac_test_compiled);
+    tcase_add_test(tc_hbac, ipa_hbac_test_compiled_utf8);
 
     suite_add_tcase(s, tc_hbac);
     return s;
 }
 
+/* Compare hbac_evaluate() with hbac_evaluate_compiled() for a large rule
+ * set and a user who is a member of many groups. Not run by default. */
+#define BENCH_RULES 2000
+#define BENCH_GROUPS 300
+#define BENCH_ROUNDS 100
+
+static const char **bench_list(TALLOC_CTX *mem_ctx, const char *prefix,
+                               int first, int count)
+{
+    const char **list;
+    int i;
+
+    list = talloc_array(mem_ctx, const char *, count + 1);
+    if (list == NULL) abort();
+
+    for (i = 0; i < count; i++) {
+        list[i] = talloc_asprintf(list, "%s%d", prefix, first + i);
+        if (list[i] == NULL) abort();
+    }
+    list[count] = NULL;
+
+    return list;
+}
+
+static struct hbac_rule_element *bench_element(TALLOC_CTX *mem_ctx,
+                                               const char *name_prefix,
+                                               const char *group_prefix,
+                                               int id)
+{
+    struct hbac_rule_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_rule_element);
+    if (el == NULL) abort();
+
+    el->names = bench_list(el, name_prefix, id, 1);
+    el->groups = bench_list(el, group_prefix, id, 2);
+
+    return el;
+}
+
+static uint64_t bench_usec(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000ULL
+           + end->tv_usec - start->tv_usec;
+}
+
+static int run_benchmark(void)
+{
+    TALLOC_CTX *bench_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_compiled_rules *compiled;
+    struct hbac_info *info;
+    enum hbac_eval_result linear_result;
+    enum hbac_eval_result compiled_result;
+    struct timeval start;
+    struct timeval end;
+    uint64_t linear_usec;
+    uint64_t compile_usec;
+    uint64_t compiled_usec;
+    int i;
+
+    bench_ctx = talloc_new(NULL);
+    if (bench_ctx == NULL) return EXIT_FAILURE;
+
+    rules = talloc_array(bench_ctx, struct hbac_rule *, BENCH_RULES + 1);
+    if (rules == NULL) abort();
+
+    for (i = 0; i < BENCH_RULES; i++) {
+        rules[i] = talloc_zero(rules, struct hbac_rule);
+        if (rules[i] == NULL) abort();
+
+        rules[i]->name = talloc_asprintf(rules[i], "rule%d", i);
+        rules[i]->enabled = true;
+        rules[i]->users = bench_element(rules[i], "user", "group", i);
+        rules[i]->services = bench_element(rules[i], "service",
+                                           "servicegroup", i % 50);
+        rules[i]->targethosts = bench_element(rules[i], "host",
+                                              "hostgroup", i % 100);
+        rules[i]->srchosts = talloc_zero(rules[i], struct hbac_rule_element);
+        if (rules[i]->srchosts == NULL) abort();
+        rules[i]->srchosts->category = HBAC_CATEGORY_ALL;
+    }
+    rules[BENCH_RULES] = NULL;
+
+    /* The user is in many groups, only rules near the end of the list
+     * apply */
+    eval_req = talloc_zero(bench_ctx, struct hbac_eval_req);
+    if (eval_req == NULL) abort();
+
+    eval_req->user = talloc_zero(eval_req, struct hbac_request_element);
+    eval_req->service = talloc_zero(eval_req, struct hbac_request_element);
+    eval_req->targethost = talloc_zero(eval_req, struct hbac_request_element);
+    eval_req->srchost = talloc_zero(eval_req, struct hbac_request_element);
+    if (eval_req->user == NULL || eval_req->service == NULL
+            || eval_req->targethost == NULL || eval_req->srchost == NULL) {
+        abort();
+    }
+
+    eval_req->user->name = "benchuser";
+    eval_req->user->groups = bench_list(eval_req, "group",
+                                        BENCH_RULES - BENCH_GROUPS + 1,
+                                        BENCH_GROUPS);
+    eval_req->service->name = "sshd";
+    eval_req->service->groups = bench_list(eval_req, "servicegroup",
+                                           (BENCH_RULES - 1) % 50, 1);
+    eval_req->targethost->name = "client.example.com";
+    eval_req->targethost->groups = bench_list(eval_req, "hostgroup",
+                                              (BENCH_RULES - 1) % 100, 1);
+    eval_req->srchost->name = "remote.example.com";
+    eval_req->srchost->groups = bench_list(eval_req, "srchostgroup", 0, 0);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        linear_result = hbac_evaluate(rules, eval_req, &info);
+        hbac_free_info(info);
+    }
+    gettimeofday(&end, NULL);
+    linear_usec = bench_usec(&start, &end) / BENCH_ROUNDS;
+
+    gettimeofday(&start, NULL);
+    compiled = hbac_compile_rules(rules);
+    gettimeofday(&end, NULL);
+    if (compiled == NULL) abort();
+    compile_usec = bench_usec(&start, &end);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        compiled_result = hbac_evaluate_compiled(compiled, eval_req, &info);
+        hbac_free_info(info);
+    }
+    gettimeofday(&end, NULL);
+    compiled_usec = bench_usec(&start, &end) / BENCH_ROUNDS;
+
+    printf("%d rules, user in %d groups\n", BENCH_RULES, BENCH_GROUPS);
+    printf("hbac_evaluate:          %llu us [%s]\n",
+           (unsigned long long) linear_usec,
+           hbac_result_string(linear_result));
+    printf("hbac_compile_rules:     %llu us\n",
+           (unsigned long long) compile_usec);
+    printf("hbac_evaluate_compiled: %llu us [%s]\n",
+           (unsigned long long) compiled_usec,
+           hbac_result_string(compiled_result));
+
+    hbac_free_compiled_rules(compiled);
+    talloc_free(bench_ctx);
+
+    return linear_result == compiled_result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, const char *argv[])
 {
     int number_failed;
+    int opt;
+    int benchmark = 0;
+    poptContext pc;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        {"benchmark", 0, POPT_ARG_NONE, &benchmark, 0,
+         "Compare the plain and the compiled evaluation of a large rule "
+         "set instead of running the tests", NULL},
+        POPT_TABLEEND
+    };
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (benchmark) {
+        return run_benchmark();
+    }
 
     tests_set_cwd();
 
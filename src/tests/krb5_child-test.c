@@ -29,6 +29,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <limits.h>
+#include <signal.h>
+#include <dirent.h>
 
 #include "util/util.h"
 #include "src/tools/tools_util.h"
@@ -315,6 +317,124 @@ child_done(struct tevent_req *req)
     ctx->child_ret = ret;
 }
 
+static errno_t
+run_child(struct krb5_child_test_ctx *ctx)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    ctx->done = false;
+    talloc_zfree(ctx->buf);
+    talloc_zfree(ctx->res);
+
+    req = handle_child_send(ctx, ctx->ev, ctx->kr);
+    if (!req) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("Cannot create child request\n"));
+        return ENOMEM;
+    }
+    tevent_req_set_callback(req, child_done, ctx);
+
+    while (ctx->done == false) {
+         tevent_loop_once(ctx->ev);
+    }
+
+    printf("Child returned %d\n", ctx->child_ret);
+    if (ctx->child_ret != EOK) {
+        return ctx->child_ret;
+    }
+
+    ret = parse_krb5_child_response(ctx, ctx->buf, ctx->len,
+                                    ctx->kr->pd, 0, &ctx->res);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("Could not parse child response\n"));
+        return ret;
+    }
+
+    return EOK;
+}
+
+/* Once a request has finished, the only processes left running as our
+ * children are the idle krb5_child workers. */
+static int
+kill_idle_workers(void)
+{
+    DIR *dir;
+    struct dirent *de;
+    char path[PATH_MAX];
+    FILE *f;
+    pid_t pid;
+    int ppid;
+    char state;
+    int killed = 0;
+    int ret;
+
+    dir = opendir("/proc");
+    if (dir == NULL) {
+        return 0;
+    }
+
+    while ((de = readdir(dir)) != NULL) {
+        pid = strtol(de->d_name, NULL, 10);
+        if (pid <= 0) continue;
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        f = fopen(path, "r");
+        if (f == NULL) continue;
+        ret = fscanf(f, "%*d (%*[^)]) %c %d", &state, &ppid);
+        fclose(f);
+        if (ret != 2 || ppid != getpid() || state == 'Z') continue;
+
+        if (kill(pid, SIGKILL) == 0) {
+            printf("Killed idle krb5_child worker [%d]\n", pid);
+            killed++;
+        }
+    }
+
+    closedir(dir);
+    return killed;
+}
+
+/* Authenticate through a pool of one worker, kill the idle worker and
+ * authenticate again. The second request must not fail, it is sent to a
+ * one-shot child when the dead worker cannot be used. */
+static errno_t
+run_pool_test(struct krb5_child_test_ctx *ctx)
+{
+    errno_t ret;
+
+    /* Like the back end, survive writing to a dead worker */
+    signal(SIGPIPE, SIG_IGN);
+
+    ret = dp_opt_set_int(ctx->kr->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 1);
+    if (ret != EOK) return ret;
+
+    ret = run_child(ctx);
+    if (ret != EOK) {
+        fprintf(stderr, "Request through a new worker failed\n");
+        return ret;
+    }
+
+    if (kill_idle_workers() != 1) {
+        fprintf(stderr, "Expected exactly one idle krb5_child worker\n");
+        return EINVAL;
+    }
+
+    ret = run_child(ctx);
+    if (ret != EOK) {
+        fprintf(stderr, "Request after killing the idle worker failed\n");
+        return ret;
+    }
+
+    /* The dead worker has been discarded, a new one is started */
+    ret = run_child(ctx);
+    if (ret != EOK) {
+        fprintf(stderr, "Request through a replacement worker failed\n");
+        return ret;
+    }
+
+    return EOK;
+}
+
 static void
 printtime(krb5_timestamp ts)
 {
@@ -421,7 +541,6 @@ main(int argc, const char *argv[])
     int opt;
     errno_t ret;
     struct krb5_child_test_ctx *ctx = NULL;
-    struct tevent_req *req;
 
     int pc_debug = 0;
     int pc_timeout = 0;
@@ -432,6 +551,7 @@ main(int argc, const char *argv[])
     const char *pc_ccname_tp = NULL;;
     char *password = NULL;
     bool rm_ccache = true;
+    bool pool = false;
 
     poptContext pc;
     struct poptOption long_options[] = {
@@ -454,6 +574,9 @@ main(int argc, const char *argv[])
           "Do not delete the ccache when the tool finishes", NULL },
         { "timeout", '\0', POPT_ARG_INT, &pc_timeout, 0,
           "The timeout for the child, in seconds", NULL },
+        { "pool", '\0', POPT_ARG_NONE, NULL, 'p',
+          "Authenticate through a krb5_child worker, kill it and "
+          "authenticate again", NULL },
         POPT_TABLEEND
     };
 
@@ -472,6 +595,9 @@ main(int argc, const char *argv[])
         case 'k':
             rm_ccache = false;
             break;
+        case 'p':
+            pool = true;
+            break;
         default:
             DEBUG(SSSDBG_FATAL_FAILURE, ("Unexpected option\n"));
             return 1;
@@ -526,24 +652,12 @@ main(int argc, const char *argv[])
         goto done;
     }
 
-    req = handle_child_send(ctx, ctx->ev, ctx->kr);
-    if (!req) {
-        DEBUG(SSSDBG_FATAL_FAILURE, ("Cannot create child request\n"));
-        ret = 4;
-        goto done;
-    }
-    tevent_req_set_callback(req, child_done, ctx);
-
-    while (ctx->done == false) {
-         tevent_loop_once(ctx->ev);
+    if (pool) {
+        ret = run_pool_test(ctx);
+    } else {
+        ret = run_child(ctx);
     }
-
-    printf("Child returned %d\n", ctx->child_ret);
-
-    ret = parse_krb5_child_response(ctx, ctx->buf, ctx->len,
-                                    ctx->kr->pd, 0, &ctx->res);
     if (ret != EOK) {
-        DEBUG(SSSDBG_FATAL_FAILURE, ("Could not parse child response\n"));
         ret = 5;
         goto done;
     }
@@ -718,6 +718,67 @@ START_TEST(test_compare_principal_realm)
 }
 END_TEST
 
+START_TEST(test_copy_ccache)
+{
+    krb5_error_code kerr;
+    krb5_context ctx;
+    krb5_ccache src_cc;
+    krb5_ccache dst_cc;
+    krb5_principal client;
+    krb5_creds creds;
+    krb5_creds mcreds;
+    krb5_creds out;
+    errno_t ret;
+
+    kerr = krb5_init_context(&ctx);
+    fail_unless(kerr == 0, "krb5_init_context failed.");
+
+    kerr = krb5_parse_name(ctx, "host/client.example.com@EXAMPLE.COM",
+                           &client);
+    fail_unless(kerr == 0, "krb5_parse_name failed.");
+
+    memset(&creds, 0, sizeof(creds));
+    creds.client = client;
+    kerr = krb5_parse_name(ctx, "ldap/server.example.com@EXAMPLE.COM",
+                           &creds.server);
+    fail_unless(kerr == 0, "krb5_parse_name failed.");
+    creds.times.endtime = time(NULL) + 3600;
+
+    kerr = krb5_cc_resolve(ctx, "MEMORY:copy_ccache_src", &src_cc);
+    fail_unless(kerr == 0, "krb5_cc_resolve failed.");
+    kerr = krb5_cc_initialize(ctx, src_cc, client);
+    fail_unless(kerr == 0, "krb5_cc_initialize failed.");
+    kerr = krb5_cc_store_cred(ctx, src_cc, &creds);
+    fail_unless(kerr == 0, "krb5_cc_store_cred failed.");
+
+    ret = sss_krb5_copy_ccache("MEMORY:copy_ccache_src",
+                               "MEMORY:copy_ccache_dst");
+    fail_unless(ret == EOK, "sss_krb5_copy_ccache failed [%d].", ret);
+
+    kerr = krb5_cc_resolve(ctx, "MEMORY:copy_ccache_dst", &dst_cc);
+    fail_unless(kerr == 0, "krb5_cc_resolve failed.");
+
+    memset(&mcreds, 0, sizeof(mcreds));
+    mcreds.client = client;
+    mcreds.server = creds.server;
+    kerr = krb5_cc_retrieve_cred(ctx, dst_cc, 0, &mcreds, &out);
+    fail_unless(kerr == 0, "Service ticket was not copied.");
+    fail_unless(out.times.endtime == creds.times.endtime,
+                "Unexpected end time [%d], expected [%d].",
+                out.times.endtime, creds.times.endtime);
+    krb5_free_cred_contents(ctx, &out);
+
+    ret = sss_krb5_copy_ccache("MEMORY:copy_ccache_empty",
+                               "MEMORY:copy_ccache_dst");
+    fail_unless(ret != EOK, "Copying an empty ccache succeeded.");
+
+    krb5_cc_destroy(ctx, dst_cc);
+    krb5_cc_destroy(ctx, src_cc);
+    krb5_free_cred_contents(ctx, &creds);
+    krb5_free_context(ctx);
+}
+END_TEST
+
 Suite *krb5_utils_suite (void)
 {
     Suite *s = suite_create ("krb5_utils");
@@ -760,6 +821,7 @@ Suite *krb5_utils_suite (void)
 
     TCase *tc_krb5_helpers = tcase_create("Helper functions");
     tcase_add_test(tc_krb5_helpers, test_compare_principal_realm);
+    tcase_add_test(tc_krb5_helpers, test_copy_ccache);
     suite_add_tcase(s, tc_krb5_helpers);
 
     return s;
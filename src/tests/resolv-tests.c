@@ -557,6 +557,88 @@ START_TEST(test_resolv_internet)
 }
 END_TEST
 
+static void test_cached(struct tevent_req *req)
+{
+    int recv_status;
+    int status;
+    struct resolv_hostent *rhostent = NULL;
+    struct resolv_test_ctx *test_ctx;
+
+    test_ctx = tevent_req_callback_data(req, struct resolv_test_ctx);
+    test_ctx->done = true;
+
+    recv_status = resolv_gethostbyname_recv(req, test_ctx,
+                                            &status, NULL, &rhostent);
+    talloc_zfree(req);
+    if (recv_status != EOK) {
+        test_ctx->error = status;
+        return;
+    }
+
+    test_ctx->error = (rhostent == NULL ||
+                       rhostent->addr_list[0] == NULL) ? ENOENT : EOK;
+    if (test_ctx->error == EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("Got address with TTL %d\n",
+                                  rhostent->addr_list[0]->ttl));
+    }
+    talloc_free(rhostent);
+}
+
+static int test_resolv_cached_lookup(struct resolv_test_ctx *test_ctx,
+                                     const char *hostname)
+{
+    struct tevent_req *req;
+
+    test_ctx->done = false;
+    test_ctx->error = EOK;
+
+    req = resolv_gethostbyname_send(test_ctx, test_ctx->ev,
+                                    test_ctx->resolv, hostname, IPV4_FIRST,
+                                    default_host_dbs);
+    if (req == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(req, test_cached, test_ctx);
+    return test_loop(test_ctx);
+}
+
+START_TEST(test_resolv_cache)
+{
+    int ret;
+    struct resolv_test_ctx *test_ctx;
+
+    ret = setup_resolv_test(RESOLV_DEFAULT_TIMEOUT, &test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up test");
+        return;
+    }
+
+    ret = resolv_cache_init(test_ctx->resolv, 300, 15, 0);
+    fail_unless(ret == EOK, "Could not enable the cache");
+
+    ck_leaks_push(test_ctx);
+
+    /* The first lookup fills the cache, the second one is answered
+     * from it */
+    ret = test_resolv_cached_lookup(test_ctx, "redhat.com");
+    fail_unless(ret == EOK, "Lookup failed: %d", ret);
+    ret = test_resolv_cached_lookup(test_ctx, "redhat.com");
+    fail_unless(ret == EOK, "Cached lookup failed: %d", ret);
+
+    /* Negative answers are cached, too */
+    ret = test_resolv_cached_lookup(test_ctx, "sssd.foo");
+    fail_unless(ret == ARES_ENOTFOUND, "Unexpected status: %d", ret);
+    ret = test_resolv_cached_lookup(test_ctx, "sssd.foo");
+    fail_unless(ret == ARES_ENOTFOUND, "Unexpected cached status: %d", ret);
+
+    resolv_cache_flush(test_ctx->resolv);
+    ck_leaks_pop(test_ctx);
+
+    talloc_zfree(test_ctx);
+}
+END_TEST
+
 START_TEST(test_resolv_internet_txt)
 {
     int ret;
@@ -902,6 +984,7 @@ Suite *create_resolv_suite(void)
         tcase_add_test(tc_resolv, test_resolv_negative);
         tcase_add_test(tc_resolv, test_resolv_localhost);
         tcase_add_test(tc_resolv, test_resolv_timeout);
+        tcase_add_test(tc_resolv, test_resolv_cache);
         if (txt_host != NULL) {
             tcase_add_test(tc_resolv, test_resolv_internet_txt);
         }
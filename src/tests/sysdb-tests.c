@@ -1897,6 +1897,179 @@ START_TEST (test_sysdb_cached_authentication)
 }
 END_TEST
 
+static uint32_t cached_failed_login_attempts(struct sysdb_test_ctx *test_ctx,
+                                             const char *username)
+{
+    const char *attrs[] = { SYSDB_FAILED_LOGIN_ATTEMPTS, NULL };
+    struct ldb_message *msg;
+    uint32_t attempts;
+    int ret;
+
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->sysdb,
+                                    test_ctx->domain, username, attrs, &msg);
+    fail_unless(ret == EOK, "sysdb_search_user_by_name failed [%d].", ret);
+
+    attempts = ldb_msg_find_attr_as_uint(msg, SYSDB_FAILED_LOGIN_ATTEMPTS, 0);
+    talloc_free(msg);
+    return attempts;
+}
+
+START_TEST (test_sysdb_cached_authentication_delayed_write)
+{
+    struct sysdb_test_ctx *test_ctx;
+    const char *val[2] = { "0", NULL };
+    char *username;
+    int ret;
+
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_unless(ret == EOK, "Could not set up the test");
+
+    username = talloc_asprintf(test_ctx, "testuser%d", _i);
+    fail_unless(username != NULL, "talloc_asprintf failed.");
+
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_CRED_TIMEOUT, val);
+    fail_unless(ret == EOK, "Could not initialize provider");
+
+    ret = sysdb_cache_auth_set_write_delay(test_ctx->sysdb, test_ctx->ev, 60);
+    fail_unless(ret == EOK, "sysdb_cache_auth_set_write_delay failed [%d].",
+                ret);
+
+    /* Remember the verifier of the right password */
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           username, test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == EOK, "Cached authentication failed [%d].", ret);
+
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+
+    fail_unless(cached_failed_login_attempts(test_ctx, username) == 0,
+                "Failed login attempts were written before the delay.");
+
+    ret = sysdb_cache_auth_flush(test_ctx->sysdb);
+    fail_unless(ret == EOK, "sysdb_cache_auth_flush failed [%d].", ret);
+    fail_unless(cached_failed_login_attempts(test_ctx, username) == 2,
+                "Failed login attempts were not written.");
+
+    /* Answered from the verifier */
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           username, test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == EOK, "Cached authentication failed [%d].", ret);
+
+    /* The verifier must not outlive the cached password */
+    ret = sysdb_cache_password(test_ctx->sysdb, test_ctx->domain,
+                               username, "new_password");
+    fail_unless(ret == EOK, "sysdb_cache_password request failed [%d].", ret);
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           username, test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Old password accepted [%d].", ret);
+
+    ret = sysdb_cache_auth_set_write_delay(test_ctx->sysdb, NULL, 0);
+    fail_unless(ret == EOK, "sysdb_cache_auth_set_write_delay failed [%d].",
+                ret);
+    fail_unless(cached_failed_login_attempts(test_ctx, username) == 1,
+                "Pending login information was not written.");
+
+    ret = sysdb_cache_password(test_ctx->sysdb, test_ctx->domain,
+                               username, username);
+    fail_unless(ret == EOK, "sysdb_cache_password request failed [%d].", ret);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+static void set_cached_auth_time(struct sysdb_test_ctx *test_ctx,
+                                 const char *username,
+                                 const char *attr, time_t value)
+{
+    struct sysdb_attrs *attrs;
+    int ret;
+
+    attrs = sysdb_new_attrs(test_ctx);
+    fail_unless(attrs != NULL, "sysdb_new_attrs failed.");
+
+    ret = sysdb_attrs_add_time_t(attrs, attr, value);
+    fail_unless(ret == EOK, "sysdb_attrs_add_time_t failed [%d].", ret);
+
+    ret = sysdb_set_user_attr(test_ctx->sysdb, test_ctx->domain, username,
+                              attrs, SYSDB_MOD_REP);
+    fail_unless(ret == EOK, "sysdb_set_user_attr failed [%d].", ret);
+    talloc_free(attrs);
+}
+
+START_TEST (test_sysdb_cached_authentication_delayed_reset)
+{
+    struct sysdb_test_ctx *test_ctx;
+    const char *val[2] = { "0", NULL };
+    char *username;
+    int ret;
+
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_unless(ret == EOK, "Could not set up the test");
+
+    username = talloc_asprintf(test_ctx, "testuser%d", _i);
+    fail_unless(username != NULL, "talloc_asprintf failed.");
+
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_CRED_TIMEOUT, val);
+    fail_unless(ret == EOK, "Could not initialize provider");
+
+    ret = sysdb_cache_auth_set_write_delay(test_ctx->sysdb, test_ctx->ev, 60);
+    fail_unless(ret == EOK, "sysdb_cache_auth_set_write_delay failed [%d].",
+                ret);
+
+    /* Make sure caching the password below changes its timestamp */
+    set_cached_auth_time(test_ctx, username, "lastCachedPasswordChange", 1);
+    set_cached_auth_time(test_ctx, username, SYSDB_LAST_ONLINE_AUTH, 1);
+
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+
+    /* Caching the password resets the counter, the pending failed
+     * attempt must not be written over it */
+    ret = sysdb_cache_password(test_ctx->sysdb, test_ctx->domain,
+                               username, username);
+    fail_unless(ret == EOK, "sysdb_cache_password request failed [%d].", ret);
+
+    ret = sysdb_cache_auth_flush(test_ctx->sysdb);
+    fail_unless(ret == EOK, "sysdb_cache_auth_flush failed [%d].", ret);
+    fail_unless(cached_failed_login_attempts(test_ctx, username) == 0,
+                "Pending failed login attempts overwrote the reset.");
+
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+
+    /* An online authentication resets the counter as well, the next
+     * failed attempt must count from the reset */
+    set_cached_auth_time(test_ctx, username, SYSDB_LAST_ONLINE_AUTH, 2);
+
+    ret = sysdb_cache_auth(test_ctx->sysdb, test_ctx->domain, username,
+                           "abc", test_ctx->confdb, false, NULL, NULL);
+    fail_unless(ret == ERR_AUTH_FAILED, "Wrong password accepted [%d].", ret);
+
+    ret = sysdb_cache_auth_set_write_delay(test_ctx->sysdb, NULL, 0);
+    fail_unless(ret == EOK, "sysdb_cache_auth_set_write_delay failed [%d].",
+                ret);
+    fail_unless(cached_failed_login_attempts(test_ctx, username) == 1,
+                "Failed login attempts were not counted from the reset.");
+
+    ret = sysdb_cache_password(test_ctx->sysdb, test_ctx->domain,
+                               username, username);
+    fail_unless(ret == EOK, "sysdb_cache_password request failed [%d].", ret);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_prepare_asq_test_user)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -4991,6 +5164,10 @@ Suite *create_sysdb_suite(void)
     tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication_wrong_password,
                         27010, 27011);
     tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication, 27010, 27011);
+    tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication_delayed_write,
+                        27010, 27011);
+    tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication_delayed_reset,
+                        27010, 27011);
 
     /* ASQ search test */
     tcase_add_loop_test(tc_sysdb, test_sysdb_prepare_asq_test_user, 28011, 28020);
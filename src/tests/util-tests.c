@@ -31,6 +31,7 @@
 #include "util/util.h"
 #include "util/sss_utf8.h"
 #include "util/murmurhash3.h"
+#include "util/sss_stats.h"
 #include "tests/common_check.h"
 
 #define FILENAME_TEMPLATE "tests-atomicio-XXXXXX"
@@ -319,6 +320,43 @@ START_TEST(test_diff_string_lists)
 }
 END_TEST
 
+START_TEST(test_get_missing_names)
+{
+    TALLOC_CTX *test_ctx;
+    const char *names[] = { "alice", "Bob", "carol", NULL };
+    const char *found[] = { "ALICE", "bob", NULL };
+    const char **missing;
+    int ret;
+
+    test_ctx = talloc_new(NULL);
+
+    /* Only carol was not returned */
+    ret = sss_get_missing_names(test_ctx, names, found, false, &missing);
+    fail_unless(ret == EOK, "sss_get_missing_names returned error [%d]", ret);
+    fail_unless(missing[0] == names[2], "Missing \"carol\" from missing");
+    fail_unless(missing[1] == NULL, "missing not NULL-terminated");
+    talloc_zfree(missing);
+
+    /* In a case sensitive domain nothing matches */
+    ret = sss_get_missing_names(test_ctx, names, found, true, &missing);
+    fail_unless(ret == EOK, "sss_get_missing_names returned error [%d]", ret);
+    fail_unless(missing[0] == names[0], "Missing \"alice\" from missing");
+    fail_unless(missing[1] == names[1], "Missing \"Bob\" from missing");
+    fail_unless(missing[2] == names[2], "Missing \"carol\" from missing");
+    fail_unless(missing[3] == NULL, "missing not NULL-terminated");
+    talloc_zfree(missing);
+
+    /* Nothing found at all */
+    ret = sss_get_missing_names(test_ctx, names, NULL, false, &missing);
+    fail_unless(ret == EOK, "sss_get_missing_names returned error [%d]", ret);
+    fail_unless(missing[0] == names[0] && missing[1] == names[1] &&
+                missing[2] == names[2] && missing[3] == NULL,
+                "Expected all names to be missing");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 
 START_TEST(test_sss_filter_sanitize)
 {
@@ -808,6 +846,64 @@ START_TEST(test_split_on_separator)
 }
 END_TEST
 
+static char *test_sss_stats_section(TALLOC_CTX *mem_ctx)
+{
+    return talloc_strdup(mem_ctx, "test section\n");
+}
+
+START_TEST(test_sss_stats)
+{
+    TALLOC_CTX *mem;
+    char *dump;
+    const char *expected;
+
+    mem = talloc_new(NULL);
+    fail_unless(mem != NULL, "talloc_new failed.");
+
+    sss_stats_reset();
+
+    sss_stats_add("test_op", 50, false);
+    sss_stats_add("test_op", 500, false);
+    sss_stats_add("test_op", 20000000, true);
+    sss_stats_inc("test_counter");
+    sss_stats_inc("test_counter");
+
+    dump = sss_stats_dump(mem);
+    fail_unless(dump != NULL, "sss_stats_dump failed.");
+
+    /* count, failed, average, maximum and one call in each used bucket */
+    expected = "test_op                          3       1   6666850  20000000"
+               "        1        1        0        0        0        0"
+               "        1\n";
+    fail_unless(strstr(dump, expected) != NULL,
+                "Unexpected timer line in [%s].", dump);
+
+    expected = "test_counter                     2\n";
+    fail_unless(strstr(dump, expected) != NULL,
+                "Unexpected counter line in [%s].", dump);
+
+    sss_stats_reset();
+    dump = sss_stats_dump(mem);
+    fail_unless(dump != NULL, "sss_stats_dump failed.");
+    fail_unless(strstr(dump, "test_op") == NULL,
+                "Reset did not drop the timers [%s].", dump);
+
+    /* adding the same section twice shows it once */
+    fail_unless(sss_stats_add_section(test_sss_stats_section) == EOK,
+                "sss_stats_add_section failed.");
+    fail_unless(sss_stats_add_section(test_sss_stats_section) == EOK,
+                "sss_stats_add_section failed.");
+    dump = sss_stats_dump(mem);
+    fail_unless(dump != NULL, "sss_stats_dump failed.");
+    expected = strstr(dump, "test section\n");
+    fail_unless(expected != NULL, "Section missing in [%s].", dump);
+    fail_unless(strstr(expected + 1, "test section\n") == NULL,
+                "Section repeated in [%s].", dump);
+
+    talloc_free(mem);
+}
+END_TEST
+
 Suite *util_suite(void)
 {
     Suite *s = suite_create("util");
@@ -818,12 +914,14 @@ Suite *util_suite(void)
                               ck_leak_check_setup,
                               ck_leak_check_teardown);
     tcase_add_test (tc_util, test_diff_string_lists);
+    tcase_add_test (tc_util, test_get_missing_names);
     tcase_add_test (tc_util, test_sss_filter_sanitize);
     tcase_add_test (tc_util, test_size_t_overflow);
     tcase_add_test (tc_util, test_parse_args);
     tcase_add_test (tc_util, test_add_string_to_list);
     tcase_add_test (tc_util, test_string_in_list);
     tcase_add_test (tc_util, test_split_on_separator);
+    tcase_add_test (tc_util, test_sss_stats);
     tcase_set_timeout(tc_util, 60);
 
     TCase *tc_utf8 = tcase_create("utf8");
@@ -0,0 +1,203 @@
+/*
+    SSSD
+
+    sss_stats
+
+    Prints the request statistics of the running SSSD services
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <talloc.h>
+#include <popt.h>
+#include <security/pam_appl.h>
+
+#include "config.h"
+#include "util/util.h"
+#include "tools/tools_util.h"
+#include "sss_client/sss_cli.h"
+
+typedef int (*sss_stats_make_request_fn)(enum sss_cli_command cmd,
+                                         struct sss_cli_req_data *rd,
+                                         uint8_t **repbuf, size_t *replen,
+                                         int *errnop);
+
+static int sss_stats_nss_make_request(enum sss_cli_command cmd,
+                                      struct sss_cli_req_data *rd,
+                                      uint8_t **repbuf, size_t *replen,
+                                      int *errnop)
+{
+    return sss_nss_make_request(cmd, rd, repbuf, replen, errnop)
+                == NSS_STATUS_SUCCESS ? SSS_STATUS_SUCCESS
+                                      : SSS_STATUS_UNAVAIL;
+}
+
+static int sss_stats_pam_make_request(enum sss_cli_command cmd,
+                                      struct sss_cli_req_data *rd,
+                                      uint8_t **repbuf, size_t *replen,
+                                      int *errnop)
+{
+    return sss_pam_make_request(cmd, rd, repbuf, replen, errnop)
+                == PAM_SUCCESS ? SSS_STATUS_SUCCESS : SSS_STATUS_UNAVAIL;
+}
+
+static int sss_stats_pac_make_request(enum sss_cli_command cmd,
+                                      struct sss_cli_req_data *rd,
+                                      uint8_t **repbuf, size_t *replen,
+                                      int *errnop)
+{
+    return sss_pac_make_request(cmd, rd, repbuf, replen, errnop)
+                == NSS_STATUS_SUCCESS ? SSS_STATUS_SUCCESS
+                                      : SSS_STATUS_UNAVAIL;
+}
+
+static struct {
+    const char *name;
+    sss_stats_make_request_fn make_request;
+} sss_stats_responders[] = {
+    { "nss", sss_stats_nss_make_request },
+    { "pam", sss_stats_pam_make_request },
+    { "sudo", sss_sudo_make_request },
+    { "autofs", sss_autofs_make_request },
+    { "ssh", sss_ssh_make_request },
+    { "pac", sss_stats_pac_make_request },
+    { NULL, NULL }
+};
+
+static errno_t print_stats(int idx)
+{
+    struct sss_cli_req_data rd;
+    uint8_t *repbuf = NULL;
+    size_t replen = 0;
+    int errnop = 0;
+    int ret;
+
+    rd.len = 0;
+    rd.data = NULL;
+
+    ret = sss_stats_responders[idx].make_request(SSS_GET_STATS, &rd,
+                                                 &repbuf, &replen, &errnop);
+
+    /* every responder listens on its own socket */
+    sss_pam_close_fd();
+
+    if (ret != SSS_STATUS_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Cannot get the statistics of [%s] [%d]: %s\n",
+               sss_stats_responders[idx].name, errnop, strerror(errnop)));
+        free(repbuf);
+        return errnop ? errnop : EIO;
+    }
+
+    if (replen == 0 || repbuf[replen - 1] != '\0') {
+        DEBUG(SSSDBG_OP_FAILURE, ("Malformed reply from [%s]\n",
+                                  sss_stats_responders[idx].name));
+        free(repbuf);
+        return EBADMSG;
+    }
+
+    printf("==== %s ====\n%s\n", sss_stats_responders[idx].name,
+           (const char *) repbuf);
+    free(repbuf);
+
+    return EOK;
+}
+
+int main(int argc, const char **argv)
+{
+    int ret;
+    int i;
+    int printed = 0;
+    int pc_debug = SSSDBG_DEFAULT;
+    const char *pc_responder = NULL;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        {"debug", '\0', POPT_ARG_INT | POPT_ARGFLAG_DOC_HIDDEN, &pc_debug,
+            0, _("The debug level to run with"), NULL },
+        POPT_TABLEEND
+    };
+    poptContext pc = NULL;
+
+    debug_prg_name = argv[0];
+
+    /* parse parameters */
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    poptSetOtherOptionHelp(pc, "[RESPONDER]");
+    while((ret = poptGetNextOpt(pc)) != -1) {
+        switch(ret) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(ret));
+            poptPrintUsage(pc, stderr, 0);
+            ret = EXIT_FAILURE;
+            goto fini;
+        }
+    }
+    DEBUG_INIT(pc_debug);
+
+    pc_responder = poptGetArg(pc);
+
+    /* No more arguments expected. If something follows it is an error. */
+    if (poptGetArg(pc)) {
+        BAD_POPT_PARAMS(pc, _("Only one argument expected\n"),
+                        ret, fini);
+    }
+
+    if (pc_responder != NULL) {
+        for (i = 0; sss_stats_responders[i].name != NULL; i++) {
+            if (strcmp(sss_stats_responders[i].name, pc_responder) == 0) {
+                break;
+            }
+        }
+        if (sss_stats_responders[i].name == NULL) {
+            BAD_POPT_PARAMS(pc, _("Unknown responder\n"), ret, fini);
+        }
+    }
+
+    CHECK_ROOT(ret, debug_prg_name);
+
+    for (i = 0; sss_stats_responders[i].name != NULL; i++) {
+        if (pc_responder != NULL
+                && strcmp(sss_stats_responders[i].name, pc_responder) != 0) {
+            continue;
+        }
+
+        ret = print_stats(i);
+        if (ret == EOK) {
+            printed++;
+        } else if (pc_responder != NULL) {
+            ERROR("Cannot get the statistics of %1$s: %2$s\n",
+                  pc_responder, strerror(ret));
+        }
+    }
+
+    if (printed == 0) {
+        if (pc_responder == NULL) {
+            ERROR("No running SSSD service returned its statistics\n");
+        }
+        ret = EXIT_FAILURE;
+        goto fini;
+    }
+
+    ret = EXIT_SUCCESS;
+
+fini:
+    poptFreeContext(pc);
+    return ret;
+}
@@ -24,6 +24,8 @@
 
 #include <sys/types.h>
 #include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
 #include <tevent.h>
 #include <sys/wait.h>
 #include <errno.h>
@@ -33,6 +35,8 @@
 #include "db/sysdb.h"
 #include "util/child_common.h"
 
+extern char **environ;
+
 struct sss_sigchild_ctx {
     struct tevent_context *ev;
     hash_table_t *children;
@@ -587,6 +591,7 @@ static void child_invoke_callback(struct tevent_context *ev,
 static errno_t prepare_child_argv(TALLOC_CTX *mem_ctx,
                                   int child_debug_fd,
                                   const char *binary,
+                                  const char **extra_args,
                                   char ***_argv)
 {
     /*
@@ -594,6 +599,7 @@ static errno_t prepare_child_argv(TALLOC_CTX *mem_ctx,
      * debug_microseconds and NULL
      */
     uint_t argc = 5;
+    uint_t extra_argc = 0;
     char ** argv;
     errno_t ret = EINVAL;
 
@@ -604,9 +610,14 @@ static errno_t prepare_child_argv(TALLOC_CTX *mem_ctx,
 
     if (child_debug_to_file) argc++;
 
+    if (extra_args != NULL) {
+        while (extra_args[extra_argc] != NULL) extra_argc++;
+        argc += extra_argc;
+    }
+
     /*
      * program name, debug_level, debug_to_file, debug_timestamps,
-     * debug_microseconds and NULL
+     * debug_microseconds, extra arguments and NULL
      */
     argv  = talloc_array(mem_ctx, char *, argc);
     if (argv == NULL) {
@@ -616,6 +627,15 @@ static errno_t prepare_child_argv(TALLOC_CTX *mem_ctx,
 
     argv[--argc] = NULL;
 
+    while (extra_argc > 0) {
+        extra_argc--;
+        argv[--argc] = talloc_strdup(argv, extra_args[extra_argc]);
+        if (argv[argc] == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+    }
+
     argv[--argc] = talloc_asprintf(argv, "--debug-level=%#.4x",
                               debug_level);
     if (argv[argc] == NULL) {
@@ -666,41 +686,120 @@ fail:
     return ret;
 }
 
-errno_t exec_child(TALLOC_CTX *mem_ctx,
-                   int *pipefd_to_child, int *pipefd_from_child,
-                   const char *binary, int debug_fd)
+errno_t sss_spawn(const char *binary, char * const *argv,
+                  int *pipefd_to_child, int *pipefd_from_child,
+                  uint32_t flags, pid_t *_pid)
 {
-    int ret;
-    errno_t err;
-    char **argv;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t sigmask;
+    short attr_flags = POSIX_SPAWN_SETSIGMASK;
+    pid_t pid;
+    errno_t ret;
 
-    close(pipefd_to_child[1]);
-    ret = dup2(pipefd_to_child[0], STDIN_FILENO);
-    if (ret == -1) {
-        err = errno;
-        DEBUG(1, ("dup2 failed [%d][%s].\n", err, strerror(err)));
-        return err;
+    ret = posix_spawn_file_actions_init(&actions);
+    if (ret != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("posix_spawn_file_actions_init failed [%d][%s].\n",
+               ret, strerror(ret)));
+        return ret;
     }
 
-    close(pipefd_from_child[0]);
-    ret = dup2(pipefd_from_child[1], STDOUT_FILENO);
-    if (ret == -1) {
-        err = errno;
-        DEBUG(1, ("dup2 failed [%d][%s].\n", err, strerror(err)));
-        return err;
+    ret = posix_spawnattr_init(&attr);
+    if (ret != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("posix_spawnattr_init failed [%d][%s].\n",
+               ret, strerror(ret)));
+        posix_spawn_file_actions_destroy(&actions);
+        return ret;
+    }
+
+    /* The file actions are applied in the child in the order they were
+     * added, this mirrors what the fork() based code used to do by hand. */
+    if (pipefd_to_child != NULL) {
+        ret = posix_spawn_file_actions_addclose(&actions, pipefd_to_child[1]);
+        if (ret != 0) goto done;
+        ret = posix_spawn_file_actions_adddup2(&actions, pipefd_to_child[0],
+                                               STDIN_FILENO);
+        if (ret != 0) goto done;
+        if (pipefd_to_child[0] != STDIN_FILENO) {
+            ret = posix_spawn_file_actions_addclose(&actions,
+                                                    pipefd_to_child[0]);
+            if (ret != 0) goto done;
+        }
+    }
+
+    if (pipefd_from_child != NULL) {
+        ret = posix_spawn_file_actions_addclose(&actions,
+                                                pipefd_from_child[0]);
+        if (ret != 0) goto done;
+        ret = posix_spawn_file_actions_adddup2(&actions, pipefd_from_child[1],
+                                               STDOUT_FILENO);
+        if (ret != 0) goto done;
+        if (pipefd_from_child[1] != STDOUT_FILENO) {
+            ret = posix_spawn_file_actions_addclose(&actions,
+                                                    pipefd_from_child[1]);
+            if (ret != 0) goto done;
+        }
+    }
+
+    /* Do not let the child inherit signals blocked by the parent */
+    sigemptyset(&sigmask);
+    ret = posix_spawnattr_setsigmask(&attr, &sigmask);
+    if (ret != 0) goto done;
+
+    if (flags & SSS_SPAWN_NEW_PGROUP) {
+        attr_flags |= POSIX_SPAWN_SETPGROUP;
+        ret = posix_spawnattr_setpgroup(&attr, 0);
+        if (ret != 0) goto done;
+    }
+
+#ifdef POSIX_SPAWN_USEVFORK
+    /* Older glibc versions only avoid copying the page tables of the
+     * parent when asked to. Newer ones always do and ignore the flag. */
+    attr_flags |= POSIX_SPAWN_USEVFORK;
+#endif
+
+    ret = posix_spawnattr_setflags(&attr, attr_flags);
+    if (ret != 0) goto done;
+
+    ret = posix_spawn(&pid, binary, &actions, &attr, argv, environ);
+    if (ret != 0) goto done;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("Spawned [%s] as [%d].\n", binary, pid));
+    *_pid = pid;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Cannot spawn [%s] [%d][%s].\n", binary, ret, strerror(ret)));
     }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return ret;
+}
+
+errno_t spawn_child(TALLOC_CTX *mem_ctx,
+                    int *pipefd_to_child, int *pipefd_from_child,
+                    const char *binary, int debug_fd,
+                    const char **extra_args, uint32_t flags,
+                    pid_t *_pid)
+{
+    errno_t ret;
+    char **argv;
 
     ret = prepare_child_argv(mem_ctx, debug_fd,
-                             binary, &argv);
+                             binary, extra_args, &argv);
     if (ret != EOK) {
         DEBUG(1, ("prepare_child_argv.\n"));
         return ret;
     }
 
-    execv(binary, argv);
-    err = errno;
-    DEBUG(SSSDBG_OP_FAILURE, ("execv failed [%d][%s].\n", err, strerror(err)));
-    return err;
+    ret = sss_spawn(binary, argv, pipefd_to_child, pipefd_from_child,
+                    flags, _pid);
+    talloc_free(argv);
+    return ret;
 }
 
 void child_cleanup(int readfd, int writefd)
@@ -100,10 +100,25 @@ void child_sig_handler(struct tevent_context *ev,
                        struct tevent_signal *sige, int signum,
                        int count, void *__siginfo, void *pvt);
 
-/* Never returns EOK, ether returns an error, or doesn't return on success */
-errno_t exec_child(TALLOC_CTX *mem_ctx,
-                   int *pipefd_to_child, int *pipefd_from_child,
-                   const char *binary, int debug_fd);
+/* Put the child into a process group of its own */
+#define SSS_SPAWN_NEW_PGROUP    0x0001
+
+/* Start binary with posix_spawn(). Unlike fork() this does not copy the
+ * page tables of the (potentially large) parent. If given, the read end
+ * of pipefd_to_child becomes stdin and the write end of pipefd_from_child
+ * becomes stdout of the child, the other ends are closed in the child.
+ * The caller is responsible for closing its own unused ends. */
+errno_t sss_spawn(const char *binary, char * const *argv,
+                  int *pipefd_to_child, int *pipefd_from_child,
+                  uint32_t flags, pid_t *_pid);
+
+/* Spawn one of the SSSD helper binaries with the common debug options
+ * followed by the NULL terminated list extra_args (which may be NULL) */
+errno_t spawn_child(TALLOC_CTX *mem_ctx,
+                    int *pipefd_to_child, int *pipefd_from_child,
+                    const char *binary, int debug_fd,
+                    const char **extra_args, uint32_t flags,
+                    pid_t *_pid);
 
 void child_cleanup(int readfd, int writefd);
 
@@ -25,6 +25,10 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <signal.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -38,6 +42,7 @@ int debug_level = SSSDBG_UNRESOLVED;
 int debug_timestamps = SSSDBG_TIMESTAMP_UNRESOLVED;
 int debug_microseconds = SSSDBG_MICROSECONDS_UNRESOLVED;
 int debug_to_file = 0;
+int debug_ring_level = 0;
 const char *debug_log_file = "sssd";
 FILE *debug_file = NULL;
 
@@ -104,16 +109,676 @@ int debug_convert_old_level(int old_level)
     return new_level;
 }
 
+/* ==================  Message prefix ================== */
+
+/*
+ * The DEBUG macros first store the message prefix here and the following
+ * debug_fn() call writes it together with the message, so that both end up
+ * in the log in one piece.
+ */
+#define DEBUG_PREFIX_LEN 256
+static char debug_prefix_buf[DEBUG_PREFIX_LEN];
+static size_t debug_prefix_len = 0;
+
+/* localtime() checks the timezone on every call, only do it once a second */
+static const char *debug_datetime(time_t sec, int *year)
+{
+    static time_t cached_sec = (time_t) -1;
+    static char datetime[26];
+    static int cached_year;
+    struct tm tm;
+
+    if (sec != cached_sec) {
+        localtime_r(&sec, &tm);
+        asctime_r(&tm, datetime);
+        datetime[19] = '\0';
+        cached_year = tm.tm_year + 1900;
+        cached_sec = sec;
+    }
+
+    *year = cached_year;
+    return datetime;
+}
+
+static void debug_format_prefix(const struct timeval *tv,
+                                const char *function, int level)
+{
+    const char *datetime;
+    int year;
+    int len;
+
+    if (debug_timestamps) {
+        datetime = debug_datetime(tv->tv_sec, &year);
+        if (debug_microseconds) {
+            len = snprintf(debug_prefix_buf, DEBUG_PREFIX_LEN,
+                           "(%s:%.6d %d) [%s] [%s] (%#.4x): ",
+                           datetime, (int) tv->tv_usec, year,
+                           debug_prg_name, function, level);
+        } else {
+            len = snprintf(debug_prefix_buf, DEBUG_PREFIX_LEN,
+                           "(%s %d) [%s] [%s] (%#.4x): ",
+                           datetime, year, debug_prg_name, function, level);
+        }
+    } else {
+        len = snprintf(debug_prefix_buf, DEBUG_PREFIX_LEN,
+                       "[%s] [%s] (%#.4x): ",
+                       debug_prg_name, function, level);
+    }
+
+    if (len < 0) {
+        len = 0;
+    } else if (len >= DEBUG_PREFIX_LEN) {
+        len = DEBUG_PREFIX_LEN - 1;
+    }
+    debug_prefix_len = len;
+}
+
+void debug_prefix(const char *function, int level)
+{
+    struct timeval tv = { 0, 0 };
+
+    if (debug_timestamps) {
+        gettimeofday(&tv, NULL);
+    }
+    debug_format_prefix(&tv, function, level);
+}
+
+/* ==================  Asynchronous log writer ================== */
+
+/*
+ * With debug_async enabled, debug_fn() only copies the formatted message
+ * into a bounded queue and a separate thread writes it to the log file, so
+ * a slow log disk does not hold up the event loop. Messages that do not fit
+ * in a full queue are dropped and counted, the writer reports the count.
+ */
+
+#define DEBUG_ASYNC_QUEUE_SIZE (1024 * 1024)   /* must be a power of two */
+#define DEBUG_ASYNC_MAX_OLD_FILES 8
+#define DEBUG_ASYNC_MSG_LEN 1024
+
+static bool debug_async_running = false;
+
+#ifdef HAVE_PTHREAD
+static struct debug_async_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+
+    char *buf;
+    size_t head;        /* next byte written by debug_fn() */
+    size_t tail;        /* next byte written to the log */
+    unsigned long dropped;
+
+    int fd;
+    /* rotated files, closed by the writer so that the close does not block
+     * the caller */
+    FILE *old_files[DEBUG_ASYNC_MAX_OLD_FILES];
+    int num_old_files;
+
+    bool stop;
+} debug_async_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+};
+#endif
+
+static void debug_write_fd(int fd, const char *buf, size_t len)
+{
+    ssize_t res;
+
+    while (len > 0) {
+        res = write(fd, buf, len);
+        if (res == -1 && errno == EINTR) continue;
+        if (res <= 0) return;
+        buf += res;
+        len -= res;
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static void debug_async_enqueue(const char *msg, size_t len)
+{
+    struct debug_async_queue *q = &debug_async_queue;
+    size_t off;
+    size_t chunk;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (len > DEBUG_ASYNC_QUEUE_SIZE - (q->head - q->tail)) {
+        q->dropped++;
+        pthread_mutex_unlock(&q->lock);
+        return;
+    }
+
+    off = q->head & (DEBUG_ASYNC_QUEUE_SIZE - 1);
+    chunk = MIN(len, DEBUG_ASYNC_QUEUE_SIZE - off);
+    memcpy(q->buf + off, msg, chunk);
+    memcpy(q->buf, msg + chunk, len - chunk);
+
+    if (q->head == q->tail) {
+        pthread_cond_signal(&q->cond);
+    }
+    q->head += len;
+
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void *debug_async_writer(void *pvt)
+{
+    struct debug_async_queue *q = &debug_async_queue;
+    FILE *old_files[DEBUG_ASYNC_MAX_OLD_FILES];
+    int num_old_files;
+    unsigned long dropped;
+    char notice[128];
+    size_t head;
+    size_t tail;
+    size_t off;
+    size_t chunk;
+    int len;
+    int fd;
+    int i;
+
+    pthread_mutex_lock(&q->lock);
+    while (true) {
+        while (q->head == q->tail && q->dropped == 0
+                && q->num_old_files == 0 && !q->stop) {
+            pthread_cond_wait(&q->cond, &q->lock);
+        }
+
+        if (q->head == q->tail && q->dropped == 0
+                && q->num_old_files == 0) {
+            /* stopped and everything is written */
+            break;
+        }
+
+        head = q->head;
+        tail = q->tail;
+        fd = q->fd;
+        dropped = q->dropped;
+        q->dropped = 0;
+        num_old_files = q->num_old_files;
+        memcpy(old_files, q->old_files, num_old_files * sizeof(FILE *));
+        q->num_old_files = 0;
+
+        /* debug_fn() only writes past head, the bytes up to it are ours */
+        pthread_mutex_unlock(&q->lock);
+
+        for (i = 0; i < num_old_files; i++) {
+            fclose(old_files[i]);
+        }
+
+        while (tail != head) {
+            off = tail & (DEBUG_ASYNC_QUEUE_SIZE - 1);
+            chunk = MIN(head - tail, DEBUG_ASYNC_QUEUE_SIZE - off);
+            debug_write_fd(fd, q->buf + off, chunk);
+            tail += chunk;
+        }
+
+        if (dropped > 0) {
+            len = snprintf(notice, sizeof(notice),
+                           "[%s] ---- %lu debug messages dropped, "
+                           "the log was not written fast enough ----\n",
+                           debug_prg_name, dropped);
+            if (len > 0 && len < sizeof(notice)) {
+                debug_write_fd(fd, notice, len);
+            }
+        }
+
+        pthread_mutex_lock(&q->lock);
+        q->tail = tail;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+/* a forked child only has the thread that called fork(), it writes
+ * directly and leaves what is queued to the parent */
+static void debug_async_atfork_child(void)
+{
+    struct debug_async_queue *q = &debug_async_queue;
+
+    if (!debug_async_running) {
+        return;
+    }
+
+    debug_async_running = false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    q->head = q->tail = 0;
+    q->dropped = 0;
+    q->num_old_files = 0;
+}
+#endif /* HAVE_PTHREAD */
+
+void debug_async_stop(void)
+{
+#ifdef HAVE_PTHREAD
+    struct debug_async_queue *q = &debug_async_queue;
+
+    if (!debug_async_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->stop = true;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->thread, NULL);
+
+    debug_async_running = false;
+    q->stop = false;
+#endif
+}
+
+errno_t debug_async_start(void)
+{
+#ifdef HAVE_PTHREAD
+    struct debug_async_queue *q = &debug_async_queue;
+    static bool registered = false;
+    sigset_t all;
+    sigset_t old;
+    int ret;
+
+    if (debug_async_running) {
+        return EOK;
+    }
+
+    if (q->buf == NULL) {
+        q->buf = malloc(DEBUG_ASYNC_QUEUE_SIZE);
+        if (q->buf == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    if (!registered) {
+        ret = pthread_atfork(NULL, NULL, debug_async_atfork_child);
+        if (ret != 0) {
+            return ret;
+        }
+        if (atexit(debug_async_stop) != 0) {
+            return EIO;
+        }
+        registered = true;
+    }
+
+    q->fd = fileno(debug_file ? debug_file : stderr);
+    q->head = q->tail = 0;
+    q->dropped = 0;
+
+    /* signals, SIGTERM in particular, are handled by the main thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&q->thread, NULL, debug_async_writer, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) {
+        return ret;
+    }
+
+    debug_async_running = true;
+    return EOK;
+#else
+    return ENOTSUP;
+#endif
+}
+
+/* Switches the writer to the current debug_file, old_file is closed by the
+ * writer once it is done with it */
+static errno_t debug_async_switch_file(FILE *old_file)
+{
+#ifdef HAVE_PTHREAD
+    struct debug_async_queue *q = &debug_async_queue;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->num_old_files == DEBUG_ASYNC_MAX_OLD_FILES) {
+        pthread_mutex_unlock(&q->lock);
+        return EBUSY;
+    }
+
+    q->old_files[q->num_old_files++] = old_file;
+    q->fd = fileno(debug_file ? debug_file : stderr);
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    return EOK;
+#else
+    return ENOTSUP;
+#endif
+}
+
 void debug_fn(const char *format, ...)
 {
+    FILE *f = debug_file ? debug_file : stderr;
+    char buf[DEBUG_ASYNC_MSG_LEN];
+    char *msg = NULL;
     va_list ap;
+    int len;
 
     va_start(ap, format);
 
-    vfprintf(debug_file ? debug_file : stderr, format, ap);
-    fflush(debug_file ? debug_file : stderr);
+#ifdef HAVE_PTHREAD
+    if (debug_async_running) {
+        memcpy(buf, debug_prefix_buf, debug_prefix_len);
+        len = vsnprintf(buf + debug_prefix_len,
+                        sizeof(buf) - debug_prefix_len, format, ap);
+        if (len >= 0 && len < sizeof(buf) - debug_prefix_len) {
+            debug_async_enqueue(buf, debug_prefix_len + len);
+        } else if (len >= 0) {
+            /* too long for the stack buffer */
+            va_end(ap);
+            va_start(ap, format);
+            len = vasprintf(&msg, format, ap);
+            if (len >= 0) {
+                debug_async_enqueue(debug_prefix_buf, debug_prefix_len);
+                debug_async_enqueue(msg, len);
+                free(msg);
+            }
+        }
+
+        debug_prefix_len = 0;
+        va_end(ap);
+        return;
+    }
+#endif
+
+    if (debug_prefix_len > 0) {
+        fwrite(debug_prefix_buf, 1, debug_prefix_len, f);
+        debug_prefix_len = 0;
+    }
+    vfprintf(f, format, ap);
+    fflush(f);
+
+    va_end(ap);
+}
+
+/* ==================  In-memory debug ring buffer ================== */
+
+/*
+ * Messages enabled in debug_ring_level but not in debug_level are only
+ * formatted into a fixed array of slots. A slot is reserved with an atomic
+ * increment, so writers never wait for each other, and is marked complete
+ * by storing its sequence number last. The slots are written to the log
+ * when an error is logged, on demand or when the process crashes.
+ */
+
+#define DEBUG_RING_ENTRIES 4096     /* must be a power of two */
+#define DEBUG_RING_MSG_LEN 224
+
+struct debug_ring_entry {
+    unsigned long seq;
+    struct timeval tv;
+    const char *function;
+    int level;
+    char msg[DEBUG_RING_MSG_LEN];
+};
+
+static struct debug_ring_entry *debug_ring = NULL;
+static unsigned long debug_ring_next = 0;
+static unsigned long debug_ring_flushed = 0;
+
+errno_t debug_ring_init(void)
+{
+    if (debug_ring != NULL) {
+        return EOK;
+    }
+
+    debug_ring = calloc(DEBUG_RING_ENTRIES, sizeof(struct debug_ring_entry));
+    if (debug_ring == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+void debug_ring_fn(const char *function, int level, const char *format, ...)
+{
+    struct debug_ring_entry *e;
+    unsigned long seq;
+    va_list ap;
+
+    if (debug_ring == NULL) {
+        return;
+    }
 
+    seq = __sync_fetch_and_add(&debug_ring_next, 1);
+    e = &debug_ring[seq & (DEBUG_RING_ENTRIES - 1)];
+
+    /* invalidate the slot while it is being written */
+    e->seq = 0;
+    __sync_synchronize();
+
+    gettimeofday(&e->tv, NULL);
+    e->function = function;
+    e->level = level;
+
+    va_start(ap, format);
+    vsnprintf(e->msg, DEBUG_RING_MSG_LEN, format, ap);
     va_end(ap);
+
+    __sync_synchronize();
+    e->seq = seq + 1;
+}
+
+void debug_ring_flush(void)
+{
+    struct debug_ring_entry *e;
+    unsigned long start;
+    unsigned long end;
+    unsigned long i;
+    size_t len;
+    bool async;
+
+    if (debug_ring == NULL) {
+        return;
+    }
+
+    end = debug_ring_next;
+    start = debug_ring_flushed;
+    if (end - start > DEBUG_RING_ENTRIES) {
+        start = end - DEBUG_RING_ENTRIES;
+    }
+
+    if (start == end) {
+        return;
+    }
+
+    /* A full ring does not fit in the queue of the log writer. Let the
+     * writer finish what was queued before and write the ring directly. */
+    async = debug_async_running;
+    if (async) {
+        debug_async_stop();
+    }
+
+    debug_fn("[%s] ---- begin of buffered debug messages ----\n",
+             debug_prg_name);
+    for (i = start; i < end; i++) {
+        e = &debug_ring[i & (DEBUG_RING_ENTRIES - 1)];
+        /* skip slots that were reused or are still being written */
+        if (e->seq != i + 1) continue;
+
+        debug_format_prefix(&e->tv, e->function, e->level);
+
+        /* a message cut at the end of the slot lost its newline */
+        len = strlen(e->msg);
+        if (len == 0 || e->msg[len - 1] != '\n') {
+            debug_fn("%s\n", e->msg);
+        } else {
+            debug_fn("%s", e->msg);
+        }
+    }
+    debug_fn("[%s] ---- end of buffered debug messages ----\n",
+             debug_prg_name);
+
+    debug_ring_flushed = end;
+
+    if (async && debug_async_start() != EOK) {
+        /* keep logging synchronously */
+        debug_fn("[%s] Cannot restart the debug log writer\n",
+                 debug_prg_name);
+    }
+}
+
+/* Only async-signal-safe calls from here on, stdio and localtime are not */
+static size_t debug_ring_append(char *buf, size_t pos, size_t size,
+                                const char *str)
+{
+    while (*str != '\0' && pos < size) {
+        buf[pos++] = *str++;
+    }
+    return pos;
+}
+
+static size_t debug_ring_append_num(char *buf, size_t pos, size_t size,
+                                    unsigned long num, unsigned int base,
+                                    unsigned int width)
+{
+    char tmp[24];
+    unsigned int n = 0;
+
+    do {
+        tmp[n++] = "0123456789abcdef"[num % base];
+        num /= base;
+    } while (num > 0 && n < sizeof(tmp));
+
+    while (n < width && n < sizeof(tmp)) {
+        tmp[n++] = '0';
+    }
+
+    while (n > 0 && pos < size) {
+        buf[pos++] = tmp[--n];
+    }
+    return pos;
+}
+
+static void debug_ring_crash_dump(int fd)
+{
+    struct debug_ring_entry *e;
+    char buf[DEBUG_RING_MSG_LEN + 128];
+    unsigned long start;
+    unsigned long end;
+    unsigned long i;
+    size_t pos;
+
+    if (debug_ring == NULL) {
+        return;
+    }
+
+    end = debug_ring_next;
+    start = debug_ring_flushed;
+    if (end - start > DEBUG_RING_ENTRIES) {
+        start = end - DEBUG_RING_ENTRIES;
+    }
+
+    for (i = start; i < end; i++) {
+        e = &debug_ring[i & (DEBUG_RING_ENTRIES - 1)];
+        if (e->seq != i + 1) continue;
+
+        pos = 0;
+        pos = debug_ring_append(buf, pos, sizeof(buf), "(");
+        pos = debug_ring_append_num(buf, pos, sizeof(buf),
+                                    e->tv.tv_sec, 10, 0);
+        pos = debug_ring_append(buf, pos, sizeof(buf), ".");
+        pos = debug_ring_append_num(buf, pos, sizeof(buf),
+                                    e->tv.tv_usec, 10, 6);
+        pos = debug_ring_append(buf, pos, sizeof(buf), ") [");
+        pos = debug_ring_append(buf, pos, sizeof(buf), debug_prg_name);
+        pos = debug_ring_append(buf, pos, sizeof(buf), "] [");
+        pos = debug_ring_append(buf, pos, sizeof(buf), e->function);
+        pos = debug_ring_append(buf, pos, sizeof(buf), "] (0x");
+        pos = debug_ring_append_num(buf, pos, sizeof(buf),
+                                    e->level, 16, 4);
+        pos = debug_ring_append(buf, pos, sizeof(buf), "): ");
+        pos = debug_ring_append(buf, pos, sizeof(buf), e->msg);
+        if (pos > 0 && buf[pos - 1] != '\n' && pos < sizeof(buf)) {
+            buf[pos++] = '\n';
+        }
+
+        debug_write_fd(fd, buf, pos);
+    }
+
+    debug_ring_flushed = end;
+}
+
+/* writes out what the log writer did not get to, without taking locks */
+static void debug_async_crash_dump(int fd)
+{
+#ifdef HAVE_PTHREAD
+    struct debug_async_queue *q = &debug_async_queue;
+    size_t tail;
+    size_t head;
+    size_t off;
+    size_t chunk;
+
+    if (!debug_async_running) {
+        return;
+    }
+
+    tail = q->tail;
+    head = q->head;
+    if (head - tail > DEBUG_ASYNC_QUEUE_SIZE) {
+        return;
+    }
+
+    while (tail != head) {
+        off = tail & (DEBUG_ASYNC_QUEUE_SIZE - 1);
+        chunk = MIN(head - tail, DEBUG_ASYNC_QUEUE_SIZE - off);
+        debug_write_fd(fd, q->buf + off, chunk);
+        tail += chunk;
+    }
+#endif
+}
+
+static struct sigaction debug_old_segv;
+static struct sigaction debug_old_abrt;
+static struct sigaction debug_old_bus;
+
+static void debug_crash_handler(int sig)
+{
+    FILE *f = debug_file ? debug_file : stderr;
+
+    debug_async_crash_dump(fileno(f));
+    debug_ring_crash_dump(fileno(f));
+
+    /* let the previous handler or the default action finish the job */
+    switch (sig) {
+    case SIGSEGV:
+        sigaction(sig, &debug_old_segv, NULL);
+        break;
+    case SIGABRT:
+        sigaction(sig, &debug_old_abrt, NULL);
+        break;
+    case SIGBUS:
+        sigaction(sig, &debug_old_bus, NULL);
+        break;
+    }
+    raise(sig);
+}
+
+errno_t debug_catch_crashes(void)
+{
+    static bool installed = false;
+    struct sigaction sa;
+    int ret;
+
+    if (installed) {
+        return EOK;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = debug_crash_handler;
+    sigemptyset(&sa.sa_mask);
+
+    ret = sigaction(SIGSEGV, &sa, &debug_old_segv);
+    if (ret == 0) ret = sigaction(SIGABRT, &sa, &debug_old_abrt);
+    if (ret == 0) ret = sigaction(SIGBUS, &sa, &debug_old_bus);
+    if (ret != 0) {
+        return errno;
+    }
+
+    installed = true;
+    return EOK;
 }
 
 int debug_get_level(int old_level)
@@ -237,9 +902,29 @@ int rotate_debug_files(void)
 {
     int ret;
     errno_t error;
+    FILE *old_file;
 
     if (!debug_to_file) return EOK;
 
+    if (debug_async_running) {
+        /* open the new file here, closing the old one may block on a slow
+         * disk and is left to the log writer */
+        old_file = debug_file;
+        debug_file = NULL;
+
+        ret = open_debug_file();
+        if (ret == EOK) {
+            ret = debug_async_switch_file(old_file);
+            if (ret != EOK) {
+                fclose(debug_file);
+            }
+        }
+        if (ret != EOK) {
+            debug_file = old_file;
+        }
+        return ret;
+    }
+
     do {
         error = 0;
         ret = fclose(debug_file);
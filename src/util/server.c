@@ -413,6 +413,7 @@ int server_setup(const char *name, int flags,
     bool dt;
     bool dl;
     bool dm;
+    bool da;
     struct tevent_signal *tes;
     struct logrotate_ctx *lctx;
 
@@ -537,6 +538,30 @@ int server_setup(const char *name, int flags,
         else debug_microseconds = 0;
     }
 
+    /* messages only kept in memory until something goes wrong */
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_RING_LEVEL,
+                         0, &debug_ring_level);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("Error reading from confdb (%d) "
+                                     "[%s]\n", ret, strerror(ret)));
+        return ret;
+    }
+
+    if (debug_ring_level != 0) {
+        debug_ring_level = debug_convert_old_level(debug_ring_level);
+
+        ret = debug_ring_init();
+        if (ret == EOK) {
+            ret = debug_catch_crashes();
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Cannot set up the debug ring buffer "
+                                      "(%d) [%s]\n", ret, strerror(ret)));
+            debug_ring_level = 0;
+        }
+    }
+
     /* same for debug to file */
     dl = (debug_to_file != 0);
     ret = confdb_get_bool(ctx->confdb_ctx, conf_entry,
@@ -572,6 +597,28 @@ int server_setup(const char *name, int flags,
         }
     }
 
+    /* write the log from a separate thread */
+    ret = confdb_get_bool(ctx->confdb_ctx, conf_entry,
+                          CONFDB_SERVICE_DEBUG_ASYNC,
+                          false, &da);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("Error reading from confdb (%d) [%s]\n",
+                                     ret, strerror(ret)));
+        return ret;
+    }
+
+    if (da) {
+        ret = debug_async_start();
+        if (ret == EOK) {
+            ret = debug_catch_crashes();
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Cannot start the log writer thread, "
+                                      "writing the log directly (%d) [%s]\n",
+                                      ret, strerror(ret)));
+        }
+    }
+
     sss_log(SSS_LOG_INFO, "Starting up");
 
     DEBUG(SSSDBG_TRACE_FUNC, ("CONFDB: %s\n", conf_db));
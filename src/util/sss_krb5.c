@@ -617,6 +617,76 @@ done:
     return krberr;
 }
 
+errno_t sss_krb5_copy_ccache(const char *src_ccname, const char *dst_ccname)
+{
+    krb5_error_code kerr;
+    krb5_context ctx = NULL;
+    krb5_ccache src_cc = NULL;
+    krb5_ccache dst_cc = NULL;
+    krb5_principal princ = NULL;
+    errno_t ret;
+
+    kerr = krb5_init_context(&ctx);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to init kerberos context.\n"));
+        return EIO;
+    }
+
+    kerr = krb5_cc_resolve(ctx, src_ccname, &src_cc);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to resolve [%s].\n", src_ccname));
+        ret = EIO;
+        goto done;
+    }
+
+    kerr = krb5_cc_resolve(ctx, dst_ccname, &dst_cc);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to resolve [%s].\n", dst_ccname));
+        ret = EIO;
+        goto done;
+    }
+
+    kerr = krb5_cc_get_principal(ctx, src_cc, &princ);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("No default principal in [%s].\n", src_ccname));
+        ret = EIO;
+        goto done;
+    }
+
+    /* Initializing drops whatever the destination held before */
+    kerr = krb5_cc_initialize(ctx, dst_cc, princ);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to init [%s].\n", dst_ccname));
+        ret = EIO;
+        goto done;
+    }
+
+    kerr = krb5_cc_copy_creds(ctx, src_cc, dst_cc);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Failed to copy credentials from [%s] to [%s].\n",
+               src_ccname, dst_ccname));
+        ret = EIO;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    if (princ != NULL) {
+        krb5_free_principal(ctx, princ);
+    }
+    if (dst_cc != NULL) {
+        krb5_cc_close(ctx, dst_cc);
+    }
+    if (src_cc != NULL) {
+        krb5_cc_close(ctx, src_cc);
+    }
+    krb5_free_context(ctx);
+    return ret;
+}
+
 krb5_error_code KRB5_CALLCONV sss_krb5_get_init_creds_opt_set_expire_callback(
                                                    krb5_context context,
                                                    krb5_get_init_creds_opt *opt,
@@ -74,6 +74,10 @@ krb5_error_code check_for_valid_tgt(krb5_context context,
                                     krb5_ccache ccache, const char *realm,
                                     const char *client_princ_str, bool *result);
 
+/* Replace the contents of dst_ccname with the credentials found in
+ * src_ccname */
+errno_t sss_krb5_copy_ccache(const char *src_ccname, const char *dst_ccname);
+
 int sss_krb5_verify_keytab_ex(const char *principal, const char *keytab_name,
                               krb5_context context, krb5_keytab keytab);
 
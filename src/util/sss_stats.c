@@ -0,0 +1,276 @@
+/*
+    SSSD
+
+    sss_stats.c
+
+    Per-process latency histograms and event counters
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+
+struct sss_stats_timer {
+    const char *name;
+    uint64_t count;
+    uint64_t failed;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t buckets[SSS_STATS_BUCKETS];
+};
+
+struct sss_stats_counter {
+    const char *name;
+    uint64_t value;
+};
+
+static struct sss_stats_timer sss_stats_timers[SSS_STATS_MAX_TIMERS];
+static size_t sss_stats_num_timers = 0;
+
+static struct sss_stats_counter sss_stats_counters[SSS_STATS_MAX_COUNTERS];
+static size_t sss_stats_num_counters = 0;
+
+static sss_stats_section_fn *sss_stats_sections[SSS_STATS_MAX_SECTIONS];
+static size_t sss_stats_num_sections = 0;
+
+static time_t sss_stats_since = 0;
+
+static const char *sss_stats_bucket_names[SSS_STATS_BUCKETS] = {
+    "<100us", "<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s"
+};
+
+static struct sss_stats_timer *sss_stats_get_timer(const char *name)
+{
+    size_t i;
+
+    /* the names are constants, comparing the pointers is usually enough */
+    for (i = 0; i < sss_stats_num_timers; i++) {
+        if (sss_stats_timers[i].name == name) {
+            return &sss_stats_timers[i];
+        }
+    }
+
+    for (i = 0; i < sss_stats_num_timers; i++) {
+        if (strcmp(sss_stats_timers[i].name, name) == 0) {
+            return &sss_stats_timers[i];
+        }
+    }
+
+    if (sss_stats_num_timers == SSS_STATS_MAX_TIMERS) {
+        return NULL;
+    }
+
+    if (sss_stats_since == 0) {
+        sss_stats_since = time(NULL);
+    }
+
+    sss_stats_timers[sss_stats_num_timers].name = name;
+    return &sss_stats_timers[sss_stats_num_timers++];
+}
+
+static struct sss_stats_counter *sss_stats_get_counter(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < sss_stats_num_counters; i++) {
+        if (sss_stats_counters[i].name == name) {
+            return &sss_stats_counters[i];
+        }
+    }
+
+    for (i = 0; i < sss_stats_num_counters; i++) {
+        if (strcmp(sss_stats_counters[i].name, name) == 0) {
+            return &sss_stats_counters[i];
+        }
+    }
+
+    if (sss_stats_num_counters == SSS_STATS_MAX_COUNTERS) {
+        return NULL;
+    }
+
+    if (sss_stats_since == 0) {
+        sss_stats_since = time(NULL);
+    }
+
+    sss_stats_counters[sss_stats_num_counters].name = name;
+    return &sss_stats_counters[sss_stats_num_counters++];
+}
+
+void sss_stats_start(struct timeval *start)
+{
+    gettimeofday(start, NULL);
+}
+
+void sss_stats_time(const char *name, const struct timeval *start,
+                    bool failed)
+{
+    struct timeval now;
+    int64_t usec;
+
+    gettimeofday(&now, NULL);
+
+    usec = (int64_t) (now.tv_sec - start->tv_sec) * 1000000
+           + (now.tv_usec - start->tv_usec);
+    if (usec < 0) {
+        /* the clock was set back */
+        usec = 0;
+    }
+
+    sss_stats_add(name, usec, failed);
+}
+
+void sss_stats_add(const char *name, uint64_t usec, bool failed)
+{
+    struct sss_stats_timer *timer;
+    uint64_t limit;
+    int bucket;
+
+    timer = sss_stats_get_timer(name);
+    if (timer == NULL) {
+        return;
+    }
+
+    timer->count++;
+    if (failed) {
+        timer->failed++;
+    }
+    timer->total_us += usec;
+    if (usec > timer->max_us) {
+        timer->max_us = usec;
+    }
+
+    limit = 100;
+    for (bucket = 0; bucket < SSS_STATS_BUCKETS - 1; bucket++) {
+        if (usec < limit) break;
+        limit *= 10;
+    }
+    timer->buckets[bucket]++;
+}
+
+void sss_stats_inc(const char *name)
+{
+    struct sss_stats_counter *counter;
+
+    counter = sss_stats_get_counter(name);
+    if (counter == NULL) {
+        return;
+    }
+
+    counter->value++;
+}
+
+char *sss_stats_dump(TALLOC_CTX *mem_ctx)
+{
+    struct sss_stats_timer *timer;
+    char *section;
+    char *out;
+    size_t i;
+    int b;
+
+    out = talloc_asprintf(mem_ctx, "Statistics of %s since %llu\n",
+                          debug_prg_name,
+                          (unsigned long long) sss_stats_since);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    if (sss_stats_num_timers > 0) {
+        out = talloc_asprintf_append(out, "\n%-24s %9s %7s %9s %9s",
+                                     "Operation", "Count", "Failed",
+                                     "Avg(us)", "Max(us)");
+        for (b = 0; out != NULL && b < SSS_STATS_BUCKETS; b++) {
+            out = talloc_asprintf_append(out, " %8s",
+                                         sss_stats_bucket_names[b]);
+        }
+        if (out != NULL) {
+            out = talloc_strdup_append(out, "\n");
+        }
+    }
+
+    for (i = 0; out != NULL && i < sss_stats_num_timers; i++) {
+        timer = &sss_stats_timers[i];
+        out = talloc_asprintf_append(out, "%-24s %9llu %7llu %9llu %9llu",
+                                     timer->name,
+                                     (unsigned long long) timer->count,
+                                     (unsigned long long) timer->failed,
+                                     (unsigned long long)
+                                        (timer->total_us / timer->count),
+                                     (unsigned long long) timer->max_us);
+        for (b = 0; out != NULL && b < SSS_STATS_BUCKETS; b++) {
+            out = talloc_asprintf_append(out, " %8llu",
+                                         (unsigned long long)
+                                            timer->buckets[b]);
+        }
+        if (out != NULL) {
+            out = talloc_strdup_append(out, "\n");
+        }
+    }
+
+    if (out != NULL && sss_stats_num_counters > 0) {
+        out = talloc_asprintf_append(out, "\n%-24s %9s\n",
+                                     "Counter", "Value");
+    }
+
+    for (i = 0; out != NULL && i < sss_stats_num_counters; i++) {
+        out = talloc_asprintf_append(out, "%-24s %9llu\n",
+                                     sss_stats_counters[i].name,
+                                     (unsigned long long)
+                                        sss_stats_counters[i].value);
+    }
+
+    for (i = 0; out != NULL && i < sss_stats_num_sections; i++) {
+        section = sss_stats_sections[i](out);
+        if (section != NULL) {
+            out = talloc_asprintf_append(out, "\n%s", section);
+            talloc_free(section);
+        }
+    }
+
+    return out;
+}
+
+int sss_stats_add_section(sss_stats_section_fn *fn)
+{
+    size_t i;
+
+    for (i = 0; i < sss_stats_num_sections; i++) {
+        if (sss_stats_sections[i] == fn) {
+            return EOK;
+        }
+    }
+
+    if (sss_stats_num_sections == SSS_STATS_MAX_SECTIONS) {
+        return ENOSPC;
+    }
+
+    sss_stats_sections[sss_stats_num_sections++] = fn;
+    return EOK;
+}
+
+void sss_stats_reset(void)
+{
+    memset(sss_stats_timers, 0, sizeof(sss_stats_timers));
+    sss_stats_num_timers = 0;
+    memset(sss_stats_counters, 0, sizeof(sss_stats_counters));
+    sss_stats_num_counters = 0;
+    sss_stats_since = time(NULL);
+}
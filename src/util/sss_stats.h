@@ -0,0 +1,78 @@
+/*
+    SSSD
+
+    sss_stats.h
+
+    Per-process latency histograms and event counters
+
+    Copyright (C) 2013 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SSS_STATS_H__
+#define __SSS_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <talloc.h>
+
+/* The statistics are kept per process. Timers and counters are identified
+ * by their name, which must be a string constant because only the pointer
+ * is stored. Only the first SSS_STATS_MAX_TIMERS timers and
+ * SSS_STATS_MAX_COUNTERS counters are kept, later names are ignored. */
+
+#define SSS_STATS_MAX_TIMERS 64
+#define SSS_STATS_MAX_COUNTERS 64
+#define SSS_STATS_MAX_SECTIONS 8
+
+/* Latency histogram buckets: <100us, <1ms, <10ms, <100ms, <1s, <10s, more */
+#define SSS_STATS_BUCKETS 7
+
+/* Names of the spans shared between components */
+#define SSS_STATS_DP_REQUEST "dp_request"
+#define SSS_STATS_SYSDB_SEARCH "sysdb_search"
+#define SSS_STATS_SYSDB_WRITE "sysdb_write"
+#define SSS_STATS_LDAP_OP "ldap_op"
+
+/* Marks the start of a span */
+void sss_stats_start(struct timeval *start);
+
+/* Records the time elapsed since start under name */
+void sss_stats_time(const char *name, const struct timeval *start,
+                    bool failed);
+
+/* Records a duration given in microseconds under name */
+void sss_stats_add(const char *name, uint64_t usec, bool failed);
+
+/* Increments the counter name */
+void sss_stats_inc(const char *name);
+
+/* Returns the current statistics as a human readable table */
+char *sss_stats_dump(TALLOC_CTX *mem_ctx);
+
+/* Returns an extra section of the dump, or NULL if there is nothing to
+ * show */
+typedef char *(sss_stats_section_fn)(TALLOC_CTX *mem_ctx);
+
+/* Appends the output of fn to every dump, for modules that keep more
+ * detailed statistics of their own. Returns ENOSPC when there are
+ * already SSS_STATS_MAX_SECTIONS sections. */
+int sss_stats_add_section(sss_stats_section_fn *fn);
+
+/* Drops everything recorded so far */
+void sss_stats_reset(void);
+
+#endif /* __SSS_STATS_H__ */
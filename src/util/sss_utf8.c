@@ -77,6 +77,47 @@ uint8_t *sss_utf8_tolower(const uint8_t *s, size_t len, size_t *_nlen)
 #error No unicode library
 #endif
 
+#ifdef HAVE_LIBUNISTRING
+uint8_t *sss_utf8_casefold(const uint8_t *s, size_t len, size_t *_nlen)
+{
+    size_t flen;
+    uint8_t *folded;
+
+    folded = u8_casefold(s, len, NULL, NULL, NULL, &flen);
+    if (!folded) return NULL;
+
+    if (_nlen) *_nlen = flen;
+    return folded;
+}
+#elif HAVE_GLIB2
+uint8_t *sss_utf8_casefold(const uint8_t *s, size_t len, size_t *_nlen)
+{
+    gchar *gfolded;
+    size_t nlen;
+    uint8_t *folded;
+
+    gfolded = g_utf8_casefold((const gchar *) s, len);
+    if (!gfolded) return NULL;
+
+    /* strlen() is safe here because g_utf8_casefold() always
+     * null-terminates */
+    nlen = strlen(gfolded);
+
+    folded = g_malloc(nlen);
+    if (!folded) {
+        g_free(gfolded);
+        return NULL;
+    }
+
+    memcpy(folded, gfolded, nlen);
+    g_free(gfolded);
+    if (_nlen) *_nlen = nlen;
+    return (uint8_t *) folded;
+}
+#else
+#error No unicode library
+#endif
+
 #ifdef HAVE_LIBUNISTRING
 bool sss_utf8_check(const uint8_t *s, size_t n)
 {
@@ -507,3 +507,71 @@ sss_get_cased_name_list(TALLOC_CTX *mem_ctx, const char * const *orig,
     *_cased = out;
     return EOK;
 }
+
+errno_t
+sss_get_missing_names(TALLOC_CTX *mem_ctx, const char * const *names,
+                      const char * const *found, bool case_sensitive,
+                      const char ***_missing)
+{
+    TALLOC_CTX *tmp_ctx;
+    hash_table_t *table;
+    hash_key_t key;
+    hash_value_t value;
+    const char **missing;
+    size_t num, i, n;
+    errno_t ret;
+
+    for (num = 0; names && names[num]; num++);
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_hash_create(tmp_ctx, 0, &table);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    key.type = HASH_KEY_STRING;
+    value.type = HASH_VALUE_UNDEF;
+    for (i = 0; found && found[i]; i++) {
+        key.str = sss_get_cased_name(tmp_ctx, found[i], case_sensitive);
+        if (key.str == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = hash_enter(table, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            ret = EIO;
+            goto done;
+        }
+    }
+
+    missing = talloc_array(tmp_ctx, const char *, num + 1);
+    if (missing == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0, n = 0; i < num; i++) {
+        key.str = sss_get_cased_name(tmp_ctx, names[i], case_sensitive);
+        if (key.str == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        if (!hash_has_key(table, &key)) {
+            missing[n++] = names[i];
+        }
+    }
+    missing[n] = NULL;
+
+    *_missing = talloc_steal(mem_ctx, missing);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
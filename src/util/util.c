@@ -120,7 +120,7 @@ done:
     return ret;
 }
 
-static void free_args(char **args)
+void free_args(char **args)
 {
     int i;
 
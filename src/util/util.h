@@ -58,8 +58,16 @@ extern int debug_level;
 extern int debug_timestamps;
 extern int debug_microseconds;
 extern int debug_to_file;
+extern int debug_ring_level;
 extern const char *debug_log_file;
+void debug_prefix(const char *function, int level);
 void debug_fn(const char *format, ...);
+errno_t debug_async_start(void);
+void debug_async_stop(void);
+errno_t debug_ring_init(void);
+void debug_ring_fn(const char *function, int level, const char *format, ...);
+void debug_ring_flush(void);
+errno_t debug_catch_crashes(void);
 int debug_get_level(int old_level);
 int debug_convert_old_level(int old_level);
 errno_t set_debug_file_from_fd(const int fd);
@@ -87,6 +95,12 @@ errno_t set_debug_file_from_fd(const int fd);
 #define SSSDBG_MICROSECONDS_UNRESOLVED   -1
 #define SSSDBG_MICROSECONDS_DEFAULT       0
 
+/* logging a message of these levels writes out the debug ring buffer */
+#define SSSDBG_RING_FLUSH_LEVELS (SSSDBG_FATAL_FAILURE | SSSDBG_CRIT_FAILURE)
+
+/* turns the parenthesized DEBUG body into an argument list */
+#define DEBUG_RING_ARGS(...) __VA_ARGS__
+
 #define SSSD_DEBUG_OPTS \
         {"debug-level", 'd', POPT_ARG_INT, &debug_level, 0, \
          _("Debug level"), NULL}, \
@@ -115,32 +129,15 @@ errno_t set_debug_file_from_fd(const int fd);
 #define DEBUG(level, body) do { \
     int __debug_macro_newlevel = debug_get_level(level); \
     if (DEBUG_IS_SET(__debug_macro_newlevel)) { \
-        if (debug_timestamps) { \
-            struct timeval __debug_macro_tv; \
-            struct tm *__debug_macro_tm; \
-            char __debug_macro_datetime[20]; \
-            int __debug_macro_year; \
-            gettimeofday(&__debug_macro_tv, NULL); \
-            __debug_macro_tm = localtime(&__debug_macro_tv.tv_sec); \
-            __debug_macro_year = __debug_macro_tm->tm_year + 1900; \
-            /* get date time without year */ \
-            memcpy(__debug_macro_datetime, ctime(&__debug_macro_tv.tv_sec), 19); \
-            __debug_macro_datetime[19] = '\0'; \
-            if (debug_microseconds) { \
-                debug_fn("(%s:%.6d %d) [%s] [%s] (%#.4x): ", \
-                         __debug_macro_datetime, __debug_macro_tv.tv_usec, \
-                         __debug_macro_year, debug_prg_name, \
-                         __FUNCTION__, __debug_macro_newlevel); \
-            } else { \
-                debug_fn("(%s %d) [%s] [%s] (%#.4x): ", \
-                         __debug_macro_datetime, __debug_macro_year, \
-                         debug_prg_name, __FUNCTION__, __debug_macro_newlevel); \
-            } \
-        } else { \
-            debug_fn("[%s] [%s] (%#.4x): ", \
-                     debug_prg_name, __FUNCTION__, __debug_macro_newlevel); \
+        if (debug_ring_level && \
+                (__debug_macro_newlevel & SSSDBG_RING_FLUSH_LEVELS)) { \
+            debug_ring_flush(); \
         } \
+        debug_prefix(__FUNCTION__, __debug_macro_newlevel); \
         debug_fn body; \
+    } else if (debug_ring_level & __debug_macro_newlevel) { \
+        debug_ring_fn(__FUNCTION__, __debug_macro_newlevel, \
+                      DEBUG_RING_ARGS body); \
     } \
 } while(0)
 
@@ -156,32 +153,14 @@ errno_t set_debug_file_from_fd(const int fd);
 #define DEBUG_MSG(level, function, message) do { \
     int __debug_macro_newlevel = debug_get_level(level); \
     if (DEBUG_IS_SET(__debug_macro_newlevel)) { \
-        if (debug_timestamps) { \
-            struct timeval __debug_macro_tv; \
-            struct tm *__debug_macro_tm; \
-            char __debug_macro_datetime[20]; \
-            int __debug_macro_year; \
-            gettimeofday(&__debug_macro_tv, NULL); \
-            __debug_macro_tm = localtime(&__debug_macro_tv.tv_sec); \
-            __debug_macro_year = __debug_macro_tm->tm_year + 1900; \
-            /* get date time without year */ \
-            memcpy(__debug_macro_datetime, ctime(&__debug_macro_tv.tv_sec), 19); \
-            __debug_macro_datetime[19] = '\0'; \
-            if (debug_microseconds) { \
-                debug_fn("(%s:%.6d %d) [%s] [%s] (%#.4x): %s\n", \
-                         __debug_macro_datetime, __debug_macro_tv.tv_usec, \
-                         __debug_macro_year, debug_prg_name, \
-                         function, __debug_macro_newlevel, message); \
-            } else { \
-                debug_fn("(%s %d) [%s] [%s] (%#.4x): %s\n", \
-                         __debug_macro_datetime, __debug_macro_year, \
-                         debug_prg_name, function, __debug_macro_newlevel, \
-                         message); \
-            } \
-        } else { \
-            debug_fn("[%s] [%s] (%#.4x): %s\n", \
-                     debug_prg_name, function, __debug_macro_newlevel, message); \
+        if (debug_ring_level && \
+                (__debug_macro_newlevel & SSSDBG_RING_FLUSH_LEVELS)) { \
+            debug_ring_flush(); \
         } \
+        debug_prefix(function, __debug_macro_newlevel); \
+        debug_fn("%s\n", message); \
+    } else if (debug_ring_level & __debug_macro_newlevel) { \
+        debug_ring_fn(function, __debug_macro_newlevel, "%s\n", message); \
     } \
 } while(0)
 
@@ -365,6 +344,14 @@ errno_t
 sss_get_cased_name_list(TALLOC_CTX *mem_ctx, const char * const *orig,
                         bool case_sensitive, const char ***_cased);
 
+/* Returns the names that are not in the found list, compared the way a
+ * domain with the given case sensitivity compares them. The returned
+ * array points to the strings of the names list. */
+errno_t
+sss_get_missing_names(TALLOC_CTX *mem_ctx, const char * const *names,
+                      const char * const *found, bool case_sensitive,
+                      const char ***_missing);
+
 /* from backup-file.c */
 int backup_file(const char *src, int dbglvl);
 
@@ -421,6 +408,7 @@ int split_on_separator(TALLOC_CTX *mem_ctx, const char *str,
                        char ***_list, int *size);
 
 char **parse_args(const char *str);
+void free_args(char **args);
 
 errno_t sss_hash_create(TALLOC_CTX *mem_ctx,
                         unsigned long count,